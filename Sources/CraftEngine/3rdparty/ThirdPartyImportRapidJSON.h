@@ -5,5 +5,7 @@
 #include <rapidjson/writer.h>
 #include <rapidjson/stringbuffer.h>
 #include <rapidjson/document.h>
+#include <rapidjson/filereadstream.h>
+#include <rapidjson/reader.h>
 
 #endif // !CRAFT_ENGINE_THIRD_PARTY_IMPORT_RAPID_JSON_H_
\ No newline at end of file
@@ -3,7 +3,17 @@
 #define CRAFT_ENGINE_THIRD_PARTY_IMPORT_STB_IMAGE_H_
 
 #define STB_IMAGE_IMPLEMENTATION
+// this stb_image (v2.13) keeps the failure reason in a plain static that every failing load writes,
+// the macro routes it to a thread local slot so concurrent decodes do not race on it
+// (stb_image 2.26 and later do the same with STBI_THREAD_LOCAL, drop this when updating)
+#define stbi__g_failure_reason (*stbi__thread_failure_reason())
 #include <stb/stb_image.h>
+#undef stbi__g_failure_reason
+static const char** stbi__thread_failure_reason()
+{
+	thread_local const char* reason = nullptr;
+	return &reason;
+}
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <stb/stb_image_write.h>
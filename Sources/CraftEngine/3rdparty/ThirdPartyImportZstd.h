@@ -0,0 +1,10 @@
+#pragma once
+#ifndef CRAFT_ENGINE_THIRD_PARTY_IMPORT_ZSTD_H_
+#define CRAFT_ENGINE_THIRD_PARTY_IMPORT_ZSTD_H_
+
+#ifdef _MSC_VER
+#pragma comment(lib, "libzstd_static.lib")
+#endif
+#include <zstd.h>
+
+#endif // !CRAFT_ENGINE_THIRD_PARTY_IMPORT_ZSTD_H_
@@ -27,6 +27,7 @@
 #include <exception>
 #include <regex>
 #include <type_traits>
+#include <cstddef>
 
 #define CRAFT_ENGINE_STATIC static
 #define CRAFT_ENGINE_EXPLICIT explicit
@@ -58,6 +59,28 @@ struct type_name \
 
 
 
+// simd instruction sets, define CRAFT_ENGINE_NO_SIMD to fall back to scalar code
+#ifndef CRAFT_ENGINE_NO_SIMD
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CRAFT_ENGINE_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(__SSE4_1__) || (defined(_MSC_VER) && defined(__AVX__))
+#define CRAFT_ENGINE_SIMD_SSE41
+#include <smmintrin.h>
+#endif
+#if defined(__AVX2__)
+#define CRAFT_ENGINE_SIMD_AVX2
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define CRAFT_ENGINE_SIMD_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
+
+
 namespace CraftEngine
 {
 
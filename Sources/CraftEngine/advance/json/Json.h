@@ -1,23 +1,292 @@
 #pragma once
 #include "../../3rdparty/ThirdPartyImportRapidJSON.h"
+#include "../../core/Serialize.h"
 
+#include <stdio.h>
+#include <functional>
+#include <limits>
+#include <memory>
 #include <string>
 
+
+/*
+ Json binding for reflected types (craft_engine_reflect_begin ...), without building a DOM:
+
+   writing   JsonFile (in memory) or JsonStreamWriter (fixed size buffer flushed to a FILE* or
+             any sink, e.g. a socket), both rapidjson::Writer based
+   reading   BasicJsonReader, a pull parser over rapidjson's iterative SAX reader, reading in
+             place when given a mutable buffer (JsonInsituReader)
+   ndjson    JsonStreamWriter::writeLine, BasicJsonReader::readBatch
+
+ Bound types: bool, integers, floating point, enums (as numbers), std::string (and
+ std::string_view for in situ reading), reflected structs as objects, string keyed maps as
+ objects, sequences, sets and fixed arrays as arrays. Unknown object members are skipped.
+*/
+
 namespace CraftEngine
 {
 	namespace json
 	{
 
-		class JsonFile
+		namespace detail
 		{
+			using namespace core::reflect::detail;
+
+			enum class JsonCategory
+			{
+				eUnsupported, eBool, eInteger, eFloat, eEnum, eString, eCString, eObject, eArray, eSet, eFixedArray, eReflected,
+			};
+
+			template<typename T>
+			constexpr JsonCategory jsonCategory()
+			{
+				if constexpr (std::is_same_v<T, bool>)
+					return JsonCategory::eBool;
+				else if constexpr (std::is_integral_v<T>)
+					return JsonCategory::eInteger;
+				else if constexpr (std::is_floating_point_v<T>)
+					return JsonCategory::eFloat;
+				else if constexpr (std::is_enum_v<T>)
+					return JsonCategory::eEnum;
+				else if constexpr (is_basic_string<T>::value)
+					return std::is_same_v<typename T::value_type, char> ? JsonCategory::eString : JsonCategory::eUnsupported;
+				else if constexpr (std::is_same_v<T, const char*> || std::is_same_v<T, char*> || (std::is_array_v<T> && std::is_same_v<std::remove_extent_t<T>, char>))
+					return JsonCategory::eCString;
+				else if constexpr (std::is_pointer_v<T>)
+					return JsonCategory::eUnsupported;
+				else if constexpr (is_std_array<T>::value || std::is_array_v<T>)
+					return JsonCategory::eFixedArray;
+				else if constexpr (is_map_like<T>::value)
+					return std::is_same_v<typename T::key_type, std::string> ? JsonCategory::eObject : JsonCategory::eUnsupported;
+				else if constexpr (is_set_like<T>::value)
+					return JsonCategory::eSet;
+				else if constexpr (is_sequence<T>::value)
+					return JsonCategory::eArray;
+				else if constexpr (core::reflect::TypeInfo<T>::fields.size != 0)
+					return JsonCategory::eReflected;
+				else
+					return JsonCategory::eUnsupported;
+			}
+
+			template<typename T>
+			constexpr bool integerFits(int64_t value)
+			{
+				if constexpr (std::is_signed_v<T>)
+					return value >= int64_t(std::numeric_limits<T>::min()) && value <= int64_t(std::numeric_limits<T>::max());
+				else
+					return value >= 0 && uint64_t(value) <= uint64_t(std::numeric_limits<T>::max());
+			}
+
+			template<typename Writer, typename T>
+			bool writeValue(Writer& writer, const T& value)
+			{
+				constexpr auto category = jsonCategory<T>();
+				static_assert(category != JsonCategory::eUnsupported, "Type has no json binding.");
+				if constexpr (category == JsonCategory::eBool)
+					return writer.Bool(value);
+				else if constexpr (category == JsonCategory::eInteger)
+				{
+					if constexpr (std::is_signed_v<T>)
+						return sizeof(T) <= 4 ? writer.Int(int(value)) : writer.Int64(int64_t(value));
+					else
+						return sizeof(T) <= 4 ? writer.Uint(unsigned(value)) : writer.Uint64(uint64_t(value));
+				}
+				else if constexpr (category == JsonCategory::eFloat)
+					return writer.Double(double(value));
+				else if constexpr (category == JsonCategory::eEnum)
+					return writeValue(writer, std::underlying_type_t<T>(value));
+				else if constexpr (category == JsonCategory::eString)
+					return writer.String(value.data(), rapidjson::SizeType(value.size()), true);
+				else if constexpr (category == JsonCategory::eCString && std::is_array_v<T>)
+					return writer.String(value);
+				else if constexpr (category == JsonCategory::eCString)
+					return value == nullptr ? writer.Null() : writer.String(value);
+				else if constexpr (category == JsonCategory::eObject)
+				{
+					bool success = writer.StartObject();
+					for (auto& it : value)
+						success = success && writer.Key(it.first.data(), rapidjson::SizeType(it.first.size()), true) && writeValue(writer, it.second);
+					return success && writer.EndObject();
+				}
+				else if constexpr (category == JsonCategory::eReflected)
+				{
+					bool success = writer.StartObject();
+					core::reflect::TypeInfo<T>::fields.ForEach([&](auto field) {
+						success = success && writer.Key(field.name.data(), rapidjson::SizeType(field.name.size())) && writeValue(writer, value.*(field.value));
+					});
+					return success && writer.EndObject();
+				}
+				else
+				{
+					bool success = writer.StartArray();
+					for (auto&& element : value)
+						success = success && writeValue(writer, static_cast<const std::remove_cv_t<std::remove_reference_t<decltype(*std::begin(value))>>&>(element));
+					return success && writer.EndArray();
+				}
+			}
+
+			template<typename T>
+			bool readValue(const rapidjson::Value& json, T& value)
+			{
+				constexpr auto category = jsonCategory<T>();
+				static_assert(category != JsonCategory::eUnsupported && category != JsonCategory::eCString, "Type has no json binding.");
+				if constexpr (category == JsonCategory::eBool)
+				{
+					if (!json.IsBool())
+						return false;
+					value = json.GetBool();
+					return true;
+				}
+				else if constexpr (category == JsonCategory::eInteger)
+				{
+					if (json.IsInt64() && integerFits<T>(json.GetInt64()))
+						value = T(json.GetInt64());
+					else if (json.IsUint64() && std::is_unsigned_v<T> && json.GetUint64() <= std::numeric_limits<T>::max())
+						value = T(json.GetUint64());
+					else
+						return false;
+					return true;
+				}
+				else if constexpr (category == JsonCategory::eFloat)
+				{
+					if (!json.IsNumber())
+						return false;
+					value = T(json.GetDouble());
+					return true;
+				}
+				else if constexpr (category == JsonCategory::eEnum)
+				{
+					std::underlying_type_t<T> underlying;
+					if (!readValue(json, underlying))
+						return false;
+					value = T(underlying);
+					return true;
+				}
+				else if constexpr (category == JsonCategory::eString)
+				{
+					if (!json.IsString())
+						return false;
+					value = T(json.GetString(), json.GetStringLength());
+					return true;
+				}
+				else if constexpr (category == JsonCategory::eObject)
+				{
+					if (!json.IsObject())
+						return false;
+					value.clear();
+					for (auto it = json.MemberBegin(); it != json.MemberEnd(); it++)
+						if (!readValue(it->value, value[std::string(it->name.GetString(), it->name.GetStringLength())]))
+							return false;
+					return true;
+				}
+				else if constexpr (category == JsonCategory::eReflected)
+				{
+					if (!json.IsObject())
+						return false;
+					bool success = true;
+					core::reflect::TypeInfo<T>::fields.ForEach([&](auto field) {
+						auto member = json.FindMember(rapidjson::Value(rapidjson::StringRef(field.name.data(), rapidjson::SizeType(field.name.size()))));
+						if (member != json.MemberEnd())
+							success = success && readValue(member->value, value.*(field.value));
+					});
+					return success;
+				}
+				else if constexpr (category == JsonCategory::eFixedArray)
+				{
+					if (!json.IsArray() || json.Size() != fixed_array<T>::value)
+						return false;
+					for (rapidjson::SizeType i = 0; i < json.Size(); i++)
+						if (!readValue(json[i], value[i]))
+							return false;
+					return true;
+				}
+				else
+				{
+					if (!json.IsArray())
+						return false;
+					value.clear();
+					for (auto& it : json.GetArray())
+					{
+						typename T::value_type element;
+						if (!readValue(it, element))
+							return false;
+						if constexpr (category == JsonCategory::eSet)
+							value.insert(std::move(element));
+						else
+							value.push_back(std::move(element));
+					}
+					return true;
+				}
+			}
+		}
+
+
+		/*
+		 rapidjson output stream that fills a fixed size buffer and hands it to the sink whenever it
+		 is full or flushed, so the memory used for writing does not grow with the document.
+		*/
+		class JsonFlushStream
+		{
+		public:
+			typedef char Ch;
+			typedef std::function<bool(const char* data, size_t size)> Sink;
 		private:
-			typedef rapidjson::Writer<rapidjson::StringBuffer> Writer;
-			rapidjson::StringBuffer m_buf;
+			std::unique_ptr<char[]> m_buffer;
+			size_t                  m_capacity;
+			size_t                  m_size = 0;
+			Sink                    m_sink;
+			bool                    m_failed = false;
+		public:
+
+			explicit JsonFlushStream(Sink sink, size_t capacity = 64 * 1024)
+				: m_buffer(new char[capacity]), m_capacity(capacity), m_sink(std::move(sink))
+			{
+
+			}
+
+			explicit JsonFlushStream(FILE* file, size_t capacity = 64 * 1024)
+				: JsonFlushStream([file](const char* data, size_t size) { return fwrite(data, 1, size, file) == size; }, capacity)
+			{
+
+			}
+
+			JsonFlushStream(const JsonFlushStream&) = delete;
+			JsonFlushStream& operator=(const JsonFlushStream&) = delete;
+
+			~JsonFlushStream()
+			{
+				Flush();
+			}
+
+			void Put(Ch c)
+			{
+				if (m_size == m_capacity)
+					Flush();
+				m_buffer[m_size++] = c;
+			}
+
+			void Flush()
+			{
+				if (m_size != 0 && !m_failed && !m_sink(m_buffer.get(), m_size))
+					m_failed = true;
+				m_size = 0;
+			}
+
+			bool failed() const { return m_failed; }
+		};
+
+
+		template<typename OutputStream>
+		class BasicJsonWriter
+		{
+		protected:
+			typedef rapidjson::Writer<OutputStream> Writer;
+			OutputStream m_stream;
 			Writer m_writer;
-			rapidjson::Document m_doc;
 		public:
 
-			JsonFile() : m_writer(m_buf)
+			template<typename... Args>
+			explicit BasicJsonWriter(Args&&... args) : m_stream(std::forward<Args>(args)...), m_writer(m_stream)
 			{
 
 			}
@@ -43,22 +312,22 @@ namespace CraftEngine
 			template<typename Type>
 			void write(const char* key, Type&& value)
 			{
-				m_writer.String(key);
-				_Write_Value(value);
+				m_writer.Key(key);
+				detail::writeValue(m_writer, value);
 			}
-			
+
 			template<typename Type>
 			void write(const std::string& key, Type&& value)
 			{
-				m_writer.String(key);
-				_Write_Value(value);
+				m_writer.Key(key.c_str(), rapidjson::SizeType(key.size()), true);
+				detail::writeValue(m_writer, value);
 			}
 
 
 			template<typename Type>
 			void value(Type&& value)
 			{
-				_Write_Value(value);
+				detail::writeValue(m_writer, value);
 			}
 
 			void key(const char* key)
@@ -67,79 +336,455 @@ namespace CraftEngine
 			}
 			void key(const std::string& key)
 			{
-				m_writer.Key(key.c_str());
+				m_writer.Key(key.c_str(), rapidjson::SizeType(key.size()), true);
 			}
 
+			// true once a complete root value has been written
+			bool isComplete() const
+			{
+				return m_writer.IsComplete();
+			}
+
+			Writer& getWriter()
+			{
+				return m_writer;
+			}
+		};
+
+
+		class JsonFile : public BasicJsonWriter<rapidjson::StringBuffer>
+		{
+		public:
+
 			const char* getString()
 			{
-				return m_buf.GetString();
+				return m_stream.GetString();
 			}
 
-			const rapidjson::Document& getDoc()
+			size_t getSize() const
 			{
-				return m_doc;
+				return m_stream.GetSize();
 			}
 
-		private:
-			template<typename Type>
-			typename std::enable_if<std::is_same<Type, int32_t>::value, void>::type
-				_Write_Value(Type value) { m_writer.Int(value); }
-			template<typename Type>
-			typename std::enable_if<std::is_same<Type, uint32_t>::value, void>::type
-				_Write_Value(Type value) { m_writer.Uint(value); }
-			template<typename Type>
-			typename std::enable_if<std::is_same<Type, int64_t>::value, void>::type
-				_Write_Value(Type value) { m_writer.Int64(value); }
-			template<typename Type>
-			typename std::enable_if<std::is_same<Type, uint64_t>::value, void>::type
-				_Write_Value(Type value) { m_writer.Uint64(value); }
-			template<typename Type>
-			typename std::enable_if<std::is_floating_point<Type>::value, void>::type
-				_Write_Value(Type value) { m_writer.Double(value); }
-			template<typename Type>
-			typename std::enable_if<std::is_same<Type, bool>::value, void>::type
-				_Write_Value(Type value) { m_writer.Bool(value); }
-			template<typename Type>
-			typename std::enable_if<std::is_same<Type, std::string>::value, void>::type
-				_Write_Value(const Type& value) { m_writer.String(value.c_str(), value.size(), true); }
-			template<typename Type>
-			typename std::enable_if<std::is_pointer<Type>::value, void>::type
-				_Write_Value(Type value) { m_writer.String(value); }
+			void clear()
+			{
+				m_stream.Clear();
+				m_writer.Reset(m_stream);
+			}
 		};
 
 
+		/*
+		 Writes to a file or sink through a JsonFlushStream. writeLine() writes one complete value
+		 followed by '\n' (NDJSON), after which the writer accepts the next root value.
+		*/
+		class JsonStreamWriter : public BasicJsonWriter<JsonFlushStream>
+		{
+		public:
 
+			explicit JsonStreamWriter(JsonFlushStream::Sink sink, size_t capacity = 64 * 1024) : BasicJsonWriter(std::move(sink), capacity) {}
+			explicit JsonStreamWriter(FILE* file, size_t capacity = 64 * 1024) : BasicJsonWriter(file, capacity) {}
 
+			template<typename T>
+			bool writeLine(const T& obj)
+			{
+				bool success = detail::writeValue(m_writer, obj);
+				m_stream.Put('\n');
+				m_writer.Reset(m_stream);
+				return success && !m_stream.failed();
+			}
 
+			template<typename Iterator>
+			bool writeLines(Iterator begin, Iterator end)
+			{
+				bool success = true;
+				for (auto it = begin; it != end && success; ++it)
+					success = writeLine(*it);
+				return success;
+			}
+
+			bool flush()
+			{
+				m_stream.Flush();
+				return !m_stream.failed();
+			}
+		};
+
+
+		enum class JsonTokenType
+		{
+			eEnd, eError, eNull, eBool, eInt, eUint, eDouble, eString, eKey, eStartObject, eEndObject, eStartArray, eEndArray,
+		};
+
+		// eInt holds every integer that fits int64_t, eUint the larger ones
+		struct JsonToken
+		{
+			JsonTokenType type = JsonTokenType::eEnd;
+			bool          boolean = false;
+			int64_t       integer = 0;
+			uint64_t      unsignedInteger = 0;
+			double        number = 0.0;
+			const char*   string = nullptr;
+			size_t        length = 0;
+
+			std::string_view stringView() const { return std::string_view(string, length); }
+		};
+
+
+		/*
+		 Pull parser: next() / peek() return one token at a time from rapidjson's iterative reader.
+		 Token strings point into the input when parsing in situ and into the reader otherwise,
+		 where they stay valid until the next token is parsed.
+		 Consecutive root values (NDJSON) are read by calling nextDocument() before each.
+		*/
+		template<typename InputStream, unsigned ParseFlags = rapidjson::kParseDefaultFlags>
+		class BasicJsonReader
+		{
+		public:
+			static constexpr unsigned kParseFlags = ParseFlags | rapidjson::kParseStopWhenDoneFlag;
+			static constexpr bool kInsitu = (ParseFlags & rapidjson::kParseInsituFlag) != 0;
+		private:
+
+			struct Handler
+			{
+				JsonToken& token;
+
+				bool set(JsonTokenType type) { token.type = type; return true; }
+				bool Null() { return set(JsonTokenType::eNull); }
+				bool Bool(bool b) { token.boolean = b; return set(JsonTokenType::eBool); }
+				bool Int(int i) { token.integer = i; return set(JsonTokenType::eInt); }
+				bool Uint(unsigned u) { token.integer = u; return set(JsonTokenType::eInt); }
+				bool Int64(int64_t i) { token.integer = i; return set(JsonTokenType::eInt); }
+				bool Uint64(uint64_t u)
+				{
+					if (u <= uint64_t(std::numeric_limits<int64_t>::max()))
+						return Int64(int64_t(u));
+					token.unsignedInteger = u;
+					return set(JsonTokenType::eUint);
+				}
+				bool Double(double d) { token.number = d; return set(JsonTokenType::eDouble); }
+				bool RawNumber(const char*, rapidjson::SizeType, bool) { return false; }
+				bool String(const char* str, rapidjson::SizeType length, bool) { token.string = str; token.length = length; return set(JsonTokenType::eString); }
+				bool Key(const char* str, rapidjson::SizeType length, bool) { token.string = str; token.length = length; return set(JsonTokenType::eKey); }
+				bool StartObject() { return set(JsonTokenType::eStartObject); }
+				bool EndObject(rapidjson::SizeType) { return set(JsonTokenType::eEndObject); }
+				bool StartArray() { return set(JsonTokenType::eStartArray); }
+				bool EndArray(rapidjson::SizeType) { return set(JsonTokenType::eEndArray); }
+			};
+
+			InputStream&      m_stream;
+			rapidjson::Reader m_reader;
+			JsonToken         m_token;
+			bool              m_pending = false;
+			bool              m_fresh = true; // no token parsed since the last IterativeParseInit
+		public:
+
+			explicit BasicJsonReader(InputStream& stream) : m_stream(stream)
+			{
+				m_reader.IterativeParseInit();
+			}
+
+			const JsonToken& peek()
+			{
+				if (!m_pending)
+				{
+					m_pending = true;
+					if (m_reader.IterativeParseComplete())
+					{
+						m_token.type = m_reader.HasParseError() ? JsonTokenType::eError : JsonTokenType::eEnd;
+						return m_token;
+					}
+					m_fresh = false;
+					m_token.type = JsonTokenType::eEnd;
+					Handler handler = { m_token };
+					if (!m_reader.template IterativeParseNext<kParseFlags>(m_stream, handler))
+						m_token.type = JsonTokenType::eError;
+				}
+				return m_token;
+			}
+
+			const JsonToken& next()
+			{
+				peek();
+				m_pending = false;
+				return m_token;
+			}
+
+			/*
+			 Prepares the next root value, to be called before each one (the first included) when
+			 reading several; false at the end of the input, after an error or inside a value.
+			*/
+			bool nextDocument()
+			{
+				if (m_pending || m_reader.HasParseError() || !(m_fresh || m_reader.IterativeParseComplete()))
+					return false;
+				rapidjson::SkipWhitespace(m_stream);
+				if (m_stream.Peek() == '\0')
+					return false;
+				if (!m_fresh)
+					m_reader.IterativeParseInit();
+				m_fresh = true;
+				return true;
+			}
+
+			// only whitespace left after the current root value
+			bool atEnd()
+			{
+				if (m_pending || !m_reader.IterativeParseComplete() || m_reader.HasParseError())
+					return false;
+				rapidjson::SkipWhitespace(m_stream);
+				return m_stream.Peek() == '\0';
+			}
+
+			bool hasError() const { return m_reader.HasParseError(); }
+			size_t errorOffset() const { return m_reader.GetErrorOffset(); }
+
+			// consumes the next value, including everything nested in it
+			bool skipValue()
+			{
+				size_t depth = 0;
+				do
+				{
+					switch (next().type)
+					{
+					case JsonTokenType::eStartObject: case JsonTokenType::eStartArray: depth++; break;
+					case JsonTokenType::eEndObject: case JsonTokenType::eEndArray: depth--; break;
+					case JsonTokenType::eKey: if (depth == 0) return false; break;
+					case JsonTokenType::eEnd: case JsonTokenType::eError: return false;
+					default: break;
+					}
+				} while (depth != 0);
+				return true;
+			}
+
+			template<typename T>
+			bool read(T& value)
+			{
+				using namespace detail;
+				constexpr auto category = jsonCategory<T>();
+				static_assert(category != JsonCategory::eUnsupported && category != JsonCategory::eCString, "Type has no json binding.");
+				// an enum leaves the token to the read of its underlying integer
+				auto& token = category == JsonCategory::eEnum ? peek() : next();
+				if constexpr (category == JsonCategory::eBool)
+				{
+					value = token.boolean;
+					return token.type == JsonTokenType::eBool;
+				}
+				else if constexpr (category == JsonCategory::eInteger)
+				{
+					if (token.type == JsonTokenType::eInt && integerFits<T>(token.integer))
+						value = T(token.integer);
+					else if (token.type == JsonTokenType::eUint && std::is_unsigned_v<T> && token.unsignedInteger <= std::numeric_limits<T>::max())
+						value = T(token.unsignedInteger);
+					else
+						return false;
+					return true;
+				}
+				else if constexpr (category == JsonCategory::eFloat)
+				{
+					if (token.type == JsonTokenType::eDouble)
+						value = T(token.number);
+					else if (token.type == JsonTokenType::eInt)
+						value = T(token.integer);
+					else if (token.type == JsonTokenType::eUint)
+						value = T(token.unsignedInteger);
+					else
+						return false;
+					return true;
+				}
+				else if constexpr (category == JsonCategory::eEnum)
+				{
+					std::underlying_type_t<T> underlying;
+					if (!read(underlying))
+						return false;
+					value = T(underlying);
+					return true;
+				}
+				else if constexpr (category == JsonCategory::eString)
+				{
+					static_assert(!is_string_view<T>::value || kInsitu, "std::string_view members can only be bound when parsing in situ.");
+					if (token.type != JsonTokenType::eString)
+						return false;
+					value = T(token.string, token.length);
+					return true;
+				}
+				else if constexpr (category == JsonCategory::eObject)
+				{
+					if (token.type != JsonTokenType::eStartObject)
+						return false;
+					value.clear();
+					while (true)
+					{
+						auto& key = next();
+						if (key.type == JsonTokenType::eEndObject)
+							return true;
+						if (key.type != JsonTokenType::eKey || !read(value[std::string(key.string, key.length)]))
+							return false;
+					}
+				}
+				else if constexpr (category == JsonCategory::eReflected)
+				{
+					if (token.type != JsonTokenType::eStartObject)
+						return false;
+					while (true)
+					{
+						auto& key = next();
+						if (key.type == JsonTokenType::eEndObject)
+							return true;
+						if (key.type != JsonTokenType::eKey)
+							return false;
+						// the key is compared before reading the value overwrites it
+						bool found = false, success = true;
+						core::reflect::TypeInfo<T>::fields.ForEach([&](auto field) {
+							if (!found && field.name == key.stringView())
+							{
+								found = true;
+								success = read(value.*(field.value));
+							}
+						});
+						if (!(found ? success : skipValue()))
+							return false;
+					}
+				}
+				else
+				{
+					if (token.type != JsonTokenType::eStartArray)
+						return false;
+					if constexpr (category != JsonCategory::eFixedArray)
+						value.clear();
+					size_t count = 0;
+					while (peek().type != JsonTokenType::eEndArray)
+					{
+						if constexpr (category == JsonCategory::eFixedArray)
+						{
+							if (count == fixed_array<T>::value || !read(value[count]))
+								return false;
+						}
+						else
+						{
+							typename T::value_type element;
+							if (!read(element))
+								return false;
+							if constexpr (category == JsonCategory::eSet)
+								value.insert(std::move(element));
+							else
+								value.push_back(std::move(element));
+						}
+						count++;
+					}
+					next();
+					if constexpr (category == JsonCategory::eFixedArray)
+						return count == fixed_array<T>::value;
+					else
+						return true;
+				}
+			}
+
+			/*
+			 Reads up to maxCount consecutive root values into batch (cleared first), returns the
+			 number read; fewer than maxCount means the input ended or a value failed to bind.
+			*/
+			template<typename T>
+			size_t readBatch(std::vector<T>& batch, size_t maxCount)
+			{
+				batch.clear();
+				while (batch.size() < maxCount && nextDocument())
+				{
+					batch.emplace_back();
+					if (!read(batch.back()))
+					{
+						batch.pop_back();
+						break;
+					}
+				}
+				return batch.size();
+			}
+		};
+
+		typedef BasicJsonReader<rapidjson::StringStream> JsonStringReader;
+		typedef BasicJsonReader<rapidjson::InsituStringStream, rapidjson::kParseInsituFlag> JsonInsituReader;
+
+
+
+		template<typename T, typename Writer>
+		bool writeJson(Writer& writer, const T& obj)
+		{
+			return detail::writeValue(writer, obj);
+		}
 		template<typename T>
-		bool writeJson(JsonFile& file, T& obj);
+		bool writeJson(JsonFile& file, const T& obj)
+		{
+			return detail::writeValue(file.getWriter(), obj);
+		}
 		template<typename T>
-		bool readJson(const rapidjson::Value& value, const T& obj);
+		bool readJson(const rapidjson::Value& value, T& obj)
+		{
+			return detail::readValue(value, obj);
+		}
+		template<typename T, typename InputStream, unsigned ParseFlags>
+		bool readJson(BasicJsonReader<InputStream, ParseFlags>& reader, T& obj)
+		{
+			return reader.read(obj) && reader.atEnd();
+		}
 
 
 
 		template<typename T>
 		bool fromJson(const std::string& json, T& obj)
 		{
-			rapidjson::Document doc;
-			doc.Parse(json.c_str());
-			if (doc.HasParseError())
-				return false;
-			return readJson(doc, obj);
+			rapidjson::StringStream stream(json.c_str());
+			JsonStringReader reader(stream);
+			return readJson(reader, obj);
+		}
+		/*
+		 Parses json (null terminated) in place; std::string_view members of obj point into it.
+		*/
+		template<typename T>
+		bool fromJsonInsitu(char* json, T& obj)
+		{
+			rapidjson::InsituStringStream stream(json);
+			JsonInsituReader reader(stream);
+			return readJson(reader, obj);
 		}
 		template<typename T>
 		bool toJson(const T& obj, std::string& json)
 		{
-			JsonFile& file;
+			JsonFile file;
 			auto success = writeJson(file, obj);
 			if (!success)
 				return false;
-			json = file.getString();
+			json.assign(file.getString(), file.getSize());
 			return true;
 		}
 
+		template<typename T>
+		bool readJsonFile(const char* path, T& obj)
+		{
+			FILE* file = fopen(path, "rb");
+			if (file == nullptr)
+				return false;
+			std::unique_ptr<char[]> buffer(new char[64 * 1024]);
+			rapidjson::FileReadStream stream(file, buffer.get(), 64 * 1024);
+			BasicJsonReader<rapidjson::FileReadStream> reader(stream);
+			bool success = readJson(reader, obj);
+			fclose(file);
+			return success;
+		}
+		template<typename T>
+		bool writeJsonFile(const char* path, const T& obj)
+		{
+			FILE* file = fopen(path, "wb");
+			if (file == nullptr)
+				return false;
+			bool success;
+			{
+				JsonStreamWriter writer(file);
+				success = writeJson(writer.getWriter(), obj) && writer.flush();
+			}
+			return (fclose(file) == 0) && success;
+		}
+
 
 
 	}
 }
-
@@ -0,0 +1,166 @@
+#pragma once
+#include "../Json.h"
+#include "../../../core/test/TestCheck.h"
+#include <iostream>
+#include <map>
+#include <set>
+
+
+
+enum class TestJsonKind : int32_t { eLight = 2, eMesh = 5 };
+
+struct TestJsonNode
+{
+	std::string name;
+	TestJsonKind kind;
+	double weight;
+	uint64_t id;
+	int8_t layer;
+	bool visible;
+	float position[3];
+	std::vector<int> children;
+	std::map<std::string, std::string> properties;
+	std::set<std::string> tags;
+};
+craft_engine_reflect_begin(TestJsonNode)
+craft_engine_reflect_field(name)
+craft_engine_reflect_field(kind)
+craft_engine_reflect_field(weight)
+craft_engine_reflect_field(id)
+craft_engine_reflect_field(layer)
+craft_engine_reflect_field(visible)
+craft_engine_reflect_field(position)
+craft_engine_reflect_field(children)
+craft_engine_reflect_field(properties)
+craft_engine_reflect_field(tags)
+craft_engine_reflect_end()
+
+struct TestJsonScene
+{
+	std::string title;
+	std::vector<TestJsonNode> nodes;
+};
+craft_engine_reflect_begin(TestJsonScene)
+craft_engine_reflect_field(title)
+craft_engine_reflect_field(nodes)
+craft_engine_reflect_end()
+
+struct TestJsonName
+{
+	std::string_view name;
+	int layer;
+};
+craft_engine_reflect_begin(TestJsonName)
+craft_engine_reflect_field(name)
+craft_engine_reflect_field(layer)
+craft_engine_reflect_end()
+
+
+
+/*
+ Writes reflected structs as json through JsonFile and a small flush buffer, reads them back
+ with the pull reader (copying and in situ), through the DOM binding and as NDJSON batches.
+*/
+void testJson()
+{
+	using namespace CraftEngine;
+
+	test::TestCheck check("testJson");
+
+	TestJsonScene scene;
+	scene.title = "test \"scene\"\n";
+	for (int i = 0; i < 50; i++)
+	{
+		TestJsonNode node;
+		node.name = "node" + std::to_string(i);
+		node.kind = i % 2 ? TestJsonKind::eMesh : TestJsonKind::eLight;
+		node.weight = i * 0.25 - 3.0;
+		node.id = 0xfedcba9876543210ull + i;
+		node.layer = int8_t(-i);
+		node.visible = i % 3 == 0;
+		node.position[0] = float(i);
+		node.position[1] = 0.5f;
+		node.position[2] = -1.0f;
+		for (int j = 0; j < i % 5; j++)
+			node.children.push_back(j);
+		node.properties["shader"] = "pbr";
+		node.properties["index"] = std::to_string(i);
+		node.tags = { "a", "b" + std::to_string(i % 3) };
+		scene.nodes.push_back(node);
+	}
+	auto same = [](const TestJsonScene& a, const TestJsonScene& b)
+	{
+		if (a.title != b.title || a.nodes.size() != b.nodes.size())
+			return false;
+		for (size_t i = 0; i < a.nodes.size(); i++)
+		{
+			auto& x = a.nodes[i];
+			auto& y = b.nodes[i];
+			if (x.name != y.name || x.kind != y.kind || x.weight != y.weight || x.id != y.id || x.layer != y.layer || x.visible != y.visible
+				|| memcmp(x.position, y.position, sizeof(x.position)) != 0 || x.children != y.children || x.properties != y.properties || x.tags != y.tags)
+				return false;
+		}
+		return true;
+	};
+
+	std::string text;
+	check("toJson", json::toJson(scene, text));
+	TestJsonScene loaded;
+	check("fromJson", json::fromJson(text, loaded) && same(scene, loaded));
+
+	std::vector<char> insitu(text.begin(), text.end());
+	insitu.push_back('\0');
+	loaded = TestJsonScene();
+	check("fromJsonInsitu", json::fromJsonInsitu(insitu.data(), loaded) && same(scene, loaded));
+
+	rapidjson::Document doc;
+	doc.Parse(text.c_str());
+	loaded = TestJsonScene();
+	check("readJson dom", json::readJson(doc, loaded) && same(scene, loaded));
+
+	// a small buffer forces many flushes, the output has to match the in-memory writer
+	std::string streamed;
+	size_t flushes = 0;
+	{
+		json::JsonStreamWriter writer([&](const char* data, size_t size) { flushes++; streamed.append(data, size); return true; }, 64);
+		check("stream write", json::writeJson(writer.getWriter(), scene) && writer.flush());
+	}
+	check("stream output", streamed == text && flushes > text.size() / 64);
+
+	std::string lines;
+	{
+		json::JsonStreamWriter writer([&](const char* data, size_t size) { lines.append(data, size); return true; }, 100);
+		check("writeLines", writer.writeLines(scene.nodes.begin(), scene.nodes.end()) && writer.flush());
+	}
+	rapidjson::StringStream line_stream(lines.c_str());
+	json::JsonStringReader line_reader(line_stream);
+	std::vector<TestJsonNode> batch;
+	TestJsonScene batched;
+	batched.title = scene.title;
+	while (line_reader.readBatch(batch, 16) != 0)
+		batched.nodes.insert(batched.nodes.end(), batch.begin(), batch.end());
+	check("readBatch", line_reader.atEnd() && same(scene, batched));
+
+	char view_text[] = " {\"unknown\": [1, {\"x\": [true, null]}], \"name\": \"in place\", \"layer\": 7} ";
+	TestJsonName name;
+	check("string_view", json::fromJsonInsitu(view_text, name) && name.name == "in place" && name.layer == 7
+		&& name.name.data() > view_text && name.name.data() < view_text + sizeof(view_text));
+
+	TestJsonNode node;
+	check("range", !json::fromJson("{\"layer\": 200}", node));
+	check("type", !json::fromJson("{\"name\": 5}", node));
+	check("fixed array size", !json::fromJson("{\"position\": [1, 2]}", node));
+	check("syntax", !json::fromJson("{\"name\": \"x\",}", node));
+	check("trailing", !json::fromJson("{} {}", node));
+	check("truncated", !json::fromJson(text.substr(0, text.size() / 2), loaded));
+
+	json::JsonFile file;
+	file.startObject();
+	file.key("type");
+	file.value("Texture");
+	file.write("index", 3);
+	file.endObject();
+	check("JsonFile", std::string(file.getString()) == "{\"type\":\"Texture\",\"index\":3}" && file.isComplete());
+
+	check.finish();
+}
@@ -1,10 +1,19 @@
 #pragma once
 #include "../../3rdparty/ThirdPartyImportSqlite3.h"
 
-#include "../../util/Core.h"
+#include "../../core/Core.h"
+#include "../../core/Reflect.h"
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <stdexcept>
+#include <tuple>
+#include <unordered_map>
 
 namespace CraftEngine
 {
@@ -15,24 +24,155 @@ namespace CraftEngine
 		typedef double               SqliteDouble;
 		typedef std::string          SqliteText;
 		typedef std::vector<uint8_t> SqliteBlob;
-		typedef nullptr_t            SqliteNull;
-		typedef util::Variant<
+		typedef std::nullptr_t       SqliteNull;
+		typedef core::Variant<
 			SqliteInteger64,
 			SqliteDouble,
 			SqliteBlob,
 			SqliteText,
 			SqliteNull
 		> SqliteValue;
-	
 
-		class SqliteDB
+
+		enum class SqliteJournalMode
+		{
+			eDefault, // leave the database as it is
+			eDelete,
+			eTruncate,
+			ePersist,
+			eMemory,
+			eWAL,
+			eOff,
+		};
+
+		enum class SqliteSynchronous
+		{
+			eDefault,
+			eOff,
+			eNormal,
+			eFull,
+			eExtra,
+		};
+
+		/*
+		 WAL with synchronous=NORMAL only syncs at checkpoints and lets readers run next to a
+		 writer, the usual choice for an application database.
+		*/
+		struct SqliteOptions
+		{
+			SqliteJournalMode journalMode = SqliteJournalMode::eWAL;
+			SqliteSynchronous synchronous = SqliteSynchronous::eNormal;
+			size_t            statementCacheSize = 64; // prepared statements kept per connection, 0 disables the cache
+			int               busyTimeout = 5000;      // milliseconds to wait on a locked database
+			bool              readOnly = false;
+		};
+
+
+		namespace detail
+		{
+
+			/*
+			 LRU cache of prepared statements keyed by their sql text. acquire() takes a statement
+			 out of the cache and release() puts it back, so a statement in use is never evicted,
+			 and using the same sql twice at once (a query inside a query) prepares a second one.
+			*/
+			class SqliteStatementCache
+			{
+			private:
+				typedef std::list<std::pair<std::string, sqlite3_stmt*>> List;
+				sqlite3* m_sqlite3 = nullptr;
+				size_t m_capacity = 0;
+				List m_lru; // most recently used first
+				std::unordered_map<std::string_view, List::iterator> m_index;
+			public:
+
+				~SqliteStatementCache()
+				{
+					clear();
+				}
+
+				void reset(sqlite3* db, size_t capacity)
+				{
+					clear();
+					m_sqlite3 = db;
+					m_capacity = capacity;
+				}
+
+				sqlite3_stmt* acquire(const std::string& sql)
+				{
+					auto it = m_index.find(sql);
+					if (it != m_index.end())
+					{
+						sqlite3_stmt* stmt = it->second->second;
+						auto node = it->second;
+						m_index.erase(it);
+						m_lru.erase(node);
+						return stmt;
+					}
+					sqlite3_stmt* stmt = nullptr;
+					if (sqlite3_prepare_v3(m_sqlite3, sql.c_str(), int(sql.size()), m_capacity != 0 ? SQLITE_PREPARE_PERSISTENT : 0, &stmt, nullptr) != SQLITE_OK)
+					{
+						sqlite3_finalize(stmt);
+						return nullptr;
+					}
+					return stmt;
+				}
+
+				void release(const std::string& sql, sqlite3_stmt* stmt)
+				{
+					sqlite3_reset(stmt);
+					sqlite3_clear_bindings(stmt);
+					if (m_capacity == 0 || m_index.find(sql) != m_index.end())
+					{
+						sqlite3_finalize(stmt);
+						return;
+					}
+					m_lru.emplace_front(sql, stmt);
+					m_index.emplace(m_lru.front().first, m_lru.begin());
+					if (m_lru.size() > m_capacity)
+					{
+						m_index.erase(m_lru.back().first);
+						sqlite3_finalize(m_lru.back().second);
+						m_lru.pop_back();
+					}
+				}
+
+				void clear()
+				{
+					m_index.clear();
+					for (auto& it : m_lru)
+						sqlite3_finalize(it.second);
+					m_lru.clear();
+				}
+
+				size_t size() const
+				{
+					return m_lru.size();
+				}
+			};
+
+			template<typename T> struct is_tuple : std::false_type {};
+			template<typename... Ts> struct is_tuple<std::tuple<Ts...>> : std::true_type {};
+			template<typename A, typename B> struct is_tuple<std::pair<A, B>> : std::true_type {};
+		}
+
+
+		class SqliteTransaction;
+
+
+		class SqliteDB : core::NonCopyable
 		{
 		private:
 
 			sqlite3* m_sqlite3 = nullptr;
+			detail::SqliteStatementCache m_cache;
+			int m_savepointDepth = 0;
+			friend class SqliteTransaction;
 
 		public:
 
+			typedef SqliteOptions Options;
+
 			struct SQLStatement
 			{
 			private:
@@ -40,30 +180,56 @@ namespace CraftEngine
 				void* unused;
 				SQLStatement(void* v):unused(v)
 				{
-					
-				}
 
+				}
+			public:
 				bool isValid()
 				{
 					return unused != nullptr;
 				}
 			};
 
-			bool open(const char* filename)
+			SqliteDB() = default;
+
+			~SqliteDB()
 			{
-				int code = sqlite3_open(filename, &m_sqlite3);
-				if (code == SQLITE_OK)
-					return true;
-				else
+				close();
+			}
+
+			bool open(const char* filename, const Options& options = Options())
+			{
+				close();
+				int flags = options.readOnly ? SQLITE_OPEN_READONLY : SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+				int code = sqlite3_open_v2(filename, &m_sqlite3, flags, nullptr);
+				if (code != SQLITE_OK)
 				{
+					sqlite3_close(m_sqlite3);
+					m_sqlite3 = nullptr;
 					return false;
 				}
+				m_cache.reset(m_sqlite3, options.statementCacheSize);
+				sqlite3_busy_timeout(m_sqlite3, options.busyTimeout);
+
+				static const char* journal_modes[] = { nullptr, "DELETE", "TRUNCATE", "PERSIST", "MEMORY", "WAL", "OFF" };
+				static const char* synchronous_modes[] = { nullptr, "OFF", "NORMAL", "FULL", "EXTRA" };
+				// a read-only connection cannot switch the journal mode, it follows the file
+				if (journal_modes[int(options.journalMode)] != nullptr && !options.readOnly)
+					execute(std::string("PRAGMA journal_mode=") + journal_modes[int(options.journalMode)]);
+				if (synchronous_modes[int(options.synchronous)] != nullptr)
+					execute(std::string("PRAGMA synchronous=") + synchronous_modes[int(options.synchronous)]);
+				return true;
 			}
 
-			bool close() throw (std::runtime_error)
+			bool isOpen() const
+			{
+				return m_sqlite3 != nullptr;
+			}
+
+			bool close()
 			{
 				if (m_sqlite3 != nullptr)
 				{
+					m_cache.clear();
 					int code = sqlite3_close(m_sqlite3);
 					while (code == SQLITE_BUSY)
 					{
@@ -76,11 +242,14 @@ namespace CraftEngine
 						else
 							throw std::runtime_error("");
 					}
+					m_sqlite3 = nullptr;
+					m_savepointDepth = 0;
 					return true;
 				}
 				return false;
 			}
 
+			// runs one or more statements without parameters, not cached
 			bool execute(const std::string& sql)
 			{
 				auto code = sqlite3_exec(m_sqlite3, sql.c_str(), nullptr, nullptr, nullptr);
@@ -92,16 +261,14 @@ namespace CraftEngine
 				}
 			}
 
+			// runs a single statement through the statement cache
 			template<typename... Args>
 			bool execute(const std::string& sql, Args&&... args)
 			{
-				SQLStatement stmt = prepareStmt(sql);
-				auto code = bindStmtParams(stmt, args);
-				bool success = false;
-				if (code == SQLITE_OK)
-					success = execute(stmt);
-				releaseStmt(stmt);
-				return success;
+				CachedStatement stmt(*this, sql);
+				if (stmt.get() == nullptr || _Bind_Params(stmt.get(), 1, std::forward<Args>(args)...) != SQLITE_OK)
+					return false;
+				return sqlite3_step(stmt.get()) == SQLITE_DONE;
 			}
 
 			bool execute(SQLStatement stmt)
@@ -114,8 +281,8 @@ namespace CraftEngine
 
 
 
-			template<typename ResultType = int64_t>
-			ResultType executeScalar(const std::string& sql)
+			template<typename ResultType = int64_t, typename... Args>
+			ResultType executeScalar(const std::string& sql, Args&&... args)
 			{
 				static_assert((
 					std::is_same<ResultType, int64_t>::value ||
@@ -124,20 +291,80 @@ namespace CraftEngine
 					std::is_same<ResultType, std::vector<uint8_t>>::value
 					), "unsupport type.");
 				ResultType result = ResultType();
-				SQLStatement stmt = prepareStmt(sql);
-				if (!stmt.isValid())
+				CachedStatement stmt(*this, sql);
+				if (stmt.get() == nullptr)
 				{
 					throw std::runtime_error("sql syntax error.");
 				}
-				auto code = sqlite3_step((sqlite3_stmt*)stmt.unused);
+				if (_Bind_Params(stmt.get(), 1, std::forward<Args>(args)...) != SQLITE_OK)
+					return result;
+				auto code = sqlite3_step(stmt.get());
 				if (code == SQLITE_ROW)
 				{
-					result = getStmtValue(stmt, 0).get<ResultType>();
+					result = getStmtValue(SQLStatement(stmt.get()), 0).get<ResultType>();
 				}
-				releaseStmt(stmt);
 				return result;
 			}
 
+			/*
+			 Calls row(SQLStatement) for each result row, read the columns with getStmtValue();
+			 row may return false to stop early.
+			*/
+			template<typename Func, typename... Args>
+			bool query(const std::string& sql, Func&& row, Args&&... args)
+			{
+				CachedStatement stmt(*this, sql);
+				if (stmt.get() == nullptr || _Bind_Params(stmt.get(), 1, std::forward<Args>(args)...) != SQLITE_OK)
+					return false;
+				int code;
+				while ((code = sqlite3_step(stmt.get())) == SQLITE_ROW)
+				{
+					if constexpr (std::is_same_v<decltype(row(SQLStatement(nullptr))), bool>)
+					{
+						if (!row(SQLStatement(stmt.get())))
+							return true;
+					}
+					else
+						row(SQLStatement(stmt.get()));
+				}
+				return code == SQLITE_DONE;
+			}
+
+			SqliteTransaction transaction(bool immediate = false);
+
+			/*
+			 Runs sql once per row in a single transaction with one prepared statement. A row is a
+			 tuple or pair, a reflected struct (bound in field order) or a single value. Rolls back
+			 and returns false if any row fails.
+			*/
+			template<typename Iterator>
+			bool bulkInsert(const std::string& sql, Iterator begin, Iterator end);
+
+			template<typename Range>
+			bool bulkInsert(const std::string& sql, const Range& rows)
+			{
+				return bulkInsert(sql, std::begin(rows), std::end(rows));
+			}
+
+			int64_t lastInsertRowId() const
+			{
+				return sqlite3_last_insert_rowid(m_sqlite3);
+			}
+
+			int changes() const
+			{
+				return sqlite3_changes(m_sqlite3);
+			}
+
+			const char* errorMessage() const
+			{
+				return sqlite3_errmsg(m_sqlite3);
+			}
+
+			size_t cachedStatementCount() const
+			{
+				return m_cache.size();
+			}
 
 			SqliteValue getStmtValue(SQLStatement stmt, int index)
 			{
@@ -145,16 +372,20 @@ namespace CraftEngine
 				int column_type = sqlite3_column_type((sqlite3_stmt*)stmt.unused, index);
 				switch (column_type)
 				{
-				case SQLITE_INTEGER:		
-					return sqlite3_column_int64(s, index); break;
+				case SQLITE_INTEGER:
+					return SqliteInteger64(sqlite3_column_int64(s, index)); break;
 				case SQLITE_FLOAT:
 					return sqlite3_column_double(s, index); break;
 				case SQLITE_TEXT:
-					return std::string((const char*)sqlite3_column_text(s, index)); break;
+				{
+					auto text = (const char*)sqlite3_column_text(s, index);
+					return std::string(text, sqlite3_column_bytes(s, index));
+					break;
+				}
 				case SQLITE_BLOB:
 				{
-					std::vector<uint8_t> data(strlen((const char*)sqlite3_column_blob(s, index)));
-					memcpy(data.data(), sqlite3_column_blob(s, index), data.size());
+					auto blob = (const uint8_t*)sqlite3_column_blob(s, index);
+					std::vector<uint8_t> data(blob, blob + sqlite3_column_bytes(s, index));
 					return data;
 					break;
 				}
@@ -163,14 +394,20 @@ namespace CraftEngine
 				}
 			}
 
+			int getStmtColumnCount(SQLStatement stmt)
+			{
+				return sqlite3_column_count((sqlite3_stmt*)stmt.unused);
+			}
 
 
-			template<typename Type, typename... Args>
+
+			template<typename... Args>
 			int bindStmtParams(SQLStatement stmt, Args&&... args)
 			{
-				return _Bind_Params((sqlite3_stmt*)stmt.unused, 1, args);
+				return _Bind_Params((sqlite3_stmt*)stmt.unused, 1, std::forward<Args>(args)...);
 			}
 
+			// the caller owns statements made here, see execute / query for cached ones
 			SQLStatement prepareStmt(const std::string& sql)
 			{
 				sqlite3_stmt* stmt = nullptr;
@@ -187,6 +424,19 @@ namespace CraftEngine
 			}
 		private:
 
+			// a statement borrowed from the cache for the current scope
+			class CachedStatement
+			{
+			private:
+				SqliteDB& m_db;
+				const std::string& m_sql;
+				sqlite3_stmt* m_stmt;
+			public:
+				CachedStatement(SqliteDB& db, const std::string& sql) : m_db(db), m_sql(sql), m_stmt(db.m_cache.acquire(sql)) {}
+				CachedStatement(const CachedStatement&) = delete;
+				~CachedStatement() { if (m_stmt != nullptr) m_db.m_cache.release(m_sql, m_stmt); }
+				sqlite3_stmt* get() const { return m_stmt; }
+			};
 
 			int _Bind_Params(sqlite3_stmt* stmt, int index)
 			{
@@ -201,57 +451,304 @@ namespace CraftEngine
 				{
 					return code;
 				}
-				_Bind_Params(stmt, index + 1, std::forward<Args>(args)...);
-				return code;
+				return _Bind_Params(stmt, index + 1, std::forward<Args>(args)...);
 			}
 
-			template<typename Type>
-			typename std::enable_if<std::is_same<Type, int32_t>::value, int>::type
-				_Bind_Value(sqlite3_stmt* stmt, int index, Type value)
+			template<typename Row>
+			int _Bind_Row(sqlite3_stmt* stmt, const Row& row)
 			{
-				return sqlite3_bind_int(stmt, index, std::forward<Type>(value));
+				if constexpr (detail::is_tuple<Row>::value)
+					return std::apply([&](const auto&... values) { return _Bind_Params(stmt, 1, values...); }, row);
+				else if constexpr (core::reflect::TypeInfo<Row>::fields.size != 0)
+				{
+					int code = SQLITE_OK, index = 1;
+					core::reflect::TypeInfo<Row>::fields.ForEach([&](auto field) {
+						if (code == SQLITE_OK)
+							code = _Bind_Value(stmt, index++, row.*(field.value));
+					});
+					return code;
+				}
+				else
+					return _Bind_Value(stmt, 1, row);
 			}
 
 			template<typename Type>
-			typename std::enable_if<std::is_same<Type, int64_t>::value, int>::type
-				_Bind_Value(sqlite3_stmt* stmt, int index, Type value)
+			int _Bind_Value(sqlite3_stmt* stmt, int index, const Type& value)
 			{
-				return sqlite3_bind_int64(stmt, index, std::forward<Type>(value));
+				using T = std::decay_t<Type>;
+				if constexpr (std::is_same_v<T, std::nullptr_t>)
+					return sqlite3_bind_null(stmt, index);
+				else if constexpr (std::is_integral_v<T> && sizeof(T) <= sizeof(int32_t) && !std::is_same_v<T, uint32_t>)
+					return sqlite3_bind_int(stmt, index, int(value));
+				else if constexpr (std::is_integral_v<T>)
+					return sqlite3_bind_int64(stmt, index, sqlite3_int64(value));
+				else if constexpr (std::is_enum_v<T>)
+					return sqlite3_bind_int64(stmt, index, sqlite3_int64(value));
+				else if constexpr (std::is_floating_point_v<T>)
+					return sqlite3_bind_double(stmt, index, double(value));
+				else if constexpr (std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view>)
+					return sqlite3_bind_text(stmt, index, value.data(), int(value.size()), SQLITE_TRANSIENT);
+				else if constexpr (std::is_array_v<Type> && std::is_same_v<std::remove_cv_t<std::remove_extent_t<Type>>, char>)
+					return sqlite3_bind_text(stmt, index, value, -1, SQLITE_TRANSIENT);
+				else if constexpr (std::is_same_v<T, char*> || std::is_same_v<T, const char*>)
+					return value == nullptr ? sqlite3_bind_null(stmt, index) : sqlite3_bind_text(stmt, index, value, -1, SQLITE_TRANSIENT);
+				else if constexpr (std::is_same_v<T, std::vector<uint8_t>>)
+					return sqlite3_bind_blob(stmt, index, value.data(), int(value.size()), SQLITE_TRANSIENT);
+				else if constexpr (std::is_same_v<T, SqliteValue>)
+				{
+					if (value.template isSame<SqliteInteger64>()) return _Bind_Value(stmt, index, value.template get<SqliteInteger64>());
+					if (value.template isSame<SqliteDouble>()) return _Bind_Value(stmt, index, value.template get<SqliteDouble>());
+					if (value.template isSame<SqliteText>()) return _Bind_Value(stmt, index, value.template get<SqliteText>());
+					if (value.template isSame<SqliteBlob>()) return _Bind_Value(stmt, index, value.template get<SqliteBlob>());
+					return sqlite3_bind_null(stmt, index);
+				}
+				else
+				{
+					static_assert(sizeof(T) == 0, "unsupport type.");
+					return SQLITE_MISUSE;
+				}
 			}
+		};
 
-			template<typename Type>
-			typename std::enable_if<std::is_floating_point<Type>::value, int>::type
-				_Bind_Value(sqlite3_stmt* stmt, int index, Type value)
+
+		/*
+		 Transaction scope: commit() makes the changes permanent, leaving the scope without it
+		 rolls them back. Opened inside another transaction it becomes a savepoint, so helpers
+		 like bulkInsert can be called within a larger transaction.
+		*/
+		class SqliteTransaction
+		{
+		private:
+			SqliteDB* m_db = nullptr;
+			int       m_depth = 0; // 0 for the outermost transaction
+		public:
+
+			SqliteTransaction() = default;
+
+			SqliteTransaction(SqliteDB& db, bool immediate = false)
 			{
-				return sqlite3_bind_double(stmt, index, std::forward<Type>(value));
+				bool nested = sqlite3_get_autocommit(db.m_sqlite3) == 0;
+				int depth = nested ? db.m_savepointDepth + 1 : 0;
+				bool success = nested
+					? db.execute("SAVEPOINT craft_engine_" + std::to_string(depth))
+					: db.execute(std::string(immediate ? "BEGIN IMMEDIATE" : "BEGIN"));
+				if (success)
+				{
+					m_db = &db;
+					m_depth = depth;
+					if (nested)
+						db.m_savepointDepth = depth;
+				}
 			}
 
-			template<typename Type>
-			typename std::enable_if<std::is_same<Type, std::string>::value, int>::type
-				_Bind_Value(sqlite3_stmt* stmt, int index, const Type& value)
+			SqliteTransaction(SqliteTransaction&& other) noexcept : m_db(other.m_db), m_depth(other.m_depth)
 			{
-				return sqlite3_bind_text(stmt, index, value.data(), value.length(), SQLITE_TRANSIENT);
+				other.m_db = nullptr;
 			}
 
-			template<typename Type>
-			typename std::enable_if<std::is_same<Type, char*>::value || std::is_same<Type, const char*>::value, int>::type
-				_Bind_Value(sqlite3_stmt* stmt, int index, Type value)
+			SqliteTransaction& operator=(SqliteTransaction&& other) noexcept
 			{
-				return sqlite3_bind_text(stmt, index, value, strlen(value), SQLITE_TRANSIENT);
+				if (this != &other)
+				{
+					rollback();
+					m_db = other.m_db;
+					m_depth = other.m_depth;
+					other.m_db = nullptr;
+				}
+				return *this;
 			}
 
-			template<typename Type>
-			typename std::enable_if<std::is_same<Type, std::vector<uint8_t>>::value, int>::type
-				_Bind_Value(sqlite3_stmt* stmt, int index, const Type& value)
+			~SqliteTransaction()
 			{
-				return sqlite3_bind_blob(stmt, index, value.data(), value.size(), SQLITE_TRANSIENT);
+				rollback();
 			}
 
-			template<typename Type>
-			typename std::enable_if<std::is_same<Type, nullptr_t>::value, int>::type
-				_Bind_Value(sqlite3_stmt* stmt, int index, Type value)
+			bool isActive() const
 			{
-				return sqlite3_bind_null(stmt, index, value);
+				return m_db != nullptr;
+			}
+
+			bool commit()
+			{
+				if (m_db == nullptr)
+					return false;
+				bool success = m_depth == 0
+					? m_db->execute(std::string("COMMIT"))
+					: m_db->execute("RELEASE craft_engine_" + std::to_string(m_depth));
+				if (success)
+					finish();
+				return success;
+			}
+
+			bool rollback()
+			{
+				if (m_db == nullptr)
+					return false;
+				bool success = m_depth == 0
+					? m_db->execute(std::string("ROLLBACK"))
+					: m_db->execute("ROLLBACK TO craft_engine_" + std::to_string(m_depth)) && m_db->execute("RELEASE craft_engine_" + std::to_string(m_depth));
+				finish();
+				return success;
+			}
+
+		private:
+			void finish()
+			{
+				if (m_depth != 0)
+					m_db->m_savepointDepth = m_depth - 1;
+				m_db = nullptr;
+			}
+		};
+
+
+		inline SqliteTransaction SqliteDB::transaction(bool immediate)
+		{
+			return SqliteTransaction(*this, immediate);
+		}
+
+		template<typename Iterator>
+		bool SqliteDB::bulkInsert(const std::string& sql, Iterator begin, Iterator end)
+		{
+			auto scope = transaction(true);
+			if (!scope.isActive())
+				return false;
+			{
+				CachedStatement stmt(*this, sql);
+				if (stmt.get() == nullptr)
+					return false;
+				for (auto it = begin; it != end; ++it)
+				{
+					if (_Bind_Row(stmt.get(), *it) != SQLITE_OK || sqlite3_step(stmt.get()) != SQLITE_DONE)
+						return false;
+					sqlite3_reset(stmt.get());
+				}
+			}
+			return scope.commit();
+		}
+
+
+		/*
+		 A fixed set of connections to one database for concurrent readers (or writers waiting
+		 on each other through the busy timeout). acquire() blocks until a connection is free and
+		 returns it for the lifetime of the lease; each connection has its own statement cache.
+		 A pool without connections, or a timed acquire that runs out, returns an empty lease.
+		*/
+		class SqliteConnectionPool : core::NonCopyable
+		{
+		private:
+			std::vector<std::unique_ptr<SqliteDB>> m_connections;
+			std::vector<SqliteDB*> m_free;
+			std::mutex m_mutex;
+			std::condition_variable m_condition;
+		public:
+
+			class Lease
+			{
+			private:
+				SqliteConnectionPool* m_pool = nullptr;
+				SqliteDB* m_db = nullptr;
+				friend class SqliteConnectionPool;
+				Lease(SqliteConnectionPool* pool, SqliteDB* db) : m_pool(pool), m_db(db) {}
+			public:
+				Lease(Lease&& other) noexcept : m_pool(other.m_pool), m_db(other.m_db) { other.m_db = nullptr; }
+				Lease(const Lease&) = delete;
+				Lease() = default;
+				// The connection held so far goes back to the pool before the other one is taken over
+				Lease& operator=(Lease&& other) noexcept
+				{
+					if (this != &other)
+					{
+						if (m_db != nullptr)
+							m_pool->release(m_db);
+						m_pool = other.m_pool;
+						m_db = other.m_db;
+						other.m_db = nullptr;
+					}
+					return *this;
+				}
+				Lease& operator=(const Lease&) = delete;
+				~Lease() { if (m_db != nullptr) m_pool->release(m_db); }
+				bool isValid() const { return m_db != nullptr; }
+				explicit operator bool() const { return m_db != nullptr; }
+				SqliteDB* operator->() const { return m_db; }
+				SqliteDB& operator*() const { return *m_db; }
+			};
+
+			SqliteConnectionPool() = default;
+
+			bool open(const char* filename, size_t size, const SqliteOptions& options = SqliteOptions())
+			{
+				close();
+				for (size_t i = 0; i < size; i++)
+				{
+					auto db = std::make_unique<SqliteDB>();
+					if (!db->open(filename, options))
+					{
+						close();
+						return false;
+					}
+					m_free.push_back(db.get());
+					m_connections.push_back(std::move(db));
+				}
+				return true;
+			}
+
+			// all leases have to be returned first
+			void close()
+			{
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_free.clear();
+					m_connections.clear();
+				}
+				// waiters wake up to an empty pool and leave with an empty lease
+				m_condition.notify_all();
+			}
+
+			size_t size() const
+			{
+				return m_connections.size();
+			}
+
+			Lease acquire()
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_condition.wait(lock, [this]() { return !m_free.empty() || m_connections.empty(); });
+				return _Take();
+			}
+
+			Lease acquire(std::chrono::milliseconds timeout)
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_condition.wait_for(lock, timeout, [this]() { return !m_free.empty() || m_connections.empty(); });
+				return _Take();
+			}
+
+			// returns an empty lease at once instead of waiting
+			Lease tryAcquire()
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				return _Take();
+			}
+
+		private:
+			// m_mutex is held
+			Lease _Take()
+			{
+				if (m_free.empty())
+					return Lease();
+				SqliteDB* db = m_free.back();
+				m_free.pop_back();
+				return Lease(this, db);
+			}
+
+			void release(SqliteDB* db)
+			{
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_free.push_back(db);
+				}
+				m_condition.notify_one();
 			}
 		};
 
@@ -260,4 +757,3 @@ namespace CraftEngine
 
 	}
 }
-
@@ -0,0 +1,147 @@
+#pragma once
+#include "../Sqlite3.h"
+#include "../../../core/test/TestCheck.h"
+#include <atomic>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+
+
+
+struct TestSqliteAsset
+{
+	int64_t id;
+	std::string path;
+	double size;
+};
+craft_engine_reflect_begin(TestSqliteAsset)
+craft_engine_reflect_field(id)
+craft_engine_reflect_field(path)
+craft_engine_reflect_field(size)
+craft_engine_reflect_end()
+
+
+
+/*
+ Bulk inserts rows in one transaction, checks the statement cache, nested transaction
+ rollback and concurrent readers through SqliteConnectionPool on a WAL database.
+*/
+void testSqlite3()
+{
+	using namespace CraftEngine;
+
+	test::TestCheck check("testSqlite3");
+
+	auto path = (std::filesystem::temp_directory_path() / "craft_engine_test.db").string();
+	std::filesystem::remove(path);
+	std::filesystem::remove(path + "-wal");
+	std::filesystem::remove(path + "-shm");
+
+	{
+		sqlite::SqliteDB db;
+		sqlite::SqliteDB::Options options;
+		options.statementCacheSize = 4;
+		check("open", db.open(path.c_str(), options));
+		check("wal", db.executeScalar<std::string>("PRAGMA journal_mode") == "wal");
+		check("create", db.execute("CREATE TABLE asset (id INTEGER PRIMARY KEY, path TEXT, size REAL)")
+			&& db.execute("CREATE TABLE tag (asset INTEGER, name TEXT)"));
+
+		std::vector<std::tuple<int64_t, std::string, double>> rows;
+		for (int i = 0; i < 20000; i++)
+			rows.emplace_back(i, "textures/" + std::to_string(i) + ".png", i * 0.5);
+		check("bulkInsert tuples", db.bulkInsert("INSERT INTO asset VALUES (?, ?, ?)", rows));
+		check("count", db.executeScalar("SELECT COUNT(*) FROM asset") == 20000);
+		check("value", db.executeScalar<std::string>("SELECT path FROM asset WHERE id = ?", 1234) == "textures/1234.png");
+		check("double", db.executeScalar<double>("SELECT size FROM asset WHERE id = ?", int64_t(10)) == 5.0);
+
+		std::vector<TestSqliteAsset> assets = { { 100000, "a.bin", 1.0 }, { 100001, "b.bin", 2.0 } };
+		check("bulkInsert reflected", db.bulkInsert("INSERT INTO asset VALUES (?, ?, ?)", assets.begin(), assets.end()));
+		check("duplicate key rolls back", !db.bulkInsert("INSERT INTO asset VALUES (?, ?, ?)", std::vector<TestSqliteAsset>{ { 100002, "c", 0 }, { 100000, "d", 0 } }));
+		check("rolled back", db.executeScalar("SELECT COUNT(*) FROM asset WHERE id >= 100000") == 2);
+
+		{
+			auto outer = db.transaction();
+			check("execute", db.execute("INSERT INTO tag VALUES (?, ?)", 1, "diffuse"));
+			{
+				auto inner = db.transaction();
+				check("nested", inner.isActive() && db.execute("INSERT INTO tag VALUES (?, ?)", 2, std::string("normal")));
+			}
+			check("savepoint rollback", db.executeScalar("SELECT COUNT(*) FROM tag") == 1);
+			check("commit", outer.commit());
+		}
+		check("committed", db.executeScalar("SELECT COUNT(*) FROM tag") == 1);
+
+		int64_t sum = 0;
+		check("query", db.query("SELECT id FROM asset WHERE id < ? ORDER BY id", [&](sqlite::SqliteDB::SQLStatement row)
+		{
+			int64_t id = db.getStmtValue(row, 0).get<int64_t>();
+			// a statement running inside another one must not evict it
+			for (int i = 0; i < 6; i++)
+				db.executeScalar("SELECT ? + " + std::to_string(i), id);
+			sum += id;
+		}, 100));
+		check("query rows", sum == 99 * 100 / 2);
+		check("cache bound", db.cachedStatementCount() <= 4);
+
+		std::vector<uint8_t> blob = { 0, 1, 2, 0, 3 };
+		check("blob", db.execute("INSERT INTO tag VALUES (?, ?)", 3, blob) && db.executeScalar<std::vector<uint8_t>>("SELECT name FROM tag WHERE asset = 3") == blob);
+	}
+
+	sqlite::SqliteConnectionPool pool;
+	sqlite::SqliteOptions read_options;
+	read_options.readOnly = true;
+	check("pool open", pool.open(path.c_str(), 3, read_options));
+	std::atomic<int> errors = 0;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 6; t++)
+	{
+		threads.emplace_back([&, t]()
+		{
+			for (int n = 0; n < 200; n++)
+			{
+				auto db = pool.acquire();
+				int64_t id = (t * 997 + n * 31) % 20000;
+				if (db->executeScalar<double>("SELECT size FROM asset WHERE id = ?", id) != id * 0.5)
+					errors++;
+			}
+		});
+	}
+	for (auto& thread : threads)
+		thread.join();
+	check("pool readers", errors == 0);
+	{
+		// every connection leased: a timed or non-blocking acquire comes back empty
+		std::vector<sqlite::SqliteConnectionPool::Lease> leases;
+		for (int i = 0; i < 3; i++)
+			leases.push_back(pool.acquire());
+		auto start = std::chrono::steady_clock::now();
+		auto timed_out = pool.acquire(std::chrono::milliseconds(50));
+		check("pool acquire timeout", !timed_out && std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(50));
+		check("pool try acquire", !pool.tryAcquire());
+		leases.pop_back();
+		auto returned = pool.acquire(std::chrono::milliseconds(50));
+		check("pool acquire returned", returned.isValid() && returned->executeScalar<double>("SELECT size FROM asset WHERE id = 2") == 1.0);
+
+		// assigning over a lease hands its connection back, an empty lease included
+		returned = pool.tryAcquire();
+		check("pool lease assign empty", !returned && pool.tryAcquire().isValid());
+		returned = pool.acquire();
+		check("pool lease assign acquired", returned.isValid() && !pool.tryAcquire());
+		returned = std::move(leases[0]);
+		check("pool lease assign moved", returned.isValid() && !leases[0] && returned->executeScalar<double>("SELECT size FROM asset WHERE id = 2") == 1.0);
+		leases[0] = pool.tryAcquire();
+		check("pool lease assign released", leases[0].isValid() && !pool.tryAcquire());
+		auto& self = leases[1];
+		leases[1] = std::move(self);
+		check("pool lease self assign", leases[1].isValid() && leases[1]->executeScalar<double>("SELECT size FROM asset WHERE id = 4") == 2.0);
+	}
+	pool.close();
+	check("pool acquire closed", !pool.acquire() && !pool.acquire(std::chrono::milliseconds(10)));
+	sqlite::SqliteConnectionPool empty_pool;
+	check("pool acquire empty", !empty_pool.acquire() && empty_pool.size() == 0);
+
+	std::filesystem::remove(path);
+	std::filesystem::remove(path + "-wal");
+	std::filesystem::remove(path + "-shm");
+	check.finish();
+}
@@ -12,8 +12,14 @@ namespace CraftEngine
 	namespace core
 	{
 
+		class ImageIOService;
+
+		/*
+		 Pixels are allocated with malloc so buffers returned by stbi_load can be adopted without a copy.
+		*/
 		class Bitmap
 		{
+			friend class ImageIOService;
 		public:
 			enum Format
 			{
@@ -61,21 +67,25 @@ namespace CraftEngine
 			Format m_format;
 		public:
 
-			//Bitmap(Bitmap&& bitmap)
-			//{
-			//	swap(bitmap);
-			//	bitmap.clear();
-			//}
+			Bitmap(Bitmap&& bitmap) noexcept :Bitmap()
+			{
+				swap(bitmap);
+			}
 
 
 			Bitmap(const Bitmap& bitmap) :m_data(nullptr), m_size(bitmap.size()), m_width(bitmap.width()), m_height(bitmap.height()), m_format(bitmap.m_format)
 			{
-				m_data = new uint8_t[bitmap.m_size];
+				m_data = malloc(bitmap.m_size);
 				memcpy(m_data, bitmap.data(), bitmap.m_size);
 			}
 			Bitmap() :m_data(nullptr), m_size(0), m_width(0), m_height(0), m_format(Format_Null)
 			{
 
+			}
+			// uninitialized pixels
+			Bitmap(uint32_t width, uint32_t height, Format format) :m_data(nullptr), m_size(CalculateSize(width, height, format)), m_width(width), m_height(height), m_format(format)
+			{
+				m_data = malloc(m_size);
 			}
 			CRAFT_ENGINE_EXPLICIT Bitmap(const char* path) :Bitmap()
 			{
@@ -96,16 +106,19 @@ namespace CraftEngine
 				m_width = bitmap.m_width;
 				m_height = bitmap.m_height;
 				m_format = bitmap.m_format;
-				m_data = new uint8_t[bitmap.m_size];
+				m_data = malloc(bitmap.m_size);
 				memcpy(m_data, bitmap.data(), bitmap.m_size);
 				return *this;
 			}
-			//Bitmap& operator=(Bitmap&& bitmap)
-			//{
-			//	swap(bitmap);
-			//	bitmap.clear();
-			//	return *this;
-			//}
+			Bitmap& operator=(Bitmap&& bitmap) noexcept
+			{
+				if (this != &bitmap)
+				{
+					clear();
+					swap(bitmap);
+				}
+				return *this;
+			}
 
 			bool valid()const { return data() != nullptr; }
 			uint32_t width()const { return m_width; }
@@ -119,7 +132,7 @@ namespace CraftEngine
 			void clear()
 			{
 				if (m_data != nullptr)
-					delete[] m_data;
+					stbi_image_free(m_data);
 				m_data = nullptr;
 				m_size = 0;
 				m_width = 0;
@@ -148,7 +161,7 @@ namespace CraftEngine
 
 			bool loadFromFile(const wchar_t* path, bool red_channal_only = false)
 			{
-				return loadFromFile(codecvt::utf16le_to_utf8(path).c_str());
+				return loadFromFile(codecvt::utf16le_to_utf8(path).c_str(), red_channal_only);
 			}
 
 			bool loadFromFile(const char* path, bool red_channal_only = false)
@@ -196,7 +209,7 @@ namespace CraftEngine
 			{		
 				Bitmap bitmap;
 				bitmap.m_size = size();
-				bitmap.m_data = new uint8_t[bitmap.m_size];
+				bitmap.m_data = malloc(bitmap.m_size);
 				bitmap.m_width = width();
 				bitmap.m_height = height();
 				bitmap.m_format = format();
@@ -230,7 +243,7 @@ namespace CraftEngine
 			{
 				Bitmap bitmap;
 				bitmap.m_size = size();
-				bitmap.m_data = new uint8_t[bitmap.m_size];
+				bitmap.m_data = malloc(bitmap.m_size);
 				bitmap.m_width = width();
 				bitmap.m_height = height();
 				bitmap.m_format = format();
@@ -267,7 +280,7 @@ namespace CraftEngine
 			{
 				Bitmap bitmap;
 				bitmap.m_size = CalculateSize(width, height, format());
-				bitmap.m_data = new uint8_t[bitmap.m_size];
+				bitmap.m_data = malloc(bitmap.m_size);
 				bitmap.m_width = width;
 				bitmap.m_height = height;
 				bitmap.m_format = format();
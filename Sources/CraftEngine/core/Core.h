@@ -9,6 +9,7 @@
 #include "./core/Memory.h"
 #include "./core/Containers.h"
 #include "./core/Thread.h"
+#include "./core/PoolAllocator.h"
 
 
 
@@ -93,12 +94,12 @@ namespace CraftEngine
 			struct IndexOf<T, T, Rest...> { enum { value = 0 }; };
 			template <typename T>
 			struct IndexOf<T> { enum { value = -1 }; };
-			template<int index, typename... Types>
+			template<int index, typename... Rest>
 			struct At;
-			template<int index, typename First, typename... Types>
-			struct At<index, First, Types...> { using type = typename At<index - 1, Types...>::type; };
-			template<typename T, typename... Types>
-			struct At<0, T, Types...> { using type = T; };
+			template<int index, typename First, typename... Rest>
+			struct At<index, First, Rest...> { using type = typename At<index - 1, Rest...>::type; };
+			template<typename T, typename... Rest>
+			struct At<0, T, Rest...> { using type = T; };
 
 			enum
 			{
@@ -189,7 +190,7 @@ namespace CraftEngine
 			}
 
 			template<typename T>
-			typename const std::decay<T>::type& get() const
+			const typename std::decay<T>::type& get() const
 			{
 				using U = typename std::decay<T>::type;
 				if (!isSame<U>())
@@ -355,25 +356,203 @@ namespace CraftEngine
 
 
 
+		/*
+		 Collects queued signal emissions and runs them once per dispatch(), normally once per frame.
+		 A queued connection posts itself at most once between two dispatches and keeps only the
+		 arguments of the latest emission.
+		*/
+		class SignalQueue :NonCopyable
+		{
+		public:
+			struct Call
+			{
+				virtual ~Call() {}
+				virtual void dispatch() = 0;
+			};
+
+			void post(std::shared_ptr<Call>&& call)
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_calls.push_back(std::move(call));
+			}
+
+			// Runs the calls posted so far and returns their count. Calls posted meanwhile wait for the next dispatch.
+			uint32_t dispatch()
+			{
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_dispatching.swap(m_calls);
+				}
+				uint32_t count = m_dispatching.size();
+				for (auto& call : m_dispatching)
+					call->dispatch();
+				m_dispatching.clear();
+				return count;
+			}
+
+			uint32_t size()
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				return m_calls.size();
+			}
+		private:
+			std::mutex m_mutex;
+			std::vector<std::shared_ptr<Call>> m_calls;
+			std::vector<std::shared_ptr<Call>> m_dispatching;
+		};
+
+
+
 		// ۲
+		/*
+		 The slot list is copy-on-write: connect/disconnect publish a new immutable list, notify()
+		 reads the current one without locking. A replaced list is freed once no notify() is running,
+		 by the last notify() to return or by the next publish, so a slot disconnected during an
+		 emission (from any thread) is skipped from then on but its callback stays alive until that
+		 emission returns. Destroying the observer disconnects its queued slots as well.
+		*/
 		template<typename FuncType>
-		class Observer
+		class Observer;
+		template<typename Result, typename... Params>
+		class Observer<Result(Params...)>
 		{
 		public:
 			typedef uint32_t KeyType;
+			typedef Result FuncType(Params...);
 			typedef FuncType CallType;
 		private:
-			template<typename CallableEntity>
-			KeyType _Register_One(CallableEntity&& func)
+			struct Slot :SignalQueue::Call
+			{
+				Callback<FuncType> mCallback;
+				SignalQueue* mQueue = nullptr;
+				std::atomic<bool> mConnected{ true };
+				std::atomic<bool> mPending{ false };
+				std::mutex mArgsMutex;
+				std::unique_ptr<std::tuple<std::decay_t<Params>...>> mArgs;
+				KeyType mKey;
+
+				template<typename... Args>
+				void post(const std::shared_ptr<Slot>& self, Args&... args)
+				{
+					{
+						std::lock_guard<std::mutex> lock(mArgsMutex);
+						if (mArgs == nullptr)
+							mArgs.reset(new std::tuple<std::decay_t<Params>...>(args...));
+						else
+							*mArgs = std::tuple<std::decay_t<Params>...>(args...);
+					}
+					if (!mPending.exchange(true, std::memory_order_acq_rel))
+						mQueue->post(std::shared_ptr<SignalQueue::Call>(self));
+				}
+
+				void dispatch() override
+				{
+					mPending.store(false, std::memory_order_release);
+					std::unique_ptr<std::tuple<std::decay_t<Params>...>> args;
+					{
+						std::lock_guard<std::mutex> lock(mArgsMutex);
+						args.swap(mArgs);
+					}
+					if (args != nullptr && mConnected.load(std::memory_order_acquire))
+						std::apply([this](auto&... values) { mCallback.call(values...); }, *args);
+				}
+			};
+
+			struct SlotList
 			{
-				auto key = m_nextKey++;
-				m_connections.emplace(key, std::forward<CallableEntity>(func));
-				return key;
+				std::vector<std::shared_ptr<Slot>> mSlots;
+			};
+
+			KeyType _Register_One(const Callback<FuncType>& func, SignalQueue* queue = nullptr)
+			{
+				auto slot = std::make_shared<Slot>();
+				slot->mCallback = func;
+				slot->mQueue = queue;
+				std::lock_guard<std::mutex> lock(m_writeMutex);
+				slot->mKey = m_nextKey++;
+				auto list = new SlotList;
+				auto current = m_slots.load(std::memory_order_relaxed);
+				if (current != nullptr)
+				{
+					list->mSlots.reserve(current->mSlots.size() + 1);
+					list->mSlots = current->mSlots;
+				}
+				list->mSlots.push_back(std::move(slot));
+				_Publish(list);
+				return m_nextKey - 1;
 			}
+
+			// Requires m_writeMutex.
+			void _Publish(SlotList* list)
+			{
+				auto old = m_slots.exchange(list, std::memory_order_seq_cst);
+				if (old != nullptr)
+				{
+					m_retired.push_back(old);
+					m_retiredCount.store(uint32_t(m_retired.size()), std::memory_order_seq_cst);
+				}
+				_Reclaim();
+			}
+
+			// Requires m_writeMutex.
+			void _Reclaim()
+			{
+				// an emitter that could still see a retired list has registered itself before loading it
+				if (m_retired.empty() || m_emitting.load(std::memory_order_seq_cst) != 0)
+					return;
+				for (auto retired : m_retired)
+					delete retired;
+				m_retired.clear();
+				m_retiredCount.store(0, std::memory_order_relaxed);
+			}
+
+			void _Copy_From(const Observer& other)
+			{
+				std::lock_guard<std::mutex> lock(const_cast<Observer&>(other).m_writeMutex);
+				auto current = other.m_slots.load(std::memory_order_relaxed);
+				if (current != nullptr)
+					for (auto& slot : current->mSlots)
+						_Register_One(slot->mCallback, slot->mQueue);
+			}
+
+			// the last emitter to leave frees the lists retired meanwhile, unless a writer holds the lock and will do it
+			struct EmitScope
+			{
+				Observer& mObserver;
+				EmitScope(Observer& observer) :mObserver(observer) { mObserver.m_emitting.fetch_add(1, std::memory_order_seq_cst); }
+				~EmitScope()
+				{
+					if (mObserver.m_emitting.fetch_sub(1, std::memory_order_seq_cst) != 1 || mObserver.m_retiredCount.load(std::memory_order_seq_cst) == 0)
+						return;
+					std::unique_lock<std::mutex> lock(mObserver.m_writeMutex, std::try_to_lock);
+					if (lock.owns_lock())
+						mObserver._Reclaim();
+				}
+			};
 		public:
 
 			Observer() :m_nextKey(0) {};
-			~Observer() = default;
+			Observer(const Observer& other) :m_nextKey(0) { _Copy_From(other); }
+			Observer& operator=(const Observer& other)
+			{
+				if (this != &other)
+				{
+					clear();
+					_Copy_From(other);
+				}
+				return *this;
+			}
+			~Observer()
+			{
+				// queued calls hold their slot, they must not fire into whatever the callbacks captured
+				auto current = m_slots.load(std::memory_order_relaxed);
+				if (current != nullptr)
+					for (auto& slot : current->mSlots)
+						slot->mConnected.store(false, std::memory_order_release);
+				delete current;
+				for (auto retired : m_retired)
+					delete retired;
+			}
 			/*
 			  connect(funcɵʵ)->
 			  һɵʵ,ֳ֧/lambdaʽ/ྲ̬
@@ -429,24 +608,84 @@ namespace CraftEngine
 				return _Register_One(Callback<FuncType>(pObject, pFunc)); // std::_Ph1ſʼ, Ϊ0Ųthisָռ
 			}
 
-			// ɾһɵʵ
-			void disconnect(KeyType key)
+			/*
+			  connect(queue, func)->key
+			  Queued connection: notify() only records the arguments, func runs in queue.dispatch()
+			  once with the latest ones, however often the signal fired since the last dispatch.
+			*/
+			KeyType connect(SignalQueue& queue, const Callback<FuncType>& func)
+			{
+				return _Register_One(func, &queue);
+			}
+
+			KeyType connect(SignalQueue& queue, std::function<FuncType>&& func)
 			{
-				m_connections.erase(key);
+				return _Register_One(Callback<FuncType>(std::forward<std::function<FuncType>>(func)), &queue);
 			}
-			// пɵö
+
+			// Removes a connection; a notify() in progress on another thread may still be inside it.
+			void disconnect(KeyType key)
+			{
+				std::lock_guard<std::mutex> lock(m_writeMutex);
+				auto current = m_slots.load(std::memory_order_relaxed);
+				if (current == nullptr)
+					return;
+				auto it = std::find_if(current->mSlots.begin(), current->mSlots.end(), [key](const std::shared_ptr<Slot>& slot) { return slot->mKey == key; });
+				if (it == current->mSlots.end())
+					return;
+				(*it)->mConnected.store(false, std::memory_order_release);
+				auto list = new SlotList;
+				list->mSlots.reserve(current->mSlots.size() - 1);
+				for (auto& slot : current->mSlots)
+					if (slot->mKey != key)
+						list->mSlots.push_back(slot);
+				_Publish(list);
+			}
+
+			void clear()
+			{
+				std::lock_guard<std::mutex> lock(m_writeMutex);
+				auto current = m_slots.load(std::memory_order_relaxed);
+				if (current == nullptr)
+					return;
+				for (auto& slot : current->mSlots)
+					slot->mConnected.store(false, std::memory_order_release);
+				_Publish(new SlotList);
+			}
+
+			// Wait-free with respect to connect/disconnect: calls direct slots, posts queued ones.
 			template<typename... Args>
 			void notify(Args&&... args)
 			{
-				for (auto& it : m_connections)
-					it.second.call(std::forward<Args>(args)...);
+				EmitScope scope(*this);
+				auto list = m_slots.load(std::memory_order_seq_cst);
+				if (list == nullptr)
+					return;
+				for (auto& slot : list->mSlots)
+				{
+					if (!slot->mConnected.load(std::memory_order_acquire))
+						continue;
+					if (slot->mQueue != nullptr)
+						slot->post(slot, args...);
+					else
+						slot->mCallback.call(args...);
+				}
+			}
+
+			uint32_t size()const
+			{
+				std::lock_guard<std::mutex> lock(const_cast<Observer*>(this)->m_writeMutex);
+				auto current = m_slots.load(std::memory_order_relaxed);
+				return current != nullptr ? current->mSlots.size() : 0;
 			}
-			// ɵö
-			uint32_t size()const { return m_connections.size(); }
 		private:
 
 			KeyType m_nextKey = 0;
-			std::unordered_map<KeyType, Callback<FuncType>> m_connections;
+			std::atomic<SlotList*> m_slots{ nullptr };
+			std::atomic<uint32_t> m_emitting{ 0 };
+			std::atomic<uint32_t> m_retiredCount{ 0 };  // m_retired.size() for emitters, which read it without the lock
+			std::mutex m_writeMutex;
+			std::vector<SlotList*> m_retired;
 		};
 
 
@@ -0,0 +1,334 @@
+#pragma once
+#ifndef CRAFT_ENGINE_CORE_IMAGE_IO_H_
+#define CRAFT_ENGINE_CORE_IMAGE_IO_H_
+
+#include "./Bitmap.h"
+#include "./core/Callable.h"
+#include "./core/Thread.h"
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <string.h>
+
+namespace CraftEngine
+{
+
+	namespace core
+	{
+
+
+		struct ImageDecodeOptions
+		{
+			Bitmap::Format format = Bitmap::Format_RGBA8;  // Format_R8 keeps only the first channel
+			uint32_t       reduction = 1;                  // divide width and height by this factor
+			uint32_t       maxDimension = 0;               // if not 0, double the reduction until the image fits
+			bool           flipY = false;
+		};
+
+		struct ImageEncodeOptions
+		{
+			int quality = 90;  // jpg only
+		};
+
+		struct ImageDecodeInfo
+		{
+			uint32_t       width = 0;
+			uint32_t       height = 0;
+			Bitmap::Format format = Bitmap::Format_Null;
+
+			bool valid() const { return width != 0 && height != 0; }
+			size_t size() const { return Bitmap::CalculateSize(width, height, format); }
+		};
+
+		/*
+		 Asynchronous image decoding and encoding on a core::ThreadPool, requests are handed to the
+		 workers in turn. Every request returns a std::future. A full size Bitmap adopts the decoder's
+		 buffer without a copy. stb_image always decodes into memory it allocates itself, so decodeInto()
+		 copies (or box filters and flips) that buffer into caller memory, for example a soft3d Memory.
+		 Reduced resolution decoding box filters the image by an integer factor on the worker, so only
+		 the small image is ever returned.
+		 stbi_failure_reason() is kept per thread (see ThirdPartyImportStbimg.h), so it describes the
+		 last failure on the calling thread only.
+		*/
+		class ImageIOService
+		{
+		public:
+
+			typedef ImageDecodeOptions DecodeOptions;
+			typedef ImageEncodeOptions EncodeOptions;
+			typedef ImageDecodeInfo    ImageInfo;
+
+			explicit ImageIOService(uint32_t threadCount = 0)
+			{
+				if (threadCount == 0)
+					threadCount = std::max(1u, std::thread::hardware_concurrency());
+				m_pool.init(std::min(threadCount, 48u));
+			}
+
+			ImageIOService(const ImageIOService&) = delete;
+			ImageIOService& operator=(const ImageIOService&) = delete;
+
+			// finishes every queued request before returning
+			~ImageIOService()
+			{
+				m_pool.wait();
+			}
+
+			uint32_t threadCount() const { return m_pool.threadCount(); }
+
+
+
+			/*
+			 Synchronous helpers, also used by the workers.
+			*/
+
+			// reads only the header
+			static ImageInfo info(const std::string& path)
+			{
+				ImageInfo info;
+				int w = 0, h = 0, c = 0;
+				if (stbi_info(path.c_str(), &w, &h, &c) != 0)
+				{
+					info.width = w;
+					info.height = h;
+					info.format = c == 1 ? Bitmap::Format_R8 : Bitmap::Format_RGBA8;
+				}
+				return info;
+			}
+
+			// size of the image decode() would return, to allocate the destination of decodeInto()
+			static ImageInfo decodedInfo(const std::string& path, const DecodeOptions& options = DecodeOptions())
+			{
+				auto source = info(path);
+				if (!source.valid())
+					return ImageInfo();
+				return reducedInfo(source.width, source.height, options);
+			}
+
+			static Bitmap decodeFile(const std::string& path, const DecodeOptions& options = DecodeOptions())
+			{
+				int w = 0, h = 0, c = 0;
+				stbi_uc* pixels = stbi_load(path.c_str(), &w, &h, &c, channels(options.format));
+				return toBitmap(pixels, w, h, options);
+			}
+
+			static Bitmap decodeMemory(const void* encoded, size_t size, const DecodeOptions& options = DecodeOptions())
+			{
+				int w = 0, h = 0, c = 0;
+				stbi_uc* pixels = stbi_load_from_memory((const stbi_uc*)encoded, int(size), &w, &h, &c, channels(options.format));
+				return toBitmap(pixels, w, h, options);
+			}
+
+			// tightly packed rows, fails without writing when capacity is too small
+			static ImageInfo decodeFileInto(const std::string& path, void* dst, size_t capacity, const DecodeOptions& options = DecodeOptions())
+			{
+				int w = 0, h = 0, c = 0;
+				stbi_uc* pixels = stbi_load(path.c_str(), &w, &h, &c, channels(options.format));
+				if (pixels == nullptr)
+					return ImageInfo();
+				auto result = reducedInfo(w, h, options);
+				if (capacity < result.size())
+					result = ImageInfo();
+				else
+					reduce(pixels, w, h, options, (uint8_t*)dst);
+				stbi_image_free(pixels);
+				return result;
+			}
+
+			// format from the extension: png, jpg/jpeg, bmp or tga
+			static bool encodeFile(const std::string& path, const void* pixels, uint32_t width, uint32_t height, Bitmap::Format format, uint32_t rowPitch = 0, const EncodeOptions& options = EncodeOptions())
+			{
+				int comp = channels(format);
+				if (pixels == nullptr || comp == 0 || width == 0 || height == 0)
+					return false;
+				if (rowPitch == 0)
+					rowPitch = width * comp;
+				auto dot = path.find_last_of('.');
+				std::string extension = dot == std::string::npos ? std::string() : path.substr(dot + 1);
+				for (auto& ch : extension)
+					ch = char(tolower(ch));
+
+				if (extension == "png")
+					return stbi_write_png(path.c_str(), width, height, comp, pixels, rowPitch) != 0;
+
+				// the other writers take tightly packed rows only
+				std::vector<uint8_t> packed;
+				if (rowPitch != width * comp)
+				{
+					packed.resize(size_t(width) * height * comp);
+					for (uint32_t y = 0; y < height; y++)
+						memcpy(packed.data() + size_t(y) * width * comp, (const uint8_t*)pixels + size_t(y) * rowPitch, size_t(width) * comp);
+					pixels = packed.data();
+				}
+				if (extension == "jpg" || extension == "jpeg")
+					return stbi_write_jpg(path.c_str(), width, height, comp, pixels, options.quality) != 0;
+				if (extension == "bmp")
+					return stbi_write_bmp(path.c_str(), width, height, comp, pixels) != 0;
+				if (extension == "tga")
+					return stbi_write_tga(path.c_str(), width, height, comp, pixels) != 0;
+				return false;
+			}
+
+
+
+			/*
+			 Asynchronous requests.
+			*/
+
+			std::future<Bitmap> decode(const std::string& path, const DecodeOptions& options = DecodeOptions())
+			{
+				return submit<Bitmap>([path, options]() { return decodeFile(path, options); });
+			}
+
+			std::future<Bitmap> decode(std::vector<uint8_t>&& encoded, const DecodeOptions& options = DecodeOptions())
+			{
+				return submit<Bitmap>([encoded = std::move(encoded), options]() { return decodeMemory(encoded.data(), encoded.size(), options); });
+			}
+
+			// dst must stay valid until the future is ready, size it with decodedInfo()
+			std::future<ImageInfo> decodeInto(const std::string& path, void* dst, size_t capacity, const DecodeOptions& options = DecodeOptions())
+			{
+				return submit<ImageInfo>([path, dst, capacity, options]() { return decodeFileInto(path, dst, capacity, options); });
+			}
+
+			std::vector<std::future<Bitmap>> decodeBatch(const std::vector<std::string>& paths, const DecodeOptions& options = DecodeOptions())
+			{
+				std::vector<std::future<Bitmap>> results;
+				results.reserve(paths.size());
+				for (auto& path : paths)
+					results.push_back(decode(path, options));
+				return results;
+			}
+
+			std::future<bool> encode(const std::string& path, Bitmap&& bitmap, const EncodeOptions& options = EncodeOptions())
+			{
+				return submit<bool>([path, bitmap = std::move(bitmap), options]()
+				{
+					return encodeFile(path, bitmap.data(), bitmap.width(), bitmap.height(), bitmap.format(), 0, options);
+				});
+			}
+
+			// pixels must stay valid until the future is ready
+			std::future<bool> encode(const std::string& path, const void* pixels, uint32_t width, uint32_t height, Bitmap::Format format, uint32_t rowPitch = 0, const EncodeOptions& options = EncodeOptions())
+			{
+				return submit<bool>([=]() { return encodeFile(path, pixels, width, height, format, rowPitch, options); });
+			}
+
+		private:
+
+			static int channels(Bitmap::Format format)
+			{
+				switch (format)
+				{
+				case Bitmap::Format_R8: return 1;
+				case Bitmap::Format_RGBA8: return 4;
+				default: return 0;
+				}
+			}
+
+			static uint32_t reductionFactor(uint32_t width, uint32_t height, const DecodeOptions& options)
+			{
+				uint32_t factor = std::max(1u, options.reduction);
+				if (options.maxDimension != 0)
+					while (std::max(width, height) / factor > options.maxDimension)
+						factor *= 2;
+				return factor;
+			}
+
+			static ImageInfo reducedInfo(uint32_t width, uint32_t height, const DecodeOptions& options)
+			{
+				uint32_t factor = reductionFactor(width, height, options);
+				ImageInfo info;
+				info.width = std::max(1u, width / factor);
+				info.height = std::max(1u, height / factor);
+				info.format = options.format;
+				return info;
+			}
+
+			// box filters (or just copies) the decoded pixels into dst, flipping rows if asked
+			static void reduce(const uint8_t* src, uint32_t width, uint32_t height, const DecodeOptions& options, uint8_t* dst)
+			{
+				const uint32_t comp = channels(options.format);
+				const uint32_t factor = reductionFactor(width, height, options);
+				const auto out = reducedInfo(width, height, options);
+				const size_t src_pitch = size_t(width) * comp;
+				const size_t dst_pitch = size_t(out.width) * comp;
+				if (factor == 1)
+				{
+					for (uint32_t y = 0; y < out.height; y++)
+					{
+						uint32_t sy = options.flipY ? out.height - 1 - y : y;
+						memcpy(dst + y * dst_pitch, src + sy * src_pitch, dst_pitch);
+					}
+					return;
+				}
+				std::vector<uint32_t> sums(dst_pitch);
+				for (uint32_t y = 0; y < out.height; y++)
+				{
+					uint32_t oy = options.flipY ? out.height - 1 - y : y;
+					uint32_t y0 = oy * factor, y1 = std::min(height, y0 + factor);
+					std::fill(sums.begin(), sums.end(), 0u);
+					for (uint32_t sy = y0; sy < y1; sy++)
+					{
+						const uint8_t* row = src + sy * src_pitch;
+						for (uint32_t x = 0; x < out.width; x++)
+						{
+							uint32_t x0 = x * factor, x1 = std::min(width, x0 + factor);
+							for (uint32_t sx = x0; sx < x1; sx++)
+								for (uint32_t c = 0; c < comp; c++)
+									sums[x * comp + c] += row[sx * comp + c];
+						}
+					}
+					uint8_t* dst_row = dst + y * dst_pitch;
+					for (uint32_t x = 0; x < out.width; x++)
+					{
+						uint32_t x0 = x * factor, x1 = std::min(width, x0 + factor);
+						uint32_t count = (x1 - x0) * (y1 - y0);
+						for (uint32_t c = 0; c < comp; c++)
+							dst_row[x * comp + c] = uint8_t((sums[x * comp + c] + count / 2) / count);
+					}
+				}
+			}
+
+			static Bitmap toBitmap(stbi_uc* pixels, int width, int height, const DecodeOptions& options)
+			{
+				Bitmap bitmap;
+				if (pixels == nullptr)
+					return bitmap;
+				auto out = reducedInfo(width, height, options);
+				if (reductionFactor(width, height, options) == 1 && !options.flipY)
+				{
+					bitmap.m_data = pixels;
+					bitmap.m_width = width;
+					bitmap.m_height = height;
+					bitmap.m_format = options.format;
+					bitmap.m_size = Bitmap::CalculateSize(width, height, options.format);
+					return bitmap;
+				}
+				Bitmap result(out.width, out.height, options.format);
+				reduce(pixels, width, height, options, (uint8_t*)result.data());
+				stbi_image_free(pixels);
+				return result;
+			}
+
+			template<typename Result, typename Func>
+			std::future<Result> submit(Func&& func)
+			{
+				std::packaged_task<Result()> task(std::forward<Func>(func));
+				auto future = task.get_future();
+				m_pool.push(std::move(task), m_nextThread++ % m_pool.threadCount());
+				return future;
+			}
+
+			ThreadPool            m_pool;
+			std::atomic<uint32_t> m_nextThread = { 0 };
+		};
+
+
+
+	}
+
+}
+
+
+#endif // CRAFT_ENGINE_CORE_IMAGE_IO_H_
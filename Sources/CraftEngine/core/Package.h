@@ -3,323 +3,870 @@
 #define CRAFT_ENGINE_UTIL_PACKAGE_H_
 
 #include "./Core.h"
-#include "../Win32/Win32Api.h"
-
+#include <algorithm>
+#include <filesystem>
+#include <limits>
+#include <string.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif // NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// define CRAFT_ENGINE_PACKAGE_USING_ZSTD to read and write Zstandard compressed entries
+#ifdef CRAFT_ENGINE_PACKAGE_USING_ZSTD
+#include "../3rdparty/ThirdPartyImportZstd.h"
+#endif
+
+
+/*
+ Package format v2, all integers little endian:
+
+   PackageHeader                     64 bytes, id "CEPACK2"
+   PackageEntry[entryCount]          48 bytes each, sorted by (path hash, path)
+   string table                      the normalized utf-8 paths, not terminated
+   entry data                        each entry starts at a multiple of its alignment
+
+ Paths are relative, '/' separated, without leading or repeated separators. An entry is
+ stored as is (and can be read in place from the mapped file) or LZ4 / Zstd compressed.
+*/
 
 namespace CraftEngine
 {
-	namespace Util
+	namespace core
 	{
 
 
+		enum class PackageCompression : uint32_t
+		{
+			eStore = 0,
+			eLZ4 = 1,
+			eZstd = 2,
+		};
 
 
-		class PackageLoader
+		namespace detail
 		{
-		private:
 
-			std::ifstream m_file;
+			struct PackageHeader
+			{
+				char     id[8];
+				uint32_t version;
+				uint32_t entryCount;
+				uint64_t entryTableOffset;
+				uint64_t stringTableOffset;
+				uint64_t stringTableSize;
+				uint64_t dataOffset;
+				uint8_t  reserved[16];
+			};
+			static_assert(sizeof(PackageHeader) == 64, "PackageHeader layout");
 
-			struct Folder
+			struct PackageEntry
 			{
-				std::string name;
-				size_t begin;
-				size_t size;
+				uint64_t hash;
+				uint64_t offset;
+				uint64_t storedSize;
+				uint64_t size;
+				uint32_t pathOffset;
+				uint32_t pathLength;
+				uint32_t compression;
+				uint32_t reserved;
 			};
+			static_assert(sizeof(PackageEntry) == 48, "PackageEntry layout");
 
-			GeneralTree<Folder> m_package;
-		public:
+			constexpr char     PackageId[8] = { 'C', 'E', 'P', 'A', 'C', 'K', '2', '\0' };
+			constexpr uint32_t PackageVersion = 2;
 
+			// walks a path as if it was normalized: '\\' becomes '/', leading and repeated separators are skipped
+			struct PackagePathCursor
+			{
+				const char* cur;
+				const char* end;
+				bool        separator = true;
 
-			~PackageLoader()
+				PackagePathCursor(const char* str, size_t length) : cur(str), end(str + length) {}
+				int next()
+				{
+					while (cur < end)
+					{
+						char c = *cur++;
+						if (c == '\\')
+							c = '/';
+						if (c == '/')
+						{
+							if (separator)
+								continue;
+							separator = true;
+						}
+						else
+							separator = false;
+						return (unsigned char)c;
+					}
+					return -1;
+				}
+			};
+
+			inline std::string packageNormalizePath(const std::string& path)
 			{
-				clear();
+				std::string result;
+				result.reserve(path.size());
+				PackagePathCursor cursor(path.data(), path.size());
+				for (int c = cursor.next(); c >= 0; c = cursor.next())
+					result.push_back(char(c));
+				return result;
 			}
 
-			void clear()
+			// FNV-1a of the normalized path
+			inline uint64_t packagePathHash(const char* path, size_t length)
 			{
-				m_file.close();
-				m_package.getRoot().clear();
+				uint64_t hash = 14695981039346656037ull;
+				PackagePathCursor cursor(path, length);
+				for (int c = cursor.next(); c >= 0; c = cursor.next())
+					hash = (hash ^ uint64_t(c)) * 1099511628211ull;
+				return hash;
 			}
 
-			bool isOpen()const
+			inline bool packagePathEqual(const char* normalized, size_t normalizedLength, const char* path, size_t length)
 			{
-				return 	m_file.is_open();
+				PackagePathCursor cursor(path, length);
+				for (size_t i = 0; i < normalizedLength; i++)
+					if (cursor.next() != (unsigned char)normalized[i])
+						return false;
+				return cursor.next() < 0;
 			}
 
-			bool link(const std::wstring& pke)
+
+
+			/*
+			 LZ4 block format (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md),
+			 greedy single-probe matcher. The output is readable by any LZ4 block decoder.
+			*/
+			constexpr size_t Lz4MinMatch = 4;
+			constexpr size_t Lz4LastLiterals = 5;
+			constexpr size_t Lz4MatchLimit = 12;
+			constexpr size_t Lz4MaxOffset = 65535;
+			constexpr int    Lz4HashBits = 16;
+
+			inline size_t lz4CompressBound(size_t size)
 			{
-				clear();
-				m_file.open(pke, std::ios::binary);
-				if (!m_file.is_open())
-					return false;
+				return size + size / 255 + 16;
+			}
+
+			// a match length byte of 255 stands for 255 output bytes, no input byte decodes to more
+			constexpr uint64_t Lz4MaxRatio = 255;
+			// a 4 byte RLE block expands to the 128 KiB block limit
+			constexpr uint64_t ZstdMaxRatio = 32768;
 
-				//
-				union FileHeader
+			inline uint32_t lz4Read32(const uint8_t* p)
+			{
+				uint32_t v;
+				memcpy(&v, p, sizeof(v));
+				return v;
+			}
+
+			// returns the compressed size, 0 if it does not fit in capacity
+			inline size_t lz4Compress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity)
+			{
+				uint8_t* op = dst;
+				uint8_t* const oend = dst + capacity;
+
+				auto emit = [&](const uint8_t* literals, size_t literalLength, size_t offset, size_t matchLength) -> bool
 				{
-					struct
+					size_t need = 1 + literalLength + literalLength / 255 + 1 + (matchLength != 0 ? 2 + matchLength / 255 + 1 : 0);
+					if (size_t(oend - op) < need)
+						return false;
+					uint8_t* token = op++;
+					if (literalLength >= 15)
+					{
+						*token = 15 << 4;
+						size_t rest = literalLength - 15;
+						for (; rest >= 255; rest -= 255)
+							*op++ = 255;
+						*op++ = uint8_t(rest);
+					}
+					else
+						*token = uint8_t(literalLength << 4);
+					if (literalLength != 0)
+						memcpy(op, literals, literalLength);
+					op += literalLength;
+					if (matchLength == 0)
+						return true;
+					*op++ = uint8_t(offset);
+					*op++ = uint8_t(offset >> 8);
+					size_t length = matchLength - Lz4MinMatch;
+					if (length >= 15)
 					{
-						char id[16];
-						uint8_t hash[16];
-						int32_t block_header_begin;
-						int32_t block_header_size;
-						int32_t block_header_count;
-					};
-					uint8_t unused[64];
+						*token |= 15;
+						size_t rest = length - 15;
+						for (; rest >= 255; rest -= 255)
+							*op++ = 255;
+						*op++ = uint8_t(rest);
+					}
+					else
+						*token |= uint8_t(length);
+					return true;
 				};
 
-				struct BlockHeader
+				size_t anchor = 0;
+				if (size > Lz4MatchLimit)
 				{
-					char name[108];
-					uint32_t children_count;
-					uint64_t begin;
-					uint64_t size;
-				};
-
-				FileHeader header = {};
-				m_file.read((char*)&header, sizeof(FileHeader));
+					std::vector<uint32_t> table(size_t(1) << Lz4HashBits, 0);
+					const size_t limit = size - Lz4MatchLimit;
+					size_t ip = 1;
+					while (ip < limit)
+					{
+						uint32_t sequence = lz4Read32(src + ip);
+						uint32_t h = (sequence * 2654435761u) >> (32 - Lz4HashBits);
+						size_t ref = table[h];
+						table[h] = uint32_t(ip);
+						if (ip - ref > Lz4MaxOffset || lz4Read32(src + ref) != sequence)
+						{
+							// skip faster through data that does not match
+							ip += 1 + ((ip - anchor) >> 6);
+							continue;
+						}
+						// extend backwards into the pending literals, then forwards
+						while (ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1])
+						{
+							ip--;
+							ref--;
+						}
+						size_t length = Lz4MinMatch;
+						const size_t maxLength = size - Lz4LastLiterals - ip;
+						while (length < maxLength && src[ref + length] == src[ip + length])
+							length++;
+						if (!emit(src + anchor, ip - anchor, ip - ref, length))
+							return 0;
+						ip += length;
+						anchor = ip;
+						if (ip - 2 < limit)
+							table[(lz4Read32(src + ip - 2) * 2654435761u) >> (32 - Lz4HashBits)] = uint32_t(ip - 2);
+					}
+				}
+				if (!emit(src + anchor, size - anchor, 0, 0))
+					return 0;
+				return size_t(op - dst);
+			}
 
-				std::vector<BlockHeader> headers_list(header.block_header_count);
-				
-				m_file.seekg(header.block_header_begin, std::ios::beg);
-				m_file.read((char*)headers_list.data(), header.block_header_count * sizeof(BlockHeader));
+			// decodes exactly dstSize bytes, false on malformed input
+			inline bool lz4Decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize)
+			{
+				const uint8_t* ip = src;
+				const uint8_t* const iend = src + srcSize;
+				uint8_t* op = dst;
+				uint8_t* const oend = dst + dstSize;
 
-				for (auto i : headers_list)
+				auto read_length = [&](size_t& length) -> bool
 				{
-					auto str = CraftEngine::Util::StringTool::fromUtf8(i.name);
-
-					if (i.children_count == 0)
+					uint8_t b;
+					do
 					{
-						std::wcout << L"file:[" << i.size << "]" << str.c_str() << std::endl;
-					}
+						if (ip >= iend)
+							return false;
+						b = *ip++;
+						length += b;
+					} while (b == 255);
+					return true;
+				};
+
+				while (ip < iend)
+				{
+					uint8_t token = *ip++;
+					size_t literalLength = token >> 4;
+					if (literalLength == 15 && !read_length(literalLength))
+						return false;
+					if (literalLength > size_t(iend - ip) || literalLength > size_t(oend - op))
+						return false;
+					if (literalLength != 0)
+						memcpy(op, ip, literalLength);
+					ip += literalLength;
+					op += literalLength;
+					if (ip == iend)
+						return op == oend;
+
+					if (iend - ip < 2)
+						return false;
+					size_t offset = size_t(ip[0]) | (size_t(ip[1]) << 8);
+					ip += 2;
+					if (offset == 0 || offset > size_t(op - dst))
+						return false;
+					size_t matchLength = token & 15;
+					if (matchLength == 15 && !read_length(matchLength))
+						return false;
+					matchLength += Lz4MinMatch;
+					if (matchLength > size_t(oend - op))
+						return false;
+					const uint8_t* match = op - offset;
+					if (offset >= matchLength)
+						memcpy(op, match, matchLength);
 					else
 					{
-						std::wcout << L"folder:[" << i.size << "]" << str.c_str() << std::endl;
+						// overlapping copy: one period, then double the already periodic output
+						memcpy(op, match, offset);
+						for (size_t done = offset; done < matchLength;)
+						{
+							size_t chunk = std::min(done, matchLength - done);
+							memcpy(op + done, op, chunk);
+							done += chunk;
+						}
 					}
+					op += matchLength;
 				}
+				return false;
+			}
 
+		}
 
-				int index = 1;
 
-				GeneralTree<Folder>::Iterator it = m_package.getRoot();
 
-				it.setData(new Folder);
-				it.getData()->begin = headers_list[0].begin;
-				it.getData()->size = headers_list[0].size;
-				it.getData()->name = headers_list[0].name;
+		/*
+		 Read-only memory mapping of a whole file.
+		*/
+		class MappedFile
+		{
+		public:
+			MappedFile() = default;
+			MappedFile(const MappedFile&) = delete;
+			MappedFile& operator=(const MappedFile&) = delete;
+			~MappedFile() { close(); }
 
-				std::function<void(BlockHeader*, int&, GeneralTree<Folder>::Iterator)> contruct_tree;
-				contruct_tree = [&](BlockHeader* headers_list, int& cur_index, GeneralTree<Folder>::Iterator it)
+			bool open(const std::filesystem::path& path)
+			{
+				close();
+#ifdef _WIN32
+				HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+				if (file == INVALID_HANDLE_VALUE)
+					return false;
+				LARGE_INTEGER size = {};
+				if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
 				{
-					int temp_index = cur_index;
-					for (int i = 0; i < headers_list[temp_index].children_count; i++)
-					{
-						Folder* folder = new Folder;
-						folder->name = headers_list[cur_index].name;
-						folder->size = headers_list[cur_index].size;
-						folder->begin = headers_list[cur_index].begin;
-						//it.addChild();
-						it.addChild(folder);
-						cur_index++;
-						contruct_tree(headers_list, cur_index, it.getChild(i));
-					}
-				};
-				contruct_tree(headers_list.data(), index, m_package.getRoot());
+					CloseHandle(file);
+					return false;
+				}
+				HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+				CloseHandle(file);
+				if (mapping == nullptr)
+					return false;
+				// the view keeps the mapping alive
+				void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+				CloseHandle(mapping);
+				if (view == nullptr)
+					return false;
+				m_data = (const uint8_t*)view;
+				m_size = size_t(size.QuadPart);
+#else
+				int fd = ::open(path.c_str(), O_RDONLY);
+				if (fd < 0)
+					return false;
+				struct stat st = {};
+				if (fstat(fd, &st) != 0 || st.st_size <= 0)
+				{
+					::close(fd);
+					return false;
+				}
+				void* view = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+				::close(fd);
+				if (view == MAP_FAILED)
+					return false;
+				m_data = (const uint8_t*)view;
+				m_size = size_t(st.st_size);
+#endif
+				return true;
+			}
+
+			void close()
+			{
+				if (m_data == nullptr)
+					return;
+#ifdef _WIN32
+				UnmapViewOfFile(m_data);
+#else
+				munmap((void*)m_data, m_size);
+#endif
+				m_data = nullptr;
+				m_size = 0;
+			}
+
+			bool isOpen() const { return m_data != nullptr; }
+			const uint8_t* data() const { return m_data; }
+			size_t size() const { return m_size; }
+
+		private:
+			const uint8_t* m_data = nullptr;
+			size_t         m_size = 0;
+		};
 
 
 
+		/*
+		 Reads v2 packages through a memory mapping. Lookups hash the path and binary search the
+		 sorted entry table. Stored entries are returned in place by view(), compressed ones are
+		 decoded by load(). After link() every method is const and safe to call from many threads.
+		*/
+		class PackageLoader
+		{
+		public:
 
+			struct View
+			{
+				const uint8_t* data = nullptr;
+				size_t         size = 0;
+
+				bool empty() const { return data == nullptr; }
+				const uint8_t* begin() const { return data; }
+				const uint8_t* end() const { return data + size; }
+			};
+
+			PackageLoader() = default;
+			PackageLoader(const PackageLoader&) = delete;
+			PackageLoader& operator=(const PackageLoader&) = delete;
+
+			~PackageLoader()
+			{
+				clear();
+			}
+
+			void clear()
+			{
+				m_file.close();
+				m_header = nullptr;
+				m_entries = nullptr;
+				m_strings = nullptr;
+			}
+
+			bool isOpen()const
+			{
+				return m_header != nullptr;
+			}
+
+			bool link(const std::filesystem::path& pke)
+			{
+				clear();
+				if (!m_file.open(pke))
+					return false;
+
+				const uint8_t* base = m_file.data();
+				const size_t file_size = m_file.size();
+				if (file_size < sizeof(detail::PackageHeader))
+					return fail();
+				auto header = (const detail::PackageHeader*)base;
+				if (memcmp(header->id, detail::PackageId, sizeof(header->id)) != 0 || header->version != detail::PackageVersion)
+					return fail();
+				if (header->entryTableOffset % alignof(detail::PackageEntry) != 0 ||
+					header->entryTableOffset > file_size ||
+					header->entryCount > (file_size - header->entryTableOffset) / sizeof(detail::PackageEntry) ||
+					header->stringTableOffset > file_size ||
+					header->stringTableSize > file_size - header->stringTableOffset)
+					return fail();
+
+				auto entries = (const detail::PackageEntry*)(base + header->entryTableOffset);
+				for (uint32_t i = 0; i < header->entryCount; i++)
+				{
+					auto& entry = entries[i];
+					if (entry.offset > file_size || entry.storedSize > file_size - entry.offset ||
+						uint64_t(entry.pathOffset) + entry.pathLength > header->stringTableSize ||
+						entry.compression > uint32_t(PackageCompression::eZstd) ||
+						(i > 0 && entries[i - 1].hash > entry.hash))
+						return fail();
+				}
+
+				m_header = header;
+				m_entries = entries;
+				m_strings = (const char*)(base + header->stringTableOffset);
 				return true;
 			}
 
+			uint32_t entryCount() const
+			{
+				return isOpen() ? m_header->entryCount : 0;
+			}
+
+			std::string entryPath(uint32_t index) const
+			{
+				if (index >= entryCount())
+					return std::string();
+				return std::string(m_strings + m_entries[index].pathOffset, m_entries[index].pathLength);
+			}
+
+			bool contains(const std::string& path) const
+			{
+				return find(path) != nullptr;
+			}
 
+			// uncompressed size, 0 when the entry does not exist
+			size_t size(const std::string& path) const
+			{
+				auto entry = find(path);
+				return entry != nullptr ? size_t(entry->size) : 0;
+			}
 
-			std::vector<uint8_t> load(std::string path)
+			// zero-copy access to a stored entry, empty for missing or compressed entries
+			View view(const std::string& path) const
 			{
-				auto&& paths = parsePath(path);
-				auto node = m_package.getRoot();
-				for (int i = 0; i < paths.size(); i++)
+				View result;
+				auto entry = find(path);
+				if (entry != nullptr && entry->compression == uint32_t(PackageCompression::eStore) && sizeValid(*entry))
 				{
-					bool found = false;
-					for (int j = 0; j < node.getChildrenCount(); j++)
-					{
-						if (node.getChild(j).getData()->name == path)
-						{
-							node = node.getChild(j);
-							found = true;
-							break;
-						}
-					}
-					if (!found)
-					{
-						return std::vector<uint8_t>();
-					}
+					result.data = m_file.data() + entry->offset;
+					result.size = size_t(entry->size);
 				}
-				std::vector<uint8_t> data(node.getData()->size);
-				m_file.seekg(node.getData()->begin, std::ios::beg);
-				m_file.read((char*)data.data(), data.size());
+				return result;
+			}
+
+			// decodes the entry into dst, which must hold at least size(path) bytes
+			bool load(const std::string& path, void* dst, size_t capacity) const
+			{
+				auto entry = find(path);
+				if (entry == nullptr || capacity < entry->size || !sizeValid(*entry))
+					return false;
+				return decode(*entry, (uint8_t*)dst);
+			}
+
+			std::vector<uint8_t> load(const std::string& path) const
+			{
+				auto entry = find(path);
+				if (entry == nullptr || !sizeValid(*entry))
+					return std::vector<uint8_t>();
+				std::vector<uint8_t> data(size_t(entry->size));
+				if (!decode(*entry, data.data()))
+					return std::vector<uint8_t>();
 				return data;
 			}
 
+		private:
+
+			bool fail()
+			{
+				clear();
+				return false;
+			}
 
-			static std::vector<std::string> parsePath(const std::string& path)
+			const detail::PackageEntry* find(const std::string& path) const
 			{
-				std::vector<std::string> paths;
-				int i = 0;
-				int j = 0;
-				while (i < path.size())
+				if (!isOpen())
+					return nullptr;
+				uint64_t hash = detail::packagePathHash(path.data(), path.size());
+				auto end = m_entries + m_header->entryCount;
+				auto it = std::lower_bound(m_entries, end, hash, [](const detail::PackageEntry& entry, uint64_t hash) { return entry.hash < hash; });
+				for (; it != end && it->hash == hash; ++it)
 				{
+					if (detail::packagePathEqual(m_strings + it->pathOffset, it->pathLength, path.data(), path.size()))
+						return it;
+				}
+				return nullptr;
+			}
 
-					if (path[i] == '/')
-					{
-						if (i - j > 0)
-						{
-							std::string sub_path = path.substr(j, i - j);
-							paths.push_back(sub_path);
-							j = i + 1;
-						}	
-					}
-					i++;
+			// checked before anything is allocated for the entry, a corrupt size must not ask for terabytes
+			bool sizeValid(const detail::PackageEntry& entry) const
+			{
+				if (entry.size > uint64_t((std::numeric_limits<size_t>::max)()))
+					return false;
+				switch (PackageCompression(entry.compression))
+				{
+				case PackageCompression::eStore:
+					return entry.storedSize == entry.size;
+				case PackageCompression::eLZ4:
+					return entry.storedSize != 0 && entry.size <= entry.storedSize * detail::Lz4MaxRatio;
+				case PackageCompression::eZstd:
+				{
+					if (entry.storedSize == 0 || entry.size > entry.storedSize * detail::ZstdMaxRatio)
+						return false;
+#ifdef CRAFT_ENGINE_PACKAGE_USING_ZSTD
+					// the frame header records the content size, the writer always sets it
+					return ZSTD_getFrameContentSize(m_file.data() + entry.offset, size_t(entry.storedSize)) == entry.size;
+#else
+					return true;
+#endif
+				}
+				default:
+					return false;
 				}
-				return paths;
 			}
 
+			bool decode(const detail::PackageEntry& entry, uint8_t* dst) const
+			{
+				const uint8_t* src = m_file.data() + entry.offset;
+				switch (PackageCompression(entry.compression))
+				{
+				case PackageCompression::eStore:
+					if (entry.storedSize != entry.size)
+						return false;
+					if (entry.size != 0)
+						memcpy(dst, src, size_t(entry.size));
+					return true;
+				case PackageCompression::eLZ4:
+					return detail::lz4Decompress(src, size_t(entry.storedSize), dst, size_t(entry.size));
+				case PackageCompression::eZstd:
+#ifdef CRAFT_ENGINE_PACKAGE_USING_ZSTD
+					return ZSTD_decompress(dst, size_t(entry.size), src, size_t(entry.storedSize)) == entry.size;
+#else
+					return false;
+#endif
+				default:
+					return false;
+				}
+			}
 
+			MappedFile                  m_file;
+			const detail::PackageHeader* m_header = nullptr;
+			const detail::PackageEntry*  m_entries = nullptr;
+			const char*                 m_strings = nullptr;
 		};
 
 
 
 
+		/*
+		 Builds v2 packages. Files are read and compressed on a thread pool in batches of at most
+		 Options::batchSize bytes, then written in order. An entry whose compressed form does not
+		 save at least 1/16 of its size is stored instead.
+		*/
 		class PackageMaker
 		{
+		public:
 
-			struct Folder
+			struct Options
 			{
-				std::wstring src_path;
-				std::wstring name;
+				PackageCompression compression = PackageCompression::eLZ4;
+				uint32_t           alignment = 16;        // power of two, 4096 lets stored entries be page aligned
+				uint32_t           threadCount = 0;       // 0 uses std::thread::hardware_concurrency()
+				size_t             batchSize = 64 << 20;  // bytes of input held in memory at once
+				int                zstdLevel = 9;
 			};
 
-		public:
-			bool make(std::wstring directory, std::wstring dstFile)
+			PackageMaker() = default;
+			explicit PackageMaker(const Options& options) : m_options(options) {}
+
+			void clear()
 			{
-				auto dir = Win32::getDirectory(directory);
-				if (dir.getRoot().getChildrenCount() == 0)
-					return false;
+				m_items.clear();
+			}
 
+			void addFile(const std::string& packagePath, const std::filesystem::path& source)
+			{
+				addFile(packagePath, source, m_options.compression, m_options.alignment);
+			}
 
-				union FileHeader
-				{
-					struct
-					{
-						char id[16];
-						uint8_t hash[16];
-						int32_t block_header_begin;
-						int32_t block_header_size;
-						int32_t block_header_count;
-					};
-					uint8_t unused[64];
-				};
+			void addFile(const std::string& packagePath, const std::filesystem::path& source, PackageCompression compression, uint32_t alignment)
+			{
+				assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+				m_items.push_back({ detail::packageNormalizePath(packagePath), source, compression, alignment });
+			}
 
-				struct BlockHeader
+			// adds every regular file below directory, named by its relative path after prefix
+			bool addDirectory(const std::filesystem::path& directory, const std::string& prefix = std::string())
+			{
+				std::error_code error;
+				std::filesystem::recursive_directory_iterator it(directory, error), end;
+				if (error)
+					return false;
+				for (; it != end; it.increment(error))
 				{
-					char name[108];
-					uint32_t children_count;
-					uint64_t begin;
-					uint64_t size;
-				};
-
-
-				FileHeader header = {};
-				std::vector<BlockHeader> headers_list;
+					if (error)
+						return false;
+					if (!it->is_regular_file(error))
+						continue;
+					auto relative = it->path().lexically_relative(directory).generic_u8string();
+					addFile(prefix + "/" + std::string(relative.begin(), relative.end()), it->path());
+				}
+				return true;
+			}
 
+			bool make(const std::wstring& directory, const std::wstring& dstFile)
+			{
+				clear();
+				if (!addDirectory(directory) || m_items.empty())
+					return false;
+				return write(dstFile);
+			}
 
-				std::function<void(CraftEngine::Util::GeneralTree<CraftEngine::Win32::Folder>::Iterator)> func;
-				func = [&](CraftEngine::Util::GeneralTree<CraftEngine::Win32::Folder>::Iterator it)
+			bool write(const std::filesystem::path& dstFile)
+			{
+				struct Item
 				{
-					BlockHeader block_header = {};
-					std::string utf8_string = CraftEngine::Util::StringTool::toUtf8(it.getData()->name);
-					strcpy_s(block_header.name, 108, utf8_string.c_str());
-
-					std::cout << "pack file: " << block_header.name << std::endl;
-					block_header.size = it.getData()->size;
-					block_header.children_count = it.getChildrenCount();
-					headers_list.push_back(block_header);
-					for (int i = 0; i < it.getChildrenCount(); i++)
-					{
-						func(it.getChild(i));
-					}
+					const Source*       source;
+					uint64_t            hash;
 				};
+				std::vector<Item> items(m_items.size());
+				for (size_t i = 0; i < m_items.size(); i++)
+					items[i] = { &m_items[i], detail::packagePathHash(m_items[i].path.data(), m_items[i].path.size()) };
+				std::sort(items.begin(), items.end(), [](const Item& a, const Item& b) { return a.hash != b.hash ? a.hash < b.hash : a.source->path < b.source->path; });
+				for (size_t i = 1; i < items.size(); i++)
+					if (items[i].source->path == items[i - 1].source->path)
+						return false;
+
+				detail::PackageHeader header = {};
+				memcpy(header.id, detail::PackageId, sizeof(header.id));
+				header.version = detail::PackageVersion;
+				header.entryCount = uint32_t(items.size());
+				header.entryTableOffset = sizeof(detail::PackageHeader);
+				header.stringTableOffset = header.entryTableOffset + items.size() * sizeof(detail::PackageEntry);
+
+				std::vector<detail::PackageEntry> entries(items.size());
+				std::string strings;
+				for (size_t i = 0; i < items.size(); i++)
+				{
+					entries[i].hash = items[i].hash;
+					entries[i].pathOffset = uint32_t(strings.size());
+					entries[i].pathLength = uint32_t(items[i].source->path.size());
+					strings += items[i].source->path;
+				}
+				header.stringTableSize = strings.size();
+				header.dataOffset = header.stringTableOffset + header.stringTableSize;
 
-				func(dir.getRoot());
-
-				headers_list[0].size = 0;
-				for (int i = 0; i < dir.getRoot().getChildrenCount(); i++)
-					headers_list[0].size += dir.getRoot().getChild(i).getData()->size;
-
-				header.block_header_begin = sizeof(FileHeader);
-				header.block_header_count = headers_list.size();
-				header.block_header_size = headers_list.size() * sizeof(BlockHeader);
-
-				int block_index = 0;
-				int64_t block_begin = sizeof(FileHeader) + header.block_header_size;
-				std::function<void(CraftEngine::Util::GeneralTree<CraftEngine::Win32::Folder>::Iterator, int, int64_t)> func2;
-				func2 = [&](CraftEngine::Util::GeneralTree<CraftEngine::Win32::Folder>::Iterator it, int index, int64_t begin)
+				std::ofstream out(dstFile, std::ios::binary | std::ios::trunc);
+				if (!out.is_open())
+					return false;
+				// the entry table is written again once the offsets are known
+				out.write((const char*)&header, sizeof(header));
+				out.write((const char*)entries.data(), entries.size() * sizeof(detail::PackageEntry));
+				out.write(strings.data(), strings.size());
+				uint64_t offset = header.dataOffset;
+
+				uint32_t thread_count = m_options.threadCount != 0 ? m_options.threadCount : std::max(1u, std::thread::hardware_concurrency());
+				ThreadPool pool;
+				pool.init(std::min(thread_count, 48u));
+
+				std::vector<Blob> blobs;
+				for (size_t first = 0; first < items.size();)
 				{
-					int cur_block_index = block_index;
-					headers_list[cur_block_index].begin = begin;
-					int cur_block_begin = begin;
-					for (int i = 0; i < it.getChildrenCount(); i++)
+					size_t last = first;
+					size_t batch_bytes = 0;
+					while (last < items.size() && (last == first || batch_bytes + items[last].source->size() <= m_options.batchSize))
+						batch_bytes += items[last++].source->size();
+
+					blobs.clear();
+					blobs.resize(last - first);
+					std::atomic<size_t> next = first;
+					std::atomic<bool> failed = false;
+					for (uint32_t t = 0; t < pool.threadCount(); t++)
 					{
-						block_index++;
-						func2(it.getChild(i), block_index, cur_block_begin);
-						cur_block_begin += it.getChild(i).getData()->size;
+						pool.push([&]()
+						{
+							for (size_t i = next++; i < last; i = next++)
+							{
+								if (!encode(*items[i].source, blobs[i - first]))
+									failed = true;
+							}
+						}, t);
 					}
-				};
-				func2(dir.getRoot(), block_index, block_begin);
+					pool.wait();
+					if (failed)
+						return false;
 
+					for (size_t i = first; i < last; i++)
+					{
+						auto& blob = blobs[i - first];
+						uint64_t alignment = items[i].source->alignment;
+						uint64_t aligned = (offset + alignment - 1) & ~(alignment - 1);
+						static const char zeros[4096] = {};
+						for (uint64_t pad = aligned - offset; pad > 0; pad -= std::min<uint64_t>(pad, sizeof(zeros)))
+							out.write(zeros, std::streamsize(std::min<uint64_t>(pad, sizeof(zeros))));
+						out.write((const char*)blob.data.data(), blob.data.size());
+						entries[i].offset = aligned;
+						entries[i].storedSize = blob.data.size();
+						entries[i].size = blob.size;
+						entries[i].compression = uint32_t(blob.compression);
+						offset = aligned + blob.data.size();
+					}
+					first = last;
+				}
 
+				out.seekp(std::streamoff(header.entryTableOffset), std::ios::beg);
+				out.write((const char*)entries.data(), entries.size() * sizeof(detail::PackageEntry));
+				out.close();
+				return !out.fail();
+			}
 
-				std::ofstream out_file(dstFile, std::ios::binary);
-				out_file.write((char*)&header, sizeof(header));
-				out_file.write((char*)&headers_list[0], header.block_header_size);
+		private:
 
+			struct Source
+			{
+				std::string           path;
+				std::filesystem::path file;
+				PackageCompression    compression;
+				uint32_t              alignment;
 
-				std::function<void(CraftEngine::Util::GeneralTree<CraftEngine::Win32::Folder>::Iterator)> func3;
-				func3 = [&](CraftEngine::Util::GeneralTree<CraftEngine::Win32::Folder>::Iterator it)
+				size_t size() const
 				{
-					if (it.getChildrenCount() == 0)
-					{
-
-						std::ifstream file(it.getData()->full_path, std::ios::binary);
-						if (!file.is_open())
-							throw std::runtime_error("");
-
-						std::wcout << "pack path: " << it.getData()->full_path << std::endl;
+					std::error_code error;
+					auto size = std::filesystem::file_size(file, error);
+					return error ? 0 : size_t(size);
+				}
+			};
 
-						int temp_size = it.getData()->size;
-						uint8_t buffer[4096];
-						while (temp_size > 0)
-						{
-							int read_size = 4096;
-							if (temp_size < 4096)
-								read_size = temp_size;
-							file.read((char*)buffer, read_size);
-							out_file.write((char*)buffer, read_size);
-							temp_size -= read_size;
-						}
-					}
+			struct Blob
+			{
+				std::vector<uint8_t> data;
+				uint64_t             size = 0;
+				PackageCompression   compression = PackageCompression::eStore;
+			};
 
-					for (int i = 0; i < it.getChildrenCount(); i++)
-					{
-						func3(it.getChild(i));
-					}
-				};
+			bool encode(const Source& source, Blob& blob) const
+			{
+				std::ifstream file(source.file, std::ios::binary);
+				if (!file.is_open())
+					return false;
+				file.seekg(0, std::ios::end);
+				std::vector<uint8_t> data(size_t(file.tellg()));
+				file.seekg(0, std::ios::beg);
+				if (!file.read((char*)data.data(), data.size()))
+					return false;
+				blob.size = data.size();
 
-				func3(dir.getRoot());
+				std::vector<uint8_t> packed;
+				switch (source.compression)
+				{
+				case PackageCompression::eStore:
+					break;
+				case PackageCompression::eLZ4:
+				{
+					// the block matcher indexes the input with 32 bit positions
+					if (data.size() >= uint32_t(-1))
+						break;
+					packed.resize(detail::lz4CompressBound(data.size()));
+					packed.resize(detail::lz4Compress(data.data(), data.size(), packed.data(), packed.size()));
+					break;
+				}
+				case PackageCompression::eZstd:
+				{
+#ifdef CRAFT_ENGINE_PACKAGE_USING_ZSTD
+					packed.resize(ZSTD_compressBound(data.size()));
+					size_t packed_size = ZSTD_compress(packed.data(), packed.size(), data.data(), data.size(), m_options.zstdLevel);
+					if (ZSTD_isError(packed_size))
+						return false;
+					packed.resize(packed_size);
+					break;
+#else
+					return false;
+#endif
+				}
+				default:
+					return false;
+				}
 
-				out_file.close();
+				if (!packed.empty() && packed.size() <= data.size() - data.size() / 16)
+				{
+					blob.data = std::move(packed);
+					blob.compression = source.compression;
+				}
+				else
+				{
+					blob.data = std::move(data);
+					blob.compression = PackageCompression::eStore;
+				}
+				return true;
 			}
 
+			Options             m_options;
+			std::vector<Source> m_items;
 		};
 
 
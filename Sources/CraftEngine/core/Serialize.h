@@ -0,0 +1,584 @@
+#pragma once
+#ifndef CRAFT_ENGINE_CORE_SERIALIZE_H_
+#define CRAFT_ENGINE_CORE_SERIALIZE_H_
+
+#include "./Reflect.h"
+#include <array>
+#include <string>
+#include <string.h>
+#include <vector>
+
+
+/*
+ Binary serialization driven by reflect::TypeInfo, native byte order:
+
+   BinaryHeader                      32 bytes, id "CEBN", schema hash and version, payload size
+   payload                           the value, encoded as below
+
+ arithmetic, enum and other trivially copyable types      raw bytes
+ reflected types (craft_engine_reflect_begin ...)         the fields in declaration order
+ std::basic_string, std::basic_string_view                uint64 length, characters
+ std::vector, reflect::ArrayView, list-like containers    uint64 count, elements
+ std::array, T[N]                                          elements
+ std::pair, map-like and set-like containers              members, uint64 count + elements
+
+ Elements of trivially copyable arrays (and string characters) start at a multiple of their
+ alignment relative to the header, so a std::string_view or reflect::ArrayView<T> field can be
+ read in place from an aligned buffer such as a mapped PackageLoader::view(). Reflected types
+ whose fields cover the whole object are copied with one memcpy; otherwise runs of adjacent
+ trivially copyable fields are.
+*/
+
+namespace CraftEngine
+{
+	namespace core
+	{
+
+		namespace reflect
+		{
+
+
+			/*
+			 Read-only view of a serialized array, pointing into the source buffer.
+			*/
+			template<typename T>
+			struct ArrayView
+			{
+				static_assert(std::is_trivially_copyable_v<T>, "ArrayView elements must be trivially copyable.");
+				using value_type = T;
+
+				const T* mData = nullptr;
+				size_t   mSize = 0;
+
+				ArrayView() = default;
+				ArrayView(const T* data, size_t size) : mData(data), mSize(size) {}
+				ArrayView(const std::vector<T>& vector) : mData(vector.data()), mSize(vector.size()) {}
+
+				const T* data() const { return mData; }
+				size_t size() const { return mSize; }
+				bool empty() const { return mSize == 0; }
+				const T* begin() const { return mData; }
+				const T* end() const { return mData + mSize; }
+				const T& operator[](size_t i) const { return mData[i]; }
+			};
+
+
+			/*
+			 Specialize (or use craft_engine_reflect_version) to version a top-level type; it is
+			 stored in the header and has to match on read, next to the layout hash.
+			*/
+			template<typename T>
+			struct SchemaVersion
+			{
+				static constexpr uint32_t value = 0;
+			};
+
+#define craft_engine_reflect_version(type_name, version_value) \
+			template<> struct CraftEngine::core::reflect::SchemaVersion<type_name> { static constexpr uint32_t value = version_value; };
+
+
+			struct BinaryHeader
+			{
+				char     id[4];
+				uint32_t format;
+				uint64_t schemaHash;
+				uint32_t schemaVersion;
+				uint32_t reserved;
+				uint64_t payloadSize;
+			};
+			static_assert(sizeof(BinaryHeader) == 32, "BinaryHeader must be 32 bytes.");
+
+
+			namespace detail
+			{
+				constexpr uint32_t kBinaryFormat = 1;
+
+				template<typename T> struct is_basic_string : std::false_type {};
+				template<typename C, typename Tr, typename A> struct is_basic_string<std::basic_string<C, Tr, A>> : std::true_type {};
+				template<typename C, typename Tr> struct is_basic_string<std::basic_string_view<C, Tr>> : std::true_type {};
+				template<typename T> struct is_string_view : std::false_type {};
+				template<typename C, typename Tr> struct is_string_view<std::basic_string_view<C, Tr>> : std::true_type {};
+				template<typename T> struct is_vector : std::false_type {};
+				template<typename T, typename A> struct is_vector<std::vector<T, A>> : std::integral_constant<bool, !std::is_same_v<T, bool>> {};
+				template<typename T> struct is_array_view : std::false_type {};
+				template<typename T> struct is_array_view<ArrayView<T>> : std::true_type {};
+				template<typename T> struct is_std_array : std::false_type {};
+				template<typename T, size_t N> struct is_std_array<std::array<T, N>> : std::true_type {};
+				template<typename T> struct is_pair : std::false_type {};
+				template<typename A, typename B> struct is_pair<std::pair<A, B>> : std::true_type {};
+
+				template<typename T, typename = void> struct is_map_like : std::false_type {};
+				template<typename T> struct is_map_like<T, std::void_t<typename T::key_type, typename T::mapped_type>> : std::true_type {};
+				template<typename T, typename = void> struct is_set_like : std::false_type {};
+				template<typename T> struct is_set_like<T, std::void_t<typename T::key_type>> : std::integral_constant<bool, !is_map_like<T>::value> {};
+				template<typename T, typename = void> struct is_sequence : std::false_type {};
+				template<typename T> struct is_sequence<T, std::void_t<typename T::value_type, decltype(std::declval<T&>().push_back(std::declval<typename T::value_type>()))>> : std::true_type {};
+
+				enum class BinaryCategory
+				{
+					eUnsupported, eRaw, eString, eArray, eFixedArray, ePair, eMap, eSet, eReflected,
+				};
+
+				template<typename T>
+				constexpr BinaryCategory binaryCategory()
+				{
+					if constexpr (std::is_pointer_v<T> || std::is_member_pointer_v<T>)
+						return BinaryCategory::eUnsupported;
+					else if constexpr (std::is_arithmetic_v<T> || std::is_enum_v<T>)
+						return BinaryCategory::eRaw;
+					else if constexpr (is_basic_string<T>::value)
+						return BinaryCategory::eString;
+					else if constexpr (is_vector<T>::value || is_array_view<T>::value)
+						return BinaryCategory::eArray;
+					else if constexpr (is_std_array<T>::value || std::is_array_v<T>)
+						return BinaryCategory::eFixedArray;
+					else if constexpr (is_pair<T>::value)
+						return BinaryCategory::ePair;
+					else if constexpr (is_map_like<T>::value)
+						return BinaryCategory::eMap;
+					else if constexpr (is_set_like<T>::value)
+						return BinaryCategory::eSet;
+					else if constexpr (is_sequence<T>::value)
+						return BinaryCategory::eArray;
+					else if constexpr (TypeInfo<T>::fields.size != 0)
+						return BinaryCategory::eReflected;
+					else if constexpr (std::is_trivially_copyable_v<T>)
+						return BinaryCategory::eRaw;
+					else
+						return BinaryCategory::eUnsupported;
+				}
+
+				template<typename T> struct fixed_array : std::tuple_size<T> { using element_type = typename T::value_type; };
+				template<typename T, size_t N> struct fixed_array<T[N]> : std::integral_constant<size_t, N> { using element_type = T; };
+				template<typename T, size_t I> using field_value_t = typename decltype(TypeInfo<T>::fields.template GetByIdx<I>())::value_type;
+
+				// true if the encoding of T is exactly its object representation
+				template<typename T>
+				constexpr bool isBulk()
+				{
+					constexpr auto category = binaryCategory<T>();
+					if constexpr (category == BinaryCategory::eRaw)
+						return true;
+					else if constexpr (category == BinaryCategory::eFixedArray)
+						return isBulk<typename fixed_array<T>::element_type>() && sizeof(T) == fixed_array<T>::value * sizeof(typename fixed_array<T>::element_type);
+					else if constexpr (category == BinaryCategory::eReflected)
+					{
+						if constexpr (!std::is_trivially_copyable_v<T>)
+							return false;
+						else
+						{
+							constexpr size_t bytes = TypeInfo<T>::fields.Accumulate(size_t(0), [](size_t sum, auto field) {
+								using U = typename decltype(field)::value_type;
+								return isBulk<U>() ? sum + sizeof(U) : sizeof(T) + 1;
+							});
+							return bytes == sizeof(T);
+						}
+					}
+					else
+						return false;
+				}
+
+				constexpr uint64_t hashBytes(uint64_t hash, std::string_view bytes)
+				{
+					for (char c : bytes)
+						hash = (hash ^ uint8_t(c)) * 0x100000001b3ull;
+					return hash;
+				}
+				constexpr uint64_t hashValue(uint64_t hash, uint64_t value)
+				{
+					for (int i = 0; i < 8; i++)
+						hash = (hash ^ ((value >> (i * 8)) & 0xff)) * 0x100000001b3ull;
+					return hash;
+				}
+
+				template<typename T>
+				constexpr uint64_t schemaHash(uint64_t hash)
+				{
+					constexpr auto category = binaryCategory<T>();
+					hash = hashValue(hash, uint64_t(category));
+					if constexpr (category == BinaryCategory::eRaw)
+						return hashValue(hashValue(hash, sizeof(T)), std::is_floating_point_v<T> ? 1 : std::is_signed_v<T> ? 2 : 0);
+					else if constexpr (category == BinaryCategory::eString)
+						return hashValue(hash, sizeof(typename T::value_type));
+					else if constexpr (category == BinaryCategory::eArray)
+						return schemaHash<typename T::value_type>(hash);
+					else if constexpr (category == BinaryCategory::eFixedArray)
+						return schemaHash<typename fixed_array<T>::element_type>(hashValue(hash, fixed_array<T>::value));
+					else if constexpr (category == BinaryCategory::ePair)
+						return schemaHash<typename T::second_type>(schemaHash<std::remove_const_t<typename T::first_type>>(hash));
+					else if constexpr (category == BinaryCategory::eMap)
+						return schemaHash<typename T::mapped_type>(schemaHash<typename T::key_type>(hash));
+					else if constexpr (category == BinaryCategory::eSet)
+						return schemaHash<typename T::key_type>(hash);
+					else
+						return TypeInfo<T>::fields.Accumulate(hashBytes(hash, TypeInfo<T>::name), [](uint64_t h, auto field) {
+							return schemaHash<typename decltype(field)::value_type>(hashBytes(h, field.name));
+						});
+				}
+
+
+				/*
+				 Copy plan of a reflected type: runs of adjacent bulk fields collapse into one
+				 memcpy, every other field goes through its own reader / writer. Member offsets
+				 are the same for every object, so the plan is built once from the first one.
+				*/
+				struct ReflectStep
+				{
+					size_t offset;
+					size_t size;
+					size_t field; // -1 for a bulk run
+				};
+
+				template<typename T, size_t I>
+				void addReflectStep(std::vector<ReflectStep>& steps, const T& obj)
+				{
+					constexpr auto field = TypeInfo<T>::fields.template GetByIdx<I>();
+					size_t offset = size_t((const char*)&(obj.*(field.value)) - (const char*)&obj);
+					if constexpr (isBulk<field_value_t<T, I>>())
+					{
+						if (!steps.empty() && steps.back().field == size_t(-1) && steps.back().offset + steps.back().size == offset)
+							steps.back().size += sizeof(field_value_t<T, I>);
+						else
+							steps.push_back({ offset, sizeof(field_value_t<T, I>), size_t(-1) });
+					}
+					else
+						steps.push_back({ offset, 0, I });
+				}
+
+				template<typename T, size_t... Is>
+				std::vector<ReflectStep> makeReflectSteps(const T& obj, std::index_sequence<Is...>)
+				{
+					std::vector<ReflectStep> steps;
+					(addReflectStep<T, Is>(steps, obj), ...);
+					return steps;
+				}
+
+				template<typename T>
+				const std::vector<ReflectStep>& reflectSteps(const T& obj)
+				{
+					static const std::vector<ReflectStep> steps = makeReflectSteps(obj, std::make_index_sequence<TypeInfo<T>::fields.size>{});
+					return steps;
+				}
+			}
+
+
+			template<typename T>
+			constexpr uint64_t schemaHash()
+			{
+				return detail::schemaHash<T>(0xcbf29ce484222325ull);
+			}
+
+
+			class BinaryWriter
+			{
+			private:
+				std::vector<uint8_t>& m_out;
+				size_t                m_begin;
+			public:
+
+				/*
+				 Appends to out; alignment is relative to its size at construction.
+				*/
+				explicit BinaryWriter(std::vector<uint8_t>& out) : m_out(out), m_begin(out.size()) {}
+
+				size_t position() const { return m_out.size() - m_begin; }
+
+				void writeBytes(const void* data, size_t size)
+				{
+					if (size == 0)
+						return;
+					size_t at = m_out.size();
+					m_out.resize(at + size);
+					memcpy(m_out.data() + at, data, size);
+				}
+
+				void align(size_t alignment)
+				{
+					size_t padding = (alignment - position() % alignment) % alignment;
+					m_out.resize(m_out.size() + padding, 0);
+				}
+
+				template<typename T>
+				void write(const T& value)
+				{
+					constexpr auto category = detail::binaryCategory<T>();
+					static_assert(category != detail::BinaryCategory::eUnsupported, "Type is neither reflected, trivially copyable nor a supported container.");
+					if constexpr (detail::isBulk<T>())
+						writeBytes(&value, sizeof(T));
+					else if constexpr (category == detail::BinaryCategory::eString)
+					{
+						writeSize(value.size());
+						writeElements(value.data(), value.size());
+					}
+					else if constexpr (detail::is_vector<T>::value || detail::is_array_view<T>::value)
+					{
+						writeSize(value.size());
+						writeElements(value.data(), value.size());
+					}
+					else if constexpr (category == detail::BinaryCategory::eFixedArray)
+						writeElements(std::data(value), std::size(value));
+					else if constexpr (category == detail::BinaryCategory::ePair)
+					{
+						write(value.first);
+						write(value.second);
+					}
+					else if constexpr (category == detail::BinaryCategory::eArray || category == detail::BinaryCategory::eMap || category == detail::BinaryCategory::eSet)
+					{
+						writeSize(value.size());
+						for (auto&& element : value)
+							write(static_cast<const typename T::value_type&>(element));
+					}
+					else
+					{
+						auto base = (const uint8_t*)&value;
+						for (auto& step : detail::reflectSteps(value))
+						{
+							if (step.field == size_t(-1))
+								writeBytes(base + step.offset, step.size);
+							else
+								fieldWriters<T>(std::make_index_sequence<TypeInfo<T>::fields.size>{})[step.field](*this, value);
+						}
+					}
+				}
+
+			private:
+
+				void writeSize(size_t size)
+				{
+					uint64_t count = size;
+					writeBytes(&count, sizeof(count));
+				}
+
+				template<typename T>
+				void writeElements(const T* data, size_t count)
+				{
+					if constexpr (detail::isBulk<T>())
+					{
+						align(alignof(T));
+						writeBytes(data, count * sizeof(T));
+					}
+					else
+					{
+						for (size_t i = 0; i < count; i++)
+							write(data[i]);
+					}
+				}
+
+				template<typename T, size_t I>
+				static void writeField(BinaryWriter& writer, const T& obj)
+				{
+					constexpr auto field = TypeInfo<T>::fields.template GetByIdx<I>();
+					writer.write(obj.*(field.value));
+				}
+
+				template<typename T, size_t... Is>
+				static const auto& fieldWriters(std::index_sequence<Is...>)
+				{
+					static constexpr void(*writers[])(BinaryWriter&, const T&) = { &writeField<T, Is>... };
+					return writers;
+				}
+			};
+
+
+			class BinaryReader
+			{
+			private:
+				const uint8_t* m_data;
+				size_t         m_size;
+				size_t         m_position = 0;
+			public:
+
+				/*
+				 Strings and arrays are copied out, except for std::basic_string_view and ArrayView
+				 members, which point into data. Those need data to stay alive and to be aligned
+				 like the largest element type they view.
+				*/
+				BinaryReader(const void* data, size_t size) : m_data((const uint8_t*)data), m_size(size) {}
+
+				size_t position() const { return m_position; }
+				size_t remaining() const { return m_size - m_position; }
+
+				const uint8_t* take(size_t size)
+				{
+					if (size > remaining())
+						return nullptr;
+					auto data = m_data + m_position;
+					m_position += size;
+					return data;
+				}
+
+				bool readBytes(void* data, size_t size)
+				{
+					auto src = take(size);
+					if (src == nullptr)
+						return false;
+					if (size != 0)
+						memcpy(data, src, size);
+					return true;
+				}
+
+				bool align(size_t alignment)
+				{
+					return take((alignment - m_position % alignment) % alignment) != nullptr;
+				}
+
+				template<typename T>
+				bool read(T& value)
+				{
+					constexpr auto category = detail::binaryCategory<T>();
+					static_assert(category != detail::BinaryCategory::eUnsupported, "Type is neither reflected, trivially copyable nor a supported container.");
+					if constexpr (detail::isBulk<T>())
+						return readBytes(&value, sizeof(T));
+					else if constexpr (detail::is_string_view<T>::value || detail::is_array_view<T>::value)
+					{
+						using U = typename T::value_type;
+						size_t count;
+						const uint8_t* data;
+						if (!readSize(count, sizeof(U)) || !align(alignof(U)) || (data = take(count * sizeof(U))) == nullptr)
+							return false;
+						value = T((const U*)data, count);
+						return true;
+					}
+					else if constexpr (category == detail::BinaryCategory::eString || detail::is_vector<T>::value)
+					{
+						size_t count;
+						if (!readSize(count, detail::isBulk<typename T::value_type>() ? sizeof(typename T::value_type) : 1))
+							return false;
+						value.resize(count);
+						return readElements(value.data(), count);
+					}
+					else if constexpr (category == detail::BinaryCategory::eFixedArray)
+						return readElements(std::data(value), std::size(value));
+					else if constexpr (category == detail::BinaryCategory::ePair)
+						return read(const_cast<std::remove_const_t<typename T::first_type>&>(value.first)) && read(value.second);
+					else if constexpr (category == detail::BinaryCategory::eArray || category == detail::BinaryCategory::eMap || category == detail::BinaryCategory::eSet)
+					{
+						size_t count;
+						if (!readSize(count, 1))
+							return false;
+						value.clear();
+						for (size_t i = 0; i < count; i++)
+						{
+							typename T::value_type element;
+							if (!read(element))
+								return false;
+							if constexpr (category == detail::BinaryCategory::eArray)
+								value.push_back(std::move(element));
+							else
+								value.insert(std::move(element));
+						}
+						return true;
+					}
+					else
+					{
+						auto base = (uint8_t*)&value;
+						for (auto& step : detail::reflectSteps(value))
+						{
+							if (step.field == size_t(-1) ? !readBytes(base + step.offset, step.size) : !fieldReaders<T>(std::make_index_sequence<TypeInfo<T>::fields.size>{})[step.field](*this, value))
+								return false;
+						}
+						return true;
+					}
+				}
+
+			private:
+
+				// every element takes at least minimum bytes, which bounds the count by the input left
+				bool readSize(size_t& size, size_t minimum)
+				{
+					uint64_t count;
+					if (!readBytes(&count, sizeof(count)) || count > remaining() / minimum)
+						return false;
+					size = size_t(count);
+					return true;
+				}
+
+				template<typename T>
+				bool readElements(T* data, size_t count)
+				{
+					if constexpr (detail::isBulk<T>())
+						return align(alignof(T)) && readBytes(data, count * sizeof(T));
+					else
+					{
+						for (size_t i = 0; i < count; i++)
+							if (!read(data[i]))
+								return false;
+						return true;
+					}
+				}
+
+				template<typename T, size_t I>
+				static bool readField(BinaryReader& reader, T& obj)
+				{
+					constexpr auto field = TypeInfo<T>::fields.template GetByIdx<I>();
+					return reader.read(obj.*(field.value));
+				}
+
+				template<typename T, size_t... Is>
+				static const auto& fieldReaders(std::index_sequence<Is...>)
+				{
+					static constexpr bool(*readers[])(BinaryReader&, T&) = { &readField<T, Is>... };
+					return readers;
+				}
+			};
+
+
+			/*
+			 Appends the header and the encoding of value to out.
+			*/
+			template<typename T>
+			void serialize(const T& value, std::vector<uint8_t>& out)
+			{
+				size_t begin = out.size();
+				BinaryHeader header = {};
+				memcpy(header.id, "CEBN", 4);
+				header.format = detail::kBinaryFormat;
+				header.schemaHash = schemaHash<T>();
+				header.schemaVersion = SchemaVersion<T>::value;
+				BinaryWriter writer(out);
+				writer.writeBytes(&header, sizeof(header));
+				writer.write(value);
+				header.payloadSize = writer.position() - sizeof(header);
+				memcpy(out.data() + begin, &header, sizeof(header));
+			}
+
+			template<typename T>
+			std::vector<uint8_t> serialize(const T& value)
+			{
+				std::vector<uint8_t> out;
+				serialize(value, out);
+				return out;
+			}
+
+			/*
+			 Fails on a foreign or truncated buffer, or when the schema hash or version of T
+			 differs from the stored one. View members of value point into data afterwards.
+			*/
+			template<typename T>
+			bool deserialize(const void* data, size_t size, T& value)
+			{
+				BinaryHeader header;
+				BinaryReader reader(data, size);
+				if (!reader.readBytes(&header, sizeof(header)) || memcmp(header.id, "CEBN", 4) != 0 || header.format != detail::kBinaryFormat)
+					return false;
+				if (header.schemaHash != schemaHash<T>() || header.schemaVersion != SchemaVersion<T>::value || header.payloadSize > reader.remaining())
+					return false;
+				BinaryReader payload(data, sizeof(header) + header.payloadSize);
+				payload.take(sizeof(header));
+				return payload.read(value) && payload.remaining() == 0;
+			}
+
+			template<typename T>
+			bool deserialize(const std::vector<uint8_t>& data, T& value)
+			{
+				return deserialize(data.data(), data.size(), value);
+			}
+
+
+		}
+
+	}
+
+}
+
+#endif // !CRAFT_ENGINE_CORE_SERIALIZE_H_
@@ -184,5 +184,129 @@ namespace CraftEngine
 
 
 
+#ifndef CRAFT_ENGINE_CORE_UNIQUE_TASK_INLINE_SIZE
+#define CRAFT_ENGINE_CORE_UNIQUE_TASK_INLINE_SIZE 256
+#endif
+
+		/*
+		 * BasicUniqueTask: move-only void() callable for task queues.
+		 * Callables up to InlineSize bytes live inside the task, larger ones take a single heap allocation.
+		 * Moving a task never copies the callable, so dequeuing is a few pointer moves.
+		*/
+		template<size_t InlineSize = CRAFT_ENGINE_CORE_UNIQUE_TASK_INLINE_SIZE>
+		class BasicUniqueTask
+		{
+		private:
+			struct Operations
+			{
+				void(*mInvoke)(void* storage);
+				void(*mMove)(void* dst, void* src);   // move constructs dst from src and destroys src
+				void(*mDestroy)(void* storage);
+			};
+
+			template<typename Func>
+			struct InlineOperations
+			{
+				static void invoke(void* storage) { (*(Func*)storage)(); }
+				static void move(void* dst, void* src) { new(dst) Func(std::move(*(Func*)src)); ((Func*)src)->~Func(); }
+				static void destroy(void* storage) { ((Func*)storage)->~Func(); }
+				static const Operations* get() { static const Operations operations = { invoke, move, destroy }; return &operations; }
+			};
+
+			template<typename Func>
+			struct HeapOperations
+			{
+				static void invoke(void* storage) { (**(Func**)storage)(); }
+				static void move(void* dst, void* src) { *(Func**)dst = *(Func**)src; }
+				static void destroy(void* storage) { delete *(Func**)storage; }
+				static const Operations* get() { static const Operations operations = { invoke, move, destroy }; return &operations; }
+			};
+
+			template<typename Func>
+			using StoresInline = std::integral_constant<bool,
+				sizeof(Func) <= InlineSize && alignof(Func) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible<Func>::value>;
+
+			static_assert(InlineSize >= sizeof(void*), "inline storage must hold at least a pointer");
+
+			alignas(std::max_align_t) unsigned char m_storage[InlineSize];
+			const Operations* m_operations;
+
+			template<typename Func>
+			void construct(Func&& func, std::true_type)
+			{
+				using FuncType = typename std::decay<Func>::type;
+				new(m_storage) FuncType(std::forward<Func>(func));
+				m_operations = InlineOperations<FuncType>::get();
+			}
+
+			template<typename Func>
+			void construct(Func&& func, std::false_type)
+			{
+				using FuncType = typename std::decay<Func>::type;
+				*(FuncType**)m_storage = new FuncType(std::forward<Func>(func));
+				m_operations = HeapOperations<FuncType>::get();
+			}
+		public:
+			BasicUniqueTask() noexcept : m_operations(nullptr) {}
+
+			template<typename Func, class = typename std::enable_if<!std::is_same<typename std::decay<Func>::type, BasicUniqueTask>::value>::type>
+			BasicUniqueTask(Func&& func) : m_operations(nullptr)
+			{
+				construct(std::forward<Func>(func), StoresInline<typename std::decay<Func>::type>());
+			}
+
+			BasicUniqueTask(BasicUniqueTask&& other) noexcept : m_operations(other.m_operations)
+			{
+				if (m_operations != nullptr)
+					m_operations->mMove(m_storage, other.m_storage);
+				other.m_operations = nullptr;
+			}
+
+			BasicUniqueTask& operator=(BasicUniqueTask&& other) noexcept
+			{
+				if (this != &other)
+				{
+					reset();
+					m_operations = other.m_operations;
+					if (m_operations != nullptr)
+						m_operations->mMove(m_storage, other.m_storage);
+					other.m_operations = nullptr;
+				}
+				return *this;
+			}
+
+			BasicUniqueTask(const BasicUniqueTask&) = delete;
+			BasicUniqueTask& operator=(const BasicUniqueTask&) = delete;
+
+			~BasicUniqueTask()
+			{
+				reset();
+			}
+
+			void reset()
+			{
+				if (m_operations != nullptr)
+					m_operations->mDestroy(m_storage);
+				m_operations = nullptr;
+			}
+
+			bool valid() const { return m_operations != nullptr; }
+			explicit operator bool() const { return valid(); }
+
+			void execute()
+			{
+				m_operations->mInvoke(m_storage);
+			}
+
+			void operator()()
+			{
+				m_operations->mInvoke(m_storage);
+			}
+		};
+
+		using UniqueTask = BasicUniqueTask<>;
+
+
+
 	}
 }
\ No newline at end of file
@@ -1,5 +1,9 @@
 #pragma once
 #include "./Memory.h"
+#include <cstring>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 namespace CraftEngine
 {
@@ -42,18 +46,25 @@ namespace CraftEngine
 			// AlignedMemoryAllocator<Type, alignment>
 			MemAllocator m_allocator;
 
-			int32_t ExpandRule(int32_t size) { return size ? 2 * size : 1; }
+			// the first allocation fills a cache line, then the capacity doubles
+			int32_t ExpandRule(int32_t size) { return size ? 2 * size : int32_t(sizeof(Type) >= 64 ? 1 : 64 / sizeof(Type)); }
+
+			// SmallArrayList overrides these, a list never frees or steals inline storage
+			virtual Type* InlineStorage() { return nullptr; }
+			virtual int32_t InlineCapacity() const { return 0; }
+			bool IsInline() { return m_data != nullptr && m_data == InlineStorage(); }
 
 			void CopyTo(Type* dest, int32_t begin, int32_t end)const
 			{
 				if (std::is_pod<Type>::value)
 				{
-					memcpy(dest, &m_data[begin], (end - begin) * sizeof(Type));
+					if (end > begin)
+						memcpy(dest, &m_data[begin], (end - begin) * sizeof(Type));
 				}
 				else
 				{
 					for (int i = begin, j = 0; i < end; i++, j++)
-						new(&dest[i]) Type(m_data[j]);
+						new(&dest[j]) Type(m_data[i]);
 				}
 			}
 
@@ -61,7 +72,8 @@ namespace CraftEngine
 			{
 				if (std::is_pod<Type>::value)
 				{
-					memcpy(dest, m_data, count * sizeof(Type));
+					if (count > 0)
+						memcpy(dest, m_data, count * sizeof(Type));
 				}
 				else
 				{
@@ -70,6 +82,24 @@ namespace CraftEngine
 				}
 			}
 
+			// move constructs the elements into dest and destroys the sources
+			void MoveTo(Type* dest, int32_t count)
+			{
+				if (std::is_pod<Type>::value)
+				{
+					if (count > 0)
+						memcpy(dest, m_data, count * sizeof(Type));
+				}
+				else
+				{
+					for (int i = 0; i < count; i++)
+					{
+						new(&dest[i]) Type(std::move(m_data[i]));
+						m_data[i].~Type();
+					}
+				}
+			}
+
 			void Init()
 			{
 				m_capacity = 0;
@@ -89,25 +119,66 @@ namespace CraftEngine
 					if (!std::is_pod<Type>::value)
 						for (int i = 0; i < size(); i++)
 							m_data[i].~Type();
-					m_allocator.deallocate(m_data);
+					if (!IsInline())
+						m_allocator.deallocate(m_data);
 				}
 				m_data = nullptr;
 				return;
 			}
 
+			// moves the elements into a buffer of exactly nSize, shrinking back into inline storage when it fits
 			void Reallocate(int32_t nSize)
 			{
-				if (capacity() < nSize)
+				if (nSize < size() || nSize == capacity())
+					return;
+				Type* s = nullptr;
+				if (nSize <= InlineCapacity())
 				{
-					Type* s = (Type*)Allocate(nSize);
-					CopyTo(s, size());
-					Deallocate();
-					m_data = s;
-					m_capacity = nSize;
+					if (IsInline())
+						return;
+					s = InlineStorage();
+					nSize = InlineCapacity();
+				}
+				else
+				{
+					s = (Type*)Allocate(nSize);
 				}
+				MoveTo(s, size());
+				if (m_data != nullptr && !IsInline())
+					m_allocator.deallocate(m_data);
+				m_data = s;
+				m_capacity = nSize;
 			}
 
-			int32_t capacity()const { return m_capacity; }
+			void Grow(int32_t minCapacity)
+			{
+				if (capacity() < minCapacity)
+				{
+					auto nSize = ExpandRule(capacity());
+					Reallocate(nSize > minCapacity ? nSize : minCapacity);
+				}
+			}
+
+			// takes the other's heap buffer, inline elements are moved one by one
+			void MoveFrom(ArrayList& other)
+			{
+				clear();
+				if (other.m_data == nullptr || other.IsInline())
+				{
+					reserve(other.size());
+					other.MoveTo(m_data, other.size());
+					m_size = other.m_size;
+					other.m_size = 0;
+					return;
+				}
+				Deallocate();
+				m_data = other.m_data;
+				m_size = other.m_size;
+				m_capacity = other.m_capacity;
+				other.m_data = other.InlineStorage();
+				other.m_size = 0;
+				other.m_capacity = other.InlineCapacity();
+			}
 
 		public:
 			ArrayList() {
@@ -122,23 +193,24 @@ namespace CraftEngine
 
 			ArrayList(const std::initializer_list<Type>& list) : ArrayList()
 			{
+				reserve(list.size());
 				for (auto& it : list)
 					push_back(it);
 			}
 
-			ArrayList(ArrayList<Type>&& list) : ArrayList()
+			ArrayList(ArrayList<Type, MemAllocator>&& list) : ArrayList()
 			{
-				swap(list);
+				MoveFrom(list);
 			}
 
-			ArrayList(const ArrayList<Type>& other) {
+			ArrayList(const ArrayList<Type, MemAllocator>& other) {
 				Init();
-				Reallocate(other.capacity());
+				Reallocate(other.size());
 				other.CopyTo(this->m_data, other.size());
 				this->m_size = other.size();
 			}
 
-			ArrayList<Type>& operator=(const ArrayList<Type>& other)
+			ArrayList<Type, MemAllocator>& operator=(const ArrayList<Type, MemAllocator>& other)
 			{
 				if (this == &other)
 					return *this;
@@ -150,6 +222,13 @@ namespace CraftEngine
 				return *this;
 			}
 
+			ArrayList<Type, MemAllocator>& operator=(ArrayList<Type, MemAllocator>&& other)
+			{
+				if (this != &other)
+					MoveFrom(other);
+				return *this;
+			}
+
 			virtual ~ArrayList() {
 				Deallocate();
 				Init();
@@ -160,11 +239,33 @@ namespace CraftEngine
 				resize(0);
 			}
 
+			int32_t capacity()const { return m_capacity; }
+
+			void reserve(int32_t nCapacity)
+			{
+				if (nCapacity > capacity())
+					Reallocate(nCapacity);
+			}
+
+			void shrink_to_fit()
+			{
+				if (size() == 0 && !IsInline())
+				{
+					Deallocate();
+					m_data = InlineStorage();
+					m_capacity = InlineCapacity();
+				}
+				else if (size() < capacity())
+				{
+					Reallocate(size());
+				}
+			}
+
 			void resize(int32_t nSize)
 			{
 				if (nSize > size())
 				{
-					Reallocate(nSize);
+					reserve(nSize);
 					for (int i = size(); i < nSize; i++)
 						new(&m_data[i]) Type();
 				}
@@ -180,9 +281,18 @@ namespace CraftEngine
 			{
 				if (nSize > size())
 				{
-					Reallocate(nSize);
-					for (int i = size(); i < nSize; i++)
-						new(&m_data[i]) Type(data);
+					if (nSize > capacity())
+					{
+						Type temp(data);
+						reserve(nSize);
+						for (int i = size(); i < nSize; i++)
+							new(&m_data[i]) Type(temp);
+					}
+					else
+					{
+						for (int i = size(); i < nSize; i++)
+							new(&m_data[i]) Type(data);
+					}
 				}
 				else
 				{
@@ -207,8 +317,7 @@ namespace CraftEngine
 
 			void erase(int32_t count, int32_t offset)
 			{
-				auto start = offset;
-				auto end = size();
+				auto end = size() - count;
 				for (int i = offset; i < end; i++)
 					m_data[i] = std::move(m_data[i + count]);
 				resize(size() - count);
@@ -224,19 +333,28 @@ namespace CraftEngine
 
 			void insert(int32_t index, Type const& val)
 			{
+				Type temp(val);
+				Grow(size() + 1);
 				resize(size() + 1);
 				int i = m_size - 1;
 				for (; i > index; i--)
-					m_data[i] = m_data[i - 1];
-				m_data[index] = val;
+					m_data[i] = std::move(m_data[i - 1]);
+				m_data[index] = std::move(temp);
 			}
 
-			void insert(int32_t index, ArrayList<Type> const& list)
+			void insert(int32_t index, ArrayList<Type, MemAllocator> const& list)
 			{
+				if (&list == this)
+				{
+					ArrayList<Type, MemAllocator> temp(list);
+					insert(index, temp);
+					return;
+				}
+				Grow(size() + list.size());
 				resize(size() + list.size());
-				int i = size() - 1, j = 0;
-				for (; i > index; i--)
-					m_data[i] = m_data[i - list.size()];
+				int i = size() - 1;
+				for (; i >= index + list.size(); i--)
+					m_data[i] = std::move(m_data[i - list.size()]);
 				for (i = 0; i < list.size(); i++)
 					m_data[i + index] = list[i];
 			}
@@ -245,43 +363,65 @@ namespace CraftEngine
 			void push_back(Type const& val)
 			{
 				if (size() == capacity())
-					Reallocate(ExpandRule(size()));
-				if constexpr (std::is_pod<Type>::value)
+				{
+					// val may live in this list, copy it before the old buffer goes away
+					Type temp(val);
+					Grow(size() + 1);
+					new(&m_data[size()]) Type(std::move(temp));
+				}
+				else if constexpr (std::is_pod<Type>::value)
 					m_data[size()] = val;
 				else
 					new(&m_data[size()]) Type(val);
 				m_size++;
 			}
 
+			void push_back(Type&& val)
+			{
+				emplace_back(std::move(val));
+			}
+
 			/* Ӷ */
-			void emplace_back(Type&& val)
+			template<typename... Args>
+			Type& emplace_back(Args&&... args)
 			{
 				if (size() == capacity())
-					Reallocate(ExpandRule(size()));
-				new(&m_data[size()]) Type(std::move(val));
-				m_size++;
+				{
+					Type temp(std::forward<Args>(args)...);
+					Grow(size() + 1);
+					new(&m_data[size()]) Type(std::move(temp));
+				}
+				else
+				{
+					new(&m_data[size()]) Type(std::forward<Args>(args)...);
+				}
+				return m_data[m_size++];
 			}
 
 			/* β */
 			void pop_back()
 			{
 				if (m_size > 0)
-					if (std::is_pod<Type>::value)
-						m_data[--m_size].~Type();
-					else
-						m_size--;
+					m_data[--m_size].~Type();
 			}
 
 			/*  i j ӦĶ */
 			void swap(int32_t i, int32_t j)
 			{
-				Type temp = m_data[i];
-				m_data[i] = m_data[j];
-				m_data[j] = temp;
+				std::swap(m_data[i], m_data[j]);
 			}
 
-			void swap(ArrayList<Type>& other)
+			void swap(ArrayList<Type, MemAllocator>& other)
 			{
+				if (this == &other)
+					return;
+				if (IsInline() || other.IsInline())
+				{
+					ArrayList<Type, MemAllocator> temp(std::move(other));
+					other.MoveFrom(*this);
+					MoveFrom(temp);
+					return;
+				}
 				auto t_capacity = other.m_capacity;
 				auto t_data = other.m_data;
 				auto t_size = other.m_size;
@@ -294,6 +434,17 @@ namespace CraftEngine
 				this->m_data = t_data;
 				this->m_size = t_size;
 				this->m_allocator = t_allocator;
+				// an empty small list handed its null buffer over falls back to its inline storage
+				if (this->m_data == nullptr && InlineCapacity() > 0)
+				{
+					this->m_data = InlineStorage();
+					this->m_capacity = InlineCapacity();
+				}
+				if (other.m_data == nullptr && other.InlineCapacity() > 0)
+				{
+					other.m_data = other.InlineStorage();
+					other.m_capacity = other.InlineCapacity();
+				}
 			}
 
 			bool empty() const { return m_size == 0; }
@@ -314,6 +465,84 @@ namespace CraftEngine
 		};
 
 
+		/*
+		 * ArrayList with the first InlineCount elements stored in the object itself,
+		 * it only allocates once it outgrows them and can be passed wherever an ArrayList& is expected.
+		*/
+		template<typename Type, int32_t InlineCount, typename MemAllocator = MemoryAllocator<Type>>
+		class SmallArrayList : public ArrayList<Type, MemAllocator>
+		{
+		private:
+			typedef ArrayList<Type, MemAllocator> base_type;
+			static_assert(InlineCount > 0, "the template pamram \'InlineCount\' must be greater than 0");
+
+			alignas(Type) unsigned char m_inlineData[InlineCount * sizeof(Type)];
+
+			void InitInline()
+			{
+				this->m_data = (Type*)m_inlineData;
+				this->m_capacity = InlineCount;
+			}
+		protected:
+			Type* InlineStorage() override { return (Type*)m_inlineData; }
+			int32_t InlineCapacity() const override { return InlineCount; }
+		public:
+			SmallArrayList() : base_type() { InitInline(); }
+
+			CRAFT_ENGINE_EXPLICIT SmallArrayList(int32_t size) : base_type()
+			{
+				InitInline();
+				this->resize(size);
+			}
+
+			SmallArrayList(const std::initializer_list<Type>& list) : base_type()
+			{
+				InitInline();
+				this->reserve(list.size());
+				for (auto& it : list)
+					this->push_back(it);
+			}
+
+			SmallArrayList(const base_type& other) : base_type()
+			{
+				InitInline();
+				base_type::operator=(other);
+			}
+
+			SmallArrayList(const SmallArrayList& other) : base_type()
+			{
+				InitInline();
+				base_type::operator=(other);
+			}
+
+			SmallArrayList(base_type&& other) : base_type()
+			{
+				InitInline();
+				this->MoveFrom(other);
+			}
+
+			SmallArrayList(SmallArrayList&& other) : base_type()
+			{
+				InitInline();
+				this->MoveFrom(other);
+			}
+
+			SmallArrayList& operator=(const base_type& other) { base_type::operator=(other); return *this; }
+			SmallArrayList& operator=(const SmallArrayList& other) { base_type::operator=(other); return *this; }
+			SmallArrayList& operator=(base_type&& other) { base_type::operator=(std::move(other)); return *this; }
+			SmallArrayList& operator=(SmallArrayList&& other) { base_type::operator=(std::move(other)); return *this; }
+
+			// the base destructor cannot see the inline buffer any more, so release it here
+			~SmallArrayList()
+			{
+				this->Deallocate();
+				this->Init();
+			}
+
+			bool is_inline() const { return this->m_data == (const Type*)m_inlineData; }
+		};
+
+
 
 		template<typename Type>
 		class LinkedList
@@ -1236,7 +1465,7 @@ namespace CraftEngine
 				return Iterator(nullptr);
 			}
 
-			ConstIterator begin() {
+			ConstIterator begin() const {
 				const Node* res = m_root;
 				if (res != nullptr)
 					while (res->mLeft != nullptr)
@@ -1244,7 +1473,7 @@ namespace CraftEngine
 				return ConstIterator(res);
 			}
 
-			ConstIterator end() {
+			ConstIterator end() const {
 				return ConstIterator(nullptr);
 			}
 		};
@@ -1493,6 +1722,835 @@ namespace CraftEngine
 
 
 
+		namespace detail
+		{
+			constexpr int8_t   FlatHashEmpty = -128;
+			constexpr int8_t   FlatHashDeleted = -2;
+			constexpr uint32_t FlatHashGroupWidth = 16;
+
+			inline uint32_t flatHashLowestBit(uint32_t mask)
+			{
+#if defined(_MSC_VER)
+				unsigned long index;
+				_BitScanForward(&index, mask);
+				return index;
+#else
+				return __builtin_ctz(mask);
+#endif
+			}
+
+			// bit i is set when control byte i of the group equals h2
+			inline uint32_t flatHashMatch(const int8_t* group, int8_t h2)
+			{
+#if defined(CRAFT_ENGINE_SIMD_SSE2)
+				auto ctrl = _mm_loadu_si128((const __m128i*)group);
+				return uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(h2))));
+#else
+				uint32_t mask = 0;
+				for (uint32_t i = 0; i < FlatHashGroupWidth; i++)
+					if (group[i] == h2)
+						mask |= 1u << i;
+				return mask;
+#endif
+			}
+
+			// empty and deleted are the only negative control bytes
+			inline uint32_t flatHashMatchFree(const int8_t* group)
+			{
+#if defined(CRAFT_ENGINE_SIMD_SSE2)
+				return uint32_t(_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)group)));
+#else
+				uint32_t mask = 0;
+				for (uint32_t i = 0; i < FlatHashGroupWidth; i++)
+					if (group[i] < 0)
+						mask |= 1u << i;
+				return mask;
+#endif
+			}
+
+			// std::hash is the identity for integers on some standard libraries, spread it before taking H1/H2
+			inline size_t flatHashMix(size_t hash)
+			{
+				uint64_t h = uint64_t(hash) * 0x9E3779B97F4A7C15ull;
+				return size_t(h ^ (h >> 32));
+			}
+		}
+
+
+		/*
+		 * Open-addressing hash map in the Swiss-table layout.
+		 * One control byte per slot holds 7 bits of the hash, a group of 16 of them is matched at once,
+		 * so a lookup usually touches one control group and one slot.
+		 * Inserting may rehash and move entries, pointers returned by find() are invalidated by it.
+		*/
+		template<typename KeyType, typename DataType, typename Hash = std::hash<KeyType>, typename KeyEqual = std::equal_to<KeyType>>
+		class FlatHashMap
+		{
+		public:
+			struct Entry
+			{
+				KeyType  mKey;
+				DataType mData;
+			};
+		private:
+			static constexpr uint32_t GroupWidth = detail::FlatHashGroupWidth;
+
+			int8_t*  m_ctrl;
+			Entry*   m_slots;
+			uint32_t m_capacity;    // 0 or a power of 2 that is a multiple of the group width
+			uint32_t m_size;
+			uint32_t m_growthLeft;  // empty slots that may still be filled before the load factor reaches 7/8
+			Hash     m_hash;
+			KeyEqual m_equal;
+
+			static uint32_t MaxLoad(uint32_t capacity) { return capacity - capacity / 8; }
+
+			template<typename ComparableKeyType>
+			size_t HashOf(const ComparableKeyType& key) const { return detail::flatHashMix(m_hash(key)); }
+
+			template<typename ComparableKeyType>
+			int64_t FindIndex(const ComparableKeyType& key) const
+			{
+				if (m_capacity == 0)
+					return -1;
+				auto hash = HashOf(key);
+				auto h2 = int8_t(hash & 0x7F);
+				uint32_t groupMask = m_capacity / GroupWidth - 1;
+				uint32_t group = uint32_t(hash >> 7) & groupMask;
+				for (uint32_t probe = 1; ; probe++)
+				{
+					auto ctrl = m_ctrl + group * GroupWidth;
+					for (auto mask = detail::flatHashMatch(ctrl, h2); mask != 0; mask &= mask - 1)
+					{
+						auto index = group * GroupWidth + detail::flatHashLowestBit(mask);
+						if (m_equal(m_slots[index].mKey, key))
+							return index;
+					}
+					if (detail::flatHashMatch(ctrl, detail::FlatHashEmpty) != 0)
+						return -1;
+					group = (group + probe) & groupMask;
+				}
+			}
+
+			uint32_t FindFree(size_t hash) const
+			{
+				uint32_t groupMask = m_capacity / GroupWidth - 1;
+				uint32_t group = uint32_t(hash >> 7) & groupMask;
+				for (uint32_t probe = 1; ; probe++)
+				{
+					auto mask = detail::flatHashMatchFree(m_ctrl + group * GroupWidth);
+					if (mask != 0)
+						return group * GroupWidth + detail::flatHashLowestBit(mask);
+					group = (group + probe) & groupMask;
+				}
+			}
+
+			void Rehash(uint32_t capacity)
+			{
+				auto oldCtrl = m_ctrl;
+				auto oldSlots = m_slots;
+				auto oldCapacity = m_capacity;
+				m_ctrl = new int8_t[capacity];
+				m_slots = (Entry*)::operator new(sizeof(Entry) * capacity);
+				m_capacity = capacity;
+				m_growthLeft = MaxLoad(capacity) - m_size;
+				memset(m_ctrl, (uint8_t)detail::FlatHashEmpty, capacity);
+				for (uint32_t i = 0; i < oldCapacity; i++)
+				{
+					if (oldCtrl[i] < 0)
+						continue;
+					auto hash = HashOf(oldSlots[i].mKey);
+					auto index = FindFree(hash);
+					m_ctrl[index] = int8_t(hash & 0x7F);
+					new(&m_slots[index]) Entry(std::move(oldSlots[i]));
+					oldSlots[i].~Entry();
+				}
+				delete[] oldCtrl;
+				::operator delete(oldSlots);
+			}
+
+			// tombstones alone can exhaust the growth budget, then the table is rebuilt at the same size
+			void Grow()
+			{
+				if (m_capacity == 0)
+					Rehash(GroupWidth);
+				else if (m_size <= MaxLoad(m_capacity) / 2)
+					Rehash(m_capacity);
+				else
+					Rehash(m_capacity * 2);
+			}
+
+			template<typename ComparableKeyType, typename... Args>
+			std::pair<uint32_t, bool> TryEmplace(ComparableKeyType&& key, Args&&... args)
+			{
+				auto found = FindIndex(key);
+				if (found >= 0)
+					return { uint32_t(found), false };
+				if (m_capacity == 0)
+					Grow();
+				auto hash = HashOf(key);
+				auto index = FindFree(hash);
+				if (m_growthLeft == 0 && m_ctrl[index] == detail::FlatHashEmpty)
+				{
+					Grow();
+					index = FindFree(hash);
+				}
+				new(&m_slots[index]) Entry{ KeyType(std::forward<ComparableKeyType>(key)), DataType(std::forward<Args>(args)...) };
+				if (m_ctrl[index] == detail::FlatHashEmpty)
+					m_growthLeft--;
+				m_ctrl[index] = int8_t(hash & 0x7F);
+				m_size++;
+				return { index, true };
+			}
+
+			void Release()
+			{
+				clear();
+				delete[] m_ctrl;
+				::operator delete(m_slots);
+				m_ctrl = nullptr;
+				m_slots = nullptr;
+				m_capacity = 0;
+				m_growthLeft = 0;
+			}
+
+		public:
+			FlatHashMap() : m_ctrl(nullptr), m_slots(nullptr), m_capacity(0), m_size(0), m_growthLeft(0) {}
+
+			FlatHashMap(const FlatHashMap& other) : FlatHashMap()
+			{
+				*this = other;
+			}
+
+			FlatHashMap(FlatHashMap&& other) : FlatHashMap()
+			{
+				swap(other);
+			}
+
+			FlatHashMap& operator=(const FlatHashMap& other)
+			{
+				if (this == &other)
+					return *this;
+				clear();
+				reserve(other.size());
+				for (auto it = other.begin(); it != other.end(); ++it)
+					insert(it.key(), *it);
+				return *this;
+			}
+
+			FlatHashMap& operator=(FlatHashMap&& other)
+			{
+				if (this != &other)
+				{
+					Release();
+					swap(other);
+				}
+				return *this;
+			}
+
+			~FlatHashMap()
+			{
+				Release();
+			}
+
+			void swap(FlatHashMap& other)
+			{
+				std::swap(m_ctrl, other.m_ctrl);
+				std::swap(m_slots, other.m_slots);
+				std::swap(m_capacity, other.m_capacity);
+				std::swap(m_size, other.m_size);
+				std::swap(m_growthLeft, other.m_growthLeft);
+				std::swap(m_hash, other.m_hash);
+				std::swap(m_equal, other.m_equal);
+			}
+
+			template<typename ComparableKeyType>
+			DataType* find(const ComparableKeyType& key)
+			{
+				auto index = FindIndex(key);
+				return index >= 0 ? &m_slots[index].mData : nullptr;
+			}
+
+			template<typename ComparableKeyType>
+			const DataType* find(const ComparableKeyType& key) const
+			{
+				auto index = FindIndex(key);
+				return index >= 0 ? &m_slots[index].mData : nullptr;
+			}
+
+			template<typename ComparableKeyType>
+			bool contain(const ComparableKeyType& key) const { return FindIndex(key) >= 0; }
+
+			bool insert(const KeyType& key, const DataType& data) { return TryEmplace(key, data).second; }
+			bool insert(KeyType&& key, DataType&& data) { return TryEmplace(std::move(key), std::move(data)).second; }
+
+			template<typename... Args>
+			bool emplace(const KeyType& key, Args&&... args) { return TryEmplace(key, std::forward<Args>(args)...).second; }
+			template<typename... Args>
+			bool emplace(KeyType&& key, Args&&... args) { return TryEmplace(std::move(key), std::forward<Args>(args)...).second; }
+
+			DataType& operator[](const KeyType& key)
+			{
+				auto index = TryEmplace(key).first;  // may rehash, read m_slots after it
+				return m_slots[index].mData;
+			}
+			DataType& operator[](KeyType&& key)
+			{
+				auto index = TryEmplace(std::move(key)).first;  // may rehash, read m_slots after it
+				return m_slots[index].mData;
+			}
+
+			template<typename ComparableKeyType>
+			bool remove(const ComparableKeyType& key)
+			{
+				auto found = FindIndex(key);
+				if (found < 0)
+					return false;
+				auto index = uint32_t(found);
+				m_slots[index].~Entry();
+				// a probe stops at the first group with an empty slot, so if this group has one nobody probes past it
+				if (detail::flatHashMatch(m_ctrl + index / GroupWidth * GroupWidth, detail::FlatHashEmpty) != 0)
+				{
+					m_ctrl[index] = detail::FlatHashEmpty;
+					m_growthLeft++;
+				}
+				else
+				{
+					m_ctrl[index] = detail::FlatHashDeleted;
+				}
+				m_size--;
+				return true;
+			}
+
+			void clear()
+			{
+				for (uint32_t i = 0; i < m_capacity; i++)
+				{
+					if (m_ctrl[i] >= 0)
+						m_slots[i].~Entry();
+				}
+				if (m_capacity > 0)
+					memset(m_ctrl, (uint8_t)detail::FlatHashEmpty, m_capacity);
+				m_size = 0;
+				m_growthLeft = MaxLoad(m_capacity);
+			}
+
+			void reserve(uint32_t count)
+			{
+				uint32_t capacity = m_capacity > 0 ? m_capacity : GroupWidth;
+				while (MaxLoad(capacity) < count)
+					capacity *= 2;
+				if (capacity > m_capacity)
+					Rehash(capacity);
+			}
+
+			uint32_t size() const { return m_size; }
+			bool empty() const { return m_size == 0; }
+			uint32_t capacity() const { return m_capacity; }
+
+
+			class Iterator
+			{
+			private:
+				friend class FlatHashMap;
+				const FlatHashMap* m_map;
+				uint32_t           m_index;
+				Iterator(const FlatHashMap* map, uint32_t index) :m_map(map), m_index(index) { skip(); }
+				void skip() { while (m_index < m_map->m_capacity && m_map->m_ctrl[m_index] < 0) m_index++; }
+			public:
+				Iterator() :m_map(nullptr), m_index(0) {};
+				bool operator==(const Iterator& other) const { return this->m_index == other.m_index; }
+				bool operator!=(const Iterator& other) const { return this->m_index != other.m_index; }
+				Iterator& operator++() { m_index++; skip(); return *this; }
+				Iterator operator++(int) { auto temp = *this; m_index++; skip(); return temp; }
+				const KeyType& key() const { return m_map->m_slots[m_index].mKey; }
+				DataType& operator*() const { return m_map->m_slots[m_index].mData; }
+				DataType* operator->() const { return &m_map->m_slots[m_index].mData; }
+			};
+
+			class ConstIterator
+			{
+			private:
+				friend class FlatHashMap;
+				const FlatHashMap* m_map;
+				uint32_t           m_index;
+				ConstIterator(const FlatHashMap* map, uint32_t index) :m_map(map), m_index(index) { skip(); }
+				void skip() { while (m_index < m_map->m_capacity && m_map->m_ctrl[m_index] < 0) m_index++; }
+			public:
+				ConstIterator() :m_map(nullptr), m_index(0) {};
+				bool operator==(const ConstIterator& other) const { return this->m_index == other.m_index; }
+				bool operator!=(const ConstIterator& other) const { return this->m_index != other.m_index; }
+				ConstIterator& operator++() { m_index++; skip(); return *this; }
+				ConstIterator operator++(int) { auto temp = *this; m_index++; skip(); return temp; }
+				const KeyType& key() const { return m_map->m_slots[m_index].mKey; }
+				const DataType& operator*() const { return m_map->m_slots[m_index].mData; }
+				const DataType* operator->() const { return &m_map->m_slots[m_index].mData; }
+			};
+
+			Iterator begin() { return Iterator(this, 0); }
+			Iterator end() { return Iterator(this, m_capacity); }
+			ConstIterator begin() const { return ConstIterator(this, 0); }
+			ConstIterator end() const { return ConstIterator(this, m_capacity); }
+		};
+
+
+
+
+		/*
+		 * Ordered map stored as a B-tree of degree NodeDegree.
+		 * Each node keeps up to 2 * NodeDegree - 1 keys contiguous and apart from the values,
+		 * so a search scans a few cache lines per level instead of chasing one pointer per key.
+		*/
+		template<typename KeyType, typename DataType, typename Compare = std::less<KeyType>, uint32_t NodeDegree = 16>
+		class BTreeMap
+		{
+		private:
+			static_assert(NodeDegree >= 2, "the template pamram \'NodeDegree\' must be at least 2");
+			static constexpr uint32_t MaxKeys = 2 * NodeDegree - 1;
+			static constexpr uint32_t MaxDepth = 32;
+
+			struct Node
+			{
+				uint32_t mCount;
+				bool     mLeaf;
+				alignas(KeyType) unsigned char mKeys[sizeof(KeyType) * MaxKeys];
+				alignas(DataType) unsigned char mData[sizeof(DataType) * MaxKeys];
+				Node*    mChildren[MaxKeys + 1];
+
+				Node(bool leaf) :mCount(0), mLeaf(leaf) {}
+				KeyType& key(uint32_t i) { return ((KeyType*)mKeys)[i]; }
+				DataType& data(uint32_t i) { return ((DataType*)mData)[i]; }
+			};
+
+			Node*    m_root;
+			uint32_t m_size;
+			Compare  m_compare;
+
+			// move constructs slot di of dst from slot si of src and destroys the source
+			static void MoveSlot(Node* dst, uint32_t di, Node* src, uint32_t si)
+			{
+				new(&dst->key(di)) KeyType(std::move(src->key(si)));
+				new(&dst->data(di)) DataType(std::move(src->data(si)));
+				src->key(si).~KeyType();
+				src->data(si).~DataType();
+			}
+
+			template<typename ComparableKeyType>
+			uint32_t LowerIndex(Node* node, const ComparableKeyType& key) const
+			{
+				uint32_t first = 0, count = node->mCount;
+				while (count > 0)
+				{
+					auto step = count / 2;
+					if (m_compare(node->key(first + step), key))
+					{
+						first += step + 1;
+						count -= step + 1;
+					}
+					else
+						count = step;
+				}
+				return first;
+			}
+
+			template<typename ComparableKeyType>
+			bool Equal(Node* node, uint32_t index, const ComparableKeyType& key) const
+			{
+				return index < node->mCount && !m_compare(key, node->key(index));
+			}
+
+			static void ClearNode(Node* node)
+			{
+				if (node == nullptr)
+					return;
+				for (uint32_t i = 0; i < node->mCount; i++)
+				{
+					node->key(i).~KeyType();
+					node->data(i).~DataType();
+				}
+				if (!node->mLeaf)
+					for (uint32_t i = 0; i <= node->mCount; i++)
+						ClearNode(node->mChildren[i]);
+				delete node;
+			}
+
+			// node->mChildren[i] is full, its median moves up into node
+			void SplitChild(Node* node, uint32_t i)
+			{
+				auto full = node->mChildren[i];
+				auto right = new Node(full->mLeaf);
+				right->mCount = NodeDegree - 1;
+				for (uint32_t j = 0; j < NodeDegree - 1; j++)
+					MoveSlot(right, j, full, j + NodeDegree);
+				if (!full->mLeaf)
+					for (uint32_t j = 0; j < NodeDegree; j++)
+						right->mChildren[j] = full->mChildren[j + NodeDegree];
+				for (uint32_t j = node->mCount; j > i; j--)
+					MoveSlot(node, j, node, j - 1);
+				for (uint32_t j = node->mCount + 1; j > i + 1; j--)
+					node->mChildren[j] = node->mChildren[j - 1];
+				node->mChildren[i + 1] = right;
+				MoveSlot(node, i, full, NodeDegree - 1);
+				full->mCount = NodeDegree - 1;
+				node->mCount++;
+			}
+
+			template<typename ComparableKeyType, typename... Args>
+			DataType* InsertNonFull(Node* node, ComparableKeyType&& key, Args&&... args)
+			{
+				while (true)
+				{
+					auto i = LowerIndex(node, key);
+					if (node->mLeaf)
+					{
+						for (uint32_t j = node->mCount; j > i; j--)
+							MoveSlot(node, j, node, j - 1);
+						new(&node->key(i)) KeyType(std::forward<ComparableKeyType>(key));
+						new(&node->data(i)) DataType(std::forward<Args>(args)...);
+						node->mCount++;
+						return &node->data(i);
+					}
+					if (node->mChildren[i]->mCount == MaxKeys)
+					{
+						SplitChild(node, i);
+						if (m_compare(node->key(i), key))
+							i++;
+					}
+					node = node->mChildren[i];
+				}
+			}
+
+			template<typename ComparableKeyType, typename... Args>
+			std::pair<DataType*, bool> TryEmplace(ComparableKeyType&& key, Args&&... args)
+			{
+				auto found = find(key);
+				if (found != nullptr)
+					return { found, false };
+				if (m_root == nullptr)
+					m_root = new Node(true);
+				if (m_root->mCount == MaxKeys)
+				{
+					auto root = new Node(false);
+					root->mChildren[0] = m_root;
+					m_root = root;
+					SplitChild(root, 0);
+				}
+				m_size++;
+				return { InsertNonFull(m_root, std::forward<ComparableKeyType>(key), std::forward<Args>(args)...), true };
+			}
+
+			// children i and i + 1 both hold NodeDegree - 1 keys, they are joined around key i
+			void Merge(Node* node, uint32_t i)
+			{
+				auto left = node->mChildren[i];
+				auto right = node->mChildren[i + 1];
+				MoveSlot(left, NodeDegree - 1, node, i);
+				for (uint32_t j = 0; j < right->mCount; j++)
+					MoveSlot(left, j + NodeDegree, right, j);
+				if (!left->mLeaf)
+					for (uint32_t j = 0; j <= right->mCount; j++)
+						left->mChildren[j + NodeDegree] = right->mChildren[j];
+				for (uint32_t j = i; j + 1 < node->mCount; j++)
+					MoveSlot(node, j, node, j + 1);
+				for (uint32_t j = i + 1; j < node->mCount; j++)
+					node->mChildren[j] = node->mChildren[j + 1];
+				left->mCount += right->mCount + 1;
+				node->mCount--;
+				delete right;
+			}
+
+			void BorrowFromPrev(Node* node, uint32_t i)
+			{
+				auto child = node->mChildren[i];
+				auto sibling = node->mChildren[i - 1];
+				for (uint32_t j = child->mCount; j > 0; j--)
+					MoveSlot(child, j, child, j - 1);
+				if (!child->mLeaf)
+				{
+					for (uint32_t j = child->mCount + 1; j > 0; j--)
+						child->mChildren[j] = child->mChildren[j - 1];
+					child->mChildren[0] = sibling->mChildren[sibling->mCount];
+				}
+				MoveSlot(child, 0, node, i - 1);
+				MoveSlot(node, i - 1, sibling, sibling->mCount - 1);
+				child->mCount++;
+				sibling->mCount--;
+			}
+
+			void BorrowFromNext(Node* node, uint32_t i)
+			{
+				auto child = node->mChildren[i];
+				auto sibling = node->mChildren[i + 1];
+				MoveSlot(child, child->mCount, node, i);
+				if (!child->mLeaf)
+					child->mChildren[child->mCount + 1] = sibling->mChildren[0];
+				MoveSlot(node, i, sibling, 0);
+				for (uint32_t j = 0; j + 1 < sibling->mCount; j++)
+					MoveSlot(sibling, j, sibling, j + 1);
+				if (!sibling->mLeaf)
+					for (uint32_t j = 0; j < sibling->mCount; j++)
+						sibling->mChildren[j] = sibling->mChildren[j + 1];
+				child->mCount++;
+				sibling->mCount--;
+			}
+
+			// makes sure the child we descend into can lose a key, returns its index afterwards
+			uint32_t Fill(Node* node, uint32_t i)
+			{
+				if (i > 0 && node->mChildren[i - 1]->mCount >= NodeDegree)
+					BorrowFromPrev(node, i);
+				else if (i < node->mCount && node->mChildren[i + 1]->mCount >= NodeDegree)
+					BorrowFromNext(node, i);
+				else if (i < node->mCount)
+					Merge(node, i);
+				else
+					Merge(node, --i);
+				return i;
+			}
+
+			template<typename ComparableKeyType>
+			bool RemoveFrom(Node* node, const ComparableKeyType& key)
+			{
+				while (true)
+				{
+					auto i = LowerIndex(node, key);
+					if (Equal(node, i, key))
+					{
+						if (node->mLeaf)
+						{
+							node->key(i).~KeyType();
+							node->data(i).~DataType();
+							for (uint32_t j = i; j + 1 < node->mCount; j++)
+								MoveSlot(node, j, node, j + 1);
+							node->mCount--;
+							return true;
+						}
+						// swap the key with its predecessor or successor, it then sits in a leaf at the edge of that subtree
+						if (node->mChildren[i]->mCount >= NodeDegree)
+						{
+							auto leaf = node->mChildren[i];
+							while (!leaf->mLeaf)
+								leaf = leaf->mChildren[leaf->mCount];
+							std::swap(node->key(i), leaf->key(leaf->mCount - 1));
+							std::swap(node->data(i), leaf->data(leaf->mCount - 1));
+							node = node->mChildren[i];
+						}
+						else if (node->mChildren[i + 1]->mCount >= NodeDegree)
+						{
+							auto leaf = node->mChildren[i + 1];
+							while (!leaf->mLeaf)
+								leaf = leaf->mChildren[0];
+							std::swap(node->key(i), leaf->key(0));
+							std::swap(node->data(i), leaf->data(0));
+							node = node->mChildren[i + 1];
+						}
+						else
+						{
+							Merge(node, i);
+							node = node->mChildren[i];
+						}
+						continue;
+					}
+					if (node->mLeaf)
+						return false;
+					if (node->mChildren[i]->mCount < NodeDegree)
+						i = Fill(node, i);
+					node = node->mChildren[i];
+				}
+			}
+
+		public:
+			BTreeMap() :m_root(nullptr), m_size(0) {}
+
+			BTreeMap(const BTreeMap& other) : BTreeMap()
+			{
+				*this = other;
+			}
+
+			BTreeMap(BTreeMap&& other) : BTreeMap()
+			{
+				swap(other);
+			}
+
+			BTreeMap& operator=(const BTreeMap& other)
+			{
+				if (this == &other)
+					return *this;
+				clear();
+				for (auto it = other.begin(); it != other.end(); ++it)
+					insert(it.key(), *it);
+				return *this;
+			}
+
+			BTreeMap& operator=(BTreeMap&& other)
+			{
+				if (this != &other)
+				{
+					clear();
+					swap(other);
+				}
+				return *this;
+			}
+
+			~BTreeMap()
+			{
+				clear();
+			}
+
+			void swap(BTreeMap& other)
+			{
+				std::swap(m_root, other.m_root);
+				std::swap(m_size, other.m_size);
+				std::swap(m_compare, other.m_compare);
+			}
+
+			template<typename ComparableKeyType>
+			DataType* find(const ComparableKeyType& key)
+			{
+				auto node = m_root;
+				while (node != nullptr)
+				{
+					auto i = LowerIndex(node, key);
+					if (Equal(node, i, key))
+						return &node->data(i);
+					node = node->mLeaf ? nullptr : node->mChildren[i];
+				}
+				return nullptr;
+			}
+
+			template<typename ComparableKeyType>
+			const DataType* find(const ComparableKeyType& key) const
+			{
+				return const_cast<BTreeMap*>(this)->find(key);
+			}
+
+			template<typename ComparableKeyType>
+			bool contain(const ComparableKeyType& key) const { return find(key) != nullptr; }
+
+			bool insert(const KeyType& key, const DataType& data) { return TryEmplace(key, data).second; }
+			bool insert(KeyType&& key, DataType&& data) { return TryEmplace(std::move(key), std::move(data)).second; }
+
+			template<typename... Args>
+			bool emplace(const KeyType& key, Args&&... args) { return TryEmplace(key, std::forward<Args>(args)...).second; }
+			template<typename... Args>
+			bool emplace(KeyType&& key, Args&&... args) { return TryEmplace(std::move(key), std::forward<Args>(args)...).second; }
+
+			DataType& operator[](const KeyType& key) { return *TryEmplace(key).first; }
+			DataType& operator[](KeyType&& key) { return *TryEmplace(std::move(key)).first; }
+
+			template<typename ComparableKeyType>
+			bool remove(const ComparableKeyType& key)
+			{
+				if (m_root == nullptr)
+					return false;
+				bool removed = RemoveFrom(m_root, key);
+				if (removed)
+					m_size--;
+				// the descent may merge the last two children of the root even when the key is missing
+				if (m_root->mCount == 0)
+				{
+					auto root = m_root;
+					m_root = root->mLeaf ? nullptr : root->mChildren[0];
+					delete root;
+				}
+				return removed;
+			}
+
+			void clear()
+			{
+				ClearNode(m_root);
+				m_root = nullptr;
+				m_size = 0;
+			}
+
+			uint32_t size() const { return m_size; }
+			bool empty() const { return m_size == 0; }
+
+
+			// in-order iterator, keeps the path from the root so it needs no parent pointers
+			class Iterator
+			{
+			private:
+				friend class BTreeMap;
+				Node*    m_nodes[MaxDepth];
+				uint32_t m_indices[MaxDepth];
+				uint32_t m_depth;
+
+				void push(Node* node, uint32_t index) { m_nodes[m_depth] = node; m_indices[m_depth] = index; m_depth++; }
+				void pushLeftmost(Node* node)
+				{
+					while (true)
+					{
+						push(node, 0);
+						if (node->mLeaf)
+							break;
+						node = node->mChildren[0];
+					}
+				}
+				void popFinished()
+				{
+					while (m_depth > 0 && m_indices[m_depth - 1] >= m_nodes[m_depth - 1]->mCount)
+						m_depth--;
+				}
+			public:
+				Iterator() :m_depth(0) {};
+				bool operator==(const Iterator& other) const
+				{
+					if (m_depth == 0 || other.m_depth == 0)
+						return m_depth == other.m_depth;
+					return m_nodes[m_depth - 1] == other.m_nodes[other.m_depth - 1] && m_indices[m_depth - 1] == other.m_indices[other.m_depth - 1];
+				}
+				bool operator!=(const Iterator& other) const { return !(*this == other); }
+				Iterator& operator++()
+				{
+					auto node = m_nodes[m_depth - 1];
+					auto& index = m_indices[m_depth - 1];
+					index++;
+					if (!node->mLeaf)
+						pushLeftmost(node->mChildren[index]);
+					else
+						popFinished();
+					return *this;
+				}
+				Iterator operator++(int) { auto temp = *this; ++(*this); return temp; }
+				const KeyType& key() const { return m_nodes[m_depth - 1]->key(m_indices[m_depth - 1]); }
+				DataType& operator*() const { return m_nodes[m_depth - 1]->data(m_indices[m_depth - 1]); }
+				DataType* operator->() const { return &m_nodes[m_depth - 1]->data(m_indices[m_depth - 1]); }
+			};
+
+			typedef Iterator ConstIterator;
+
+			Iterator begin() const
+			{
+				Iterator it;
+				if (m_root != nullptr && m_root->mCount > 0)
+					it.pushLeftmost(m_root);
+				return it;
+			}
+
+			Iterator end() const { return Iterator(); }
+
+			// first entry whose key is not less than key
+			template<typename ComparableKeyType>
+			Iterator lower_bound(const ComparableKeyType& key) const
+			{
+				Iterator it;
+				auto node = m_root;
+				while (node != nullptr)
+				{
+					auto i = LowerIndex(node, key);
+					it.push(node, i);
+					if (Equal(node, i, key) || node->mLeaf)
+						break;
+					node = node->mChildren[i];
+				}
+				it.popFinished();
+				return it;
+			}
+		};
+
+
+
 
 	}
 }
\ No newline at end of file
@@ -13,7 +13,7 @@ namespace CraftEngine
 			typedef MemoryAllocator<Type> this_type;
 
 			void* memoryAllocate(size_t byteCount) { return new char[byteCount]; }
-			void  memoryFree(void* memPtr) { delete[] memPtr; }
+			void  memoryFree(void* memPtr) { delete[] (char*)memPtr; }
 		public:
 			typedef Type* pointer;
 			typedef Type& reference;
@@ -60,7 +60,7 @@ namespace CraftEngine
 
 			void* memoryAllocate(size_t byteCount) { return new char[byteCount]; }
 
-			void  memoryFree(void* memPtr) { delete[] memPtr; }
+			void  memoryFree(void* memPtr) { delete[] (char*)memPtr; }
 
 			void* alignedMemoryAllocate(size_t byteCount, unsigned alignment)
 			{
@@ -0,0 +1,635 @@
+#pragma once
+#include "../Common.h"
+#include <algorithm>
+#include <cassert>
+#include <new>
+
+#ifndef CRAFT_ENGINE_CORE_POOL_SLAB_SIZE
+#define CRAFT_ENGINE_CORE_POOL_SLAB_SIZE (64 * 1024)
+#endif
+
+#ifndef CRAFT_ENGINE_CORE_POOL_MAGAZINE_SIZE
+#define CRAFT_ENGINE_CORE_POOL_MAGAZINE_SIZE 64
+#endif
+
+/*
+ * Size-class pool allocator for small objects under multi-threaded load.
+ * Every thread keeps a magazine of free blocks per size class, so alloc/free normally touch no shared state.
+ * Magazines are exchanged with a lock-free global free list in batches, and the pool grows slab by slab.
+ * Slabs are aligned to their size, the owning pool and size class of any block are found by masking its address.
+ * Blocks past the largest class come from the system behind a small header, a process wide bitmap of slabs tells
+ * them apart from pool blocks without touching memory outside the block.
+*/
+
+namespace CraftEngine
+{
+	namespace core
+	{
+
+		class PoolAllocator;
+
+		namespace detail
+		{
+			constexpr size_t   PoolSlabSize = CRAFT_ENGINE_CORE_POOL_SLAB_SIZE;
+			constexpr size_t   PoolSlabHeaderSize = 64;
+			constexpr uint32_t PoolMaxSlabsPerChunk = 16;
+			constexpr uint32_t PoolMagazineSize = CRAFT_ENGINE_CORE_POOL_MAGAZINE_SIZE;
+			constexpr uint32_t PoolSizeClassCount = 32;
+			constexpr size_t   PoolMaxSmallSize = 8192;
+			constexpr size_t   PoolBlockAlignment = 16;
+
+			static_assert((PoolSlabSize & (PoolSlabSize - 1)) == 0, "the pool slab size must be a power of 2");
+			static_assert(PoolSlabSize >= PoolSlabHeaderSize + PoolMaxSmallSize * 4, "the pool slab size is too small for the largest size class");
+			static_assert(PoolMagazineSize > 0, "the pool magazine size must not be 0");
+
+			constexpr uint32_t poolLog2(size_t value)
+			{
+				return value <= 1 ? 0 : 1 + poolLog2(value >> 1);
+			}
+
+			// 16-byte steps up to 128, then 4 steps per power of 2 up to 8192
+			inline uint32_t poolSizeClassIndex(size_t size)
+			{
+				if (size <= 128)
+					return size == 0 ? 0 : uint32_t((size - 1) >> 4);
+				uint32_t lg = 0;
+				for (size_t s = size - 1; s > 1; s >>= 1)
+					lg++;
+				return 8 + (lg - 7) * 4 + uint32_t((size - 1 - (size_t(1) << lg)) >> (lg - 2));
+			}
+
+			inline size_t poolSizeClassSize(uint32_t index)
+			{
+				if (index < 8)
+					return size_t(index + 1) << 4;
+				uint32_t lg = 7 + (index - 8) / 4;
+				return (size_t(1) << lg) + size_t((index - 8) % 4 + 1) * (size_t(1) << (lg - 2));
+			}
+
+			struct PoolFreeBlock
+			{
+				PoolFreeBlock*              mNext;       // next block in a magazine or batch
+				std::atomic<PoolFreeBlock*> mNextBatch;  // next batch on the global free list, only valid on a batch head
+			};
+
+			struct PoolSlabHeader
+			{
+				PoolAllocator* mOwner;
+				uint32_t       mSizeClass;
+			};
+
+			// in front of every large block, the owner is kept by id so the block may outlive its pool
+			struct alignas(PoolBlockAlignment) PoolLargeHeader
+			{
+				uint64_t mOwnerId;
+				size_t   mSize;
+			};
+
+			inline PoolSlabHeader* poolSlabOf(const void* pointer)
+			{
+				return (PoolSlabHeader*)(uintptr_t(pointer) & ~uintptr_t(PoolSlabSize - 1));
+			}
+
+			inline PoolLargeHeader* poolLargeHeaderOf(const void* pointer)
+			{
+				return (PoolLargeHeader*)pointer - 1;
+			}
+
+			// one bit per slab of every live pool, a two level radix tree over the slab index of the address
+			class PoolSlabMap
+			{
+			private:
+				static constexpr uint32_t SlabShift = poolLog2(PoolSlabSize);
+				static constexpr uint32_t IndexBits = (sizeof(void*) >= 8 ? 48 : 32) - SlabShift;
+				static constexpr uint32_t LeafBits = IndexBits / 2;
+				static constexpr size_t   RootSize = size_t(1) << (IndexBits - LeafBits);
+				static constexpr size_t   LeafWords = (size_t(1) << LeafBits) / 64;
+
+				std::atomic<std::atomic<uint64_t>*> m_root[RootSize];
+				std::mutex                          m_mutex;  // serializes leaf creation
+
+				static size_t indexOf(const void* pointer) { return size_t(uintptr_t(pointer) >> SlabShift); }
+
+				std::atomic<uint64_t>* leaf(size_t index)
+				{
+					assert((index >> LeafBits) < RootSize);
+					auto& slot = m_root[index >> LeafBits];
+					auto leaf = slot.load(std::memory_order_acquire);
+					if (leaf != nullptr)
+						return leaf;
+					std::lock_guard<std::mutex> lock(m_mutex);
+					leaf = slot.load(std::memory_order_relaxed);
+					if (leaf == nullptr)
+					{
+						leaf = new std::atomic<uint64_t>[LeafWords]();
+						slot.store(leaf, std::memory_order_release);
+					}
+					return leaf;
+				}
+
+				void set(const void* slabs, size_t count, bool value)
+				{
+					for (size_t i = 0, index = indexOf(slabs); i < count; i++, index++)
+					{
+						auto& word = leaf(index)[(index & ((size_t(1) << LeafBits) - 1)) / 64];
+						auto bit = uint64_t(1) << (index % 64);
+						if (value)
+							word.fetch_or(bit, std::memory_order_release);
+						else
+							word.fetch_and(~bit, std::memory_order_release);
+					}
+				}
+			public:
+				// leaves are never released, they only cover address ranges pools have used
+				void insert(const void* slabs, size_t count) { set(slabs, count, true); }
+				void erase(const void* slabs, size_t count) { set(slabs, count, false); }
+
+				bool contains(const void* pointer) const
+				{
+					auto index = indexOf(pointer);
+					if ((index >> LeafBits) >= RootSize)
+						return false;
+					auto leaf = m_root[index >> LeafBits].load(std::memory_order_acquire);
+					if (leaf == nullptr)
+						return false;
+					auto word = leaf[(index & ((size_t(1) << LeafBits) - 1)) / 64].load(std::memory_order_acquire);
+					return (word >> (index % 64)) & 1;
+				}
+			};
+
+			inline PoolSlabMap& poolSlabMap()
+			{
+				static PoolSlabMap map;
+				return map;
+			}
+
+			struct PoolThreadCache
+			{
+				PoolFreeBlock* mHead[PoolSizeClassCount];
+				uint32_t       mCount[PoolSizeClassCount];
+				bool           mBound;  // guarded by the owning pool's mutex
+			};
+
+			// Treiber stack of batches, the upper 16 bits of the head carry an ABA tag
+			class PoolBatchStack
+			{
+			private:
+				static constexpr uint64_t PointerMask = (uint64_t(1) << 48) - 1;
+				std::atomic<uint64_t> m_head;
+
+				static PoolFreeBlock* pointerOf(uint64_t head) { return (PoolFreeBlock*)uintptr_t(head & PointerMask); }
+				static uint64_t pack(PoolFreeBlock* pointer, uint64_t head) { return uint64_t(uintptr_t(pointer)) | ((head & ~PointerMask) + (uint64_t(1) << 48)); }
+			public:
+				PoolBatchStack() : m_head(0) {}
+
+				void push(PoolFreeBlock* batch)
+				{
+					uint64_t head = m_head.load(std::memory_order_relaxed);
+					do {
+						batch->mNextBatch.store(pointerOf(head), std::memory_order_relaxed);
+					} while (!m_head.compare_exchange_weak(head, pack(batch, head), std::memory_order_release, std::memory_order_relaxed));
+				}
+
+				// slabs are only released with the pool, so reading a stale head's link is safe and the tag rejects it
+				PoolFreeBlock* pop()
+				{
+					uint64_t head = m_head.load(std::memory_order_acquire);
+					while (pointerOf(head) != nullptr)
+					{
+						auto next = pointerOf(head)->mNextBatch.load(std::memory_order_relaxed);
+						if (m_head.compare_exchange_weak(head, pack(next, head), std::memory_order_acquire, std::memory_order_acquire))
+							return pointerOf(head);
+					}
+					return nullptr;
+				}
+			};
+
+			struct PoolCacheBinding
+			{
+				uint64_t         mPoolId;
+				PoolAllocator*   mPool;
+				PoolThreadCache* mCache;
+			};
+
+			// returns this thread's magazines to their pools when the thread exits
+			struct PoolThreadBindings
+			{
+				std::vector<PoolCacheBinding> mBindings;
+				~PoolThreadBindings();
+			};
+
+			inline std::mutex& poolRegistryMutex()
+			{
+				static std::mutex mutex;
+				return mutex;
+			}
+
+			inline std::unordered_map<uint64_t, PoolAllocator*>& poolRegistry()
+			{
+				static std::unordered_map<uint64_t, PoolAllocator*> registry;
+				return registry;
+			}
+
+			inline uint64_t poolNextId()
+			{
+				static std::atomic<uint64_t> id(1);
+				return id.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			inline PoolThreadBindings& poolThreadBindings()
+			{
+				thread_local PoolThreadBindings bindings;
+				return bindings;
+			}
+		}
+
+
+		class PoolAllocator
+		{
+		private:
+			friend struct detail::PoolThreadBindings;
+
+			uint64_t                                              m_id;
+			detail::PoolBatchStack                                m_freeBatches[detail::PoolSizeClassCount];
+			std::mutex                                            m_mutex;
+			std::vector<std::pair<void*, uint32_t>>               m_chunks;  // base and slab count
+			char*                                                 m_chunkCursor;
+			uint32_t                                              m_chunkSlabsLeft;
+			uint32_t                                              m_nextChunkSlabs;
+			std::vector<std::unique_ptr<detail::PoolThreadCache>> m_caches;
+			std::atomic<size_t>                                   m_reservedBytes;
+			std::atomic<size_t>                                   m_largeBytes;
+
+			detail::PoolThreadCache* threadCache()
+			{
+				for (auto& binding : detail::poolThreadBindings().mBindings)
+					if (binding.mPoolId == m_id)
+						return binding.mCache;
+				return bindThreadCache();
+			}
+
+			detail::PoolThreadCache* bindThreadCache()
+			{
+				std::lock_guard<std::mutex> registryLock(detail::poolRegistryMutex());
+				auto& registry = detail::poolRegistry();
+				auto& bindings = detail::poolThreadBindings().mBindings;
+				bindings.erase(std::remove_if(bindings.begin(), bindings.end(), [&](const detail::PoolCacheBinding& binding) {
+					return registry.find(binding.mPoolId) == registry.end();
+				}), bindings.end());
+
+				std::lock_guard<std::mutex> lock(m_mutex);
+				detail::PoolThreadCache* cache = nullptr;
+				for (auto& it : m_caches)
+				{
+					if (!it->mBound)
+					{
+						cache = it.get();
+						break;
+					}
+				}
+				if (cache == nullptr)
+				{
+					m_caches.emplace_back(new detail::PoolThreadCache());
+					cache = m_caches.back().get();
+					for (uint32_t i = 0; i < detail::PoolSizeClassCount; i++)
+					{
+						cache->mHead[i] = nullptr;
+						cache->mCount[i] = 0;
+					}
+				}
+				cache->mBound = true;
+				bindings.push_back({ m_id, this, cache });
+				return cache;
+			}
+
+			// called with the registry mutex held, the pool cannot be destroyed meanwhile
+			void unbindThreadCache(detail::PoolThreadCache* cache)
+			{
+				for (uint32_t i = 0; i < detail::PoolSizeClassCount; i++)
+				{
+					if (cache->mHead[i] != nullptr)
+						m_freeBatches[i].push(cache->mHead[i]);
+					cache->mHead[i] = nullptr;
+					cache->mCount[i] = 0;
+				}
+				std::lock_guard<std::mutex> lock(m_mutex);
+				cache->mBound = false;
+			}
+
+			char* allocateSlab()
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (m_chunkSlabsLeft == 0)
+				{
+					// chunks grow geometrically so small pools stay small and big pools rarely lock
+					auto chunk = ::operator new(detail::PoolSlabSize * m_nextChunkSlabs, std::align_val_t(detail::PoolSlabSize));
+					detail::poolSlabMap().insert(chunk, m_nextChunkSlabs);
+					m_chunks.push_back({ chunk, m_nextChunkSlabs });
+					m_chunkCursor = (char*)chunk;
+					m_chunkSlabsLeft = m_nextChunkSlabs;
+					m_reservedBytes.fetch_add(detail::PoolSlabSize * m_nextChunkSlabs, std::memory_order_relaxed);
+					if (m_nextChunkSlabs < detail::PoolMaxSlabsPerChunk)
+						m_nextChunkSlabs *= 2;
+				}
+				auto slab = m_chunkCursor;
+				m_chunkCursor += detail::PoolSlabSize;
+				m_chunkSlabsLeft--;
+				return slab;
+			}
+
+			// a fresh slab gives one magazine to this thread, the rest is published in batches for the others
+			detail::PoolFreeBlock* refill(detail::PoolThreadCache* cache, uint32_t index)
+			{
+				auto batch = m_freeBatches[index].pop();
+				if (batch != nullptr)
+				{
+					uint32_t count = 0;
+					for (auto block = batch; block != nullptr; block = block->mNext)
+						count++;
+					cache->mHead[index] = batch;
+					cache->mCount[index] = count;
+					return batch;
+				}
+
+				auto slab = allocateSlab();
+				auto header = (detail::PoolSlabHeader*)slab;
+				header->mOwner = this;
+				header->mSizeClass = index;
+				auto blockSize = detail::poolSizeClassSize(index);
+				auto blockCount = uint32_t((detail::PoolSlabSize - detail::PoolSlabHeaderSize) / blockSize);
+				auto blocks = slab + detail::PoolSlabHeaderSize;
+				auto link = [&](uint32_t begin, uint32_t end) {
+					auto first = (detail::PoolFreeBlock*)(blocks + begin * blockSize);
+					auto block = first;
+					for (uint32_t i = begin + 1; i < end; i++)
+					{
+						auto next = (detail::PoolFreeBlock*)(blocks + i * blockSize);
+						block->mNext = next;
+						block = next;
+					}
+					block->mNext = nullptr;
+					return first;
+				};
+				auto kept = std::min(blockCount, detail::PoolMagazineSize);
+				for (uint32_t begin = kept; begin < blockCount; begin += detail::PoolMagazineSize)
+					m_freeBatches[index].push(link(begin, std::min(blockCount, begin + detail::PoolMagazineSize)));
+				auto first = link(0, kept);
+				cache->mHead[index] = first;
+				cache->mCount[index] = kept;
+				return first;
+			}
+
+			void releaseBatch(detail::PoolThreadCache* cache, uint32_t index)
+			{
+				auto batch = cache->mHead[index];
+				auto tail = batch;
+				for (uint32_t i = 1; i < detail::PoolMagazineSize; i++)
+					tail = tail->mNext;
+				cache->mHead[index] = tail->mNext;
+				cache->mCount[index] -= detail::PoolMagazineSize;
+				tail->mNext = nullptr;
+				m_freeBatches[index].push(batch);
+			}
+
+			void* allocateLarge(size_t size)
+			{
+				auto header = (detail::PoolLargeHeader*)::operator new(sizeof(detail::PoolLargeHeader) + size, std::align_val_t(detail::PoolBlockAlignment));
+				header->mOwnerId = m_id;
+				header->mSize = size;
+				m_largeBytes.fetch_add(size, std::memory_order_relaxed);
+				return header + 1;
+			}
+
+			// the pool may already be gone, its large blocks stay valid and are only left out of its count
+			static void releaseLarge(void* pointer)
+			{
+				auto header = detail::poolLargeHeaderOf(pointer);
+				{
+					std::lock_guard<std::mutex> registryLock(detail::poolRegistryMutex());
+					auto owner = detail::poolRegistry().find(header->mOwnerId);
+					if (owner != detail::poolRegistry().end())
+						owner->second->m_largeBytes.fetch_sub(header->mSize, std::memory_order_relaxed);
+				}
+				::operator delete(header, std::align_val_t(detail::PoolBlockAlignment));
+			}
+
+			void deallocateSmall(void* pointer, uint32_t index)
+			{
+				auto cache = threadCache();
+				auto block = (detail::PoolFreeBlock*)pointer;
+				block->mNext = cache->mHead[index];
+				cache->mHead[index] = block;
+				if (++cache->mCount[index] >= 2 * detail::PoolMagazineSize)
+					releaseBatch(cache, index);
+			}
+
+		public:
+			PoolAllocator()
+				: m_id(detail::poolNextId()), m_chunkCursor(nullptr), m_chunkSlabsLeft(0), m_nextChunkSlabs(1), m_reservedBytes(0), m_largeBytes(0)
+			{
+				std::lock_guard<std::mutex> registryLock(detail::poolRegistryMutex());
+				detail::poolRegistry()[m_id] = this;
+			}
+
+			PoolAllocator(const PoolAllocator&) = delete;
+			PoolAllocator& operator=(const PoolAllocator&) = delete;
+
+			// every small block of the pool is released at once, large blocks stay valid until they are freed
+			~PoolAllocator()
+			{
+				{
+					std::lock_guard<std::mutex> registryLock(detail::poolRegistryMutex());
+					detail::poolRegistry().erase(m_id);
+				}
+				for (auto& chunk : m_chunks)
+				{
+					detail::poolSlabMap().erase(chunk.first, chunk.second);
+					::operator delete(chunk.first, std::align_val_t(detail::PoolSlabSize));
+				}
+			}
+
+			void* allocate(size_t size)
+			{
+				if (size > detail::PoolMaxSmallSize)
+					return allocateLarge(size);
+				auto index = detail::poolSizeClassIndex(size);
+				auto cache = threadCache();
+				auto block = cache->mHead[index];
+				if (block == nullptr)
+					block = refill(cache, index);
+				cache->mHead[index] = block->mNext;
+				cache->mCount[index]--;
+				return block;
+			}
+
+			// any thread may free any block, a small one goes back through the owner found from the slab header
+			static void release(void* pointer)
+			{
+				if (pointer == nullptr)
+					return;
+				if (!detail::poolSlabMap().contains(pointer))
+				{
+					releaseLarge(pointer);
+					return;
+				}
+				auto header = detail::poolSlabOf(pointer);
+				header->mOwner->deallocateSmall(pointer, header->mSizeClass);
+			}
+
+			// sized release, size must be the one passed to allocate
+			static void release(void* pointer, size_t size)
+			{
+				if (pointer == nullptr)
+					return;
+				if (size > detail::PoolMaxSmallSize)
+				{
+					assert(detail::poolLargeHeaderOf(pointer)->mSize == size);
+					releaseLarge(pointer);
+				}
+				else
+				{
+					auto header = detail::poolSlabOf(pointer);
+					auto index = detail::poolSizeClassIndex(size);
+					assert(header->mSizeClass == index);
+					header->mOwner->deallocateSmall(pointer, index);
+				}
+			}
+
+			void deallocate(void* pointer)
+			{
+				release(pointer);
+			}
+
+			void deallocate(void* pointer, size_t size)
+			{
+				release(pointer, size);
+			}
+
+			// nullptr once the pool of a large block is gone
+			static PoolAllocator* owner_of(const void* pointer)
+			{
+				if (pointer == nullptr)
+					return nullptr;
+				if (detail::poolSlabMap().contains(pointer))
+					return detail::poolSlabOf(pointer)->mOwner;
+				std::lock_guard<std::mutex> registryLock(detail::poolRegistryMutex());
+				auto owner = detail::poolRegistry().find(detail::poolLargeHeaderOf(pointer)->mOwnerId);
+				return owner != detail::poolRegistry().end() ? owner->second : nullptr;
+			}
+
+			static size_t block_size(const void* pointer)
+			{
+				if (!detail::poolSlabMap().contains(pointer))
+					return detail::poolLargeHeaderOf(pointer)->mSize;
+				return detail::poolSizeClassSize(detail::poolSlabOf(pointer)->mSizeClass);
+			}
+
+			size_t reserved_bytes() const { return m_reservedBytes.load(std::memory_order_relaxed) + m_largeBytes.load(std::memory_order_relaxed); }
+		};
+
+
+		namespace detail
+		{
+			inline PoolThreadBindings::~PoolThreadBindings()
+			{
+				std::lock_guard<std::mutex> registryLock(poolRegistryMutex());
+				auto& registry = poolRegistry();
+				for (auto& binding : mBindings)
+					if (registry.find(binding.mPoolId) != registry.end())
+						binding.mPool->unbindThreadCache(binding.mCache);
+				mBindings.clear();
+			}
+		}
+
+
+		inline PoolAllocator& defaultPoolAllocator()
+		{
+			static PoolAllocator allocator;
+			return allocator;
+		}
+
+
+		/*
+		 * Typed front end with the ObjectPool interface, unlike ObjectPool it never fills up.
+		 * alloc/store construct the object and free destroys it.
+		*/
+		template<typename Type>
+		class ConcurrentObjectPool
+		{
+		private:
+			static_assert(alignof(Type) <= 16, "pool blocks are only 16-byte aligned");
+			PoolAllocator m_allocator;
+		public:
+			Type* alloc()
+			{
+				return new(m_allocator.allocate(sizeof(Type))) Type();
+			}
+
+			Type* store(const Type& elem)
+			{
+				return new(m_allocator.allocate(sizeof(Type))) Type(elem);
+			}
+
+			Type* store(Type&& elem)
+			{
+				return new(m_allocator.allocate(sizeof(Type))) Type(std::move(elem));
+			}
+
+			template<typename... Args>
+			Type* emplace(Args&&... args)
+			{
+				return new(m_allocator.allocate(sizeof(Type))) Type(std::forward<Args>(args)...);
+			}
+
+			void free(Type* address)
+			{
+				if (address == nullptr)
+					return;
+				address->~Type();
+				m_allocator.deallocate(address);
+			}
+
+			bool contain(const Type* address) const { return PoolAllocator::owner_of(address) == &m_allocator; }
+			PoolAllocator& allocator() { return m_allocator; }
+		};
+
+
+		// STL allocator adapter, containers share the default pool unless another one is given
+		template<typename Type>
+		class PoolStlAllocator
+		{
+		private:
+			PoolAllocator* m_pool;
+		public:
+			typedef Type value_type;
+			template<typename Other>
+			struct rebind { typedef PoolStlAllocator<Other> other; };
+
+			PoolStlAllocator() noexcept : m_pool(&defaultPoolAllocator()) {}
+			explicit PoolStlAllocator(PoolAllocator& pool) noexcept : m_pool(&pool) {}
+			template<typename Other>
+			PoolStlAllocator(const PoolStlAllocator<Other>& other) noexcept : m_pool(other.pool()) {}
+
+			Type* allocate(size_t count)
+			{
+				static_assert(alignof(Type) <= 16, "pool blocks are only 16-byte aligned");
+				return (Type*)m_pool->allocate(count * sizeof(Type));
+			}
+
+			void deallocate(Type* pointer, size_t count)
+			{
+				PoolAllocator::release(pointer, count * sizeof(Type));
+			}
+
+			PoolAllocator* pool() const { return m_pool; }
+
+			template<typename Other>
+			bool operator==(const PoolStlAllocator<Other>& other) const { return m_pool == other.pool(); }
+			template<typename Other>
+			bool operator!=(const PoolStlAllocator<Other>& other) const { return m_pool != other.pool(); }
+		};
+
+
+
+	}
+}
@@ -60,6 +60,35 @@ namespace CraftEngine
 				return ws;
 			}
 
+#else
+			// wchar_t is 4 bytes here, String holds UTF-32
+			static String fromUtf8(const void* byte_array, uint32_t byte_count)
+			{
+				return codecvt::utf8_to_wide((const char*)byte_array, byte_count);
+			}
+
+			static String fromUtf8(const std::string& utf8str)
+			{
+				return fromUtf8(utf8str.c_str(), utf8str.size());
+			}
+
+			// a std::wstring holds wchar_t units, so the kernel follows sizeof(wchar_t) and not the name
+			static String fromUtf16(const std::wstring& utf16str)
+			{
+				size_t skip = !utf16str.empty() && utf16str[0] == 0xFEFF ? 1 : 0;
+				return fromUtf8(codecvt::wide_to_utf8(utf16str.data() + skip, utf16str.size() - skip));
+			}
+
+			static const String& fromStdWString(const std::wstring& wstr)
+			{
+				return wstr;
+			}
+
+			static std::string toUtf8(const String& str)
+			{
+				return codecvt::wide_to_utf8(str);
+			}
+
 #endif
 
 			template<typename Type>
@@ -11,8 +11,7 @@ namespace CraftEngine
 		private:
 			void RunningLoop()
 			{
-				Command<void> default_task;
-				Command<void>& task = default_task;
+				UniqueTask task;
 				while (true)
 				{
 					{
@@ -20,16 +19,17 @@ namespace CraftEngine
 						m_condition.wait(lock, [this]() { return !m_tasksQueue.empty() || m_destroying; });
 						if (m_destroying)
 							break;
-						task = m_tasksQueue.front();
+						task = std::move(m_tasksQueue.front());
+						m_tasksQueue.pop();
 						m_executing = true;
 					}
-					task.execute();		
+					task.execute();
+					task.reset();
 					{
 						std::lock_guard<std::mutex> lock(m_queueMutex);
-						m_tasksQueue.pop();
-						if (m_tasksQueue.size() == 0)
-							m_executing = false;
-						m_condition.notify_one();
+						m_executing = false;
+						if (m_tasksQueue.empty())
+							m_idleCondition.notify_all();
 					}
 				}
 			}
@@ -53,46 +53,45 @@ namespace CraftEngine
 				}
 			}
 
-			void push(std::function<void()> task)
+			template<typename Func>
+			void push(Func&& task)
 			{
+				UniqueTask unique_task(std::forward<Func>(task));
 				std::lock_guard<std::mutex> lock(m_queueMutex);
-				Command<void> cmd;
-				cmd.wrap(task);
-				m_tasksQueue.push(std::move(cmd));
+				m_tasksQueue.push(std::move(unique_task));
 				m_condition.notify_one();
 			}
 
 			void push(Command<void> task)
 			{
-				std::lock_guard<std::mutex> lock(m_queueMutex);
-				m_tasksQueue.push(std::move(task));
-				m_condition.notify_one();
+				push([task]() mutable { task.execute(); });
 			}
 
 			void clear()
 			{
 				std::lock_guard<std::mutex> lock(m_queueMutex);
-				while (m_tasksQueue.size() > 1)
+				while (!m_tasksQueue.empty())
 					m_tasksQueue.pop();
 			}
 
 			void wait()
 			{
 				std::unique_lock<std::mutex> lock(m_queueMutex);
-				m_condition.wait(lock, [this]() { return m_tasksQueue.empty() && m_executing == false; });
+				m_idleCondition.wait(lock, [this]() { return m_tasksQueue.empty() && m_executing == false; });
 			}
 
 			void stop()
 			{
 				std::unique_lock<std::mutex> lock(m_queueMutex);
-				while (m_tasksQueue.size() > 1)
+				while (!m_tasksQueue.empty())
 					m_tasksQueue.pop();
-				m_condition.wait(lock, [this]() { return m_tasksQueue.empty() && m_executing == false; });
+				m_idleCondition.wait(lock, [this]() { return m_tasksQueue.empty() && m_executing == false; });
 			}
 
 			bool finished()
 			{
-				return m_executing == false;
+				std::lock_guard<std::mutex> lock(m_queueMutex);
+				return m_tasksQueue.empty() && m_executing == false;
 			}
 
 			uint32_t count()
@@ -105,9 +104,10 @@ namespace CraftEngine
 			bool m_destroying = false;
 			bool m_executing = false;
 			std::thread m_thread;
-			std::queue<Command<void>> m_tasksQueue;
+			std::queue<UniqueTask> m_tasksQueue;
 			std::mutex m_queueMutex;
-			std::condition_variable m_condition;
+			std::condition_variable m_condition;      // wakes the worker
+			std::condition_variable m_idleCondition;  // wakes wait() and stop()
 		};
 
 
@@ -151,12 +151,13 @@ namespace CraftEngine
 				return m_threads.size();
 			}
 
-			void push(std::function<void()> task, int threadid = 0)
+			template<typename Func>
+			void push(Func&& task, int threadid = 0)
 			{
 				if (threadid < threadCount())
-					m_threads[threadid]->push(task);
+					m_threads[threadid]->push(std::forward<Func>(task));
 				else
-					m_threads[0]->push(task);
+					m_threads[0]->push(std::forward<Func>(task));
 			}
 
 			void push(std::vector<std::function<void()>> tasks)
@@ -1,6 +1,7 @@
 #pragma once
 #include "../../Common.h"
 #include <string>
+#include <algorithm>
 
 namespace CraftEngine
 {
@@ -46,9 +47,489 @@ namespace CraftEngine
             }
 
 
-            //     תС½     //
+            /*
+             Validated transcoding into caller-provided buffers. Each function stops at the first
+             malformed sequence or when the output is full and reports how far it got, so callers
+             can size the output with the *_length_from_* helpers and convert without reallocating.
+             Runs of ASCII are handled 16/32 bytes at a time with SSE2/AVX2, multi-byte sequences go
+             through the scalar decoder. UTF-8 input is rejected when it is overlong, encodes a
+             surrogate or exceeds U+10FFFF; UTF-16 input is rejected on unpaired surrogates.
+            */
+            enum TranscodeStatus
+            {
+                eTranscodeStatus_Ok,
+                eTranscodeStatus_Invalid,    // malformed input at 'read'
+                eTranscodeStatus_Truncated,  // input ends inside a sequence starting at 'read'
+                eTranscodeStatus_Overflow,   // output full, 'read' units were converted
+            };
+
+            struct TranscodeResult
+            {
+                TranscodeStatus status;
+                size_t read;
+                size_t written;
+                bool ok() const { return status == eTranscodeStatus_Ok; }
+            };
+
+
+            namespace detail
+            {
+                static inline uint32_t popcount(uint32_t x)
+                {
+#if defined(__GNUC__)
+                    return __builtin_popcount(x);
+#else
+                    x = x - ((x >> 1) & 0x55555555);
+                    x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+                    return (((x + (x >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+#endif
+                }
+
+                // length of the leading ASCII run, at least the whole 16/32-byte blocks
+                static inline size_t ascii_prefix(const uint8_t* src, size_t count)
+                {
+                    size_t i = 0;
+#if defined(CRAFT_ENGINE_SIMD_AVX2)
+                    for (; i + 32 <= count; i += 32)
+                        if (_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)(src + i))) != 0)
+                            break;
+#endif
+#if defined(CRAFT_ENGINE_SIMD_SSE2)
+                    for (; i + 16 <= count; i += 16)
+                        if (_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(src + i))) != 0)
+                            break;
+#endif
+                    while (i < count && src[i] < 0x80)
+                        i++;
+                    return i;
+                }
+
+                // widens 'count' ASCII bytes to 16- or 32-bit units
+                template<typename Unit>
+                static inline void widen_ascii(const uint8_t* src, size_t count, Unit* dst)
+                {
+                    size_t i = 0;
+#if defined(CRAFT_ENGINE_SIMD_SSE2)
+                    const __m128i zero = _mm_setzero_si128();
+                    for (; i + 16 <= count; i += 16)
+                    {
+                        __m128i bytes = _mm_loadu_si128((const __m128i*)(src + i));
+                        __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+                        __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+                        if (sizeof(Unit) == 2)
+                        {
+                            _mm_storeu_si128((__m128i*)(dst + i), lo);
+                            _mm_storeu_si128((__m128i*)(dst + i + 8), hi);
+                        }
+                        else
+                        {
+                            _mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi16(lo, zero));
+                            _mm_storeu_si128((__m128i*)(dst + i + 4), _mm_unpackhi_epi16(lo, zero));
+                            _mm_storeu_si128((__m128i*)(dst + i + 8), _mm_unpacklo_epi16(hi, zero));
+                            _mm_storeu_si128((__m128i*)(dst + i + 12), _mm_unpackhi_epi16(hi, zero));
+                        }
+                    }
+#endif
+                    for (; i < count; i++)
+                        dst[i] = (Unit)src[i];
+                }
+
+                // length of the leading run of units below 0x80
+                template<typename Unit>
+                static inline size_t ascii_prefix_wide(const Unit* src, size_t count)
+                {
+                    size_t i = 0;
+#if defined(CRAFT_ENGINE_SIMD_SSE2)
+                    if (sizeof(Unit) == 2)
+                    {
+                        const __m128i mask = _mm_set1_epi16((short)0xFF80);
+                        for (; i + 8 <= count; i += 8)
+                        {
+                            __m128i units = _mm_loadu_si128((const __m128i*)(src + i));
+                            if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(units, mask), _mm_setzero_si128())) != 0xFFFF)
+                                break;
+                        }
+                    }
+                    else
+                    {
+                        const __m128i mask = _mm_set1_epi32((int)0xFFFFFF80);
+                        for (; i + 4 <= count; i += 4)
+                        {
+                            __m128i units = _mm_loadu_si128((const __m128i*)(src + i));
+                            if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(units, mask), _mm_setzero_si128())) != 0xFFFF)
+                                break;
+                        }
+                    }
+#endif
+                    while (i < count && (uint32_t)src[i] < 0x80)
+                        i++;
+                    return i;
+                }
+
+                // narrows 'count' units below 0x80 to bytes
+                template<typename Unit>
+                static inline void narrow_ascii(const Unit* src, size_t count, uint8_t* dst)
+                {
+                    size_t i = 0;
+#if defined(CRAFT_ENGINE_SIMD_SSE2)
+                    if (sizeof(Unit) == 2)
+                    {
+                        for (; i + 16 <= count; i += 16)
+                        {
+                            __m128i lo = _mm_loadu_si128((const __m128i*)(src + i));
+                            __m128i hi = _mm_loadu_si128((const __m128i*)(src + i + 8));
+                            _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
+                        }
+                    }
+                    else
+                    {
+                        for (; i + 16 <= count; i += 16)
+                        {
+                            __m128i a = _mm_packs_epi32(_mm_loadu_si128((const __m128i*)(src + i)), _mm_loadu_si128((const __m128i*)(src + i + 4)));
+                            __m128i b = _mm_packs_epi32(_mm_loadu_si128((const __m128i*)(src + i + 8)), _mm_loadu_si128((const __m128i*)(src + i + 12)));
+                            _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(a, b));
+                        }
+                    }
+#endif
+                    for (; i < count; i++)
+                        dst[i] = (uint8_t)src[i];
+                }
+
+                /*
+                 Decodes one UTF-8 sequence starting at src[0] (a non-ASCII byte).
+                 Returns the sequence length, 0 when malformed, or -1 when the input ends inside it.
+                */
+                static inline int decode_utf8(const uint8_t* src, size_t count, uint32_t& codePoint)
+                {
+                    uint32_t c = src[0];
+                    int length;
+                    uint32_t min;
+                    if (c >= 0xC2 && c <= 0xDF) { length = 2; min = 0x80; codePoint = c & 0x1F; }
+                    else if (c >= 0xE0 && c <= 0xEF) { length = 3; min = 0x800; codePoint = c & 0x0F; }
+                    else if (c >= 0xF0 && c <= 0xF4) { length = 4; min = 0x10000; codePoint = c & 0x07; }
+                    else return 0;
+                    for (int k = 1; k < length; k++)
+                    {
+                        if ((size_t)k >= count)
+                            return -1;
+                        uint32_t cc = src[k];
+                        if ((cc & 0xC0) != 0x80)
+                            return 0;
+                        codePoint = (codePoint << 6) | (cc & 0x3F);
+                    }
+                    if (codePoint < min || codePoint > 0x10FFFF || (codePoint >= 0xD800 && codePoint <= 0xDFFF))
+                        return 0;
+                    return length;
+                }
+
+                static inline int encode_utf8(uint32_t codePoint, uint8_t* dst)
+                {
+                    if (codePoint < 0x80) { dst[0] = (uint8_t)codePoint; return 1; }
+                    if (codePoint < 0x800)
+                    {
+                        dst[0] = (uint8_t)(0xC0 | (codePoint >> 6));
+                        dst[1] = (uint8_t)(0x80 | (codePoint & 0x3F));
+                        return 2;
+                    }
+                    if (codePoint < 0x10000)
+                    {
+                        dst[0] = (uint8_t)(0xE0 | (codePoint >> 12));
+                        dst[1] = (uint8_t)(0x80 | ((codePoint >> 6) & 0x3F));
+                        dst[2] = (uint8_t)(0x80 | (codePoint & 0x3F));
+                        return 3;
+                    }
+                    dst[0] = (uint8_t)(0xF0 | (codePoint >> 18));
+                    dst[1] = (uint8_t)(0x80 | ((codePoint >> 12) & 0x3F));
+                    dst[2] = (uint8_t)(0x80 | ((codePoint >> 6) & 0x3F));
+                    dst[3] = (uint8_t)(0x80 | (codePoint & 0x3F));
+                    return 4;
+                }
+
+                // UTF-8 to UTF-16 (Wide = false) or UTF-32 (Wide = true) units of type Unit
+                template<bool Wide, typename Unit>
+                static inline TranscodeResult utf8_to_units(const char* u8str, size_t count, Unit* dst, size_t capacity)
+                {
+                    auto src = (const uint8_t*)u8str;
+                    size_t i = 0, o = 0;
+                    while (i < count)
+                    {
+                        size_t run = ascii_prefix(src + i, std::min(count - i, capacity - o));
+                        widen_ascii(src + i, run, dst + o);
+                        i += run;
+                        o += run;
+                        if (i >= count)
+                            break;
+                        if (src[i] < 0x80) // output full
+                            return { eTranscodeStatus_Overflow, i, o };
+                        uint32_t codePoint;
+                        int length = decode_utf8(src + i, count - i, codePoint);
+                        if (length <= 0)
+                            return { length < 0 ? eTranscodeStatus_Truncated : eTranscodeStatus_Invalid, i, o };
+                        if (!Wide && codePoint >= 0x10000)
+                        {
+                            if (capacity - o < 2)
+                                return { eTranscodeStatus_Overflow, i, o };
+                            codePoint -= 0x10000;
+                            dst[o++] = (Unit)(0xD800 | (codePoint >> 10));
+                            dst[o++] = (Unit)(0xDC00 | (codePoint & 0x3FF));
+                        }
+                        else
+                        {
+                            if (o >= capacity)
+                                return { eTranscodeStatus_Overflow, i, o };
+                            dst[o++] = (Unit)codePoint;
+                        }
+                        i += length;
+                    }
+                    return { eTranscodeStatus_Ok, i, o };
+                }
+
+                // UTF-16 (Wide = false) or UTF-32 (Wide = true) units to UTF-8
+                template<bool Wide, typename Unit>
+                static inline TranscodeResult units_to_utf8(const Unit* src, size_t count, char* u8str, size_t capacity)
+                {
+                    auto dst = (uint8_t*)u8str;
+                    size_t i = 0, o = 0;
+                    while (i < count)
+                    {
+                        size_t run = ascii_prefix_wide(src + i, std::min(count - i, capacity - o));
+                        narrow_ascii(src + i, run, dst + o);
+                        i += run;
+                        o += run;
+                        if (i >= count)
+                            break;
+                        uint32_t codePoint = (uint32_t)src[i];
+                        if (codePoint < 0x80) // output full
+                            return { eTranscodeStatus_Overflow, i, o };
+                        size_t consumed = 1;
+                        if (!Wide)
+                            codePoint &= 0xFFFF;
+                        if (codePoint >= 0xD800 && codePoint <= 0xDFFF)
+                        {
+                            if (Wide || codePoint >= 0xDC00)
+                                return { eTranscodeStatus_Invalid, i, o };
+                            if (i + 1 >= count)
+                                return { eTranscodeStatus_Truncated, i, o };
+                            uint32_t low = (uint32_t)src[i + 1] & 0xFFFF;
+                            if (low < 0xDC00 || low > 0xDFFF)
+                                return { eTranscodeStatus_Invalid, i, o };
+                            codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                            consumed = 2;
+                        }
+                        else if (codePoint > 0x10FFFF)
+                            return { eTranscodeStatus_Invalid, i, o };
+                        size_t length = codePoint < 0x800 ? 2 : codePoint < 0x10000 ? 3 : 4;
+                        if (capacity - o < length)
+                            return { eTranscodeStatus_Overflow, i, o };
+                        encode_utf8(codePoint, dst + o);
+                        o += length;
+                        i += consumed;
+                    }
+                    return { eTranscodeStatus_Ok, i, o };
+                }
+
+                // counts bytes that start a sequence and bytes that start a 4-byte sequence
+                static inline void count_utf8_leads(const uint8_t* src, size_t count, size_t& leads, size_t& fourByteLeads)
+                {
+                    size_t i = 0;
+                    leads = 0;
+                    fourByteLeads = 0;
+#if defined(CRAFT_ENGINE_SIMD_SSE2)
+                    const __m128i continuation = _mm_set1_epi8((char)0xBF); // signed: continuation bytes are <= -65
+                    const __m128i four = _mm_set1_epi8((char)0xEF);         // signed: 0xF0..0xFF are -16..-1
+                    for (; i + 16 <= count; i += 16)
+                    {
+                        __m128i bytes = _mm_loadu_si128((const __m128i*)(src + i));
+                        uint32_t lead = _mm_movemask_epi8(_mm_cmpgt_epi8(bytes, continuation));
+                        uint32_t big = _mm_movemask_epi8(_mm_andnot_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8(-1)), _mm_cmpgt_epi8(bytes, four)));
+                        leads += popcount(lead);
+                        fourByteLeads += popcount(big);
+                    }
+#endif
+                    for (; i < count; i++)
+                    {
+                        leads += (src[i] & 0xC0) != 0x80;
+                        fourByteLeads += src[i] >= 0xF0;
+                    }
+                }
+            }
+
+
+            // UTF-16 units needed for valid UTF-8 input
+            CRAFT_ENGINE_CORE_API size_t utf16_length_from_utf8(const char* u8str, size_t count)
+            {
+                size_t leads, fourByteLeads;
+                detail::count_utf8_leads((const uint8_t*)u8str, count, leads, fourByteLeads);
+                return leads + fourByteLeads;
+            }
+
+            // UTF-32 units needed for valid UTF-8 input
+            CRAFT_ENGINE_CORE_API size_t utf32_length_from_utf8(const char* u8str, size_t count)
+            {
+                size_t leads, fourByteLeads;
+                detail::count_utf8_leads((const uint8_t*)u8str, count, leads, fourByteLeads);
+                return leads;
+            }
+
+            // UTF-8 bytes needed for valid UTF-16 input
+            CRAFT_ENGINE_CORE_API size_t utf8_length_from_utf16(const char16_t* u16str, size_t count)
+            {
+                size_t i = 0, length = 0;
+#if defined(CRAFT_ENGINE_SIMD_SSE2)
+                // per unit: 1 + (u >= 0x80) + (u >= 0x800) - (surrogate), a surrogate pair gives 4
+                const __m128i sign = _mm_set1_epi16((short)0x8000);
+                const __m128i above7F = _mm_set1_epi16((short)(0x007F ^ 0x8000));
+                const __m128i above7FF = _mm_set1_epi16((short)(0x07FF ^ 0x8000));
+                const __m128i surrogateMask = _mm_set1_epi16((short)0xF800);
+                const __m128i surrogate = _mm_set1_epi16((short)0xD800);
+                for (; i + 8 <= count; i += 8)
+                {
+                    __m128i units = _mm_loadu_si128((const __m128i*)(u16str + i));
+                    __m128i biased = _mm_xor_si128(units, sign);
+                    uint32_t two = _mm_movemask_epi8(_mm_cmpgt_epi16(biased, above7F));
+                    uint32_t three = _mm_movemask_epi8(_mm_cmpgt_epi16(biased, above7FF));
+                    uint32_t pair = _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(units, surrogateMask), surrogate));
+                    length += 8 + (detail::popcount(two) + detail::popcount(three) - detail::popcount(pair)) / 2;
+                }
+#endif
+                for (; i < count; i++)
+                {
+                    uint32_t u = u16str[i];
+                    length += 1 + (u >= 0x80) + (u >= 0x800) - (u >= 0xD800 && u <= 0xDFFF);
+                }
+                return length;
+            }
+
+            // UTF-8 bytes needed for valid UTF-32 input
+            CRAFT_ENGINE_CORE_API size_t utf8_length_from_utf32(const char32_t* u32str, size_t count)
+            {
+                size_t length = 0;
+                for (size_t i = 0; i < count; i++)
+                {
+                    uint32_t u = u32str[i];
+                    length += 1 + (u >= 0x80) + (u >= 0x800) + (u >= 0x10000);
+                }
+                return length;
+            }
+
+            CRAFT_ENGINE_CORE_API TranscodeResult utf8_to_utf16(const char* u8str, size_t count, char16_t* u16str, size_t capacity)
+            {
+                return detail::utf8_to_units<false>(u8str, count, u16str, capacity);
+            }
+
+            CRAFT_ENGINE_CORE_API TranscodeResult utf8_to_utf32(const char* u8str, size_t count, char32_t* u32str, size_t capacity)
+            {
+                return detail::utf8_to_units<true>(u8str, count, u32str, capacity);
+            }
+
+            CRAFT_ENGINE_CORE_API TranscodeResult utf16_to_utf8(const char16_t* u16str, size_t count, char* u8str, size_t capacity)
+            {
+                return detail::units_to_utf8<false>(u16str, count, u8str, capacity);
+            }
+
+            CRAFT_ENGINE_CORE_API TranscodeResult utf32_to_utf8(const char32_t* u32str, size_t count, char* u8str, size_t capacity)
+            {
+                return detail::units_to_utf8<true>(u32str, count, u8str, capacity);
+            }
+
+            CRAFT_ENGINE_CORE_API bool validate_utf8(const char* u8str, size_t count)
+            {
+                auto src = (const uint8_t*)u8str;
+                size_t i = 0;
+                while (i < count)
+                {
+                    i += detail::ascii_prefix(src + i, count - i);
+                    if (i >= count)
+                        break;
+                    uint32_t codePoint;
+                    int length = detail::decode_utf8(src + i, count - i, codePoint);
+                    if (length <= 0)
+                        return false;
+                    i += length;
+                }
+                return true;
+            }
+
+            /*
+             wchar_t is UTF-16 on Windows and UTF-32 elsewhere; these follow the platform.
+             Malformed input is replaced by U+FFFD and reported through 'ok'.
+            */
+            CRAFT_ENGINE_CORE_API std::wstring utf8_to_wide(const char* u8str, size_t count, bool* ok = NULL)
+            {
+                constexpr bool wide = sizeof(wchar_t) == 4;
+                std::wstring result;
+                bool is_ok = true;
+                if (u8str != nullptr && count > 0)
+                {
+                    size_t leads, fourByteLeads;
+                    detail::count_utf8_leads((const uint8_t*)u8str, count, leads, fourByteLeads);
+                    result.resize(wide ? leads : leads + fourByteLeads);
+                    size_t read = 0, written = 0;
+                    while (true)
+                    {
+                        auto r = detail::utf8_to_units<wide>(u8str + read, count - read, &result[0] + written, result.size() - written);
+                        read += r.read;
+                        written += r.written;
+                        if (r.status == eTranscodeStatus_Ok)
+                            break;
+                        is_ok = false;
+                        if (written + 2 > result.size())
+                            result.resize(written + 16);
+                        if (r.status != eTranscodeStatus_Overflow)
+                        {
+                            // skip the lead byte and any continuation bytes that follow it
+                            result[written++] = 0xFFFD;
+                            read++;
+                            while (read < count && (((const uint8_t*)u8str)[read] & 0xC0) == 0x80)
+                                read++;
+                        }
+                    }
+                    result.resize(written);
+                }
+                if (ok != NULL) { *ok = is_ok; }
+                return result;
+            }
+
+            CRAFT_ENGINE_CORE_API std::wstring utf8_to_wide(const std::string& u8str, bool* ok = NULL)
+            {
+                return utf8_to_wide(u8str.data(), u8str.size(), ok);
+            }
+
+            CRAFT_ENGINE_CORE_API std::string wide_to_utf8(const wchar_t* wstr, size_t count, bool* ok = NULL)
+            {
+                constexpr bool wide = sizeof(wchar_t) == 4;
+                std::string result;
+                bool is_ok = true;
+                if (wstr != nullptr && count > 0)
+                {
+                    // worst case is 3 bytes per unit for UTF-16 and 4 for UTF-32
+                    result.resize(count * (wide ? 4 : 3));
+                    size_t read = 0, written = 0;
+                    while (true)
+                    {
+                        auto r = detail::units_to_utf8<wide>(wstr + read, count - read, &result[0] + written, result.size() - written);
+                        read += r.read;
+                        written += r.written;
+                        if (r.status == eTranscodeStatus_Ok)
+                            break;
+                        is_ok = false;
+                        written += detail::encode_utf8(0xFFFD, (uint8_t*)&result[written]);
+                        read++;
+                    }
+                    result.resize(written);
+                }
+                if (ok != NULL) { *ok = is_ok; }
+                return result;
+            }
+
+            CRAFT_ENGINE_CORE_API std::string wide_to_utf8(const std::wstring& wstr, bool* ok = NULL)
+            {
+                return wide_to_utf8(wstr.data(), wstr.size(), ok);
+            }
+
+
+            //     legacy UTF-16 helpers, implemented on top of the kernels above     //
 
-            // UTF16ַҪBOM
             std::string utf16_to_utf8(const std::wstring& u16str)
             {
                 if (u16str.empty()) { return std::string(); }
@@ -66,69 +547,26 @@ namespace CraftEngine
                 }
             }
 
-            // UTF16 LEַ
             std::string utf16le_to_utf8(const wchar_t* u16str, size_t count)
             {
                 if (u16str == nullptr || count == 0) { return std::string(); }
-                auto p = u16str;
-                auto len = count;
-                if (p[0] == 0xFEFF) {
-                    p += 1; //bomǣ
-                    len -= 1;
+                if (u16str[0] == 0xFEFF) {
+                    u16str += 1;
+                    count -= 1;
                 }
-
-                // ʼת
-                std::string u8str;
-                u8str.reserve(len * 3);
-
-                char16_t u16char;
-                for (std::wstring::size_type i = 0; i < len; ++i) {
-                    // С()
-                    u16char = p[i];
-
-                    // 1ֽڱʾ
-                    if (u16char < 0x0080) {
-                        // u16char <= 0x007f
-                        // U- 0000 0000 ~ 0000 07ff : 0xxx xxxx
-                        u8str.push_back((char)(u16char & 0x00FF));  // ȡ8bit
-                        continue;
-                    }
-                    // 2 ֽܱʾ
-                    if (u16char >= 0x0080 && u16char <= 0x07FF) {
-                        // * U-00000080 - U-000007FF:  110xxxxx 10xxxxxx
-                        u8str.push_back((char)(((u16char >> 6) & 0x1F) | 0xC0));
-                        u8str.push_back((char)((u16char & 0x3F) | 0x80));
-                        continue;
-                    }
-                    // Բ(4ֽڱʾ)
-                    if (u16char >= 0xD800 && u16char <= 0xDBFF) {
-                        // * U-00010000 - U-001FFFFF: 1111 0xxx 10xxxxxx 10xxxxxx 10xxxxxx
-                        uint32_t highSur = u16char;
-                        uint32_t lowSur = p[++i];
-                        // ӴԵUNICODEת
-                        // 1Ӹߴȥ0xD800ȡЧ10bit
-                        // 2ӵʹȥ0xDC00ȡЧ10bit
-                        // 30x10000ȡUNICODEֵ
-                        uint32_t codePoint = highSur - 0xD800;
-                        codePoint <<= 10;
-                        codePoint |= lowSur - 0xDC00;
-                        codePoint += 0x10000;
-                        // תΪ4ֽUTF8ʾ
-                        u8str.push_back((char)((codePoint >> 18) | 0xF0));
-                        u8str.push_back((char)(((codePoint >> 12) & 0x3F) | 0x80));
-                        u8str.push_back((char)(((codePoint >> 06) & 0x3F) | 0x80));
-                        u8str.push_back((char)((codePoint & 0x3F) | 0x80));
-                        continue;
-                    }
-                    // 3 ֽڱʾ
-                    {
-                        // * U-0000E000 - U-0000FFFF:  1110xxxx 10xxxxxx 10xxxxxx
-                        u8str.push_back((char)(((u16char >> 12) & 0x0F) | 0xE0));
-                        u8str.push_back((char)(((u16char >> 6) & 0x3F) | 0x80));
-                        u8str.push_back((char)((u16char & 0x3F) | 0x80));
-                        continue;
-                    }
+                std::string u8str(count * 3, '\0');
+                size_t read = 0, written = 0;
+                while (true)
+                {
+                    auto r = detail::units_to_utf8<false>(u16str + read, count - read, &u8str[0] + written, u8str.size() - written);
+                    read += r.read;
+                    written += r.written;
+                    if (r.status == eTranscodeStatus_Ok)
+                        break;
+                    written += detail::encode_utf8(0xFFFD, (uint8_t*)&u8str[written]);
+                    read++;
                 }
+                u8str.resize(written);
                 return u8str;
             }
 
@@ -137,181 +575,78 @@ namespace CraftEngine
                return utf16le_to_utf8(u16str.c_str(), u16str.size());
             }
 
-            // UTF16BEַ
             std::string utf16be_to_utf8(const wchar_t* u16str, size_t count)
             {
                 if (u16str == nullptr || count == 0) { return std::string(); }
-                auto p = u16str;
-                std::wstring::size_type len = count;
-                if (p[0] == 0xFEFF) {
-                    p += 1; //bomǣ
-                    len -= 1;
-                }
-                // ʼת
-                std::string u8str;
-                u8str.reserve(len * 2);
-                char16_t u16char;   //u16le ֽڴλֽڴλ
-                for (std::wstring::size_type i = 0; i < len; ++i) {
-                    // С()
-                    u16char = p[i];
-                    // תΪС
-                    u16char = detail::byteswap_ushort(u16char);
-
-                    // 1ֽڱʾ
-                    if (u16char < 0x0080) {
-                        // u16char <= 0x007f
-                        // U- 0000 0000 ~ 0000 07ff : 0xxx xxxx
-                        u8str.push_back((char)(u16char & 0x00FF));
-                        continue;
-                    }
-                    // 2 ֽܱʾ
-                    if (u16char >= 0x0080 && u16char <= 0x07FF) {
-                        // * U-00000080 - U-000007FF:  110xxxxx 10xxxxxx
-                        u8str.push_back((char)(((u16char >> 6) & 0x1F) | 0xC0));
-                        u8str.push_back((char)((u16char & 0x3F) | 0x80));
-                        continue;
-                    }
-                    // Բ(4ֽڱʾ)
-                    if (u16char >= 0xD800 && u16char <= 0xDBFF) {
-                        // * U-00010000 - U-001FFFFF: 1111 0xxx 10xxxxxx 10xxxxxx 10xxxxxx
-                        uint32_t highSur = u16char;
-                        uint32_t lowSur = detail::byteswap_ushort(p[++i]);
-                        // ӴԵUNICODEת
-                        // 1Ӹߴȥ0xD800ȡЧ10bit
-                        // 2ӵʹȥ0xDC00ȡЧ10bit
-                        // 30x10000ȡUNICODEֵ
-                        uint32_t codePoint = highSur - 0xD800;
-                        codePoint <<= 10;
-                        codePoint |= lowSur - 0xDC00;
-                        codePoint += 0x10000;
-                        // תΪ4ֽUTF8ʾ
-                        u8str.push_back((char)((codePoint >> 18) | 0xF0));
-                        u8str.push_back((char)(((codePoint >> 12) & 0x3F) | 0x80));
-                        u8str.push_back((char)(((codePoint >> 06) & 0x3F) | 0x80));
-                        u8str.push_back((char)((codePoint & 0x3F) | 0x80));
-                        continue;
-                    }
-                    // 3 ֽڱʾ
-                    {
-                        // * U-0000E000 - U-0000FFFF:  1110xxxx 10xxxxxx 10xxxxxx
-                        u8str.push_back((char)(((u16char >> 12) & 0x0F) | 0xE0));
-                        u8str.push_back((char)(((u16char >> 6) & 0x3F) | 0x80));
-                        u8str.push_back((char)((u16char & 0x3F) | 0x80));
-                        continue;
-                    }
-                }
-                return u8str;
+                std::wstring swapped(u16str, count);
+                for (auto& c : swapped)
+                    c = detail::byteswap_ushort((uint16_t)c);
+                return utf16le_to_utf8(swapped);
             }
 
-            // UTF16BEַ
             std::string utf16be_to_utf8(const std::wstring& u16str)
             {
                 return utf16be_to_utf8(u16str.c_str(), u16str.size());
             }
 
-
             std::wstring utf8_to_utf16le(const char* u8str, size_t count, bool addbom, bool* ok)
             {
                 if (u8str == nullptr || count == 0)
                     return std::wstring();
-
+                const unsigned char* p = (unsigned char*)(u8str);
+                if (count >= 3 && p[0] == 0xEF && p[1] == 0xBB && p[2] == 0xBF) {
+                    u8str += 3;
+                    count -= 3;
+                }
                 std::wstring u16str;
-                u16str.reserve(count);
+                size_t leads, fourByteLeads;
+                detail::count_utf8_leads((const uint8_t*)u8str, count, leads, fourByteLeads);
+                size_t start = addbom ? 1 : 0;
+                u16str.resize(start + leads + fourByteLeads);
                 if (addbom) {
-                    u16str.push_back(0xFEFF);   //bom (ֽڱʾΪ FF FE)
-                }
-                std::string::size_type len = count;
-                const unsigned char* p = (unsigned char*)(u8str);
-                // жǷBOM(жϳС3ֽڵ)
-                if (len > 3 && p[0] == 0xEF && p[1] == 0xBB && p[2] == 0xBF) {
-                    p += 3;
-                    len -= 3;
+                    u16str[0] = 0xFEFF;
                 }
                 bool is_ok = true;
-                // ʼת
-                for (std::string::size_type i = 0; i < len; ++i) {
-                    uint32_t ch = p[i]; // ȡUTF8ֽ
-                    if ((ch & 0x80) == 0) {
-                        // λΪ0ֻ1ֽڱʾUNICODE
-                        u16str.push_back((char16_t)ch);
-                        continue;
-                    }
-                    switch (ch & 0xF0)
-                    {
-                    case 0xF0: // 4 ַֽ, 0x10000  0x10FFFF
-                    {
-                        uint32_t c2 = p[++i];
-                        uint32_t c3 = p[++i];
-                        uint32_t c4 = p[++i];
-                        // UNICODEֵ(һֽȡ3bitȡ6bit)
-                        uint32_t codePoint = ((ch & 0x07U) << 18) | ((c2 & 0x3FU) << 12) | ((c3 & 0x3FU) << 6) | (c4 & 0x3FU);
-                        if (codePoint >= 0x10000)
-                        {
-                            // UTF-16 U+10000  U+10FFFF 16bitԪʾ, .
-                            // 1ȥ0x10000(õΪ20bitֵ)
-                            // 2high  ǽ20bitеĸ10bit0xD800(110110 00 00000000)
-                            // 3low   ǽ20bitеĵ10bit0xDC00(110111 00 00000000)
-                            codePoint -= 0x10000;
-                            u16str.push_back((char16_t)((codePoint >> 10) | 0xD800U));
-                            u16str.push_back((char16_t)((codePoint & 0x03FFU) | 0xDC00U));
-                        }
-                        else
-                        {
-                            // UTF-16 U+0000  U+D7FF Լ U+E000  U+FFFF Unicodeֵͬ.
-                            // U+D800  U+DFFF Чַ, Ϊ˼(򲻱)
-                            u16str.push_back((char16_t)codePoint);
-                        }
-                    }
-                    break;
-                    case 0xE0: // 3 ַֽ, 0x800  0xFFFF
-                    {
-                        uint32_t c2 = p[++i];
-                        uint32_t c3 = p[++i];
-                        // UNICODEֵ(һֽȡ4bitȡ6bit)
-                        uint32_t codePoint = ((ch & 0x0FU) << 12) | ((c2 & 0x3FU) << 6) | (c3 & 0x3FU);
-                        u16str.push_back((char16_t)codePoint);
-                    }
-                    break;
-                    case 0xD0: // 2 ַֽ, 0x80  0x7FF
-                    case 0xC0:
-                    {
-                        uint32_t c2 = p[++i];
-                        // UNICODEֵ(һֽȡ5bitȡ6bit)
-                        uint32_t codePoint = ((ch & 0x1FU) << 12) | ((c2 & 0x3FU) << 6);
-                        u16str.push_back((char16_t)codePoint);
-                    }
-                    break;
-                    default:    // ֽڲ(ǰѾԲӦý)
-                        is_ok = false;
+                size_t read = 0, written = start;
+                while (true)
+                {
+                    auto r = detail::utf8_to_units<false>(u8str + read, count - read, &u16str[0] + written, u16str.size() - written);
+                    read += r.read;
+                    written += r.written;
+                    if (r.status == eTranscodeStatus_Ok)
                         break;
+                    is_ok = false;
+                    if (written + 2 > u16str.size())
+                        u16str.resize(written + 16);
+                    if (r.status != eTranscodeStatus_Overflow)
+                    {
+                        u16str[written++] = 0xFFFD;
+                        read++;
+                        while (read < count && (((const uint8_t*)u8str)[read] & 0xC0) == 0x80)
+                            read++;
                     }
                 }
+                u16str.resize(written);
                 if (ok != NULL) { *ok = is_ok; }
                 return u16str;
             }
 
-            // ȡתΪUTF-16 LEַ
             std::wstring utf8_to_utf16le(const std::string& u8str, bool addbom, bool* ok)
-            {           
+            {
                 return utf8_to_utf16le(u8str.c_str(), u8str.size(), addbom, ok);
             }
 
-            // ȡתΪUTF-16 BEַ
             std::wstring utf8_to_utf16be(const char* u8str, size_t count, bool addbom, bool* ok)
             {
                 if (u8str == nullptr || count == 0)
                     return std::wstring();
-
-                // Ȼȡutf16leַ
                 std::wstring u16str = utf8_to_utf16le(u8str, count, addbom, ok);
-                // СתΪ
                 for (size_t i = 0; i < u16str.size(); ++i) {
                     u16str[i] = detail::byteswap_ushort(u16str[i]);
                 }
                 return u16str;
             }
 
-            // ȡתΪUTF-16 BEַ
             std::wstring utf8_to_utf16be(const std::string& u8str, bool addbom, bool* ok)
             {
                 return utf8_to_utf16be(u8str.c_str(), u8str.size(), addbom, ok);
@@ -321,4 +656,4 @@ namespace CraftEngine
 
 	}
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,240 @@
+#pragma once
+#include "../Core.h"
+#include "TestCheck.h"
+#include <vector>
+
+
+
+/*
+ Moves and copies ArrayList and SmallArrayList between inline and heap storage, appends elements
+ that live in the list's own buffer while it grows, shrinks heap lists back into inline storage,
+ and counts constructions and destructions of a non-trivial element so that none is lost, run
+ twice or left alive.
+*/
+void testArrayList()
+{
+	using namespace CraftEngine;
+
+	test::TestCheck check("testArrayList");
+
+	// counts live objects and catches destroying one twice or using one after destruction
+	struct Tracked
+	{
+		static int& live() { static int count = 0; return count; }
+		static int& errors() { static int count = 0; return count; }
+		int value;
+		int state;
+		Tracked(int v = 0) :value(v), state(0x600D) { live()++; }
+		Tracked(const Tracked& other) :value(other.value), state(0x600D) { verify(other); live()++; }
+		Tracked(Tracked&& other) :value(other.value), state(0x600D) { verify(other); other.value = -1; live()++; }
+		Tracked& operator=(const Tracked& other) { verify(*this); verify(other); value = other.value; return *this; }
+		Tracked& operator=(Tracked&& other) { verify(*this); verify(other); value = other.value; other.value = -1; return *this; }
+		~Tracked() { verify(*this); state = 0xDEAD; live()--; }
+		static void verify(const Tracked& object) { if (object.state != 0x600D) errors()++; }
+	};
+	typedef core::ArrayList<Tracked> List;
+	typedef core::SmallArrayList<Tracked, 4> SmallList;
+
+	auto fill = [](List& list, int count, int base) {
+		list.clear();
+		for (int i = 0; i < count; i++)
+			list.emplace_back(base + i);
+	};
+	auto holds = [](const List& list, int count, int base) {
+		if (list.size() != count)
+			return false;
+		for (int i = 0; i < count; i++)
+			if (list[i].value != base + i)
+				return false;
+		return true;
+	};
+
+	// moves between inline and heap storage
+	{
+		SmallList inline_list;
+		fill(inline_list, 3, 0);
+		SmallList moved(std::move(inline_list));
+		check("move inline", moved.is_inline() && holds(moved, 3, 0) && inline_list.empty() && inline_list.is_inline());
+
+		SmallList heap_list;
+		fill(heap_list, 10, 100);
+		auto buffer = heap_list.data();
+		SmallList stolen(std::move(heap_list));
+		check("move heap steals the buffer", !stolen.is_inline() && stolen.data() == buffer && holds(stolen, 10, 100));
+		check("moved from heap falls back to inline", heap_list.empty() && heap_list.is_inline() && heap_list.capacity() == 4);
+
+		// a heap buffer is handed across to a plain list and back
+		List plain(std::move(stolen));
+		check("small to plain", plain.data() == buffer && holds(plain, 10, 100) && stolen.is_inline());
+		SmallList back(std::move(plain));
+		check("plain to small", back.data() == buffer && holds(back, 10, 100) && plain.data() == nullptr && plain.capacity() == 0);
+
+		// inline elements can only be moved one by one
+		List from_inline(std::move(moved));
+		check("inline to plain", holds(from_inline, 3, 0) && moved.empty() && moved.is_inline());
+
+		// move assignment over a list that holds elements of the other kind
+		SmallList target;
+		fill(target, 8, 200);
+		SmallList source;
+		fill(source, 2, 300);
+		target = std::move(source);
+		check("move assign inline over heap", holds(target, 2, 300) && source.empty());
+		fill(source, 9, 400);
+		fill(target, 1, 500);
+		target = std::move(source);
+		check("move assign heap over inline", !target.is_inline() && holds(target, 9, 400) && source.is_inline() && source.empty());
+	}
+	check("move destructions", Tracked::live() == 0);
+
+	// copies between inline and heap storage
+	{
+		SmallList inline_list, heap_list;
+		fill(inline_list, 4, 0);
+		fill(heap_list, 12, 50);
+		SmallList inline_copy(inline_list), heap_copy(heap_list);
+		check("copy inline", inline_copy.is_inline() && holds(inline_copy, 4, 0) && holds(inline_list, 4, 0));
+		check("copy heap", !heap_copy.is_inline() && heap_copy.data() != heap_list.data() && holds(heap_copy, 12, 50));
+
+		inline_copy = heap_list;
+		heap_copy = inline_list;
+		check("copy assign heap over inline", !inline_copy.is_inline() && holds(inline_copy, 12, 50));
+		check("copy assign inline over heap", holds(heap_copy, 4, 0));
+
+		List plain(heap_list);
+		SmallList from_plain(plain);
+		check("copy through a plain list", holds(plain, 12, 50) && holds(from_plain, 12, 50));
+		plain = plain;
+		check("self assignment", holds(plain, 12, 50));
+
+		// swapping any mix of inline and heap lists
+		SmallList a, b;
+		fill(a, 2, 10);
+		fill(b, 7, 20);
+		a.swap(b);
+		bool swapped = holds(a, 7, 20) && holds(b, 2, 10);
+		b.swap(a);
+		swapped &= holds(a, 2, 10) && holds(b, 7, 20);
+		fill(b, 3, 30);
+		a.swap(b);
+		swapped &= holds(a, 3, 30) && holds(b, 2, 10);
+		List c;
+		fill(c, 6, 40);
+		a.swap(c);
+		swapped &= holds(a, 6, 40) && holds(c, 3, 30);
+		check("swap", swapped);
+	}
+	check("copy destructions", Tracked::live() == 0);
+
+	// growing while the argument refers to an element of the list itself
+	{
+		SmallList small;
+		fill(small, 4, 0);
+		small.emplace_back(small[0]);
+		small.push_back(small[1]);
+		bool aliasing = !small.is_inline() && small.size() == 6 && small[4].value == 0 && small[5].value == 1;
+
+		List plain;
+		fill(plain, 1, 7);
+		while (plain.size() < plain.capacity())
+			plain.push_back(plain.back());
+		plain.emplace_back(plain.front());
+		aliasing &= plain.back().value == 7 && plain.size() > 1;
+		for (auto& element : plain)
+			aliasing &= element.value == 7;
+
+		fill(plain, 1, 9);
+		while (plain.size() < plain.capacity())
+			plain.push_back(plain.front());
+		plain.push_back(plain.back());
+		plain.insert(0, plain.back());
+		plain.resize(plain.capacity() * 2 + 1, plain[1]);
+		for (auto& element : plain)
+			aliasing &= element.value == 9;
+
+		// moving an element into its own list leaves the source element moved from
+		fill(small, 4, 60);
+		small.push_back(std::move(small[2]));
+		aliasing &= small.size() == 5 && small[4].value == 62 && small[2].value == -1;
+		check("own element while growing", aliasing);
+	}
+	check("aliasing destructions", Tracked::live() == 0);
+
+	// shrink_to_fit returns to inline storage once the elements fit
+	{
+		SmallList list;
+		fill(list, 20, 0);
+		while (list.size() > 3)
+			list.pop_back();
+		list.shrink_to_fit();
+		check("shrink to inline", list.is_inline() && list.capacity() == 4 && holds(list, 3, 0) && Tracked::live() == 3);
+
+		fill(list, 9, 10);
+		list.shrink_to_fit();
+		check("shrink on the heap", !list.is_inline() && list.capacity() == 9 && holds(list, 9, 10));
+		list.clear();
+		list.shrink_to_fit();
+		check("shrink empty", list.is_inline() && list.capacity() == 4 && list.empty());
+		list.shrink_to_fit();
+		list.emplace_back(1);
+		check("reuse after shrink", list.is_inline() && holds(list, 1, 1));
+
+		List plain;
+		fill(plain, 20, 0);
+		plain.resize(5);
+		plain.shrink_to_fit();
+		bool plain_ok = plain.capacity() == 5 && holds(plain, 5, 0);
+		plain.clear();
+		plain.shrink_to_fit();
+		plain_ok &= plain.capacity() == 0 && plain.data() == nullptr;
+		check("shrink plain", plain_ok);
+	}
+	check("shrink destructions", Tracked::live() == 0);
+
+	// erase and insert keep every element constructed exactly once
+	{
+		SmallList list;
+		fill(list, 10, 0);
+		list.erase(0);
+		list.erase(3, 2);
+		list.insert(1, Tracked(-5));
+		SmallList more;
+		fill(more, 3, 90);
+		list.insert(2, more);
+		list.insert(0, list);
+		list.resize(30);
+		list.resize(2);
+		check("erase and insert", list.size() == 2 && list[0].value == 1 && list[1].value == -5 && Tracked::live() == 5);
+	}
+	check("no double destruction", Tracked::live() == 0 && Tracked::errors() == 0);
+
+	// trivial elements take the memcpy paths
+	{
+		core::SmallArrayList<int, 8> small;
+		core::ArrayList<int> empty;
+		core::ArrayList<int> empty_copy(empty);
+		std::vector<int> reference;
+		for (int i = 0; i < 100; i++)
+		{
+			small.push_back(i * 3);
+			reference.push_back(i * 3);
+			if (i % 10 == 9)
+			{
+				small.erase(i % 7);
+				reference.erase(reference.begin() + i % 7);
+			}
+		}
+		core::SmallArrayList<int, 8> moved(std::move(small));
+		core::ArrayList<int> copied(moved);
+		bool pod = empty_copy.empty() && moved.size() == (int32_t)reference.size() && copied.size() == moved.size();
+		for (int i = 0; i < moved.size(); i++)
+			pod &= moved[i] == reference[i] && copied[i] == reference[i];
+		while (moved.size() > 5)
+			moved.pop_back();
+		moved.shrink_to_fit();
+		pod &= moved.is_inline() && moved[4] == reference[4];
+		check("trivial elements", pod);
+	}
+
+	check.finish();
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <iostream>
+
+
+
+namespace CraftEngine
+{
+	namespace test
+	{
+
+		/*
+		 Failure counter shared by the Test*.h files. check(what, ok) logs the first failures,
+		 finish() prints "<name>: passed/failed (N failures)" and returns whether all passed.
+		*/
+		class TestCheck
+		{
+		public:
+			explicit TestCheck(const char* name, const char* noun = "failures") :m_name(name), m_noun(noun) {}
+
+			void operator()(const char* what, bool ok)
+			{
+				if (!ok && fail())
+					log() << what << " failed\n";
+			}
+
+			// Counts a failure, true while it should still be logged.
+			bool fail() { return m_failed++ < m_maxLogged; }
+			std::ostream& log() { return std::cout << m_name << ": "; }
+			int failed()const { return m_failed; }
+
+			bool finish()
+			{
+				std::cout << m_name << ": " << (m_failed == 0 ? "passed" : "failed") << " (" << m_failed << " " << m_noun << ")\n";
+				return m_failed == 0;
+			}
+		private:
+			static constexpr int m_maxLogged = 16;
+			const char* m_name;
+			const char* m_noun;
+			int m_failed = 0;
+		};
+
+	}
+}
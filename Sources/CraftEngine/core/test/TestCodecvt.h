@@ -0,0 +1,132 @@
+#pragma once
+#include "../Core.h"
+#include "TestCheck.h"
+#include <iostream>
+#include <random>
+
+
+
+/*
+ Round-trips random text through the UTF-8/16/32 kernels against a reference encoder, checks the
+ length helpers, feeds malformed, truncated and oversized input to the validating paths, and
+ converts native wide strings through StringTool.
+*/
+void testCodecvt()
+{
+	using namespace CraftEngine;
+	using namespace CraftEngine::core::codecvt;
+
+	test::TestCheck check("testCodecvt");
+
+	std::mt19937 rng(7);
+	auto random_code_point = [&]() -> char32_t
+	{
+		switch (rng() % 8)
+		{
+		case 0: return 0x80 + rng() % 0x780;
+		case 1: return 0x800 + rng() % (0xD800 - 0x800);
+		case 2: return 0xE000 + rng() % 0x2000;
+		case 3: return 0x10000 + rng() % 0x100000;
+		default: return 0x20 + rng() % 0x5F;
+		}
+	};
+
+	for (int round = 0; round < 200; round++)
+	{
+		std::u32string text;
+		size_t length = rng() % 300;
+		for (size_t i = 0; i < length; i++)
+		{
+			// long ASCII runs exercise the vector paths
+			if (rng() % 16 == 0)
+				text.append(rng() % 70, U'a' + char32_t(rng() % 26));
+			text.push_back(random_code_point());
+		}
+		std::string u8;
+		std::u16string u16;
+		for (char32_t c : text)
+		{
+			uint8_t bytes[4];
+			int n = detail::encode_utf8(c, bytes);
+			u8.append((const char*)bytes, n);
+			if (c >= 0x10000)
+			{
+				u16.push_back(char16_t(0xD800 + ((c - 0x10000) >> 10)));
+				u16.push_back(char16_t(0xDC00 + ((c - 0x10000) & 0x3FF)));
+			}
+			else
+				u16.push_back(char16_t(c));
+		}
+
+		check("utf16_length_from_utf8", utf16_length_from_utf8(u8.data(), u8.size()) == u16.size());
+		check("utf32_length_from_utf8", utf32_length_from_utf8(u8.data(), u8.size()) == text.size());
+		check("utf8_length_from_utf16", utf8_length_from_utf16(u16.data(), u16.size()) == u8.size());
+		check("utf8_length_from_utf32", utf8_length_from_utf32(text.data(), text.size()) == u8.size());
+		check("validate_utf8", validate_utf8(u8.data(), u8.size()));
+
+		std::u16string out16(u16.size(), 0);
+		auto r16 = utf8_to_utf16(u8.data(), u8.size(), &out16[0], out16.size());
+		check("utf8_to_utf16", r16.ok() && r16.written == u16.size() && out16 == u16);
+		std::u32string out32(text.size(), 0);
+		auto r32 = utf8_to_utf32(u8.data(), u8.size(), &out32[0], out32.size());
+		check("utf8_to_utf32", r32.ok() && r32.written == text.size() && out32 == text);
+
+		std::string back(u8.size(), '\0');
+		auto b16 = utf16_to_utf8(u16.data(), u16.size(), &back[0], back.size());
+		check("utf16_to_utf8", b16.ok() && back == u8);
+		auto b32 = utf32_to_utf8(text.data(), text.size(), &back[0], back.size());
+		check("utf32_to_utf8", b32.ok() && back == u8);
+
+		check("wide round trip", wide_to_utf8(utf8_to_wide(u8)) == u8);
+		check("utf16le round trip", utf16le_to_utf8(utf8_to_utf16le(u8)) == u8);
+	}
+
+	struct Malformed { const char* bytes; TranscodeStatus status; size_t read; };
+	const Malformed malformed[] = {
+		{ "ab\xC0\x80", eTranscodeStatus_Invalid, 2 },          // overlong
+		{ "\xE0\x80\x80", eTranscodeStatus_Invalid, 0 },        // overlong
+		{ "x\xED\xA0\x80", eTranscodeStatus_Invalid, 1 },       // surrogate
+		{ "\xF4\x90\x80\x80", eTranscodeStatus_Invalid, 0 },    // above U+10FFFF
+		{ "abc\x80", eTranscodeStatus_Invalid, 3 },             // stray continuation
+		{ "\xE4\xB8\x41", eTranscodeStatus_Invalid, 0 },        // bad continuation
+		{ "abcdefghijklmnopqrstu\xE4\xB8", eTranscodeStatus_Truncated, 21 },
+	};
+	for (auto& m : malformed)
+	{
+		char16_t out[64];
+		auto r = utf8_to_utf16(m.bytes, strlen(m.bytes), out, 64);
+		check("malformed utf8", r.status == m.status && r.read == m.read && r.written == m.read);
+		check("validate malformed", !validate_utf8(m.bytes, strlen(m.bytes)));
+	}
+
+	const char16_t lone[] = { u'a', 0xDC00, u'b' };
+	char bytes[16];
+	check("lone surrogate", utf16_to_utf8(lone, 3, bytes, 16).status == eTranscodeStatus_Invalid);
+	const char16_t cut[] = { u'a', 0xD83D };
+	check("cut surrogate", utf16_to_utf8(cut, 2, bytes, 16).status == eTranscodeStatus_Truncated);
+
+	std::string chinese = "\xE4\xBD\xA0\xE5\xA5\xBD, world";
+	char16_t small[3];
+	auto overflow = utf8_to_utf16(chinese.data(), chinese.size(), small, 3);
+	check("overflow", overflow.status == eTranscodeStatus_Overflow && overflow.read == 7 && overflow.written == 3);
+	char tiny[4];
+	const char32_t emoji[] = { U'a', 0x1F600 };
+	auto narrow = utf32_to_utf8(emoji, 2, tiny, 4);
+	check("overflow utf8", narrow.status == eTranscodeStatus_Overflow && narrow.read == 1 && narrow.written == 1);
+
+	bool ok = true;
+	auto replaced = utf8_to_wide("a\xFF\xE4\xB8z", 5, &ok);
+	check("replacement", !ok && replaced == std::wstring({ L'a', 0xFFFD, 0xFFFD, L'z' }));
+	check("two byte sequence", utf8_to_utf16le("\xC3\xA9") == std::wstring(1, wchar_t(0xE9)));
+	check("bom", utf8_to_utf16le("\xEF\xBB\xBFok", 5) == L"ok");
+
+	// StringTool takes wchar_t strings in the platform's wide encoding, UTF-32 outside Windows
+	std::wstring native = utf8_to_wide("a\xC3\xA9\xE4\xB8\xAD\xF0\x9F\x98\x80");
+	check("fromUtf16", core::StringTool::fromUtf16(native) == native);
+#ifndef _WIN32
+	check("fromUtf16 bom", core::StringTool::fromUtf16(std::wstring(1, wchar_t(0xFEFF)) + native) == native);
+#endif
+	check("fromUtf16 utf8", core::StringTool::toUtf8(core::StringTool::fromUtf16(native)) == "a\xC3\xA9\xE4\xB8\xAD\xF0\x9F\x98\x80");
+
+	check.finish();
+}
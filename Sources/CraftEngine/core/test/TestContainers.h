@@ -0,0 +1,268 @@
+#pragma once
+#include "../Core.h"
+#include "TestCheck.h"
+#include <random>
+#include <string>
+#include <map>
+#include <unordered_map>
+
+
+
+/*
+ Runs random inserts, lookups and removals on FlatHashMap and BTreeMap next to std::unordered_map
+ and std::map and compares the contents after every round. Also removes entries while iterating,
+ churns a hash table full of tombstones that must be rebuilt in place, and drives B-trees of small
+ degree through splits, borrows and merges at node boundaries.
+*/
+void testContainers()
+{
+	using namespace CraftEngine;
+
+	test::TestCheck check("testContainers");
+
+	// every key maps to one of 8 hashes, probes run long and cross groups
+	struct CollidingHash { size_t operator()(uint32_t key) const { return key % 8; } };
+
+	auto same_hash = [](const auto& map, const auto& reference)
+	{
+		if (map.size() != reference.size())
+			return false;
+		size_t visited = 0;
+		for (auto it = map.begin(); it != map.end(); ++it, visited++)
+		{
+			auto found = reference.find(it.key());
+			if (found == reference.end() || found->second != *it)
+				return false;
+		}
+		for (auto& entry : reference)
+		{
+			auto data = map.find(entry.first);
+			if (data == nullptr || *data != entry.second)
+				return false;
+		}
+		return visited == reference.size();
+	};
+	auto same_tree = [](const auto& map, const auto& reference)
+	{
+		if (map.size() != reference.size())
+			return false;
+		auto it = map.begin();
+		for (auto& entry : reference)
+		{
+			if (it == map.end() || it.key() != entry.first || *it != entry.second)
+				return false;
+			++it;
+		}
+		return it == map.end();
+	};
+
+	// random differential runs
+	{
+		std::mt19937 rng(36);
+		core::FlatHashMap<uint32_t, std::string> hash;
+		core::FlatHashMap<uint32_t, std::string, CollidingHash> colliding;
+		core::BTreeMap<uint32_t, std::string> tree;
+		core::BTreeMap<uint32_t, std::string, std::less<uint32_t>, 2> small_tree;
+		std::unordered_map<uint32_t, std::string> hash_reference;
+		std::map<uint32_t, std::string> tree_reference;
+		bool hash_ok = true, colliding_ok = true, tree_ok = true, small_tree_ok = true, results = true;
+		for (int round = 0; round < 200; round++)
+		{
+			uint32_t range = round % 2 == 0 ? 64 : 2000;
+			for (int op = 0; op < 100; op++)
+			{
+				uint32_t key = rng() % range;
+				auto value = std::to_string(rng());
+				switch (rng() % 4)
+				{
+				case 0:
+				case 1:
+				{
+					bool inserted = hash_reference.emplace(key, value).second;
+					tree_reference.emplace(key, value);
+					results &= hash.insert(key, value) == inserted && colliding.insert(key, value) == inserted;
+					results &= tree.insert(key, value) == inserted && small_tree.insert(key, value) == inserted;
+					break;
+				}
+				case 2:
+				{
+					bool removed = hash_reference.erase(key) != 0;
+					tree_reference.erase(key);
+					results &= hash.remove(key) == removed && colliding.remove(key) == removed;
+					results &= tree.remove(key) == removed && small_tree.remove(key) == removed;
+					break;
+				}
+				default:
+				{
+					hash_reference[key] = value;
+					tree_reference[key] = value;
+					hash[key] = value;
+					colliding[key] = value;
+					tree[key] = value;
+					small_tree[key] = value;
+					break;
+				}
+				}
+			}
+			hash_ok &= same_hash(hash, hash_reference);
+			colliding_ok &= same_hash(colliding, hash_reference);
+			tree_ok &= same_tree(tree, tree_reference);
+			small_tree_ok &= same_tree(small_tree, tree_reference);
+		}
+		check("insert and remove results", results);
+		check("flat hash map", hash_ok);
+		check("flat hash map colliding", colliding_ok);
+		check("b-tree map", tree_ok);
+		check("b-tree map degree 2", small_tree_ok);
+
+		// copies and moves keep the contents
+		auto hash_copy = colliding;
+		auto tree_copy = small_tree;
+		auto hash_moved = std::move(hash_copy);
+		auto tree_moved = std::move(tree_copy);
+		check("copy and move", same_hash(hash_moved, hash_reference) && same_tree(tree_moved, tree_reference) && hash_copy.empty() && tree_copy.empty());
+	}
+
+	// removing entries while iterating
+	{
+		core::FlatHashMap<uint32_t, std::string, CollidingHash> hash;
+		std::unordered_map<uint32_t, std::string> reference;
+		for (uint32_t i = 0; i < 1000; i++)
+		{
+			hash.insert(i, std::to_string(i));
+			reference.emplace(i, std::to_string(i));
+		}
+		// removal never moves other entries, the iterator steps over the freed slot
+		uint32_t visited = 0;
+		for (auto it = hash.begin(); it != hash.end(); ++it, visited++)
+		{
+			auto key = it.key();
+			if (key % 3 != 0)
+			{
+				hash.remove(key);
+				reference.erase(key);
+			}
+		}
+		check("flat hash map remove while iterating", visited == 1000 && same_hash(hash, reference));
+
+		// a B-tree removal may rebalance, so the walk seeks the next key again
+		core::BTreeMap<uint32_t, std::string, std::less<uint32_t>, 3> tree;
+		std::map<uint32_t, std::string> tree_reference;
+		for (uint32_t i = 0; i < 1000; i++)
+		{
+			tree.insert(i, std::to_string(i));
+			tree_reference.emplace(i, std::to_string(i));
+		}
+		visited = 0;
+		for (auto it = tree.begin(); it != tree.end(); visited++)
+		{
+			auto key = it.key();
+			if (key % 3 != 0)
+			{
+				tree.remove(key);
+				tree_reference.erase(key);
+				it = tree.lower_bound(key);
+			}
+			else
+				++it;
+		}
+		check("b-tree map remove while iterating", visited == 1000 && same_tree(tree, tree_reference));
+	}
+
+	// tombstones exhaust the growth budget of a table whose size stays small, it is rebuilt at the same capacity
+	{
+		// keys of one class share a hash, class 0 and class `other` start probing in different groups of a 2 group table
+		struct ClassHash { size_t operator()(uint32_t key) const { return key >> 16; } };
+		uint32_t other = 1;
+		while (((core::detail::flatHashMix(other) >> 7) & 1) == ((core::detail::flatHashMix(0) >> 7) & 1))
+			other++;
+		core::FlatHashMap<uint32_t, uint32_t, ClassHash> hash;
+		std::unordered_map<uint32_t, uint32_t> reference;
+		hash.reserve(28);
+		auto capacity = hash.capacity();
+		auto insert = [&](uint32_t key) { hash.insert(key, key * 7); reference.emplace(key, key * 7); };
+		// class 0 fills its group, class `other` takes all but the slots the load factor keeps empty
+		for (uint32_t i = 0; i < 16; i++)
+			insert(i);
+		for (uint32_t i = 0; i < 12; i++)
+			insert(other << 16 | i);
+		// a full group keeps tombstones, then the next insert into an empty slot finds no budget left
+		bool ok = capacity == 32;
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			ok &= hash.remove(i);
+			reference.erase(i);
+		}
+		insert(other << 16 | 12);
+		ok &= same_hash(hash, reference) && hash.capacity() == capacity;
+		check("tombstone rehash keeps capacity", ok);
+
+		// steady churn through both classes at a constant size
+		uint32_t next = 13;
+		for (uint32_t round = 0; round < 5000; round++, next++)
+		{
+			auto key = (round % 2 == 0 ? 0 : other) << 16 | next;
+			insert(key);
+			auto oldest = reference.begin()->first;
+			ok &= hash.remove(oldest);
+			reference.erase(oldest);
+			if (round % 500 == 0)
+				ok &= same_hash(hash, reference);
+		}
+		check("tombstone churn", ok && same_hash(hash, reference) && hash.capacity() == capacity);
+
+		hash.clear();
+		check("clear", hash.empty() && hash.find(other << 16 | 12) == nullptr && hash.capacity() == capacity);
+	}
+
+	// ascending and descending runs split and merge nodes at the same boundary over and over
+	{
+		core::BTreeMap<uint32_t, uint32_t, std::less<uint32_t>, 2> tree;
+		std::map<uint32_t, uint32_t> reference;
+		bool ok = true;
+		for (uint32_t count = 1; count <= 40; count++)
+		{
+			for (uint32_t i = 0; i < count; i++)
+			{
+				tree.insert(i, i);
+				reference.emplace(i, i);
+			}
+			ok &= same_tree(tree, reference);
+			// removing from the front empties the leftmost leaf first, from the back the rightmost
+			for (uint32_t i = 0; i < count; i++)
+			{
+				auto key = count % 2 == 0 ? i : count - 1 - i;
+				ok &= tree.remove(key);
+				reference.erase(key);
+				ok &= same_tree(tree, reference);
+			}
+			ok &= tree.empty() && tree.begin() == tree.end();
+		}
+		check("b-tree boundary splits and merges", ok);
+
+		// keys removed from the middle of internal nodes, then lower_bound across the gaps
+		for (uint32_t i = 0; i < 500; i++)
+		{
+			tree.insert(i * 2, i);
+			reference.emplace(i * 2, i);
+		}
+		for (uint32_t i = 0; i < 500; i += 2)
+		{
+			tree.remove(i * 2 + 200 > 998 ? i * 2 : i * 2 + 200);
+			reference.erase(i * 2 + 200 > 998 ? i * 2 : i * 2 + 200);
+		}
+		bool bounds = same_tree(tree, reference);
+		for (uint32_t key = 0; key < 1002; key++)
+		{
+			auto it = tree.lower_bound(key);
+			auto expected = reference.lower_bound(key);
+			if (expected == reference.end())
+				bounds &= it == tree.end();
+			else
+				bounds &= it != tree.end() && it.key() == expected->first && *it == expected->second;
+		}
+		check("b-tree lower_bound", bounds);
+	}
+
+	check.finish();
+}
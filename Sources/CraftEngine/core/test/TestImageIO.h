@@ -0,0 +1,89 @@
+#pragma once
+#include "../ImageIO.h"
+#include "TestCheck.h"
+#include <filesystem>
+
+
+
+/*
+ Encodes a generated image, then decodes it back through ImageIOService: full size, reduced,
+ flipped, into a caller buffer and as a batch.
+*/
+void testImageIO()
+{
+	using namespace CraftEngine;
+
+	test::TestCheck check("testImageIO");
+
+	const uint32_t width = 67, height = 45;
+	core::Bitmap source(width, height, core::Bitmap::Format_RGBA8);
+	auto pixels = (uint8_t*)source.data();
+	for (uint32_t y = 0; y < height; y++)
+		for (uint32_t x = 0; x < width; x++)
+		{
+			uint8_t* p = pixels + (y * width + x) * 4;
+			p[0] = uint8_t(x * 3);
+			p[1] = uint8_t(y * 5);
+			p[2] = uint8_t((x + y) & 1 ? 255 : 0);
+			p[3] = 255;
+		}
+
+	auto directory = std::filesystem::temp_directory_path();
+	std::vector<std::string> paths;
+	for (int i = 0; i < 8; i++)
+		paths.push_back((directory / ("craft_engine_test_image_" + std::to_string(i) + ".png")).string());
+
+	core::ImageIOService service(4);
+	std::vector<std::future<bool>> writes;
+	for (auto& path : paths)
+		writes.push_back(service.encode(path, source.data(), width, height, core::Bitmap::Format_RGBA8));
+	for (auto& write : writes)
+		check("encode", write.get());
+
+	auto full = service.decode(paths[0]).get();
+	check("decode size", full.width() == width && full.height() == height && full.format() == core::Bitmap::Format_RGBA8);
+	check("decode pixels", full.valid() && memcmp(full.data(), source.data(), source.size()) == 0);
+
+	core::ImageIOService::DecodeOptions flip;
+	flip.flipY = true;
+	auto flipped = service.decode(paths[1], flip).get();
+	check("flipY", flipped.valid() && memcmp(flipped.data(), source.flipY().data(), source.size()) == 0);
+
+	core::ImageIOService::DecodeOptions reduced;
+	reduced.maxDimension = 20;
+	auto info = core::ImageIOService::decodedInfo(paths[2], reduced);
+	check("decodedInfo", info.width == width / 4 && info.height == height / 4);
+	std::vector<uint8_t> buffer(info.size());
+	auto result = service.decodeInto(paths[2], buffer.data(), buffer.size(), reduced).get();
+	check("decodeInto", result.valid() && result.width == info.width && result.height == info.height);
+	// the first output pixel averages the top-left 4x4 block
+	uint32_t sum = 0;
+	for (uint32_t y = 0; y < 4; y++)
+		for (uint32_t x = 0; x < 4; x++)
+			sum += pixels[(y * width + x) * 4 + 0];
+	check("reduction", buffer[0] == (sum + 8) / 16);
+	check("decodeInto capacity", !service.decodeInto(paths[2], buffer.data(), buffer.size() - 1, reduced).get().valid());
+
+	core::ImageIOService::DecodeOptions red;
+	red.format = core::Bitmap::Format_R8;
+	auto batch = service.decodeBatch(paths, red);
+	for (auto& future : batch)
+	{
+		auto bitmap = future.get();
+		check("batch", bitmap.format() == core::Bitmap::Format_R8 && bitmap.size() == width * height && ((uint8_t*)bitmap.data())[width + 1] == pixels[(width + 1) * 4]);
+	}
+	check("missing file", !service.decode((directory / "craft_engine_missing.png").string()).get().valid());
+
+	// failing decodes on every worker at once each record their own failure reason
+	std::vector<std::future<core::Bitmap>> failures;
+	for (uint32_t i = 0; i < service.threadCount() * 4; i++)
+		failures.push_back(service.decode(std::vector<uint8_t>(16, uint8_t(i))));
+	bool all_failed = true;
+	for (auto& future : failures)
+		all_failed &= !future.get().valid();
+	check("concurrent failures", all_failed);
+
+	for (auto& path : paths)
+		std::filesystem::remove(path);
+	check.finish();
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include "../Core.h"
+#include "TestCheck.h"
+#include <iostream>
+
+
+
+/*
+ Exercises Observer connections: direct and member slots, disconnecting and connecting from inside
+ an emission, coalesced queued connections, queued calls outliving their observer, freeing lists
+ retired during an emission, and emitting from several threads while slots change.
+*/
+void testObserver()
+{
+	using namespace CraftEngine;
+
+	test::TestCheck check("testObserver");
+
+	struct Receiver
+	{
+		int sum = 0;
+		void add(int value) { sum += value; }
+	};
+
+	core::Observer<void(int)> observer;
+	Receiver receiver;
+	int direct = 0;
+	auto a = observer.connect(std::function<void(int)>([&](int value) { direct += value; }));
+	observer.connect(&receiver, &Receiver::add);
+	observer.notify(3);
+	check("direct", direct == 3 && receiver.sum == 3 && observer.size() == 2);
+	observer.disconnect(a);
+	observer.notify(4);
+	check("disconnect", direct == 3 && receiver.sum == 7 && observer.size() == 1);
+
+	// a slot that removes itself and adds another while the signal is being emitted
+	core::Observer<void()> reentrant;
+	int self_calls = 0, added_calls = 0;
+	core::Observer<void()>::KeyType self = 0;
+	self = reentrant.connect(std::function<void()>([&]() {
+		self_calls++;
+		reentrant.disconnect(self);
+		reentrant.connect(std::function<void()>([&]() { added_calls++; }));
+	}));
+	reentrant.notify();
+	check("reentrant emission", self_calls == 1 && added_calls == 0 && reentrant.size() == 1);
+	reentrant.notify();
+	check("after reentrant emission", self_calls == 1 && added_calls == 1);
+
+	// queued connections run once per dispatch with the latest arguments
+	core::SignalQueue queue;
+	core::Observer<void(int, const std::string&)> changed;
+	int queued_calls = 0, last_value = 0;
+	std::string last_name;
+	changed.connect(queue, std::function<void(int, const std::string&)>([&](int value, const std::string& name) { queued_calls++; last_value = value; last_name = name; }));
+	auto dropped = changed.connect(queue, std::function<void(int, const std::string&)>([&](int, const std::string&) { check("disconnected queued slot", false); }));
+	for (int i = 0; i <= 100; i++)
+		changed.notify(i, std::to_string(i));
+	check("queued before dispatch", queued_calls == 0 && queue.size() == 2);
+	changed.disconnect(dropped);
+	queue.dispatch();
+	check("queued coalesced", queued_calls == 1 && last_value == 100 && last_name == "100");
+	check("queue drained", queue.dispatch() == 0 && queued_calls == 1);
+	changed.notify(5, "five");
+	queue.dispatch();
+	check("queued again", queued_calls == 2 && last_value == 5);
+
+	// an observer destroyed with calls still queued must not run them
+	{
+		int late_calls = 0;
+		{
+			core::Observer<void(int)> doomed;
+			doomed.connect(queue, std::function<void(int)>([&](int) { late_calls++; }));
+			doomed.notify(1);
+		}
+		queue.dispatch();
+		check("destroyed observer queued call", late_calls == 0);
+	}
+
+	// a list retired during an emission is freed when the emission ends, not at the next publish
+	{
+		core::Observer<void()> once;
+		auto token = std::make_shared<int>(0);
+		std::weak_ptr<int> watch = token;
+		core::Observer<void()>::KeyType key = 0;
+		key = once.connect(std::function<void()>([&once, &key, token]() { once.disconnect(key); }));
+		token.reset();
+		once.notify();
+		check("retired list reclaimed after emission", watch.expired() && once.size() == 0);
+	}
+
+	// emitters on several threads while the slot list keeps changing
+	core::Observer<void(int)> shared;
+	std::atomic<int> hits{ 0 };
+	std::atomic<bool> running{ true };
+	shared.connect(std::function<void(int)>([&](int value) { hits += value; }));
+	std::vector<std::thread> emitters;
+	for (int t = 0; t < 4; t++)
+		emitters.emplace_back([&]() { while (running) shared.notify(1); });
+	for (int i = 0; i < 2000; i++)
+	{
+		auto key = shared.connect(std::function<void(int)>([&](int) {}));
+		shared.disconnect(key);
+	}
+	running = false;
+	for (auto& emitter : emitters)
+		emitter.join();
+	check("concurrent emission", hits > 0 && shared.size() == 1);
+
+	auto copy = observer;
+	copy.notify(1);
+	check("copy", receiver.sum == 8 && copy.size() == 1);
+
+	check.finish();
+}
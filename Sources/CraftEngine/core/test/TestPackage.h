@@ -0,0 +1,134 @@
+#pragma once
+#include "../Package.h"
+#include "TestCheck.h"
+#include <random>
+
+
+
+/*
+ Packs a generated directory tree, reads it back through PackageLoader and compares every
+ entry with the source file, then reads the same package from several threads at once.
+*/
+void testPackage()
+{
+	using namespace CraftEngine;
+	namespace fs = std::filesystem;
+
+	test::TestCheck check("testPackage");
+
+	// raw LZ4 round trips, including sizes around the minimum block length
+	std::mt19937 rng(97);
+	for (size_t size = 0; size < 300; size += (size < 40 ? 1 : 37))
+	{
+		std::vector<uint8_t> src(size), packed(core::detail::lz4CompressBound(size)), dst(size);
+		for (auto& b : src)
+			b = uint8_t(rng() % 3);
+		size_t packed_size = core::detail::lz4Compress(src.data(), src.size(), packed.data(), packed.size());
+		check("lz4 round trip", packed_size != 0 && core::detail::lz4Decompress(packed.data(), packed_size, dst.data(), dst.size()) && src == dst);
+	}
+
+	auto root = fs::temp_directory_path() / "craft_engine_test_package";
+	fs::remove_all(root);
+	fs::create_directories(root / "textures" / "ui");
+	fs::create_directories(root / "shaders");
+
+	std::vector<std::pair<std::string, std::vector<uint8_t>>> files;
+	auto add = [&](const std::string& path, std::vector<uint8_t> data)
+	{
+		std::ofstream(root / path, std::ios::binary).write((const char*)data.data(), data.size());
+		files.push_back({ path, std::move(data) });
+	};
+	std::string text;
+	for (int i = 0; i < 20000; i++)
+		text += "vec4 color = texture(sampler, uv) * " + std::to_string(i % 17) + ";\n";
+	add("shaders/basic.frag", std::vector<uint8_t>(text.begin(), text.end()));
+	std::vector<uint8_t> noise(300000);
+	for (auto& b : noise)
+		b = uint8_t(rng());
+	add("textures/noise.bin", noise);
+	add("textures/ui/empty.bin", std::vector<uint8_t>());
+	add("textures/ui/small.txt", std::vector<uint8_t>{ 'o', 'k' });
+	add("readme.txt", std::vector<uint8_t>(5000, 'x'));
+
+	core::PackageMaker::Options options;
+	options.alignment = 4096;
+	options.batchSize = 100000; // forces several batches
+	core::PackageMaker maker(options);
+	check("addDirectory", maker.addDirectory(root, "assets"));
+	auto package = fs::temp_directory_path() / "craft_engine_test_package.pak";
+	check("write", maker.write(package));
+
+	core::PackageLoader loader;
+	check("link", loader.link(package));
+	check("entryCount", loader.entryCount() == files.size());
+	for (auto& file : files)
+	{
+		auto path = "assets/" + file.first;
+		check("contains", loader.contains(path));
+		check("size", loader.size(path) == file.second.size());
+		check("load", loader.load(path) == file.second);
+		auto view = loader.view(path);
+		if (!view.empty())
+		{
+			check("view", std::vector<uint8_t>(view.begin(), view.end()) == file.second);
+			check("view alignment", (size_t(view.data) & 4095) == 0);
+		}
+	}
+	check("noise is stored", !loader.view("assets/textures/noise.bin").empty());
+	check("text is compressed", loader.view("assets/shaders/basic.frag").empty());
+	check("path normalization", loader.load("/assets\\shaders//basic.frag") == files[0].second);
+	check("missing entry", !loader.contains("assets/shaders") && loader.load("assets/missing").empty());
+
+	std::vector<std::thread> threads;
+	std::atomic<int> mismatches = 0;
+	for (int t = 0; t < 4; t++)
+	{
+		threads.emplace_back([&]()
+		{
+			for (int n = 0; n < 20; n++)
+				for (auto& file : files)
+					if (loader.load("assets/" + file.first) != file.second)
+						mismatches++;
+		});
+	}
+	for (auto& thread : threads)
+		thread.join();
+	check("concurrent load", mismatches == 0);
+
+	loader.clear();
+
+	// an entry whose size does not fit its compressed data fails before anything is allocated for it
+	{
+		std::vector<uint8_t> bytes(fs::file_size(package));
+		std::ifstream(package, std::ios::binary).read((char*)bytes.data(), bytes.size());
+		auto header = (core::detail::PackageHeader*)bytes.data();
+		auto entries = (core::detail::PackageEntry*)(bytes.data() + header->entryTableOffset);
+		for (uint32_t i = 0; i < header->entryCount; i++)
+		{
+			if (entries[i].compression == uint32_t(core::PackageCompression::eLZ4))
+				entries[i].size = entries[i].storedSize * core::detail::Lz4MaxRatio + 1;
+			else if (entries[i].size != 0)
+				entries[i].size = uint64_t(1) << 40;
+		}
+		auto corrupt = fs::temp_directory_path() / "craft_engine_test_package_corrupt.pak";
+		std::ofstream(corrupt, std::ios::binary).write((const char*)bytes.data(), bytes.size());
+		core::PackageLoader corrupt_loader;
+		check("corrupt link", corrupt_loader.link(corrupt));
+		bool rejected = true;
+		for (auto& file : files)
+		{
+			auto path = "assets/" + file.first;
+			uint8_t small[16];
+			if (file.second.empty())
+				continue;
+			rejected &= corrupt_loader.load(path).empty() && !corrupt_loader.load(path, small, sizeof(small)) && corrupt_loader.view(path).empty();
+		}
+		check("corrupt size rejected", rejected);
+		corrupt_loader.clear();
+		fs::remove(corrupt);
+	}
+
+	fs::remove(package);
+	fs::remove_all(root);
+	check.finish();
+}
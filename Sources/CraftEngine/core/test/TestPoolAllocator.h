@@ -0,0 +1,199 @@
+#pragma once
+#include "../Core.h"
+#include "TestCheck.h"
+#include <random>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <unordered_set>
+
+
+
+/*
+ Checks the PoolAllocator size classes and the large allocation path, allocates on producer
+ threads and frees on consumer threads while checking that no live block is overwritten, that
+ blocks freed by exited threads are reused without duplicates, that one thread does not keep a
+ whole fresh slab to itself, that large blocks outlive their pool, and that the sized STL adapter
+ releases what it allocated.
+*/
+void testPoolAllocator()
+{
+	using namespace CraftEngine;
+
+	test::TestCheck check("testPoolAllocator");
+
+	// every size maps to the smallest class that holds it
+	bool classes = true;
+	for (size_t size = 1; size <= core::detail::PoolMaxSmallSize; size++)
+	{
+		auto index = core::detail::poolSizeClassIndex(size);
+		classes &= index < core::detail::PoolSizeClassCount && core::detail::poolSizeClassSize(index) >= size;
+		classes &= index == 0 || core::detail::poolSizeClassSize(index - 1) < size;
+	}
+	check("size classes", classes);
+
+	{
+		core::PoolAllocator pool;
+		bool blocks = true;
+		const size_t sizes[] = { 1, 16, 17, 128, 129, 1000, 4096, 8191, 8192 };
+		for (auto size : sizes)
+		{
+			auto pointer = (uint8_t*)pool.allocate(size);
+			memset(pointer, 0xAB, size);
+			blocks &= core::PoolAllocator::owner_of(pointer) == &pool && core::PoolAllocator::block_size(pointer) >= size && uintptr_t(pointer) % 16 == 0;
+			pool.deallocate(pointer, size);
+		}
+		check("small blocks", blocks);
+
+		// past the largest class the block comes straight from the system and is counted until freed
+		auto reserved = pool.reserved_bytes();
+		const size_t large_sizes[] = { core::detail::PoolMaxSmallSize + 1, 100000, 3 * core::detail::PoolSlabSize };
+		std::vector<void*> large;
+		size_t large_total = 0;
+		bool large_ok = true;
+		for (auto size : large_sizes)
+		{
+			auto pointer = pool.allocate(size);
+			memset(pointer, 0xCD, size);
+			large_ok &= core::PoolAllocator::owner_of(pointer) == &pool && core::PoolAllocator::block_size(pointer) == size && uintptr_t(pointer) % 16 == 0;
+			large.push_back(pointer);
+			large_total += size;
+		}
+		large_ok &= pool.reserved_bytes() == reserved + large_total;
+		pool.deallocate(large[0]);
+		pool.deallocate(large[1], large_sizes[1]);
+		core::PoolAllocator::release(large[2]);
+		check("large blocks", large_ok && pool.reserved_bytes() == reserved);
+	}
+
+	// a large block may be freed after its pool is gone
+	{
+		void* survivor;
+		{
+			core::PoolAllocator pool;
+			survivor = pool.allocate(50000);
+			memset(survivor, 0xEF, 50000);
+		}
+		bool kept = core::PoolAllocator::owner_of(survivor) == nullptr && core::PoolAllocator::block_size(survivor) == 50000 && ((uint8_t*)survivor)[49999] == 0xEF;
+		core::PoolAllocator::release(survivor);
+		check("large block outlives its pool", kept);
+	}
+
+	// a fresh slab gives one thread a magazine, other threads take the rest without growing the pool
+	{
+		core::PoolAllocator pool;
+		// this thread stays alive and keeps its magazine
+		void* first = pool.allocate(16);
+		auto reserved = pool.reserved_bytes();
+		std::vector<void*> others;
+		std::thread([&]() {
+			for (uint32_t i = 0; i < 4 * core::detail::PoolMagazineSize; i++)
+				others.push_back(pool.allocate(16));
+		}).join();
+		check("refill batch", reserved == core::detail::PoolSlabSize && pool.reserved_bytes() == reserved);
+		pool.deallocate(first, 16);
+		for (auto pointer : others)
+			pool.deallocate(pointer, 16);
+	}
+
+	// producers allocate and tag blocks, consumers on other threads verify and free them
+	{
+		core::PoolAllocator pool;
+		struct Item { uint32_t* block; uint32_t size; uint32_t tag; };
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::deque<Item> queue;
+		int producers_left = 4;
+		std::atomic<bool> corrupted{ false };
+		std::atomic<size_t> freed{ 0 };
+		const int per_producer = 20000;
+
+		std::vector<std::thread> threads;
+		for (int p = 0; p < 4; p++)
+			threads.emplace_back([&, p]() {
+				std::mt19937 rng(p);
+				for (int i = 0; i < per_producer; i++)
+				{
+					uint32_t size = 4 + rng() % 600 * 4;
+					auto block = (uint32_t*)pool.allocate(size);
+					uint32_t tag = uint32_t(p << 24 | i);
+					for (uint32_t w = 0; w < size / 4; w++)
+						block[w] = tag;
+					std::lock_guard<std::mutex> lock(mutex);
+					queue.push_back({ block, size, tag });
+					condition.notify_one();
+				}
+				std::lock_guard<std::mutex> lock(mutex);
+				producers_left--;
+				condition.notify_all();
+			});
+		for (int c = 0; c < 3; c++)
+			threads.emplace_back([&]() {
+				while (true)
+				{
+					Item item;
+					{
+						std::unique_lock<std::mutex> lock(mutex);
+						condition.wait(lock, [&]() { return !queue.empty() || producers_left == 0; });
+						if (queue.empty())
+							return;
+						item = queue.front();
+						queue.pop_front();
+					}
+					for (uint32_t w = 0; w < item.size / 4; w++)
+						if (item.block[w] != item.tag)
+							corrupted = true;
+					pool.deallocate(item.block, item.size);
+					freed++;
+				}
+			});
+		for (auto& thread : threads)
+			thread.join();
+		check("cross thread free", !corrupted && freed == 4 * per_producer);
+	}
+
+	// blocks allocated and freed by threads that exited are handed out again without duplicates
+	{
+		core::PoolAllocator pool;
+		const int count = 10000;
+		std::vector<void*> blocks;
+		std::thread([&]() {
+			for (int i = 0; i < count; i++)
+				blocks.push_back(pool.allocate(64));
+		}).join();
+		std::thread([&]() {
+			for (auto pointer : blocks)
+				pool.deallocate(pointer, 64);
+		}).join();
+		auto reserved = pool.reserved_bytes();
+		std::unordered_set<void*> live;
+		bool unique = true;
+		for (int i = 0; i < count; i++)
+			unique &= live.insert(pool.allocate(64)).second;
+		check("no duplicate blocks", unique);
+		check("freed blocks reused", pool.reserved_bytes() == reserved);
+		for (auto pointer : live)
+			pool.deallocate(pointer, 64);
+	}
+
+	// the STL adapter frees with the size it allocated, including growth past the largest class
+	{
+		core::PoolAllocator pool;
+		size_t reserved, large_bytes;
+		{
+			std::vector<uint64_t, core::PoolStlAllocator<uint64_t>> values{ core::PoolStlAllocator<uint64_t>(pool) };
+			for (uint64_t i = 0; i < 5000; i++)
+				values.push_back(i);
+			bool ok = true;
+			for (uint64_t i = 0; i < values.size(); i++)
+				ok &= values[i] == i;
+			check("stl vector", ok && values.get_allocator().pool() == &pool);
+			reserved = pool.reserved_bytes();
+			large_bytes = values.capacity() * sizeof(uint64_t);
+		}
+		check("stl large released", large_bytes > core::detail::PoolMaxSmallSize && pool.reserved_bytes() == reserved - large_bytes);
+	}
+
+	check.finish();
+}
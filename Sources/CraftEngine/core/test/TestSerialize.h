@@ -0,0 +1,134 @@
+#pragma once
+#include "../Serialize.h"
+#include "TestCheck.h"
+#include <iostream>
+#include <list>
+#include <map>
+#include <set>
+
+
+
+struct TestSerializeTransform
+{
+	float position[3];
+	float scale;
+	int32_t parent;
+};
+craft_engine_reflect_begin(TestSerializeTransform)
+craft_engine_reflect_field(position)
+craft_engine_reflect_field(scale)
+craft_engine_reflect_field(parent)
+craft_engine_reflect_end()
+
+struct TestSerializeMaterial
+{
+	std::string name;
+	uint32_t flags;
+	float roughness;
+	float metallic;
+	std::vector<float> parameters;
+	std::map<std::string, int> textures;
+	std::set<uint16_t> passes;
+	std::list<std::string> tags;
+	std::vector<bool> toggles;
+	std::array<TestSerializeTransform, 2> transforms;
+	uint8_t mode;
+};
+craft_engine_reflect_begin(TestSerializeMaterial)
+craft_engine_reflect_field(name)
+craft_engine_reflect_field(flags)
+craft_engine_reflect_field(roughness)
+craft_engine_reflect_field(metallic)
+craft_engine_reflect_field(parameters)
+craft_engine_reflect_field(textures)
+craft_engine_reflect_field(passes)
+craft_engine_reflect_field(tags)
+craft_engine_reflect_field(toggles)
+craft_engine_reflect_field(transforms)
+craft_engine_reflect_field(mode)
+craft_engine_reflect_end()
+craft_engine_reflect_version(TestSerializeMaterial, 3)
+
+// same wire format as TestSerializeMaterial up to the views, read in place
+struct TestSerializeMaterialView
+{
+	std::string_view name;
+	uint32_t flags;
+	float roughness;
+	float metallic;
+	CraftEngine::core::reflect::ArrayView<float> parameters;
+};
+craft_engine_reflect_begin(TestSerializeMaterialView)
+craft_engine_reflect_field(name)
+craft_engine_reflect_field(flags)
+craft_engine_reflect_field(roughness)
+craft_engine_reflect_field(metallic)
+craft_engine_reflect_field(parameters)
+craft_engine_reflect_end()
+
+
+
+/*
+ Round trips reflected structs through the binary serializer, reads views in place and
+ rejects truncated buffers and schema mismatches.
+*/
+void testSerialize()
+{
+	using namespace CraftEngine::core;
+
+	CraftEngine::test::TestCheck check("testSerialize");
+
+	static_assert(reflect::detail::isBulk<TestSerializeTransform>(), "a padding free reflected struct is copied at once");
+	static_assert(!reflect::detail::isBulk<TestSerializeMaterial>(), "");
+	static_assert(reflect::schemaHash<TestSerializeMaterial>() != reflect::schemaHash<TestSerializeTransform>(), "");
+
+	TestSerializeMaterial material;
+	material.name = "brushed steel";
+	material.flags = 0x12345678;
+	material.roughness = 0.35f;
+	material.metallic = 1.0f;
+	for (int i = 0; i < 1000; i++)
+		material.parameters.push_back(i * 0.5f);
+	material.textures = { { "albedo", 3 }, { "normal", 7 } };
+	material.passes = { 1, 4, 9 };
+	material.tags = { "metal", "", "floor" };
+	material.toggles = { true, false, true };
+	material.transforms[0] = { { 1, 2, 3 }, 4, -1 };
+	material.transforms[1] = { { 5, 6, 7 }, 8, 0 };
+	material.mode = 9;
+
+	auto data = reflect::serialize(material);
+	TestSerializeMaterial loaded;
+	check("round trip", reflect::deserialize(data, loaded));
+	check("values", loaded.name == material.name && loaded.flags == material.flags && loaded.roughness == material.roughness && loaded.metallic == material.metallic
+		&& loaded.parameters == material.parameters && loaded.textures == material.textures && loaded.passes == material.passes && loaded.tags == material.tags
+		&& loaded.toggles == material.toggles && loaded.mode == material.mode);
+	check("bulk fields", memcmp(loaded.transforms.data(), material.transforms.data(), sizeof(material.transforms)) == 0);
+	check("deterministic", reflect::serialize(loaded) == data);
+
+	for (size_t size = 0; size < data.size(); size += 7)
+		check("truncated", !reflect::deserialize(data.data(), size, loaded));
+	auto corrupt = data;
+	corrupt[8] ^= 1;
+	check("schema hash", !reflect::deserialize(corrupt, loaded));
+
+	TestSerializeTransform transform;
+	check("schema type", !reflect::deserialize(data, transform));
+
+	// the view type has its own schema, so it reads the bytes of a view written the same way
+	TestSerializeMaterialView view = { material.name, material.flags, material.roughness, material.metallic, material.parameters };
+	auto view_data = reflect::serialize(view);
+	TestSerializeMaterialView read_view;
+	check("view", reflect::deserialize(view_data, read_view));
+	check("view in place", read_view.name == material.name && read_view.parameters.size() == material.parameters.size()
+		&& (const uint8_t*)read_view.parameters.data() > view_data.data() && (const uint8_t*)read_view.parameters.data() < view_data.data() + view_data.size()
+		&& size_t(read_view.parameters.data()) % alignof(float) == 0
+		&& memcmp(read_view.parameters.data(), material.parameters.data(), material.parameters.size() * sizeof(float)) == 0);
+
+	std::vector<TestSerializeTransform> transforms(10000, material.transforms[0]);
+	std::vector<TestSerializeTransform> loaded_transforms;
+	check("bulk array", reflect::deserialize(reflect::serialize(transforms), loaded_transforms)
+		&& memcmp(loaded_transforms.data(), transforms.data(), transforms.size() * sizeof(TestSerializeTransform)) == 0);
+
+	check.finish();
+}
@@ -10,7 +10,7 @@ namespace CraftEngine
 		class Scene : public AbstraceScene
 		{
 		private:
-			std::unordered_map<IDType, ModelInstance> m_instanceList;
+			core::FlatHashMap<IDType, ModelInstance>  m_instanceList;
 			core::ArrayList<IDType>                   m_renderInstanceList;
 			IDType m_nextID = 0;
 			Camera m_camera;
@@ -21,19 +21,17 @@ namespace CraftEngine
 				IDType id = m_nextID++;
 				ModelInstance ins;
 				ins.mModel = model;
-				m_instanceList.emplace(std::make_pair(id, ins));
+				m_instanceList.insert(id, ins);
 				return id;
 			}
+			// the reference stays valid until the next createInstance
 			virtual ModelInstance& getInstance(IDType id) override
 			{
 				return m_instanceList[id];
 			}
 			virtual void destroyInstance(IDType id) override
 			{
-				auto it = m_instanceList.find(id);
-				if (it == m_instanceList.end())
-					return;
-				m_instanceList.erase(id);
+				m_instanceList.remove(id);
 			}
 			virtual Camera& getCamera() override 
 			{
@@ -41,18 +39,18 @@ namespace CraftEngine
 			}
 			virtual void updateScene() override 
 			{
-				for (auto& it : m_instanceList)
+				for (auto& instance : m_instanceList)
 				{
 					math::mat4 model = math::mat4();
-					model = math::rotate(it.second.mTransform.mRotation, model);
-					model = math::scale(it.second.mTransform.mScale, model);
-					model = math::translate(it.second.mTransform.mTranslate, model);
-					it.second.mModelMatrix = model;
+					model = math::rotate(instance.mTransform.mRotation, model);
+					model = math::scale(instance.mTransform.mScale, model);
+					model = math::translate(instance.mTransform.mTranslate, model);
+					instance.mModelMatrix = model;
 				}
 				m_renderInstanceList.resize(m_instanceList.size());
 				int i = 0;
-				for (auto& it : m_instanceList)
-					m_renderInstanceList[i++] = it.first;
+				for (auto it = m_instanceList.begin(); it != m_instanceList.end(); ++it)
+					m_renderInstanceList[i++] = it.key();
 			}
 			virtual core::ArrayList<int> getInstanceList() override
 			{
@@ -108,8 +108,9 @@ namespace CraftEngine
 					auto G = params[6];
 					auto H = params[7];
 					auto I = params[8];
-					auto chi = vec4(1.0f + cos_gamma * cos_gamma) / math::pow(H * H + 1.0f - 2.0f * cos_gamma * H, vec4(1.5f));
-					return (A.xyz * (math::exp(B.xyz / (cos_theta + 0.01f))) + 1.0f) * ((C + D * (exp(E * gamma)) + F * (cos_gamma * cos_gamma) + G * chi + I * sqrt(math::max(cos_theta, 0.0f)))).xyz;
+					// evaluated per sky sample, so use the polynomial exp/pow (relative error below 1e-6)
+					auto chi = vec4(1.0f + cos_gamma * cos_gamma) / math::fast::pow(H * H + 1.0f - 2.0f * cos_gamma * H, vec4(1.5f));
+					return (A.xyz * (math::fast::exp(B.xyz / (cos_theta + 0.01f))) + 1.0f) * ((C + D * (math::fast::exp(E * gamma)) + F * (cos_gamma * cos_gamma) + G * chi + I * sqrt(math::max(cos_theta, 0.0f)))).xyz;
 				}
 
 			};
@@ -7,6 +7,7 @@
 #include "../core/Core.h"
 #include "../core/Bitmap.h"
 #include "../math/LinearMath.h"
+#include <future>
 
 
 #define CRAFT_ENGINE_GUI_API CRAFT_ENGINE_INLINE
@@ -199,97 +200,286 @@ namespace CraftEngine
 		bool KeyBoard::m_keyIsDown[256] = { };
 
 
+		/*
+		 Hierarchical timing wheel on a 1 ms steady_clock tick. Four levels of 64 slots cover about
+		 4.6 hours; a later deadline waits in the last level and is placed again when that level
+		 turns. Start and cancel (re)link a pooled node in an intrusive slot list in O(1), and
+		 step() jumps over empty slots. Callbacks run after the wheel has advanced, so they may
+		 start, pause or remove any timer, including their own.
+
+		 getOne(ms, times, ...) fires the callback times times, every ms / times, then removes the
+		 timer and clears the handle. times == 0 repeats every ms until the timer is removed. The
+		 callback receives the milliseconds since the (re)start and ms.
+		*/
 		class SyncTimerSystem
 		{
 		private:
-			class TimerInfo
+			static constexpr uint32_t kWheelBits = 6;
+			static constexpr uint32_t kWheelSize = 1 << kWheelBits;
+			static constexpr uint32_t kWheelLevels = 4;
+			static constexpr uint32_t kNodeBlockSize = 64;
+
+			struct TimerInfo
 			{
-			private:
-				friend class SyncTimerSystem;
+				enum State { eIdle, eScheduled, eFiring, eFree };
 				float m_ms;
-				float m_acc_ms;
+				uint64_t m_period;     // ticks between two executions
+				uint64_t m_start;      // tick of the last start / restart
+				uint64_t m_expiry;
 				uint32_t m_execution_times;
 				uint32_t m_max_execution_times;
+				uint32_t m_generation; // bumped on free, stale batch entries are skipped
+				State m_state;
+				uint32_t m_level, m_slot;
+				TimerInfo* m_next;     // slot list or free list
+				TimerInfo** m_ppPrev;  // the pointer that points at this node while scheduled
 				TimerInfo** m_ppThis;
 				CraftEngine::core::Callback<void(float, float)> m_callback;
-				bool m_enable;
-			public:
-				TimerInfo(float ms, uint32_t max_times, CraftEngine::core::Callback<void(float, float)> callback, TimerInfo** ppDest)
-					:m_ms(ms), m_acc_ms(0), m_max_execution_times(max_times), m_execution_times(0), m_ppThis(ppDest), m_callback(callback), m_enable(false) {}
+			};
 
-				void start() { m_acc_ms = 0; m_execution_times = 0; m_enable = true; }
-				void pause() { m_enable = false; }
-				void restart() { m_acc_ms = 0; m_execution_times = 0; m_enable = true; }
+			struct Expired
+			{
+				TimerInfo* timer;
+				uint32_t generation;
 			};
 		public:
 			craft_engine_make_handle(TimerHandle);
 
+			SyncTimerSystem() : m_origin(std::chrono::steady_clock::now())
+			{
+				for (auto& level : m_slots)
+					for (auto& slot : level)
+						slot = nullptr;
+				for (auto& bits : m_occupied)
+					bits = 0;
+			}
 
 			void getOne(float ms, uint32_t times, CraftEngine::core::Callback<void(float, float)> callback, TimerHandle* ppDest)
 			{
 				assert(ppDest != nullptr);
-				auto pTimer = new TimerInfo(ms, times, callback, (TimerInfo**)ppDest);
-				m_timerList.push_back(pTimer);
+				TimerInfo* pTimer = _Alloc_Node();
+				pTimer->m_ms = ms;
+				pTimer->m_max_execution_times = times;
+				pTimer->m_execution_times = 0;
+				pTimer->m_period = std::max<uint64_t>(1, uint64_t(std::ceil(times > 1 ? ms / times : ms)));
+				pTimer->m_state = TimerInfo::eIdle;
+				pTimer->m_ppThis = (TimerInfo**)ppDest;
+				pTimer->m_callback = callback;
 				*((TimerInfo**)(ppDest)) = pTimer;
 			}
 			void startOne(TimerHandle timer)
 			{
 				if (timer != nullptr)
-					((TimerInfo*)(void*)timer)->start();
+					_Schedule((TimerInfo*)(void*)timer);
 			}
 			void restartOne(TimerHandle timer)
 			{
 				if (timer != nullptr)
-					((TimerInfo*)(void*)timer)->restart();
+					_Schedule((TimerInfo*)(void*)timer);
 			}
 			void pauseOne(TimerHandle timer)
 			{
 				if (timer != nullptr)
-					((TimerInfo*)(void*)timer)->pause();
+				{
+					TimerInfo* pTimer = (TimerInfo*)(void*)timer;
+					_Unlink(pTimer);
+					pTimer->m_state = TimerInfo::eIdle;
+				}
 			}
 			void removeOne(TimerHandle pDest)
 			{
 				TimerInfo* pTimer = (TimerInfo*)(void*)pDest;
 				TimerInfo** ppTimer = pTimer->m_ppThis;
-				m_timerList.remove(pTimer);
+				_Unlink(pTimer);
 				*ppTimer = nullptr;
-				delete pTimer;
+				_Free_Node(pTimer);
+			}
+
+			uint32_t getTimerCount() const
+			{
+				return m_timerCount;
 			}
 
 			void step()
 			{
 				if (m_mutex.try_lock())
 				{
-					auto system_cur_time_point = std::chrono::system_clock::now();
-					long long duration_us = std::chrono::duration_cast<std::chrono::nanoseconds>(system_cur_time_point - m_curTimePoint).count();
-					m_curTimePoint = system_cur_time_point;
-					float duration_ms = duration_us / 1000000.0;
+					uint64_t now = _Current_Tick();
+					_Advance(now);
+					for (size_t i = 0; i < m_expired.size(); i++)
+					{
+						TimerInfo* timer = m_expired[i].timer;
+						if (timer->m_generation != m_expired[i].generation || timer->m_state != TimerInfo::eFiring)
+							continue;
+						timer->m_execution_times++;
+						timer->m_callback.call(float(now - timer->m_start), timer->m_ms);
+						// the callback may have paused, restarted or removed the timer
+						if (timer->m_generation != m_expired[i].generation || timer->m_state != TimerInfo::eFiring)
+							continue;
+						if (timer->m_max_execution_times != 0 && timer->m_execution_times >= timer->m_max_execution_times)
+							removeOne(TimerHandle(timer));
+						else
+						{
+							timer->m_expiry += timer->m_period;
+							_Insert(timer);
+						}
+					}
+					m_expired.clear();
+					m_mutex.unlock();
+				}
+			}
+		private:
 
-					std::list<TimerInfo*> removeList;
-					for (auto timer : m_timerList)
+			uint64_t _Current_Tick() const
+			{
+				auto elapsed = std::chrono::steady_clock::now() - m_origin;
+				return uint64_t(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count());
+			}
+
+			static uint32_t _Lowest_Bit(uint64_t mask)
+			{
+#if defined(_MSC_VER)
+				unsigned long index;
+				_BitScanForward64(&index, mask);
+				return index;
+#else
+				return __builtin_ctzll(mask);
+#endif
+			}
+
+			TimerInfo* _Alloc_Node()
+			{
+				if (m_freeList == nullptr)
+				{
+					m_blocks.emplace_back(new TimerInfo[kNodeBlockSize]);
+					for (uint32_t i = 0; i < kNodeBlockSize; i++)
 					{
-						if (timer->m_enable)
+						m_blocks.back()[i].m_generation = 0;
+						m_blocks.back()[i].m_state = TimerInfo::eFree;
+						m_blocks.back()[i].m_next = m_freeList;
+						m_freeList = &m_blocks.back()[i];
+					}
+				}
+				TimerInfo* pTimer = m_freeList;
+				m_freeList = pTimer->m_next;
+				m_timerCount++;
+				return pTimer;
+			}
+
+			void _Free_Node(TimerInfo* pTimer)
+			{
+				pTimer->m_callback = CraftEngine::core::Callback<void(float, float)>();
+				pTimer->m_generation++;
+				pTimer->m_state = TimerInfo::eFree;
+				pTimer->m_next = m_freeList;
+				m_freeList = pTimer;
+				m_timerCount--;
+			}
+
+			void _Schedule(TimerInfo* pTimer)
+			{
+				_Unlink(pTimer);
+				pTimer->m_start = _Current_Tick();
+				pTimer->m_expiry = pTimer->m_start + pTimer->m_period;
+				pTimer->m_execution_times = 0;
+				_Insert(pTimer);
+			}
+
+			void _Insert(TimerInfo* pTimer)
+			{
+				uint64_t at = std::max(pTimer->m_expiry, m_now);
+				uint64_t delta = at - m_now;
+				uint32_t level = 0;
+				while (level < kWheelLevels - 1 && delta >= (uint64_t(1) << (kWheelBits * (level + 1))))
+					level++;
+				if (delta >= (uint64_t(1) << (kWheelBits * kWheelLevels)))
+					at = m_now + (uint64_t(1) << (kWheelBits * kWheelLevels)) - 1;
+				uint32_t slot = uint32_t(at >> (kWheelBits * level)) & (kWheelSize - 1);
+
+				TimerInfo*& head = m_slots[level][slot];
+				pTimer->m_next = head;
+				if (head != nullptr)
+					head->m_ppPrev = &pTimer->m_next;
+				pTimer->m_ppPrev = &head;
+				head = pTimer;
+				pTimer->m_level = level;
+				pTimer->m_slot = slot;
+				pTimer->m_state = TimerInfo::eScheduled;
+				m_occupied[level] |= uint64_t(1) << slot;
+			}
+
+			void _Unlink(TimerInfo* pTimer)
+			{
+				if (pTimer->m_state != TimerInfo::eScheduled)
+					return;
+				*pTimer->m_ppPrev = pTimer->m_next;
+				if (pTimer->m_next != nullptr)
+					pTimer->m_next->m_ppPrev = pTimer->m_ppPrev;
+				if (m_slots[pTimer->m_level][pTimer->m_slot] == nullptr)
+					m_occupied[pTimer->m_level] &= ~(uint64_t(1) << pTimer->m_slot);
+				pTimer->m_state = TimerInfo::eIdle;
+			}
+
+			TimerInfo* _Take_Slot(uint32_t level, uint32_t slot)
+			{
+				TimerInfo* list = m_slots[level][slot];
+				m_slots[level][slot] = nullptr;
+				m_occupied[level] &= ~(uint64_t(1) << slot);
+				return list;
+			}
+
+			// moves every timer due at or before tick into m_expired
+			void _Advance(uint64_t tick)
+			{
+				while (m_now <= tick)
+				{
+					uint32_t index = uint32_t(m_now) & (kWheelSize - 1);
+					if (index == 0)
+					{
+						// a higher level slot turns over into the levels below it
+						for (uint32_t level = 1; level < kWheelLevels; level++)
 						{
-							timer->m_acc_ms += duration_ms;
-							float dest_time_point = timer->m_ms * (1 + timer->m_execution_times) / timer->m_max_execution_times;
-							if (timer->m_acc_ms > dest_time_point)
+							uint32_t slot = uint32_t(m_now >> (kWheelBits * level)) & (kWheelSize - 1);
+							for (TimerInfo* pTimer = _Take_Slot(level, slot); pTimer != nullptr;)
 							{
-								timer->m_callback.call(timer->m_acc_ms, timer->m_ms);
-								removeList.push_back(timer);
+								TimerInfo* next = pTimer->m_next;
+								_Insert(pTimer);
+								pTimer = next;
 							}
+							if (slot != 0)
+								break;
 						}
 					}
-					for (auto timer : removeList)
+					uint64_t pending = m_occupied[0] >> index;
+					if (pending == 0)
 					{
-						removeOne(TimerHandle(timer));
+						m_now = std::min((m_now | (kWheelSize - 1)) + 1, tick + 1);
+						continue;
 					}
-					m_mutex.unlock();
+					uint64_t due = m_now + _Lowest_Bit(pending);
+					if (due > tick)
+					{
+						m_now = tick + 1;
+						break;
+					}
+					for (TimerInfo* pTimer = _Take_Slot(0, uint32_t(due) & (kWheelSize - 1)); pTimer != nullptr; pTimer = pTimer->m_next)
+					{
+						pTimer->m_state = TimerInfo::eFiring;
+						m_expired.push_back({ pTimer, pTimer->m_generation });
+					}
+					m_now = due + 1;
 				}
 			}
-		private:
+
 			std::mutex m_mutex;
-			std::chrono::system_clock::time_point m_curTimePoint;
-			std::list<TimerInfo*> m_timerList;
+			std::chrono::steady_clock::time_point m_origin;
+			uint64_t m_now = 0; // the next tick to process
+			TimerInfo* m_slots[kWheelLevels][kWheelSize];
+			uint64_t m_occupied[kWheelLevels];
+			std::vector<Expired> m_expired;
+			std::vector<std::unique_ptr<TimerInfo[]>> m_blocks;
+			TimerInfo* m_freeList = nullptr;
+			uint32_t m_timerCount = 0;
 		};
 
 
@@ -302,6 +492,12 @@ namespace CraftEngine
 			uint32_t m_maxExecution = 1;
 			SyncTimerSystem* m_timer_sys = nullptr;
 		public:
+			~Timer()
+			{
+				if (isValid())
+					m_timer_sys->removeOne(m_handle);
+			}
+
 			void setCallback(CraftEngine::core::Callback<void(float, float)> callback)
 			{
 				m_callback = callback;
@@ -338,6 +534,7 @@ namespace CraftEngine
 					m_timer_sys->restartOne(m_handle);
 					return true;
 				}
+				return false;
 			}
 
 			bool stopTimer(SyncTimerSystem* timer_sys)
@@ -369,97 +566,392 @@ namespace CraftEngine
 		};
 
 
+		/*
+		 TaskManager runs async work on its own worker threads and hands the results back to the UI
+		 thread, which drains them in solvingSync() within a per-frame time budget.
+		 - Two lanes: interactive work is always picked first, background work (thumbnails, imports)
+		   only starts while at least two workers are idle, so one is always left for interactive
+		   tasks. A single worker manager cannot keep one free and runs background work when idle.
+		 - A task is a chain of stages, each either async (worker) or sync (UI thread), sharing one
+		   core::Any and one CancelToken. AtomicTask is the classic async-then-sync pair.
+		 - Finished stages are pushed to a lock-free MPSC queue that only the UI thread consumes.
+		 - Nothing is dropped: addTask only fails after the manager started shutting down.
+		*/
 		class TaskManager
 		{
 		public:
+			enum Priority
+			{
+				ePriority_Interactive,
+				ePriority_Background,
+			};
+
+			class CancelToken
+			{
+			public:
+				CancelToken() :m_flag(std::make_shared<std::atomic<bool>>(false)) {}
+				void cancel() { m_flag->store(true, std::memory_order_relaxed); }
+				bool isCancelled() const { return m_flag->load(std::memory_order_relaxed); }
+			private:
+				std::shared_ptr<std::atomic<bool>> m_flag;
+			};
+
 			struct AtomicTask
 			{
 				std::function<void(core::Any& data)> mAsyncTask;
 				std::function<void(core::Any& data)> mSyncTask;
 				core::Any mResult;
+				Priority mPriority = ePriority_Interactive;
+				CancelToken mToken;
 			};
-			
+
+		private:
+			struct Job;
+
+		public:
+			/*
+			 Builds a continuation chain: manager.chain(ePriority_Background).async(load).sync(show).async(...).submit();
+			*/
+			class TaskChain
+			{
+			public:
+				TaskChain& async(std::function<void(core::Any& data)>&& task) { m_job->mStages.push_back({ std::move(task), false }); return *this; }
+				TaskChain& sync(std::function<void(core::Any& data)>&& task) { m_job->mStages.push_back({ std::move(task), true }); return *this; }
+				TaskChain& token(const CancelToken& token) { m_job->mToken = token; return *this; }
+				const CancelToken& token() const { return m_job->mToken; }
+
+				bool submit()
+				{
+					if (m_job == nullptr)
+						return false;
+					return m_manager->_Submit(m_job.release());
+				}
+			private:
+				friend class TaskManager;
+				TaskChain(TaskManager* manager, Priority priority) :m_manager(manager), m_job(new Job)
+				{
+					m_job->mPriority = priority;
+				}
+				TaskManager* m_manager;
+				std::unique_ptr<Job> m_job;
+			};
+
+			explicit TaskManager(uint32_t workerCount = 0)
+			{
+				m_stub.mNext.store(nullptr, std::memory_order_relaxed);
+				m_head.store(&m_stub, std::memory_order_relaxed);
+				m_tail = &m_stub;
+				if (workerCount == 0)
+					workerCount = std::max(1u, std::min(4u, std::thread::hardware_concurrency() / 2));
+				m_workerCount = workerCount;
+			}
+
+			~TaskManager()
+			{
+				{
+					std::lock_guard<std::mutex> lock(m_laneMutex);
+					m_stopping = true;
+				}
+				m_laneCondition.notify_all();
+				for (auto& worker : m_workers)
+					worker.join();
+				_Clear_Lanes();
+				_Clear_Completions();
+			}
+
+			TaskChain chain(Priority priority = ePriority_Interactive)
+			{
+				return TaskChain(this, priority);
+			}
+
 			bool addTask(AtomicTask&& task)
 			{
-				std::lock_guard<std::mutex> lock(m_asyncMutex);
-				if (m_asyncTasks.size() > 1000)
-					return false;
-				m_asyncTasks.emplace(task);
-				return true;
+				auto job = new Job;
+				job->mPriority = task.mPriority;
+				job->mToken = task.mToken;
+				job->mResult = std::move(task.mResult);
+				if (task.mAsyncTask)
+					job->mStages.push_back({ std::move(task.mAsyncTask), false });
+				if (task.mSyncTask)
+					job->mStages.push_back({ std::move(task.mSyncTask), true });
+				return _Submit(job);
+			}
+
+			// cancel the task through a token created beforehand and passed in
+			bool addTask(std::function<void(core::Any& data)>&& async, std::function<void(core::Any& data)>&& sync, Priority priority = ePriority_Interactive, const CancelToken& token = CancelToken())
+			{
+				AtomicTask task;
+				task.mAsyncTask = std::move(async);
+				task.mSyncTask = std::move(sync);
+				task.mPriority = priority;
+				task.mToken = token;
+				return addTask(std::move(task));
 			}
 
+			/*
+			 Runs queued async stages on the calling thread; the workers keep running regardless.
+			*/
 			void solvingAsync(int32_t maxTask = -1)
 			{
-				const int maxTaskCount = maxTask;
-				int curTaskCount = 0;
-				while (1)
+				for (int32_t i = 0; maxTask < 0 || i < maxTask; i++)
 				{
-					if (maxTaskCount > 0 && curTaskCount >= maxTaskCount)
+					Job* job;
+					{
+						std::lock_guard<std::mutex> lock(m_laneMutex);
+						job = _Pick_Job();
+					}
+					if (job == nullptr)
 						return;
-					AtomicTask task;
+					_Run_Async(job);
+				}
+			}
+
+			/*
+			 Runs finished stages on the UI thread until the queue is empty, maxTask stages ran, or
+			 the sync budget is used up. At least one stage runs per call so the queue always drains.
+			*/
+			void solvingSync(int32_t maxTask = -1)
+			{
+				auto start = std::chrono::steady_clock::now();
+				const auto budget = std::chrono::microseconds(m_syncBudget);
+				for (int32_t i = 0; maxTask < 0 || i < maxTask; i++)
+				{
+					if (i > 0 && m_syncBudget > 0 && std::chrono::steady_clock::now() - start >= budget)
+						return;
+					Job* job = _Pop_Completion();
+					if (job == nullptr)
+						return;
+					m_pendingSync.fetch_sub(1, std::memory_order_relaxed);
+					if (job->mToken.isCancelled())
 					{
-						std::lock_guard<std::mutex> lock(m_asyncMutex);
-						if (m_asyncTasks.size() == 0)
-							return;
-						std::swap(task.mAsyncTask, m_asyncTasks.front().mAsyncTask);
-						std::swap(task.mSyncTask, m_asyncTasks.front().mSyncTask);
-						m_asyncTasks.pop();
+						_Finish(job);
+						continue;
+					}
+					job->mStages[job->mStage++].mTask(job->mResult);
+					_Dispatch(job);
+				}
+			}
+
+			void clearAllTask()
+			{
+				_Clear_Lanes();
+				_Clear_Completions();
+			}
+
+			// Microseconds of sync work per solvingSync() call, 0 disables the budget.
+			void setSyncBudget(uint32_t microseconds) { m_syncBudget = microseconds; }
+			uint32_t getSyncBudget() const { return m_syncBudget; }
+
+			uint32_t getWorkerCount() const { return m_workerCount; }
+			// Tasks submitted and not yet finished or cancelled, including stages waiting for the UI thread.
+			uint32_t getPendingCount() const { return m_pendingJobs.load(std::memory_order_relaxed); }
+			// Stages waiting for the next solvingSync().
+			uint32_t getPendingSyncCount() const { return m_pendingSync.load(std::memory_order_relaxed); }
+
+		private:
+			struct Stage
+			{
+				std::function<void(core::Any& data)> mTask;
+				bool mSync;
+			};
+
+			struct Job
+			{
+				std::atomic<Job*> mNext{ nullptr };
+				std::vector<Stage> mStages;
+				uint32_t mStage = 0;
+				Priority mPriority = ePriority_Interactive;
+				CancelToken mToken;
+				core::Any mResult;
+			};
+
+			bool _Submit(Job* job)
+			{
+				{
+					std::lock_guard<std::mutex> lock(m_laneMutex);
+					if (m_stopping)
+					{
+						delete job;
+						return false;
 					}
-					task.mAsyncTask(task.mResult);
+					if (m_workers.size() == 0)
 					{
-						std::lock_guard<std::mutex> lock(m_syncMutex);
-						m_syncTasks.emplace(task);
+						for (uint32_t i = 0; i < m_workerCount; i++)
+							m_workers.emplace_back(&TaskManager::_Worker_Loop, this);
 					}
 				}
+				m_pendingJobs.fetch_add(1, std::memory_order_relaxed);
+				_Dispatch(job);
+				return true;
 			}
 
+			// Sends the job to the lane or queue of its next stage, or retires it.
+			void _Dispatch(Job* job)
+			{
+				if (job->mStage >= job->mStages.size() || job->mToken.isCancelled())
+				{
+					_Finish(job);
+					return;
+				}
+				if (job->mStages[job->mStage].mSync)
+				{
+					_Push_Completion(job);
+					return;
+				}
+				{
+					std::lock_guard<std::mutex> lock(m_laneMutex);
+					m_lanes[job->mPriority].push_back(job);
+				}
+				m_laneCondition.notify_one();
+			}
 
-			void solvingSync(int32_t maxTask = -1)
+			void _Finish(Job* job)
+			{
+				m_pendingJobs.fetch_sub(1, std::memory_order_relaxed);
+				delete job;
+			}
+
+			// Requires m_laneMutex. Background jobs leave one worker free for interactive work.
+			Job* _Pick_Job()
 			{
-				const int maxTaskCount = maxTask;
-				int curTaskCount = 0;
-				std::queue<AtomicTask> syncTasks;
-				if (maxTask < 0)
+				Job* job = nullptr;
+				if (!m_lanes[ePriority_Interactive].empty())
 				{
-					std::lock_guard<std::mutex> lock(m_syncMutex);
-					syncTasks.swap(m_syncTasks);
+					job = m_lanes[ePriority_Interactive].front();
+					m_lanes[ePriority_Interactive].pop_front();
 				}
-				else
+				else if (!m_lanes[ePriority_Background].empty() &&
+					(m_runningJobs + 2 <= m_workerCount || (m_workerCount == 1 && m_runningJobs == 0)))
+				{
+					job = m_lanes[ePriority_Background].front();
+					m_lanes[ePriority_Background].pop_front();
+				}
+				if (job != nullptr)
+					m_runningJobs++;
+				return job;
+			}
+
+			void _Run_Async(Job* job)
+			{
+				if (!job->mToken.isCancelled())
+				{
+					while (job->mStage < job->mStages.size() && !job->mStages[job->mStage].mSync)
+					{
+						job->mStages[job->mStage++].mTask(job->mResult);
+						if (job->mToken.isCancelled())
+							break;
+					}
+				}
+				bool background_waiting;
 				{
-					std::lock_guard<std::mutex> lock(m_syncMutex);
-					for (int i = 0; i < maxTaskCount && m_syncTasks.size() > 0; i++)
+					std::lock_guard<std::mutex> lock(m_laneMutex);
+					m_runningJobs--;
+					background_waiting = !m_lanes[ePriority_Background].empty();
+				}
+				// the freed worker may let a waiting background job start
+				if (background_waiting)
+					m_laneCondition.notify_one();
+				_Dispatch(job);
+			}
+
+			void _Worker_Loop()
+			{
+				while (true)
+				{
+					Job* job = nullptr;
 					{
-						syncTasks.emplace(m_syncTasks.front());
-						m_syncTasks.pop();
+						std::unique_lock<std::mutex> lock(m_laneMutex);
+						m_laneCondition.wait(lock, [&]() { return m_stopping || (job = _Pick_Job()) != nullptr; });
+						if (job == nullptr)
+							return;
 					}
+					_Run_Async(job);
 				}
-				for (int i = 0; i < syncTasks.size(); i++)
+			}
+
+			void _Clear_Lanes()
+			{
+				std::deque<Job*> lanes[2];
+				{
+					std::lock_guard<std::mutex> lock(m_laneMutex);
+					lanes[0].swap(m_lanes[0]);
+					lanes[1].swap(m_lanes[1]);
+				}
+				for (auto& lane : lanes)
+					for (auto job : lane)
+						_Finish(job);
+			}
+
+			// Consumer side, UI thread only.
+			void _Clear_Completions()
+			{
+				while (Job* job = _Pop_Completion())
 				{
-					syncTasks.front().mSyncTask(syncTasks.front().mResult);
-					syncTasks.pop();
+					m_pendingSync.fetch_sub(1, std::memory_order_relaxed);
+					_Finish(job);
 				}
 			}
 
+			// Intrusive MPSC queue (Vyukov): producers exchange the head, the UI thread pops from the tail.
+			void _Push_Completion(Job* job)
+			{
+				m_pendingSync.fetch_add(1, std::memory_order_relaxed);
+				job->mNext.store(nullptr, std::memory_order_relaxed);
+				Job* prev = m_head.exchange(job, std::memory_order_acq_rel);
+				prev->mNext.store(job, std::memory_order_release);
+			}
 
-			void clearAllTask()
+			Job* _Pop_Completion()
 			{
+				Job* tail = m_tail;
+				Job* next = tail->mNext.load(std::memory_order_acquire);
+				if (tail == &m_stub)
+				{
+					if (next == nullptr)
+						return nullptr;
+					m_tail = next;
+					tail = next;
+					next = next->mNext.load(std::memory_order_acquire);
+				}
+				if (next != nullptr)
 				{
-					std::lock_guard<std::mutex> lock(m_asyncMutex);
-					while (m_asyncTasks.size() > 0)
-						m_asyncTasks.pop();
+					m_tail = next;
+					return tail;
 				}
+				if (tail != m_head.load(std::memory_order_acquire))
+					return nullptr; // a producer is between exchange and link, pick it up next call
+				_Push_Stub();
+				next = tail->mNext.load(std::memory_order_acquire);
+				if (next != nullptr)
 				{
-					std::lock_guard<std::mutex> lock(m_syncMutex);
-					while (m_syncTasks.size() > 0)
-						m_syncTasks.pop();
+					m_tail = next;
+					return tail;
 				}
+				return nullptr;
 			}
-		
-		private:
-			std::mutex m_asyncMutex;
-			std::mutex m_syncMutex;
-			std::queue<AtomicTask> m_asyncTasks;
-			std::queue<AtomicTask> m_syncTasks;
+
+			void _Push_Stub()
+			{
+				m_stub.mNext.store(nullptr, std::memory_order_relaxed);
+				Job* prev = m_head.exchange(&m_stub, std::memory_order_acq_rel);
+				prev->mNext.store(&m_stub, std::memory_order_release);
+			}
+
+			std::mutex m_laneMutex;
+			std::condition_variable m_laneCondition;
+			std::deque<Job*> m_lanes[2];
+			std::vector<std::thread> m_workers;
+			uint32_t m_workerCount;
+			uint32_t m_runningJobs = 0;
+			bool m_stopping = false;
+
+			Job m_stub;
+			std::atomic<Job*> m_head;
+			Job* m_tail;
+
+			std::atomic<uint32_t> m_pendingJobs{ 0 };
+			std::atomic<uint32_t> m_pendingSync{ 0 };
+			uint32_t m_syncBudget = 4000;
 		};
 
 
@@ -602,6 +1094,11 @@ namespace CraftEngine
 				return m_fontBitmap;
 			}
 
+			core::Bitmap& getSdfImage()
+			{
+				return m_fontBitmap;
+			}
+
 			float fontCount()const { return header.fontCount; }
 			float fontYOffset()const { return header.yOffset; }
 			float fontYHeight()const { return header.yHeight; }
@@ -725,6 +1222,348 @@ namespace CraftEngine
 
 
 
+		/*
+		 CPU side of the shared glyph atlas: square R8 pages packed with shelves. Glyphs are copied in
+		 on first use; when every page is full, the least recently used page that was not touched in
+		 the current frame is wiped and reused. A page's generation changes when it is wiped, so a
+		 Location recorded earlier tells by itself whether the glyph is still there.
+		*/
+		class GlyphAtlas
+		{
+		public:
+			struct Location
+			{
+				int32_t  page = -1;
+				uint16_t x = 0;
+				uint16_t y = 0;
+				uint32_t generation = 0;
+			};
+
+			GlyphAtlas(uint32_t pageSize = 1024, uint32_t maxPages = 4) :m_pageSize(pageSize), m_maxPages(maxPages) {}
+
+			void reset(uint32_t pageSize, uint32_t maxPages)
+			{
+				clear();
+				m_pageSize = pageSize;
+				m_maxPages = maxPages;
+			}
+
+			// page generations keep counting across clear(), a location handed out before never becomes resident again
+			void clear()
+			{
+				m_pages.clear();
+			}
+
+			bool isResident(const Location& location)const
+			{
+				return location.page >= 0 && location.page < (int32_t)m_pages.size() && m_pages[location.page].generation == location.generation;
+			}
+
+			// Reserves width x height pixels, page is -1 when the glyph cannot fit into an empty page.
+			Location allocate(uint32_t width, uint32_t height)
+			{
+				Location location;
+				// one pixel gap to the right and below keeps linear filtering from bleeding
+				uint32_t w = width + 1, h = height + 1;
+				if (w > m_pageSize || h > m_pageSize)
+					return location;
+				// the least recently used page is kept out of gap filling so there is always one to recycle
+				int32_t page = -1;
+				if (m_pages.size() >= m_maxPages)
+				{
+					uint64_t oldest = m_frame;
+					for (int32_t i = 0; i < (int32_t)m_pages.size(); i++)
+						if (m_pages[i].lastUse < oldest)
+						{
+							oldest = m_pages[i].lastUse;
+							page = i;
+						}
+				}
+				for (int32_t i = 0; i < (int32_t)m_pages.size(); i++)
+					if (i != page && _Allocate_In(i, w, h, location))
+						return location;
+				if (page >= 0)
+					_Wipe(page);
+				else
+				{
+					// every page is in use this frame, grow past the limit rather than corrupt the frame
+					page = m_pages.size();
+					m_pages.emplace_back();
+					m_pages.back().pixels.assign(m_pageSize * m_pageSize, 0);
+					m_pages.back().generation = ++m_generation;
+					m_pages.back().dirty = true;
+				}
+				_Allocate_In(page, w, h, location);
+				return location;
+			}
+
+			void touch(int32_t page) { m_pages[page].lastUse = m_frame; }
+			void nextFrame() { m_frame++; }
+			uint64_t frame()const { return m_frame; }
+
+			uint8_t* pixels(int32_t page) { return m_pages[page].pixels.data(); }
+			void markDirty(int32_t page) { m_pages[page].dirty = true; }
+			bool isDirty(int32_t page)const { return m_pages[page].dirty; }
+			void clearDirty(int32_t page) { m_pages[page].dirty = false; }
+			uint32_t generation(int32_t page)const { return m_pages[page].generation; }
+
+			uint32_t pageCount()const { return m_pages.size(); }
+			uint32_t pageSize()const { return m_pageSize; }
+			uint32_t maxPages()const { return m_maxPages; }
+
+		private:
+			struct Shelf
+			{
+				uint32_t y;
+				uint32_t height;
+				uint32_t x;
+			};
+
+			struct Page
+			{
+				std::vector<uint8_t> pixels;
+				std::vector<Shelf> shelves;
+				uint32_t nextY = 0;
+				uint32_t generation = 0;
+				uint64_t lastUse = 0;
+				bool dirty = false;
+			};
+
+			bool _Allocate_In(int32_t index, uint32_t w, uint32_t h, Location& location)
+			{
+				auto& page = m_pages[index];
+				// best fitting shelf that wastes at most a third of its height, else a new shelf
+				Shelf* best = nullptr;
+				for (auto& shelf : page.shelves)
+					if (shelf.height >= h && shelf.x + w <= m_pageSize && shelf.height * 2 <= h * 3 && (best == nullptr || shelf.height < best->height))
+						best = &shelf;
+				if (best == nullptr && page.nextY + h <= m_pageSize)
+				{
+					page.shelves.push_back({ page.nextY, h, 0 });
+					page.nextY += h;
+					best = &page.shelves.back();
+				}
+				if (best == nullptr)
+					for (auto& shelf : page.shelves)
+						if (shelf.height >= h && shelf.x + w <= m_pageSize && (best == nullptr || shelf.height < best->height))
+							best = &shelf;
+				if (best == nullptr)
+					return false;
+				location.page = index;
+				location.x = best->x;
+				location.y = best->y;
+				location.generation = page.generation;
+				best->x += w;
+				page.lastUse = m_frame;
+				return true;
+			}
+
+			void _Wipe(int32_t index)
+			{
+				auto& page = m_pages[index];
+				page.shelves.clear();
+				page.nextY = 0;
+				page.generation = ++m_generation;
+				std::fill(page.pixels.begin(), page.pixels.end(), 0);
+				page.dirty = true;
+			}
+
+			std::vector<Page> m_pages;
+			uint32_t m_pageSize;
+			uint32_t m_maxPages;
+			uint32_t m_generation = 0;
+			uint64_t m_frame = 1;
+		};
+
+
+
+		/*
+		 Measured text runs: for every character the x where it starts, so the width of a run or of
+		 any of its prefixes is a lookup and hit-testing is a binary search. Runs are keyed by their
+		 characters and the font parameters and recycled least recently used first. The font
+		 generation is part of the key, runs measured before a font was replaced are never found again.
+		*/
+		class TextRunCache
+		{
+		public:
+			struct Params
+			{
+				uint32_t fontId;
+				uint32_t generation;
+				float    size;
+				int32_t  interval;
+
+				bool operator==(const Params& right)const {
+					return fontId == right.fontId && generation == right.generation && size == right.size && interval == right.interval;
+				}
+			};
+
+			struct Run
+			{
+				Params               params;
+				std::vector<Char>    chars;
+				std::vector<int32_t> prefix;  // prefix[i]: x where character i starts, prefix[count]: width
+				std::vector<int32_t> advance; // advance[i]: width of character i without the interval
+				bool                 monotonic;
+
+				// Same result as walking the characters: the caret goes before the character whose left
+				// half x falls into and after it for the right half.
+				int32_t pointerIndex(int32_t count, int x)const
+				{
+					if (!monotonic)
+					{
+						// a negative interval makes characters overlap, fall back to the walk
+						int32_t index = 0;
+						for (; index < count; index++)
+						{
+							if (x < prefix[index] + advance[index] / 2)
+								break;
+							if (x < prefix[index] + advance[index])
+								return index + 1;
+						}
+						return index;
+					}
+					auto half = _Lower_Bound(count, [&](int32_t i) { return x < prefix[i] + advance[i] / 2; });
+					auto full = _Lower_Bound(count, [&](int32_t i) { return x < prefix[i] + advance[i]; });
+					return std::min(half, full + 1);
+				}
+			private:
+				template<class Predicate>
+				static int32_t _Lower_Bound(int32_t count, Predicate&& predicate)
+				{
+					int32_t first = 0;
+					while (count > 0)
+					{
+						int32_t step = count / 2;
+						if (!predicate(first + step))
+						{
+							first += step + 1;
+							count -= step + 1;
+						}
+						else
+							count = step;
+					}
+					return first;
+				}
+			};
+
+			TextRunCache(uint32_t maxChars = 1 << 18) :m_maxChars(maxChars) {}
+
+			void setLimit(uint32_t maxChars)
+			{
+				m_maxChars = maxChars;
+				_Trim();
+			}
+
+			void clear()
+			{
+				m_index.clear();
+				m_runs.clear();
+				m_charCount = 0;
+			}
+
+			/*
+			 Returns a run whose first count characters are pStr, measuring them with measure(Char)
+			 on a miss. A prefix of the run used last is answered by that run, so measuring text up to
+			 the caret after measuring the whole line does not shape it again.
+			*/
+			template<class Measure>
+			const Run& find(const Char* pStr, int32_t count, const Params& params, Measure&& measure)
+			{
+				if (!m_runs.empty())
+				{
+					auto& last = m_runs.front();
+					if (last.params == params && count <= (int32_t)last.chars.size() && std::equal(pStr, pStr + count, last.chars.data()))
+					{
+						m_hitCount++;
+						return last;
+					}
+				}
+
+				auto key = _Hash(pStr, count, params);
+				auto it = m_index.find(key);
+				if (it != m_index.end())
+				{
+					auto run = it->second;
+					m_runs.splice(m_runs.begin(), m_runs, run);
+					if (run->params == params && count == (int32_t)run->chars.size() && std::equal(pStr, pStr + count, run->chars.data()))
+					{
+						m_hitCount++;
+						return *run;
+					}
+					// hash collision, the slot is taken over by the new run
+					m_charCount -= run->chars.size();
+				}
+				else
+				{
+					m_runs.emplace_front();
+					m_index[key] = m_runs.begin();
+				}
+				m_missCount++;
+
+				auto& run = m_runs.front();
+				run.params = params;
+				run.chars.assign(pStr, pStr + count);
+				run.prefix.resize(count + 1);
+				run.advance.resize(count);
+				run.monotonic = true;
+				run.prefix[0] = 0;
+				for (int32_t i = 0; i < count; i++)
+				{
+					run.advance[i] = measure(pStr[i]);
+					run.prefix[i + 1] = run.prefix[i] + run.advance[i] + params.interval;
+					if (i > 0 && (run.prefix[i] + run.advance[i] / 2 < run.prefix[i - 1] + run.advance[i - 1] / 2 ||
+						run.prefix[i] + run.advance[i] < run.prefix[i - 1] + run.advance[i - 1]))
+						run.monotonic = false;
+				}
+				m_charCount += count;
+				_Trim();
+				return run;
+			}
+
+			size_t size()const { return m_runs.size(); }
+			size_t charCount()const { return m_charCount; }
+			uint64_t hitCount()const { return m_hitCount; }
+			uint64_t missCount()const { return m_missCount; }
+		private:
+			static uint64_t _Hash(const Char* pStr, int32_t count, const Params& params)
+			{
+				uint64_t hash = 14695981039346656037ull;
+				auto mix = [&hash](uint64_t value) { hash = (hash ^ value) * 1099511628211ull; };
+				uint32_t size_bits;
+				memcpy(&size_bits, &params.size, sizeof(size_bits));
+				mix(params.fontId);
+				mix(params.generation);
+				mix(size_bits);
+				mix((uint32_t)params.interval);
+				mix((uint32_t)count);
+				for (int32_t i = 0; i < count; i++)
+					mix((uint32_t)pStr[i]);
+				return hash;
+			}
+
+			// keeps the run just returned even when it alone exceeds the limit
+			void _Trim()
+			{
+				while (m_charCount > m_maxChars && m_runs.size() > 1)
+				{
+					auto& run = m_runs.back();
+					m_charCount -= run.chars.size();
+					m_index.erase(_Hash(run.chars.data(), run.chars.size(), run.params));
+					m_runs.pop_back();
+				}
+			}
+
+			std::list<Run> m_runs;
+			std::unordered_map<uint64_t, std::list<Run>::iterator> m_index;
+			size_t   m_charCount = 0;
+			uint32_t m_maxChars;
+			uint64_t m_hitCount = 0;
+			uint64_t m_missCount = 0;
+		};
+
+
+
 		class GuiFontSystem
 		{
 		public:
@@ -740,12 +1579,26 @@ namespace CraftEngine
 				float xadvance;
 			};
 
+			// A glyph ready to draw: metrics, the atlas page holding it and its pixel rect there.
+			struct GlyphSlot
+			{
+				const FontUnit* unit;
+				HandleImage     image;
+				Rect            rect;
+				Size            imageSize;
+			};
+
 			enum class FontIndex
 			{
 				eDefault = 0,			
 				eFixedWidth = 31,
 			};
 		private:
+			/*
+			 Glyph metrics live in a two-level table: 256 pages of 256 code points, allocated only for
+			 ranges the font covers. The SDF source image stays on the CPU and glyphs are copied into
+			 the shared atlas when first drawn.
+			*/
 			struct FontInstance
 			{
 				struct FontInfo
@@ -757,36 +1610,108 @@ namespace CraftEngine
 					float yMaxHeight;
 					float scalar;
 				};
-				core::Array<FontUnit, 65535> m_fontUnits;
+				struct Glyph
+				{
+					FontUnit              unit;
+					GlyphAtlas::Location  location;
+				};
+
+				Glyph& find(Char c)
+				{
+					uint32_t code = (uint32_t)c;
+					if (code < 0x10000)
+					{
+						auto& page = m_glyphPages[code >> 8];
+						if (page != nullptr && page[code & 0xFF].unit.id != 0)
+							return page[code & 0xFF];
+					}
+					return *m_fallback;
+				}
+
+				Glyph& insert(uint32_t code)
+				{
+					auto& page = m_glyphPages[code >> 8];
+					if (page == nullptr)
+						page.reset(new Glyph[256]());
+					return page[code & 0xFF];
+				}
+
+				std::unique_ptr<Glyph[]> m_glyphPages[256];
+				Glyph*      m_fallback = &m_missing;
+				Glyph       m_missing = {};
 				FontInfo    m_fontInfo;
-				HandleImage m_fontImage;
+				core::Bitmap m_sourceImage;
 				String      m_name;
 			};
-			static FontInstance* m_instanceList[32];
+			static std::atomic<FontInstance*> m_instanceList[32];
+			static std::mutex m_retiredMutex;
+			static std::vector<FontInstance*> m_retiredList;
+			static GlyphAtlas m_atlas;
+			static std::vector<HandleImage> m_atlasImages;
+			static std::atomic<uint32_t> m_fontGeneration;
+			static std::mutex m_runMutex;
+			static TextRunCache m_runCache;
+
+			// Fonts still loading fall back to the default font.
+			static inline FontInstance* _Instance(uint32_t id)
+			{
+				auto instance = m_instanceList[id].load(std::memory_order_acquire);
+				return instance != nullptr ? instance : m_instanceList[0].load(std::memory_order_acquire);
+			}
+			static inline FontInstance::Glyph& _Resident_Glyph(Char c, uint32_t id);
+			static void _Install(FontFile& font, uint32_t id, bool fromWorker);
+			// Runs shorter than this are cheaper to walk than to look up.
+			static constexpr int32_t m_shortRunLength = 8;
+			// read before the font instance, so a run measured during a reload is keyed as stale
+			static inline TextRunCache::Params _Run_Params(const Font& font)
+			{
+				return { (uint32_t)font.getFontID(), m_fontGeneration.load(std::memory_order_acquire), font.getSize(), (int32_t)font.getInterval() };
+			}
 		public:
-			static void clearAllFont() { for (int i = 0; i < 32; i++) freeFont(i); }
+			static void clearAllFont();
 			static void freeFont(uint32_t id);
 			static void loadFont(const FontFile* font, uint32_t id);
 
 			static core::ArrayList<int> getGlobalFontIDList() { 
 				core::ArrayList<int> list;
 				for (int i = 0; i < 32; i++)
-					if (m_instanceList[i] != nullptr)
+					if (m_instanceList[i].load(std::memory_order_acquire) != nullptr)
 						list.push_back(i);
 				return list;
 			}
 
-			static inline float getGlobalFontScalar(uint32_t id) { return m_instanceList[id]->m_fontInfo.scalar; }
-			static inline float getGlobalFontYOffset(uint32_t id) { return m_instanceList[id]->m_fontInfo.yOffset; }
-			static inline float getGlobalFontYHeight(uint32_t id) { return m_instanceList[id]->m_fontInfo.yHeight; }
-			static inline float getGlobalFontYStandardLineHeight(uint32_t id) { return m_instanceList[id]->m_fontInfo.yLineHeight; }
-			static inline float getGlobalFontYMaxOffset(uint32_t id) { return m_instanceList[id]->m_fontInfo.yMaxOffset; }
-			static inline float getGlobalFontYMaxHeight(uint32_t id) { return m_instanceList[id]->m_fontInfo.yMaxHeight; }
+			static inline float getGlobalFontScalar(uint32_t id) { return _Instance(id)->m_fontInfo.scalar; }
+			static inline float getGlobalFontYOffset(uint32_t id) { return _Instance(id)->m_fontInfo.yOffset; }
+			static inline float getGlobalFontYHeight(uint32_t id) { return _Instance(id)->m_fontInfo.yHeight; }
+			static inline float getGlobalFontYStandardLineHeight(uint32_t id) { return _Instance(id)->m_fontInfo.yLineHeight; }
+			static inline float getGlobalFontYMaxOffset(uint32_t id) { return _Instance(id)->m_fontInfo.yMaxOffset; }
+			static inline float getGlobalFontYMaxHeight(uint32_t id) { return _Instance(id)->m_fontInfo.yMaxHeight; }
 
 			static inline const FontUnit& getGlobalFontUnit(Char idx, int id);
-			static inline HandleImage getGlobalFontImage(int id);
 			static inline float getGlobalFontCharWidth(Char c, int id);
 
+			/*
+			 Glyph atlas, render thread only. prepareGlyphs() makes a run of text resident and uploads
+			 the pages it touched once; getGlobalGlyph() then returns where each glyph is. Call
+			 nextGlyphFrame() once per frame so pages unused in the last frames can be recycled.
+			*/
+			static inline void prepareGlyphs(const Char* pStr, uint32_t count, int id);
+			static inline GlyphSlot getGlobalGlyph(Char idx, int id);
+			static inline void flushGlyphAtlas();
+			static inline void nextGlyphFrame() { m_atlas.nextFrame(); }
+			static inline void setGlyphAtlasLimits(uint32_t pageSize, uint32_t maxPages);
+			static inline const GlyphAtlas& getGlyphAtlas() { return m_atlas; }
+
+			/*
+			 calcFontLineWidth() and calcFontPointerIndex() measure through a cache of text runs
+			 that every font load drops. The limit is the number of characters kept.
+			*/
+			static inline void setTextRunCacheLimit(uint32_t maxChars)
+			{
+				std::lock_guard<std::mutex> lock(m_runMutex);
+				m_runCache.setLimit(maxChars);
+			}
+
 			static inline float calcFontLineOffset(const Font& font)
 			{
 				return (getGlobalFontYOffset(font.getFontID()) + 0.5 *
@@ -815,16 +1740,30 @@ namespace CraftEngine
 			static bool loadFromFile(const char* file, int id) 
 			{ 
 				FontFile f(file);
-				if (f.isLoaded()) loadFont(&f, id);
+				if (f.isLoaded()) _Install(f, id, false);
 				else return false; return true; 
 			}
 			static bool loadFromMemory(const void* data, uint32_t size, int id) 
 			{
 				FontFile f;
 				f.loadFromMemory((uint8_t*)data, size);
-				if (f.isLoaded())loadFont(&f, id);
+				if (f.isLoaded()) _Install(f, id, false);
 				else return false; return true;
 			}
+			/*
+			 Decodes the font file on a worker thread and installs it when done. Until then the id
+			 draws with the default font; a font it replaces is released by clearAllFont().
+			*/
+			static std::future<bool> loadFromFileAsync(const std::string& file, int id)
+			{
+				return std::async(std::launch::async, [file, id]() {
+					FontFile f(file.c_str());
+					if (!f.isLoaded())
+						return false;
+					_Install(f, id, true);
+					return true;
+				});
+			}
 
 			static inline int step_forward(float xadvance, float scalar, int interval)
 			{
@@ -836,7 +1775,14 @@ namespace CraftEngine
 				// return int(xadvance * scalar);
 			}
 		};
-		GuiFontSystem::FontInstance* GuiFontSystem::m_instanceList[32];
+		std::atomic<GuiFontSystem::FontInstance*> GuiFontSystem::m_instanceList[32];
+		std::mutex GuiFontSystem::m_retiredMutex;
+		std::vector<GuiFontSystem::FontInstance*> GuiFontSystem::m_retiredList;
+		GlyphAtlas GuiFontSystem::m_atlas;
+		std::vector<HandleImage> GuiFontSystem::m_atlasImages;
+		std::atomic<uint32_t> GuiFontSystem::m_fontGeneration;
+		std::mutex GuiFontSystem::m_runMutex;
+		TextRunCache GuiFontSystem::m_runCache;
 
 
 
@@ -2579,9 +3525,7 @@ namespace CraftEngine
 			auto& offset = getGlobalBasepoint();
 			float scalar = font.getSize() * GuiFontSystem::getGlobalFontScalar(font.getFontID());
 			int interval = font.getInterval();
-			auto font_image = GuiFontSystem::getGlobalFontImage(font.getFontID());
-			auto font_image_info = GuiRenderSystem::getImageInfo(font_image);
-			checkState(font_image, scissor, 1);
+			GuiFontSystem::prepareGlyphs(pStr, count, font.getFontID());
 			Point cp = point + offset;
 			Vertex vertices[4];
 			vec4 font_texcoord;
@@ -2599,10 +3543,17 @@ namespace CraftEngine
 			vertices[3].col = Color(color.rgb, color.a * getAlpha() / 255);
 			for (int i = 0; i < count; i++)
 			{
-				auto& slot = GuiFontSystem::getGlobalFontUnit(pStr[i], font.getFontID());
+				auto glyph = GuiFontSystem::getGlobalGlyph(pStr[i], font.getFontID());
+				auto& slot = *glyph.unit;
+				if (glyph.image == nullptr)
+				{
+					cp.x += GuiFontSystem::step_forward(slot.xadvance, scalar, interval);
+					continue;
+				}
+				checkState(glyph.image, scissor, 1);
 				font_texcoord = vec4(cp.x + slot.xoffset * scalar, cp.y + slot.yoffset * scalar, slot.width * scalar, slot.height * scalar);
-				image_texcoord = vec4(slot.xcoord / float(font_image_info.mWidth), slot.ycoord / float(font_image_info.mHeight),
-					slot.width / float(font_image_info.mWidth), slot.height / float(font_image_info.mHeight));
+				image_texcoord = vec4(glyph.rect.mX / float(glyph.imageSize.x), glyph.rect.mY / float(glyph.imageSize.y),
+					glyph.rect.mWidth / float(glyph.imageSize.x), glyph.rect.mHeight / float(glyph.imageSize.y));
 				vertices[0].pos = vec2(font_texcoord.xy);
 				vertices[1].pos = vec2(font_texcoord.x + font_texcoord.z, font_texcoord.y);
 				vertices[2].pos = vec2(font_texcoord.x + font_texcoord.z, font_texcoord.y + font_texcoord.w);
@@ -2624,9 +3575,7 @@ namespace CraftEngine
 			auto& offset = getGlobalBasepoint();
 			float scalar = font.getSize() * GuiFontSystem::getGlobalFontScalar(font.getFontID());
 			int interval = font.getInterval();
-			auto font_image = GuiFontSystem::getGlobalFontImage(font.getFontID());
-			auto font_image_info = GuiRenderSystem::getImageInfo(font_image);
-			checkState(font_image, scissor, 1);
+			GuiFontSystem::prepareGlyphs(pStr, count, font.getFontID());
 			Point cp = point + offset;
 			Vertex vertices[4];
 			vec4 font_texcoord;
@@ -2640,10 +3589,17 @@ namespace CraftEngine
 			indices[5] = 0;
 			for (int i = 0; i < count; i++)
 			{
-				auto& slot = GuiFontSystem::getGlobalFontUnit(pStr[i], font.getFontID());
+				auto glyph = GuiFontSystem::getGlobalGlyph(pStr[i], font.getFontID());
+				auto& slot = *glyph.unit;
+				if (glyph.image == nullptr)
+				{
+					cp.x += GuiFontSystem::step_forward(slot.xadvance, scalar, interval);
+					continue;
+				}
+				checkState(glyph.image, scissor, 1);
 				font_texcoord = vec4(cp.x + slot.xoffset * scalar, cp.y + slot.yoffset * scalar, slot.width * scalar, slot.height * scalar);
-				image_texcoord = vec4(slot.xcoord / float(font_image_info.mWidth), slot.ycoord / float(font_image_info.mHeight),
-					slot.width / float(font_image_info.mWidth), slot.height / float(font_image_info.mHeight));
+				image_texcoord = vec4(glyph.rect.mX / float(glyph.imageSize.x), glyph.rect.mY / float(glyph.imageSize.y),
+					glyph.rect.mWidth / float(glyph.imageSize.x), glyph.rect.mHeight / float(glyph.imageSize.y));
 				vertices[0].pos = vec2(font_texcoord.xy);
 				vertices[1].pos = vec2(font_texcoord.x + font_texcoord.z, font_texcoord.y);
 				vertices[2].pos = vec2(font_texcoord.x + font_texcoord.z, font_texcoord.y + font_texcoord.w);
@@ -2670,9 +3626,7 @@ namespace CraftEngine
 			auto& offset = getGlobalBasepoint();
 			float scalar = font.getSize() * GuiFontSystem::getGlobalFontScalar(font.getFontID());
 			int interval = font.getInterval();
-			auto font_image = GuiFontSystem::getGlobalFontImage(font.getFontID());
-			auto font_image_info = GuiRenderSystem::getImageInfo(font_image);
-			checkState(font_image, scissor, 1);
+			GuiFontSystem::prepareGlyphs(pStr, count, font.getFontID());
 			Point cp = point + offset;
 			Vertex vertices[4];
 			vec4 font_texcoord;
@@ -2686,10 +3640,17 @@ namespace CraftEngine
 			indices[5] = 0;
 			for (int i = 0; i < count; i++)
 			{
-				auto& slot = GuiFontSystem::getGlobalFontUnit(pStr[i], font.getFontID());
+				auto glyph = GuiFontSystem::getGlobalGlyph(pStr[i], font.getFontID());
+				auto& slot = *glyph.unit;
+				if (glyph.image == nullptr)
+				{
+					cp.x += GuiFontSystem::step_forward(slot.xadvance, scalar, interval);
+					continue;
+				}
+				checkState(glyph.image, scissor, 1);
 				font_texcoord = vec4(cp.x + slot.xoffset * scalar, cp.y + slot.yoffset * scalar, slot.width * scalar, slot.height * scalar);
-				image_texcoord = vec4(slot.xcoord / float(font_image_info.mWidth), slot.ycoord / float(font_image_info.mHeight),
-					slot.width / float(font_image_info.mWidth), slot.height / float(font_image_info.mHeight));
+				image_texcoord = vec4(glyph.rect.mX / float(glyph.imageSize.x), glyph.rect.mY / float(glyph.imageSize.y),
+					glyph.rect.mWidth / float(glyph.imageSize.x), glyph.rect.mHeight / float(glyph.imageSize.y));
 				vertices[0].pos = vec2(font_texcoord.xy);
 				vertices[1].pos = vec2(font_texcoord.x + font_texcoord.z, font_texcoord.y);
 				vertices[2].pos = vec2(font_texcoord.x + font_texcoord.z, font_texcoord.y + font_texcoord.w);
@@ -4459,76 +5420,197 @@ namespace CraftEngine
 
 
 
+		CRAFT_ENGINE_GUI_API void GuiFontSystem::clearAllFont()
+		{
+			for (int i = 0; i < 32; i++)
+				freeFont(i);
+			{
+				std::lock_guard<std::mutex> lock(m_retiredMutex);
+				for (auto instance : m_retiredList)
+					delete instance;
+				m_retiredList.clear();
+			}
+			for (auto image : m_atlasImages)
+				GuiRenderSystem::deleteImage(image);
+			m_atlasImages.clear();
+			m_atlas.clear();
+			std::lock_guard<std::mutex> lock(m_runMutex);
+			m_runCache.clear();
+		}
+
 		CRAFT_ENGINE_GUI_API void GuiFontSystem::freeFont(uint32_t id)
 		{
-			if (m_instanceList[id] != nullptr)
-			{
-				GuiRenderSystem::deleteImage(m_instanceList[id]->m_fontImage);
-				delete m_instanceList[id];
-				m_instanceList[id] = nullptr;
-			}
+			delete m_instanceList[id].exchange(nullptr, std::memory_order_acq_rel);
+			m_fontGeneration.fetch_add(1, std::memory_order_acq_rel);
 		}
 
 		CRAFT_ENGINE_GUI_API void GuiFontSystem::loadFont(const FontFile* font, uint32_t id)
 		{
-			freeFont(id);
-			m_instanceList[id] = new FontInstance;
-			m_instanceList[id]->m_fontInfo.scalar = 1.0f / font->fontYHeight();
-			m_instanceList[id]->m_fontInfo.yHeight = font->fontYHeight();
-			m_instanceList[id]->m_fontInfo.yLineHeight = font->fontYLineHeight();
-			m_instanceList[id]->m_fontInfo.yMaxHeight = font->fontYMaxHeight();
-			m_instanceList[id]->m_fontInfo.yMaxOffset = font->fontYMaxOffset();
-			m_instanceList[id]->m_fontInfo.yOffset = font->fontYOffset();
-			memset(m_instanceList[id]->m_fontUnits.data(), 0, sizeof(m_instanceList[id]->m_fontUnits));
-
-			auto pfont_units = m_instanceList[id]->m_fontUnits.data();
-			for (int i = 0; i < font->fontCount(); i++)
-			{
-				pfont_units[font->fontUnits()[i].id].id = font->fontUnits()[i].id;
-				pfont_units[font->fontUnits()[i].id].xcoord = font->fontUnits()[i].xcoord;
-				pfont_units[font->fontUnits()[i].id].ycoord = font->fontUnits()[i].ycoord;
-				pfont_units[font->fontUnits()[i].id].width = font->fontUnits()[i].width;
-				pfont_units[font->fontUnits()[i].id].height = font->fontUnits()[i].height;
-				pfont_units[font->fontUnits()[i].id].xoffset = font->fontUnits()[i].xoffset;
-				pfont_units[font->fontUnits()[i].id].yoffset = font->fontUnits()[i].yoffset;
-				pfont_units[font->fontUnits()[i].id].xadvance = font->fontUnits()[i].xadvance;
-			}
-			for (int i = 1; i < 65535; i++)
-				if (pfont_units[i].id == 0)
-					pfont_units[i] = pfont_units[L'?'];
-
-			pfont_units['\t'] = pfont_units[' '];
-			pfont_units['\t'].xadvance = pfont_units['\t'].xadvance * 4;
-			pfont_units['\t'].width = pfont_units['\t'].width * 4;
-			pfont_units['\t'].id = '\t';
-
-			auto& fontBitmap = font->getSdfImage();
-			m_instanceList[id]->m_fontImage = GuiRenderSystem::createImage(fontBitmap.data(), fontBitmap.size(), fontBitmap.width(), fontBitmap.height());
+			FontFile copy = *font;
+			_Install(copy, id, false);
 		}
 
-		CRAFT_ENGINE_GUI_API const GuiFontSystem::FontUnit& GuiFontSystem::getGlobalFontUnit(Char idx, int id)
+		CRAFT_ENGINE_GUI_API void GuiFontSystem::_Install(FontFile& font, uint32_t id, bool fromWorker)
 		{
-			return m_instanceList[id]->m_fontUnits[idx];
+			auto instance = new FontInstance;
+			instance->m_fontInfo.scalar = 1.0f / font.fontYHeight();
+			instance->m_fontInfo.yHeight = font.fontYHeight();
+			instance->m_fontInfo.yLineHeight = font.fontYLineHeight();
+			instance->m_fontInfo.yMaxHeight = font.fontYMaxHeight();
+			instance->m_fontInfo.yMaxOffset = font.fontYMaxOffset();
+			instance->m_fontInfo.yOffset = font.fontYOffset();
+
+			for (int i = 0; i < font.fontCount(); i++)
+			{
+				auto& unit = font.fontUnits()[i];
+				if (unit.id <= 0 || unit.id >= 0x10000)
+					continue;
+				auto& glyph = instance->insert(unit.id);
+				glyph.unit.id = unit.id;
+				glyph.unit.xcoord = unit.xcoord;
+				glyph.unit.ycoord = unit.ycoord;
+				glyph.unit.width = unit.width;
+				glyph.unit.height = unit.height;
+				glyph.unit.xoffset = unit.xoffset;
+				glyph.unit.yoffset = unit.yoffset;
+				glyph.unit.xadvance = unit.xadvance;
+			}
+			// missing code points draw as '?'
+			auto& question = instance->find(L'?');
+			if (question.unit.id == L'?')
+				instance->m_fallback = &question;
+
+			auto& space = instance->find(L' ');
+			auto& tab = instance->insert('\t');
+			tab.unit = space.unit;
+			tab.unit.xadvance = tab.unit.xadvance * 4;
+			tab.unit.width = tab.unit.width * 4;
+			tab.unit.id = '\t';
+
+			instance->m_sourceImage = std::move(font.getSdfImage());
+
+			auto old = m_instanceList[id].exchange(instance, std::memory_order_acq_rel);
+			// a new font may also stand in for ids still falling back to the default font
+			m_fontGeneration.fetch_add(1, std::memory_order_acq_rel);
+			if (old != nullptr)
+			{
+				// the render thread may still be reading a font replaced from a worker
+				if (fromWorker)
+				{
+					std::lock_guard<std::mutex> lock(m_retiredMutex);
+					m_retiredList.push_back(old);
+				}
+				else
+					delete old;
+			}
 		}
-		CRAFT_ENGINE_GUI_API HandleImage GuiFontSystem::getGlobalFontImage(int id)
+
+		CRAFT_ENGINE_GUI_API const GuiFontSystem::FontUnit& GuiFontSystem::getGlobalFontUnit(Char idx, int id)
 		{
-			return m_instanceList[id]->m_fontImage;
+			return _Instance(id)->find(idx).unit;
 		}
 		CRAFT_ENGINE_GUI_API float GuiFontSystem::getGlobalFontCharWidth(Char c, int id)
 		{
-			return m_instanceList[id]->m_fontUnits[c].xadvance;
+			return _Instance(id)->find(c).unit.xadvance;
+		}
+
+		CRAFT_ENGINE_GUI_API GuiFontSystem::FontInstance::Glyph& GuiFontSystem::_Resident_Glyph(Char c, uint32_t id)
+		{
+			auto instance = _Instance(id);
+			auto& glyph = instance->find(c);
+			auto& unit = glyph.unit;
+			if (unit.width <= 0 || unit.height <= 0)
+				return glyph;
+			if (!m_atlas.isResident(glyph.location))
+			{
+				auto location = m_atlas.allocate(unit.width, unit.height);
+				if (location.page < 0)
+					return glyph;
+				auto& source = instance->m_sourceImage;
+				uint8_t* dst = m_atlas.pixels(location.page);
+				const uint8_t* src = (const uint8_t*)source.data();
+				const int32_t page_size = m_atlas.pageSize();
+				const int32_t x0 = math::clamp(unit.xcoord, 0, (int)source.width());
+				const int32_t x1 = math::clamp(unit.xcoord + unit.width, 0, (int)source.width());
+				for (int32_t y = 0; y < unit.height; y++)
+				{
+					int32_t sy = unit.ycoord + y;
+					uint8_t* row = dst + (location.y + y) * page_size + location.x;
+					memset(row, 0, unit.width);
+					if (src != nullptr && sy >= 0 && sy < (int)source.height() && x1 > x0)
+						memcpy(row + (x0 - unit.xcoord), src + sy * source.width() + x0, x1 - x0);
+				}
+				m_atlas.markDirty(location.page);
+				glyph.location = location;
+			}
+			m_atlas.touch(glyph.location.page);
+			return glyph;
+		}
+
+		CRAFT_ENGINE_GUI_API void GuiFontSystem::prepareGlyphs(const Char* pStr, uint32_t count, int id)
+		{
+			for (uint32_t i = 0; i < count; i++)
+				_Resident_Glyph(pStr[i], id);
+			flushGlyphAtlas();
+		}
+
+		CRAFT_ENGINE_GUI_API GuiFontSystem::GlyphSlot GuiFontSystem::getGlobalGlyph(Char idx, int id)
+		{
+			auto& glyph = _Resident_Glyph(idx, id);
+			GlyphSlot slot;
+			slot.unit = &glyph.unit;
+			slot.imageSize = Size(m_atlas.pageSize(), m_atlas.pageSize());
+			if (!m_atlas.isResident(glyph.location))
+				return slot;
+			if (glyph.location.page >= (int32_t)m_atlasImages.size() || m_atlas.isDirty(glyph.location.page))
+				flushGlyphAtlas();
+			slot.image = m_atlasImages[glyph.location.page];
+			slot.rect = Rect(glyph.location.x, glyph.location.y, glyph.unit.width, glyph.unit.height);
+			return slot;
+		}
+
+		CRAFT_ENGINE_GUI_API void GuiFontSystem::flushGlyphAtlas()
+		{
+			const uint32_t page_size = m_atlas.pageSize();
+			for (uint32_t page = 0; page < m_atlas.pageCount(); page++)
+			{
+				if (!m_atlas.isDirty(page))
+					continue;
+				if (page >= m_atlasImages.size())
+					m_atlasImages.push_back(GuiRenderSystem::createImage(m_atlas.pixels(page), page_size * page_size, page_size, page_size));
+				else
+					GuiRenderSystem::updateImage(m_atlasImages[page], m_atlas.pixels(page), page_size * page_size, page_size, page_size);
+				m_atlas.clearDirty(page);
+			}
+		}
+
+		CRAFT_ENGINE_GUI_API void GuiFontSystem::setGlyphAtlasLimits(uint32_t pageSize, uint32_t maxPages)
+		{
+			for (auto image : m_atlasImages)
+				GuiRenderSystem::deleteImage(image);
+			m_atlasImages.clear();
+			m_atlas.reset(pageSize, maxPages);
 		}
 
 
 
 		CRAFT_ENGINE_GUI_API int GuiFontSystem::calcFontLineWidth(const Char* pStr, int32_t count, const Font& font)
 		{
-			int wacc = 0.0f;
 			float scalar = font.getSize() * getGlobalFontScalar(font.getFontID());
 			int interval = font.getInterval();
-			for (int i = 0; i < count; i++)
-				wacc += step_forward(getGlobalFontUnit(pStr[i], font.getFontID()).xadvance, scalar, interval);//
-			return wacc;
+			if (count < m_shortRunLength)
+			{
+				int wacc = 0.0f;
+				for (int i = 0; i < count; i++)
+					wacc += step_forward(getGlobalFontUnit(pStr[i], font.getFontID()).xadvance, scalar, interval);//
+				return wacc;
+			}
+			auto params = _Run_Params(font);
+			auto instance = _Instance(font.getFontID());
+			scalar = font.getSize() * instance->m_fontInfo.scalar;
+			std::lock_guard<std::mutex> lock(m_runMutex);
+			auto& run = m_runCache.find(pStr, count, params, [&](Char c) { return step_advance(instance->find(c).unit.xadvance, scalar); });
+			return run.prefix[count];
 		}
 		CRAFT_ENGINE_GUI_API int GuiFontSystem::calcFontLineWidth(const String& str, const Font& font)
 		{
@@ -4580,6 +5662,15 @@ namespace CraftEngine
 			int x = 0;
 			int interval = font.getInterval();
 			float scalar = font.getSize() * GuiFontSystem::getGlobalFontScalar(font.getFontID());
+			if (count >= m_shortRunLength)
+			{
+				auto params = _Run_Params(font);
+				auto instance = _Instance(font.getFontID());
+				scalar = font.getSize() * instance->m_fontInfo.scalar;
+				std::lock_guard<std::mutex> lock(m_runMutex);
+				auto& run = m_runCache.find(pStr, count, params, [&](Char c) { return step_advance(instance->find(c).unit.xadvance, scalar); });
+				return run.pointerIndex(count, xcooed);
+			}
 			int advance = 0;
 			int index = 0;
 			for (int i = 0; i < count; i++)
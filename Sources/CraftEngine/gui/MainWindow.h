@@ -488,13 +488,14 @@ namespace CraftEngine
 				{
 					Sleep(1);
 					getSyncTimerSystem()->step();
-					Application::getThreadPool().push([=]() { getTaskManager()->solvingAsync(); });
 					getTaskManager()->solvingSync();
+					getSignalQueue()->dispatch();
 					return true;
 				}
 				//else if (m_shouldRepaint == 1)
 				//	return true;
 				m_shouldRepaint--;
+				GuiFontSystem::nextGlyphFrame();
 
 #if (CRAFT_ENGINE_RENDER_SYSTEM == CRAFT_ENGINE_GUI_RENDER_API_USING_VULKAN)
 				uint32_t currentSwapChainImageIndex;
@@ -590,8 +591,8 @@ namespace CraftEngine
 				// ¼ʱ
 				//std::this_thread::sleep_for(std::chrono::nanoseconds(5000000));
 				getSyncTimerSystem()->step();
-				Application::getThreadPool().push([=](){ getTaskManager()->solvingAsync(); });
 				getTaskManager()->solvingSync();
+				getSignalQueue()->dispatch();
 
 
 
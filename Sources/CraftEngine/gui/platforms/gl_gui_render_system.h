@@ -94,14 +94,25 @@ namespace CraftEngine
 					if (image != nullptr)
 					{
 						Image* pimage = (Image*)image.operator void* ();
-						if (pimage->mWidth == width && pimage->mHeight == height)
+						// the size tells the format apart as in createImage(), glyph atlas pages are single channel
+						GLenum format;
+						if (size == width * height * 4)
+							format = GL_RGBA;
+						else if (size == width * height)
+							format = GL_RED;
+						else
+							throw std::runtime_error("unrecognized format!");
+						if (pimage->mWidth == width && pimage->mHeight == height && pimage->mFormat == format)
 						{
 							opengl::updateTexture2D(*pimage, 0, 0, width, height, data, size);
 						}
 						else
 						{
 							opengl::destroyTexture(*pimage);
-							*pimage = opengl::createTexture2D(width, height, GL_RGBA, data, size);
+							if (format == GL_RGBA)
+								*pimage = opengl::createTexture2D(width, height, GL_RGBA, data, size);
+							else
+								*pimage = opengl::createTexture2D(width, height, GL_RED, data, size, false, GL_CLAMP_TO_EDGE);
 						}
 					}
 					else
@@ -64,7 +64,15 @@ namespace CraftEngine
 					if (image != nullptr)
 					{
 						Image* pimage = (Image*)image.operator void* ();
-						if (pimage->width() == width && pimage->height() == height)
+						// the size tells the format apart as in createImage(), glyph atlas pages are single channel
+						soft3d::ImageFormat format;
+						if (size == width * height * 4)
+							format = soft3d::ImageFormat::eR8G8B8A8_UNORM;
+						else if (size == width * height)
+							format = soft3d::ImageFormat::eR8_UNORM;
+						else
+							throw std::runtime_error("unrecognized format!");
+						if (pimage->width() == width && pimage->height() == height && pimage->format() == format)
 						{
 							auto memory = pimage->memory();
 							memcpy(memory.data(), data, size);
@@ -73,7 +81,7 @@ namespace CraftEngine
 						{
 							soft3d::destroyMemory(pimage->memory());
 							soft3d::destroyImage(*pimage);
-							*pimage = soft3d::createImage(width, height, 1, 1, soft3d::ImageType::eImage2D, soft3d::ImageFormat::eR8G8B8A8_UNORM, 1, 1);
+							*pimage = soft3d::createImage(width, height, 1, 1, soft3d::ImageType::eImage2D, format, 1, 1);
 							auto memory = soft3d::createMemory(pimage->size());
 							pimage->bindMemory(memory, 0);
 							memcpy(memory.data(), data, size);
@@ -33,6 +33,8 @@ namespace CraftEngine
 				Sampler m_sampler;
 				Buffer m_rectVertexBuffer;
 				Buffer m_rectIndexBuffer;
+				// vertex/index memory of drawPolygon calls, recycled every frame
+				soft3d::LinearArena m_polygonArena;
 				HandleImage m_pureWhiteImage = HandleImage(nullptr);
 			public:
 
@@ -74,6 +76,7 @@ namespace CraftEngine
 					m_rectIndexBuffer = soft3d::createBuffer(sizeof(indices));
 					m_rectIndexBuffer.bindMemory(soft3d::createMemory(sizeof(indices)), 0);
 					m_rectIndexBuffer.write(indices, sizeof(indices), 0);
+					m_polygonArena = soft3d::createLinearArena(MAX_VERTEX_COUNT * sizeof(Vertex) * 16);
 
 
 					uint32_t whiteImageData[] = { 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF };
@@ -95,6 +98,7 @@ namespace CraftEngine
 					soft3d::destroyBuffer(m_rectVertexBuffer);
 					soft3d::destroyMemory(m_rectIndexBuffer.memory());
 					soft3d::destroyBuffer(m_rectIndexBuffer);
+					soft3d::destroyLinearArena(m_polygonArena);
 
 					GuiRenderSystem::deleteImage(m_pureWhiteImage);
 
@@ -174,14 +178,25 @@ namespace CraftEngine
 					Point cp = point;
 					m_context.bindPipeline(m_pipeline.mPipelines[2]);
 
-					const Image* font_image = (Image*)(GuiFontSystem::getGlobalFontImage(font.getFontID()).unused);
-					m_context.bindTexture(*font_image, 0);
+					GuiFontSystem::prepareGlyphs(pStr, count, font.getFontID());
+					const Image* font_image = nullptr;
 					m_context.enableNoBlock(true);
 					for (int i = 0; i < count; i++)
 					{
-						auto& slot = GuiFontSystem::getGlobalFontUnit(pStr[i], font.getFontID());
+						auto glyph = GuiFontSystem::getGlobalGlyph(pStr[i], font.getFontID());
+						auto& slot = *glyph.unit;
+						if (glyph.image == nullptr)
+						{
+							cp.x += GuiFontSystem::step_forward(slot.xadvance, scalar, interval);
+							continue;
+						}
+						if ((const Image*)glyph.image.unused != font_image)
+						{
+							font_image = (const Image*)glyph.image.unused;
+							m_context.bindTexture(*font_image, 0);
+						}
 						push_constants.ltwh = math::vec4(cp.x + slot.xoffset * scalar, cp.y + slot.yoffset * scalar, slot.width * scalar, slot.height * scalar);
-						push_constants.uvltwh = Rect(slot.xcoord, slot.ycoord, slot.width, slot.height);
+						push_constants.uvltwh = glyph.rect;
 						m_context.pushConstants(&push_constants, sizeof(push_constants));
 						m_context.drawIndex(6, 1, 0, 0, 0);
 						cp.x += GuiFontSystem::step_forward(slot.xadvance, scalar, interval); // 
@@ -202,14 +217,25 @@ namespace CraftEngine
 					Point cp = point;
 					m_context.bindPipeline(m_pipeline.mPipelines[2]);
 
-					const Image* font_image = (Image*)(GuiFontSystem::getGlobalFontImage(font.getFontID()).unused);
-					m_context.bindTexture(*font_image, 0);
+					GuiFontSystem::prepareGlyphs(pStr, count, font.getFontID());
+					const Image* font_image = nullptr;
 					m_context.enableNoBlock(true);
 					for (int i = 0; i < count; i++)
 					{
-						auto& slot = GuiFontSystem::getGlobalFontUnit(pStr[i], font.getFontID());
+						auto glyph = GuiFontSystem::getGlobalGlyph(pStr[i], font.getFontID());
+						auto& slot = *glyph.unit;
+						if (glyph.image == nullptr)
+						{
+							cp.x += GuiFontSystem::step_forward(slot.xadvance, scalar, interval);
+							continue;
+						}
+						if ((const Image*)glyph.image.unused != font_image)
+						{
+							font_image = (const Image*)glyph.image.unused;
+							m_context.bindTexture(*font_image, 0);
+						}
 						push_constants.ltwh = math::vec4(cp.x + slot.xoffset * scalar, cp.y + slot.yoffset * scalar, slot.width * scalar, slot.height * scalar);
-						push_constants.uvltwh = Rect(slot.xcoord, slot.ycoord, slot.width, slot.height);
+						push_constants.uvltwh = glyph.rect;
 						push_constants.color = *((uint32_t*)&colorList[i]);
 						m_context.pushConstants(&push_constants, sizeof(push_constants));
 						m_context.drawIndex(6, 1, 0, 0, 0);
@@ -229,14 +255,25 @@ namespace CraftEngine
 					Point cp = point;
 					m_context.bindPipeline(m_pipeline.mPipelines[2]);
 
-					const Image* font_image = (Image*)(GuiFontSystem::getGlobalFontImage(font.getFontID()).unused);
-					m_context.bindTexture(*font_image, 0);
+					GuiFontSystem::prepareGlyphs(pStr, count, font.getFontID());
+					const Image* font_image = nullptr;
 					m_context.enableNoBlock(true);
 					for (int i = 0; i < count; i++)
 					{
-						auto& slot = GuiFontSystem::getGlobalFontUnit(pStr[i], font.getFontID());
+						auto glyph = GuiFontSystem::getGlobalGlyph(pStr[i], font.getFontID());
+						auto& slot = *glyph.unit;
+						if (glyph.image == nullptr)
+						{
+							cp.x += GuiFontSystem::step_forward(slot.xadvance, scalar, interval);
+							continue;
+						}
+						if ((const Image*)glyph.image.unused != font_image)
+						{
+							font_image = (const Image*)glyph.image.unused;
+							m_context.bindTexture(*font_image, 0);
+						}
 						push_constants.ltwh = math::vec4(cp.x + slot.xoffset * scalar, cp.y + slot.yoffset * scalar, slot.width * scalar, slot.height * scalar);
-						push_constants.uvltwh = Rect(slot.xcoord, slot.ycoord, slot.width, slot.height);
+						push_constants.uvltwh = glyph.rect;
 						push_constants.color = *((uint32_t*)&colorList[colorIdxList[i]]);
 						m_context.pushConstants(&push_constants, sizeof(push_constants));
 						m_context.drawIndex(6, 1, 0, 0, 0);
@@ -453,8 +490,6 @@ namespace CraftEngine
 			private:
 				void freePolygonData(soft3d::Buffer& vbuf, soft3d::Buffer& ibuf)
 				{
-					soft3d::destroyMemory(vbuf.memory());
-					soft3d::destroyMemory(ibuf.memory());
 					soft3d::destroyBuffer(vbuf);
 					soft3d::destroyBuffer(ibuf);
 				}
@@ -464,8 +499,8 @@ namespace CraftEngine
 					auto index_buf_size = info.indexCount * sizeof(uint32_t);
 					vbuf = soft3d::createBuffer(vertex_buf_size);
 					ibuf = soft3d::createBuffer(index_buf_size);
-					vbuf.bindMemory(soft3d::createMemory(vertex_buf_size), 0);
-					ibuf.bindMemory(soft3d::createMemory(index_buf_size), 0);
+					m_polygonArena.bind(vbuf);
+					m_polygonArena.bind(ibuf);
 
 					if (info.mixBuffer != nullptr)
 					{
@@ -517,7 +552,7 @@ namespace CraftEngine
 
 				virtual void begin(void* userData)
 				{
-
+					m_polygonArena.reset();
 					m_context.bindFrameBuffer(m_swapchainFramebuffers[m_framebufferIndex]);
 					m_context.bindSampler(m_sampler, 0);
 					m_context.bindBuffer(m_renderInfoBuffer, 0);
@@ -531,7 +566,7 @@ namespace CraftEngine
 					m_context.bindIndexBuffer(m_rectIndexBuffer);
 					//auto framebuffer_data = (soft3d::detail::FrameBufferData*)m_swapchainFramebuffers[m_framebufferIndex].handle();
 					auto& background_color = GuiColorStyle::getBackgroundColor();
-					soft3d::imgClear(m_swapchainImages[m_framebufferIndex], math::vec4(background_color) * (1.0f / 255.0f));
+					soft3d::imgFastClear(m_swapchainImages[m_framebufferIndex], math::vec4(background_color) * (1.0f / 255.0f));
 /*					soft3d::imgSetZero(m_swapchainImages[m_framebufferIndex]);	*/		
 				}
 
@@ -117,15 +117,24 @@ namespace CraftEngine
 					{
 						auto pool = getCommandPool();
 						Image* pimage = (Image*)image.operator void* ();
-						if (pimage->image.mWidth == width && pimage->image.mHeight == height)
+						// the size tells the format apart as in createImage(), glyph atlas pages are single channel
+						vulkan::ImageFormat format;
+						if (size == width * height * 4)
+							format = vulkan::ImageFormat::format_rgba8_unorm;
+						else if (size == width * height)
+							format = vulkan::ImageFormat::format_r8_unorm;
+						else
+							throw std::runtime_error("unrecognized format!");
+						if (pimage->image.mWidth == width && pimage->image.mHeight == height && pimage->image.mFormat == (VkFormat)format)
 						{
-							m_pLogicalDevice->updateImage2D(pool, &pimage->image, width, height, data, size, vulkan::ImageFormat::format_rgba8_unorm);
+							m_pLogicalDevice->updateImage2D(pool, &pimage->image, width, height, data, size, format);
 						}
 						else
 						{
 							m_pLogicalDevice->destroy(pimage->image);
-							pimage->image = m_pLogicalDevice->createTexture2D(pool, width, height, vulkan::ImageFormat::format_rgba8_unorm, data, size);
-							VkDescriptorImageInfo imageInfo = vulkan::vkt::descriptorImageInfo(m_sampler, pimage->image.mView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+							pimage->image = m_pLogicalDevice->createTexture2D(pool, width, height, format, data, size);
+							auto sampler = format == vulkan::ImageFormat::format_r8_unorm ? m_sdf_sampler : m_sampler;
+							VkDescriptorImageInfo imageInfo = vulkan::vkt::descriptorImageInfo(sampler, pimage->image.mView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 							VkWriteDescriptorSet bufferWrite = {};
 							bufferWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 							bufferWrite.dstSet = pimage->set;
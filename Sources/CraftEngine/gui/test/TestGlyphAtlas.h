@@ -0,0 +1,91 @@
+#pragma once
+#include "../Common.h"
+#include "../../core/test/TestCheck.h"
+#include <random>
+
+
+
+/*
+ Packs random glyph sizes into GlyphAtlas frame by frame and checks that live allocations never
+ overlap, that only pages idle in the current frame are recycled, and that recycling invalidates
+ the locations handed out before.
+*/
+void testGlyphAtlas()
+{
+	using namespace CraftEngine;
+
+	test::TestCheck check("testGlyphAtlas");
+
+	const uint32_t page_size = 256, max_pages = 3;
+	gui::GlyphAtlas atlas(page_size, max_pages);
+	std::mt19937 rng(5);
+
+	struct Placed { gui::GlyphAtlas::Location location; uint32_t width, height; uint64_t frame; };
+	std::vector<Placed> placed;
+	bool overlap = false, stale = false, bounds = false;
+	for (int frame = 0; frame < 40; frame++)
+	{
+		atlas.nextFrame();
+		for (int i = 0; i < 60; i++)
+		{
+			uint32_t w = 8 + rng() % 40, h = 12 + rng() % 24;
+			auto location = atlas.allocate(w, h);
+			if (location.page < 0 || location.x + w > page_size || location.y + h > page_size)
+			{
+				bounds = true;
+				continue;
+			}
+			atlas.touch(location.page);
+			for (auto& other : placed)
+			{
+				if (!atlas.isResident(other.location) || other.location.page != location.page)
+					continue;
+				bool apart = location.x + w <= other.location.x || other.location.x + other.width <= location.x ||
+					location.y + h <= other.location.y || other.location.y + other.height <= location.y;
+				if (!apart)
+					overlap = true;
+			}
+			placed.push_back({ location, w, h, atlas.frame() });
+		}
+		// everything allocated this frame must still be resident at its end
+		for (auto& p : placed)
+			if (p.frame == atlas.frame() && !atlas.isResident(p.location))
+				stale = true;
+	}
+	check("bounds", !bounds);
+	check("no overlap", !overlap);
+	check("current frame kept", !stale);
+	check("page limit", atlas.pageCount() == max_pages);
+	check("recycled", !atlas.isResident(placed.front().location));
+
+	// a frame that needs more than the page limit grows instead of evicting its own glyphs
+	atlas.nextFrame();
+	std::vector<gui::GlyphAtlas::Location> burst;
+	for (int i = 0; i < 4 * 64; i++)
+	{
+		burst.push_back(atlas.allocate(63, 63));
+		atlas.touch(burst.back().page);
+	}
+	bool all_resident = true;
+	for (auto& location : burst)
+		all_resident &= atlas.isResident(location);
+	check("burst resident", all_resident && atlas.pageCount() > max_pages);
+	check("oversized", atlas.allocate(page_size, 8).page < 0);
+
+	atlas.reset(128, 1);
+	check("reset", atlas.pageCount() == 0 && !atlas.isResident(burst.front()) && atlas.pageSize() == 128);
+
+	// pages created after a reset must not revive the locations handed out before it
+	atlas.nextFrame();
+	auto before = atlas.allocate(8, 8);
+	atlas.reset(128, 1);
+	atlas.nextFrame();
+	auto after = atlas.allocate(8, 8);
+	check("reset invalidates", after.page == before.page && atlas.isResident(after) && !atlas.isResident(before));
+	bool stale_after_reset = false;
+	for (auto& location : burst)
+		stale_after_reset |= atlas.isResident(location);
+	check("burst invalidated", !stale_after_reset);
+
+	check.finish();
+}
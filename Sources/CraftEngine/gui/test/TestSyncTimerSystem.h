@@ -0,0 +1,101 @@
+#pragma once
+#include "../Common.h"
+#include "../../core/test/TestCheck.h"
+#include <random>
+
+
+
+/*
+ Runs one-shot, counted and repeating timers through SyncTimerSystem in real time, checks that
+ nothing fires early or twice, and that cancelled or paused timers stay silent.
+*/
+void testSyncTimerSystem()
+{
+	using namespace CraftEngine;
+	using Clock = std::chrono::steady_clock;
+
+	test::TestCheck check("testSyncTimerSystem");
+
+	gui::SyncTimerSystem system;
+	auto begin = Clock::now();
+	auto elapsed = [&]() { return std::chrono::duration<float, std::milli>(Clock::now() - begin).count(); };
+	auto run = [&](float ms)
+	{
+		while (elapsed() < ms)
+		{
+			system.step();
+			std::this_thread::sleep_for(std::chrono::microseconds(500));
+		}
+	};
+
+	const int count = 4000;
+	std::mt19937 rng(11);
+	std::vector<gui::SyncTimerSystem::TimerHandle> handles(count);
+	std::vector<int> fired(count, 0);
+	std::vector<float> due(count), fired_at(count, 0.0f);
+	for (int i = 0; i < count; i++)
+	{
+		due[i] = float(1 + rng() % 150);
+		system.getOne(due[i], 1, core::Callback<void(float, float)>([&, i](float, float) { fired[i]++; fired_at[i] = elapsed(); }), &handles[i]);
+		system.startOne(handles[i]);
+	}
+	// cancel every third timer, pause every fifth
+	for (int i = 0; i < count; i += 3)
+		system.removeOne(handles[i]);
+	for (int i = 1; i < count; i += 5)
+		if (handles[i] != nullptr)
+			system.pauseOne(handles[i]);
+
+	gui::Timer repeating;
+	int repeats = 0;
+	repeating.setDuration(10);
+	repeating.setMaxExecution(0);
+	repeating.setCallback(core::Callback<void(float, float)>([&](float, float) { repeats++; }));
+	repeating.startTimer(&system);
+
+	gui::Timer counted;
+	int counts = 0;
+	counted.setDuration(40);
+	counted.setMaxExecution(4);
+	counted.setCallback(core::Callback<void(float, float)>([&](float, float) { counts++; }));
+	counted.startTimer(&system);
+
+	// two timers due in the same step that remove each other: exactly one of them fires
+	gui::SyncTimerSystem::TimerHandle first, second;
+	int pair_fired = 0;
+	system.getOne(30, 1, core::Callback<void(float, float)>([&](float, float) { pair_fired++; if (second != nullptr) system.removeOne(second); }), &first);
+	system.getOne(30, 1, core::Callback<void(float, float)>([&](float, float) { pair_fired++; if (first != nullptr) system.removeOne(first); }), &second);
+	system.startOne(first);
+	system.startOne(second);
+
+	gui::SyncTimerSystem::TimerHandle far_away;
+	system.getOne(10.0f * 3600 * 1000, 1, core::Callback<void(float, float)>([&](float, float) { check("far timer", false); }), &far_away);
+	system.startOne(far_away);
+
+	run(200);
+
+	bool early = false, missing = false;
+	for (int i = 0; i < count; i++)
+	{
+		bool cancelled = i % 3 == 0 || i % 5 == 1;
+		if (cancelled ? fired[i] != 0 : fired[i] != 1)
+			missing = true;
+		if (!cancelled && fired_at[i] + 1.0f < due[i])
+			early = true;
+	}
+	check("one-shot timers", !missing);
+	check("not early", !early);
+	check("handles cleared", handles[2] == nullptr && handles[1] != nullptr);
+	check("repeating", repeats >= 15 && repeats <= 20 && repeating.isValid());
+	check("counted", counts == 4 && !counted.isValid());
+	check("removed in batch", first == nullptr && second == nullptr && pair_fired == 1);
+
+	repeating.stopTimer(&system);
+	system.removeOne(far_away);
+	for (int i = 1; i < count; i += 5)
+		if (handles[i] != nullptr)
+			system.removeOne(handles[i]);
+	check("timer count", system.getTimerCount() == 0);
+
+	check.finish();
+}
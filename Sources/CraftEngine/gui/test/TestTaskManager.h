@@ -0,0 +1,146 @@
+#pragma once
+#include "../Common.h"
+#include "../../core/test/TestCheck.h"
+
+
+
+/*
+ Pushes interactive, background and chained tasks through TaskManager and drains them the way a
+ frame loop does, checking thread affinity, cancellation, lane priority and the sync budget.
+*/
+void testTaskManager()
+{
+	using namespace CraftEngine;
+	using Clock = std::chrono::steady_clock;
+
+	test::TestCheck check("testTaskManager");
+
+	gui::TaskManager manager(3);
+	const auto ui_thread = std::this_thread::get_id();
+	auto drain = [&](float ms)
+	{
+		auto begin = Clock::now();
+		while (manager.getPendingCount() > 0 && std::chrono::duration<float, std::milli>(Clock::now() - begin).count() < ms)
+		{
+			manager.solvingSync();
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+		}
+	};
+
+	// many small tasks, none dropped, sync halves on the UI thread
+	const int count = 5000;
+	std::atomic<int> async_runs{ 0 };
+	int sync_sum = 0;
+	std::atomic<bool> wrong_thread{ false };
+	for (int i = 0; i < count; i++)
+		manager.addTask([&, i](core::Any& data) { async_runs++; data = i; if (std::this_thread::get_id() == ui_thread) wrong_thread = true; },
+			[&](core::Any& data) { sync_sum += data.cast<int>(); if (std::this_thread::get_id() != ui_thread) wrong_thread = true; },
+			i % 2 ? gui::TaskManager::ePriority_Background : gui::TaskManager::ePriority_Interactive);
+	manager.setSyncBudget(0);
+	drain(5000);
+	check("all async ran", async_runs == count);
+	check("all sync ran", sync_sum == count * (count - 1) / 2);
+	check("thread affinity", !wrong_thread);
+
+	// continuation chain alternating worker and UI thread
+	std::vector<int> order;
+	std::mutex order_mutex;
+	auto record = [&](int stage) { std::lock_guard<std::mutex> lock(order_mutex); order.push_back(stage); };
+	manager.chain(gui::TaskManager::ePriority_Background)
+		.async([&](core::Any& data) { data = 1; record(1); })
+		.sync([&](core::Any& data) { data = data.cast<int>() + 1; record(2); })
+		.async([&](core::Any& data) { data = data.cast<int>() + 1; record(3); })
+		.sync([&](core::Any& data) { record(data.cast<int>() + 1); })
+		.submit();
+	drain(1000);
+	check("chain", order == std::vector<int>({ 1, 2, 3, 4 }));
+
+	// background work never holds every worker: an interactive task starts while it is busy
+	gui::TaskManager::CancelToken slow;
+	std::atomic<int> slow_runs{ 0 };
+	for (int i = 0; i < 64; i++)
+		manager.chain(gui::TaskManager::ePriority_Background).token(slow)
+			.async([&](core::Any&) { slow_runs++; std::this_thread::sleep_for(std::chrono::milliseconds(5)); })
+			.sync([&](core::Any&) { check("cancelled sync ran", false); })
+			.submit();
+	std::this_thread::sleep_for(std::chrono::milliseconds(2));
+	auto submitted = Clock::now();
+	// ordering, not wall clock: the interactive task starts long before the queued background work is through
+	std::atomic<bool> started{ false };
+	std::atomic<int> slow_runs_before{ -1 };
+	check("interactive queued", manager.addTask([&](core::Any&) { slow_runs_before = slow_runs.load(); started = true; }, nullptr));
+	while (!started && std::chrono::duration<float, std::milli>(Clock::now() - submitted).count() < 5000)
+		std::this_thread::yield();
+	check("interactive before background", started && slow_runs_before < 32);
+	slow.cancel();
+	drain(5000);
+	check("cancelled", slow_runs < 64 && manager.getPendingCount() == 0);
+
+	// a token passed in cancels a task before it runs
+	{
+		gui::TaskManager stalled(1);
+		std::atomic<bool> release{ false }, ran{ false };
+		stalled.addTask([&](core::Any&) { while (!release) std::this_thread::yield(); }, nullptr);
+		gui::TaskManager::CancelToken token;
+		bool queued = stalled.addTask([&](core::Any&) { ran = true; }, nullptr, gui::TaskManager::ePriority_Interactive, token);
+		token.cancel();
+		release = true;
+		auto begin = Clock::now();
+		while (stalled.getPendingCount() > 0 && std::chrono::duration<float, std::milli>(Clock::now() - begin).count() < 5000)
+			stalled.solvingSync();
+		check("token passed in", queued && !ran);
+	}
+
+	// the sync budget bounds the time one solvingSync() spends: every task takes at least 1 ms,
+	// so a 3 ms budget stops before the 20th whatever the scheduler does
+	int sync_runs = 0;
+	for (int i = 0; i < 20; i++)
+		manager.addTask(nullptr, [&](core::Any&) { sync_runs++; std::this_thread::sleep_for(std::chrono::milliseconds(1)); });
+	manager.setSyncBudget(3000);
+	manager.solvingSync();
+	check("sync budget", sync_runs > 0 && sync_runs < 20 && manager.getPendingSyncCount() > 0);
+	drain(1000);
+	check("sync drained", manager.getPendingSyncCount() == 0);
+
+	// background work starts only while two workers are idle
+	{
+		gui::TaskManager lanes(3);
+		std::atomic<bool> release{ false };
+		std::atomic<int> running{ 0 };
+		std::atomic<bool> second_background{ false }, interactive{ false };
+		auto hold = [&](core::Any&) { running++; while (!release) std::this_thread::yield(); };
+		auto wait_for = [&](std::function<bool()> done) {
+			auto begin = Clock::now();
+			while (!done() && std::chrono::duration<float, std::milli>(Clock::now() - begin).count() < 1000)
+				std::this_thread::yield();
+			return done();
+		};
+		lanes.addTask(hold, nullptr);
+		check("interactive holds a worker", wait_for([&]() { return running == 1; }));
+		lanes.addTask(hold, nullptr, gui::TaskManager::ePriority_Background);
+		check("background with two idle workers", wait_for([&]() { return running == 2; }));
+		lanes.addTask([&](core::Any&) { second_background = true; }, nullptr, gui::TaskManager::ePriority_Background);
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		check("last idle worker kept", !second_background);
+		lanes.addTask([&](core::Any&) { interactive = true; }, nullptr);
+		check("interactive takes the last worker", wait_for([&]() { return interactive.load(); }));
+		release = true;
+		check("background resumes", wait_for([&]() { return second_background.load(); }));
+
+		// a single worker runs background work when nothing else is running
+		gui::TaskManager single(1);
+		std::atomic<bool> ran_background{ false };
+		single.addTask([&](core::Any&) { ran_background = true; }, nullptr, gui::TaskManager::ePriority_Background);
+		check("single worker background", wait_for([&]() { return ran_background.load(); }));
+	}
+
+	// clearAllTask drops queued work without running it
+	gui::TaskManager idle(1);
+	bool ran = false;
+	idle.addTask(nullptr, [&](core::Any&) { ran = true; });
+	idle.clearAllTask();
+	idle.solvingSync();
+	check("clearAllTask", !ran && idle.getPendingCount() == 0);
+
+	check.finish();
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include "../Common.h"
+#include "../../core/test/TestCheck.h"
+#include <random>
+
+
+
+/*
+ Measures random runs through TextRunCache and compares widths, prefix widths and hit-testing
+ with a plain walk over the characters, then checks reuse, generation changes and the limit.
+*/
+void testTextRunCache()
+{
+	using namespace CraftEngine;
+
+	test::TestCheck check("testTextRunCache");
+
+	std::mt19937 rng(11);
+	auto measure = [](gui::Char c) { return int32_t(c % 7 == 0 ? 0 : 4 + c % 13); };
+	auto walk_width = [&](const gui::Char* str, int32_t count, int32_t interval)
+	{
+		int32_t x = 0;
+		for (int32_t i = 0; i < count; i++)
+			x += measure(str[i]) + interval;
+		return x;
+	};
+	auto walk_index = [&](const gui::Char* str, int32_t count, int xcoord, int32_t interval)
+	{
+		int x = 0, index = 0;
+		for (int32_t i = 0; i < count; i++)
+		{
+			int advance = measure(str[i]);
+			if (xcoord < x + advance / 2)
+				break;
+			else if (xcoord < x + advance)
+			{
+				index++;
+				break;
+			}
+			x += advance + interval;
+			index++;
+		}
+		return index;
+	};
+
+	gui::TextRunCache cache(1 << 12);
+	bool width = true, prefix = true, index = true;
+	for (int round = 0; round < 300; round++)
+	{
+		std::vector<gui::Char> str(1 + rng() % 80);
+		for (auto& c : str)
+			c = gui::Char(L' ' + rng() % 90);
+		int32_t interval = int32_t(rng() % 6) - (round % 5 == 0 ? 8 : 0);
+		gui::TextRunCache::Params params = { 0, 0, 16.0f, interval };
+		int32_t count = (int32_t)str.size();
+
+		auto& run = cache.find(str.data(), count, params, measure);
+		width &= run.prefix[count] == walk_width(str.data(), count, interval);
+		for (int x = -10; x < run.prefix[count] + 20; x += 1 + rng() % 3)
+			index &= run.pointerIndex(count, x) == walk_index(str.data(), count, x, interval);
+
+		int32_t part = rng() % (count + 1);
+		auto& head = cache.find(str.data(), part, params, measure);
+		prefix &= head.prefix[part] == walk_width(str.data(), part, interval);
+		for (int x = -10; x < head.prefix[part] + 20; x += 1 + rng() % 3)
+			index &= head.pointerIndex(part, x) == walk_index(str.data(), part, x, interval);
+	}
+	check("width", width);
+	check("prefix width", prefix);
+	check("pointer index", index);
+
+	gui::TextRunCache lines;
+	std::wstring line = L"The quick brown fox jumps over the lazy dog";
+	gui::TextRunCache::Params params = { 1, 0, 12.0f, 1 };
+	lines.find(line.data(), (int32_t)line.size(), params, measure);
+	lines.find(line.data(), 9, params, measure);
+	lines.find(line.data(), (int32_t)line.size(), params, measure);
+	check("reuse", lines.missCount() == 1 && lines.hitCount() == 2 && lines.size() == 1);
+
+	// a reloaded font bumps the generation, the old run must not answer
+	auto reloaded = params;
+	reloaded.generation++;
+	lines.find(line.data(), (int32_t)line.size(), reloaded, [&](gui::Char c) { return measure(c) * 2; });
+	auto& scaled = lines.find(line.data(), (int32_t)line.size(), reloaded, measure);
+	check("generation", lines.missCount() == 2 && scaled.prefix[line.size()] == 2 * walk_width(line.data(), (int32_t)line.size(), 0) + (int32_t)line.size());
+
+	lines.setLimit(100);
+	for (int i = 0; i < 20; i++)
+	{
+		std::wstring str = line.substr(i % 10) + std::to_wstring(i);
+		lines.find(str.data(), (int32_t)str.size(), params, measure);
+	}
+	check("limit", lines.charCount() <= 100 && lines.size() >= 1);
+
+	check.finish();
+}
@@ -886,6 +886,7 @@ namespace CraftEngine
 			std::vector<Widget*> m_popupWidgetsList;
 			SyncTimerSystem* m_timerSystem;
 			TaskManager* m_taskManager;
+			core::SignalQueue m_signalQueue;
 
 			AbstractCursor* m_cursor = nullptr;
 			AbstractCursor* m_system_cursor_list[16];
@@ -1003,9 +1004,16 @@ namespace CraftEngine
 				return m_taskManager;
 			}
 
-			bool addAtomicTask(std::function<void(core::Any&)>&& sync, std::function<void(core::Any&)>&& async = [](core::Any&) {})
+			// Queued signal connections made with this queue run once per frame.
+			core::SignalQueue* getSignalQueue()
 			{
-				return m_taskManager->addTask({ sync, async });
+				return &m_signalQueue;
+			}
+
+			// async runs on a worker thread, then sync on the UI thread with the same data, false if the task was not queued
+			bool addAtomicTask(std::function<void(core::Any&)>&& async, std::function<void(core::Any&)>&& sync = nullptr, TaskManager::Priority priority = TaskManager::ePriority_Interactive, const TaskManager::CancelToken& token = TaskManager::CancelToken())
+			{
+				return m_taskManager->addTask(std::move(async), std::move(sync), priority, token);
 			}
 
 			/*
@@ -0,0 +1,439 @@
+#pragma once
+#ifndef CRAFT_ENGINE_MATH_FAST_H_
+#define CRAFT_ENGINE_MATH_FAST_H_
+
+#include "./LinearMathWide.h"
+#include <string.h>
+
+
+/*
+ math::fast: polynomial approximations of the transcendental functions for shader code.
+ Every function exists for float, simd_float8 and Vector<Len, float / simd_float8>.
+ The polynomials only pay off eight lanes at a time: simd_float8 and Vector<Len, simd_float8>
+ use them. For a float, alone or as a component of a vec4, libm is faster for everything but
+ atan/atan2 (glibc, SSE2 and AVX2 builds), so there exp, exp2, log, log2, pow, sin and cos
+ forward to <cmath>. Each lane of a packet gets what the polynomial returns for that float
+ (exactly, unless the compiler contracts one of the two to FMA).
+
+ Maximum error of the polynomials over the documented domain (float, against double precision):
+   exp         relative 1.5e-7 for |x| <= 87
+   exp2        relative 1.5e-7 for -126 < x < 127
+   log, log2   absolute 1e-7 on [0.5, 2], relative 1.5e-7 elsewhere, x > 0 and normal
+   pow         relative 1.5e-7 * (1 + |y * log2(x)|) for x > 0, 0 for x <= 0, pow(x, 0) == 1
+               (a float pow is std::pow and follows <cmath> for x <= 0)
+   sin, cos    absolute 2e-7 for |x| <= 8192
+   atan        absolute 2e-7
+   atan2       absolute 4e-7, atan2(0, 0) == 0
+ Inputs outside the range of exp/exp2 are clamped, so there are no infinities or NaNs.
+
+ The range reductions rely on the order of their floating point steps (Cody-Waite). With GCC or
+ Clang -ffast-math an optimization barrier keeps them apart. MSVC /fp:fast has no such guard,
+ build this header with /fp:precise (the default) there.
+
+ Define CRAFT_ENGINE_MATH_FAST_EXACT to forward every function to the <cmath> version
+ (per lane for the wide types) when bit-exact results are required.
+*/
+
+namespace CraftEngine
+{
+	namespace math
+	{
+
+		namespace _Math_Detail
+		{
+
+			/*
+			 Lane primitives. Everything else is built from +, -, *, /, min, max and these.
+			*/
+
+			// floor for |x| < 2^31
+			CRAFT_ENGINE_MATH_FUNC_DECL float fast_floor(float x)
+			{
+				float t = static_cast<float>(static_cast<int32_t>(x));
+				return t - static_cast<float>(t > x);
+			}
+			// 1 where a < b, else 0
+			CRAFT_ENGINE_MATH_FUNC_DECL float fast_less(float a, float b) { return a < b ? 1.0f : 0.0f; }
+			// 2^n for integral n in [-126, 127]
+			CRAFT_ENGINE_MATH_FUNC_DECL float fast_pow2i(float n)
+			{
+				int32_t bits = (static_cast<int32_t>(n) + 127) << 23;
+				float r;
+				memcpy(&r, &bits, sizeof(r));
+				return r;
+			}
+			// x = m * 2^e with m in [1, 2), x positive and normal
+			CRAFT_ENGINE_MATH_FUNC_DECL float fast_split(float x, float& e)
+			{
+				int32_t bits;
+				memcpy(&bits, &x, sizeof(bits));
+				e = static_cast<float>(((bits >> 23) & 0xff) - 127);
+				bits = (bits & 0x007fffff) | 0x3f800000;
+				float m;
+				memcpy(&m, &bits, sizeof(m));
+				return m;
+			}
+
+#if defined(CRAFT_ENGINE_SIMD_AVX2)
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 fast_floor(simd_float8 const& x) { simd_float8 r; r.v = _mm256_floor_ps(x.v); return r; }
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 fast_less(simd_float8 const& a, simd_float8 const& b) { simd_float8 r; r.v = _mm256_and_ps(_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ), _mm256_set1_ps(1.0f)); return r; }
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 fast_pow2i(simd_float8 const& n)
+			{
+				simd_float8 r;
+				r.v = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(n.v), _mm256_set1_epi32(127)), 23));
+				return r;
+			}
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 fast_split(simd_float8 const& x, simd_float8& e)
+			{
+				__m256i bits = _mm256_castps_si256(x.v);
+				e.v = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_and_si256(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(0xff)), _mm256_set1_epi32(127)));
+				simd_float8 m;
+				m.v = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)), _mm256_set1_epi32(0x3f800000)));
+				return m;
+			}
+#elif defined(CRAFT_ENGINE_SIMD_SSE2)
+			CRAFT_ENGINE_MATH_FUNC_DECL __m128 fast_floor_half(__m128 x)
+			{
+#	if defined(CRAFT_ENGINE_SIMD_SSE41)
+				return _mm_floor_ps(x);
+#	else
+				__m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+				return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, x), _mm_set1_ps(1.0f)));
+#	endif
+			}
+			CRAFT_ENGINE_MATH_FUNC_DECL __m128 fast_pow2i_half(__m128 n)
+			{
+				return _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(n), _mm_set1_epi32(127)), 23));
+			}
+			CRAFT_ENGINE_MATH_FUNC_DECL __m128 fast_split_half(__m128 x, __m128& e)
+			{
+				__m128i bits = _mm_castps_si128(x);
+				e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_and_si128(_mm_srli_epi32(bits, 23), _mm_set1_epi32(0xff)), _mm_set1_epi32(127)));
+				return _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000)));
+			}
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 fast_floor(simd_float8 const& x) { simd_float8 r; r.lo = fast_floor_half(x.lo); r.hi = fast_floor_half(x.hi); return r; }
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 fast_less(simd_float8 const& a, simd_float8 const& b)
+			{
+				simd_float8 r;
+				r.lo = _mm_and_ps(_mm_cmplt_ps(a.lo, b.lo), _mm_set1_ps(1.0f));
+				r.hi = _mm_and_ps(_mm_cmplt_ps(a.hi, b.hi), _mm_set1_ps(1.0f));
+				return r;
+			}
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 fast_pow2i(simd_float8 const& n) { simd_float8 r; r.lo = fast_pow2i_half(n.lo); r.hi = fast_pow2i_half(n.hi); return r; }
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 fast_split(simd_float8 const& x, simd_float8& e) { simd_float8 m; m.lo = fast_split_half(x.lo, e.lo); m.hi = fast_split_half(x.hi, e.hi); return m; }
+#elif defined(CRAFT_ENGINE_SIMD_NEON)
+			CRAFT_ENGINE_MATH_FUNC_DECL float32x4_t fast_floor_half(float32x4_t x)
+			{
+#	if defined(__aarch64__) || defined(_M_ARM64)
+				return vrndmq_f32(x);
+#	else
+				float32x4_t t = vcvtq_f32_s32(vcvtq_s32_f32(x));
+				return vsubq_f32(t, vreinterpretq_f32_u32(vandq_u32(vcgtq_f32(t, x), vreinterpretq_u32_f32(vdupq_n_f32(1.0f)))));
+#	endif
+			}
+			CRAFT_ENGINE_MATH_FUNC_DECL float32x4_t fast_less_half(float32x4_t a, float32x4_t b)
+			{
+				return vreinterpretq_f32_u32(vandq_u32(vcltq_f32(a, b), vreinterpretq_u32_f32(vdupq_n_f32(1.0f))));
+			}
+			CRAFT_ENGINE_MATH_FUNC_DECL float32x4_t fast_pow2i_half(float32x4_t n)
+			{
+				return vreinterpretq_f32_s32(vshlq_n_s32(vaddq_s32(vcvtq_s32_f32(n), vdupq_n_s32(127)), 23));
+			}
+			CRAFT_ENGINE_MATH_FUNC_DECL float32x4_t fast_split_half(float32x4_t x, float32x4_t& e)
+			{
+				int32x4_t bits = vreinterpretq_s32_f32(x);
+				e = vcvtq_f32_s32(vsubq_s32(vandq_s32(vshrq_n_s32(bits, 23), vdupq_n_s32(0xff)), vdupq_n_s32(127)));
+				return vreinterpretq_f32_s32(vorrq_s32(vandq_s32(bits, vdupq_n_s32(0x007fffff)), vdupq_n_s32(0x3f800000)));
+			}
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 fast_floor(simd_float8 const& x) { simd_float8 r; r.lo = fast_floor_half(x.lo); r.hi = fast_floor_half(x.hi); return r; }
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 fast_less(simd_float8 const& a, simd_float8 const& b) { simd_float8 r; r.lo = fast_less_half(a.lo, b.lo); r.hi = fast_less_half(a.hi, b.hi); return r; }
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 fast_pow2i(simd_float8 const& n) { simd_float8 r; r.lo = fast_pow2i_half(n.lo); r.hi = fast_pow2i_half(n.hi); return r; }
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 fast_split(simd_float8 const& x, simd_float8& e) { simd_float8 m; m.lo = fast_split_half(x.lo, e.lo); m.hi = fast_split_half(x.hi, e.hi); return m; }
+#else
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 fast_floor(simd_float8 const& x) { simd_float8 r; for (int i = 0; i < 8; i++) r.v[i] = fast_floor(x.v[i]); return r; }
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 fast_less(simd_float8 const& a, simd_float8 const& b) { simd_float8 r; for (int i = 0; i < 8; i++) r.v[i] = fast_less(a.v[i], b.v[i]); return r; }
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 fast_pow2i(simd_float8 const& n) { simd_float8 r; for (int i = 0; i < 8; i++) r.v[i] = fast_pow2i(n.v[i]); return r; }
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 fast_split(simd_float8 const& x, simd_float8& e) { simd_float8 m; for (int i = 0; i < 8; i++) m.v[i] = fast_split(x.v[i], e.v[i]); return m; }
+#endif
+			// stops -ffast-math from reassociating one reduction step into the next, a no-op otherwise
+			template<typename T>
+			CRAFT_ENGINE_MATH_FUNC_DECL void fast_keep(T& value)
+			{
+#if defined(__FAST_MATH__) && (defined(__GNUC__) || defined(__clang__))
+				__asm__("" : "+m"(value));
+#else
+				(void)value;
+#endif
+			}
+
+			CRAFT_ENGINE_MATH_FUNC_DECL float fast_abs(float x) { return std::abs(x); }
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 fast_abs(simd_float8 const& x) { return math::abs(x); }
+			CRAFT_ENGINE_MATH_FUNC_DECL float fast_min(float a, float b) { return math::min(a, b); }
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 fast_min(simd_float8 const& a, simd_float8 const& b) { return math::min(a, b); }
+			CRAFT_ENGINE_MATH_FUNC_DECL float fast_max(float a, float b) { return math::max(a, b); }
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 fast_max(simd_float8 const& a, simd_float8 const& b) { return math::max(a, b); }
+
+
+
+			/*
+			 Kernels (Cephes style minimax polynomials), shared by float and simd_float8.
+			*/
+
+			// 2^f * 2^n with f = x - n in [-0.5, 0.5], polynomial in f * ln2
+			template<typename T>
+			CRAFT_ENGINE_MATH_FUNC_DECL T fast_exp2_kernel(T x)
+			{
+				x = fast_min(fast_max(x, T(-126.0f)), T(127.0f));
+				T n = fast_floor(x + T(0.5f));
+				T r = (x - n) * T(0.693147180559945f);
+				T p = T(1.9875691500e-4f);
+				p = p * r + T(1.3981999507e-3f);
+				p = p * r + T(8.3334519073e-3f);
+				p = p * r + T(4.1665795894e-2f);
+				p = p * r + T(1.6666665459e-1f);
+				p = p * r + T(5.0000001201e-1f);
+				p = p * r * r + r + T(1.0f);
+				return p * fast_pow2i(n);
+			}
+
+			template<typename T>
+			CRAFT_ENGINE_MATH_FUNC_DECL T fast_exp_kernel(T x)
+			{
+				x = fast_min(fast_max(x, T(-87.33654f)), T(88.37626f));
+				T n = fast_floor(x * T(1.44269504088896341f) + T(0.5f));
+				// Cody-Waite reduction by ln2 = C1 + C2
+				T r = x - n * T(0.693359375f);
+				fast_keep(r);
+				r = r - n * T(-2.12194440e-4f);
+				T p = T(1.9875691500e-4f);
+				p = p * r + T(1.3981999507e-3f);
+				p = p * r + T(8.3334519073e-3f);
+				p = p * r + T(4.1665795894e-2f);
+				p = p * r + T(1.6666665459e-1f);
+				p = p * r + T(5.0000001201e-1f);
+				p = p * r * r + r + T(1.0f);
+				return p * fast_pow2i(n);
+			}
+
+			// returns log(x), x = m * 2^e with m folded into [sqrt(0.5), sqrt(2))
+			template<typename T>
+			CRAFT_ENGINE_MATH_FUNC_DECL T fast_log_kernel(T x, T& e)
+			{
+				T m = fast_split(x, e) * T(0.5f);
+				e = e + T(1.0f);
+				T small = fast_less(m, T(0.707106781186547524f));
+				e = e - small;
+				m = m + m * small - T(1.0f);
+				T z = m * m;
+				T p = T(7.0376836292e-2f);
+				p = p * m + T(-1.1514610310e-1f);
+				p = p * m + T(1.1676998740e-1f);
+				p = p * m + T(-1.2420140846e-1f);
+				p = p * m + T(1.4249322787e-1f);
+				p = p * m + T(-1.6668057665e-1f);
+				p = p * m + T(2.0000714765e-1f);
+				p = p * m + T(-2.4999993993e-1f);
+				p = p * m + T(3.3333331174e-1f);
+				p = p * m * z;
+				return m + (p - T(0.5f) * z);
+			}
+
+			template<typename T>
+			CRAFT_ENGINE_MATH_FUNC_DECL T fast_log(T x)
+			{
+				T e;
+				T l = fast_log_kernel(x, e);
+				// e * ln2 split as C1 + C2 so the sum stays exact for large exponents
+				T r = l + e * T(-2.12194440e-4f);
+				fast_keep(r);
+				return r + e * T(0.693359375f);
+			}
+
+			template<typename T>
+			CRAFT_ENGINE_MATH_FUNC_DECL T fast_log2(T x)
+			{
+				T e;
+				T l = fast_log_kernel(x, e);
+				return l * T(1.44269504088896341f) + e;
+			}
+
+			// sin(x + quadrant * pi/2)
+			template<typename T>
+			CRAFT_ENGINE_MATH_FUNC_DECL T fast_sin_kernel(T x, float quadrant)
+			{
+				T k = fast_floor(x * T(0.636619772367581343f) + T(0.5f));
+				// Cody-Waite reduction by pi/2 = C1 + C2 + C3, r in [-pi/4, pi/4]
+				T r = x - k * T(1.5703125f);
+				fast_keep(r);
+				r = r - k * T(4.837512969970703125e-4f);
+				fast_keep(r);
+				r = r - k * T(7.54978995489188216e-8f);
+				T z = r * r;
+				T s = T(-1.9515295891e-4f);
+				s = s * z + T(8.3321608736e-3f);
+				s = s * z + T(-1.6666654611e-1f);
+				s = s * z * r + r;
+				T c = T(2.443315711809948e-5f);
+				c = c * z + T(-1.388731625493765e-3f);
+				c = c * z + T(4.166664568298827e-2f);
+				c = c * z * z - T(0.5f) * z + T(1.0f);
+				// q = (k + quadrant) mod 4: 0 -> s, 1 -> c, 2 -> -s, 3 -> -c
+				T q = k + T(quadrant);
+				q = q - T(4.0f) * fast_floor(q * T(0.25f));
+				T half = fast_floor(q * T(0.5f));
+				T odd = q - T(2.0f) * half;
+				return (s + odd * (c - s)) * (T(1.0f) - T(2.0f) * half);
+			}
+
+			// atan(a) for a in [0, 1]
+			template<typename T>
+			CRAFT_ENGINE_MATH_FUNC_DECL T fast_atan_unit(T a)
+			{
+				// above tan(pi/8) use atan(a) = pi/4 + atan((a - 1) / (a + 1))
+				T m = fast_less(T(0.414213562373095f), a);
+				a = (a - m) / (T(1.0f) + m * a);
+				T z = a * a;
+				T p = T(8.05374449538e-2f);
+				p = p * z + T(-1.38776856032e-1f);
+				p = p * z + T(1.99777106478e-1f);
+				p = p * z + T(-3.33329491539e-1f);
+				return m * T(0.785398163397448309f) + (p * z * a + a);
+			}
+
+			template<typename T>
+			CRAFT_ENGINE_MATH_FUNC_DECL T fast_atan(T x)
+			{
+				T ax = fast_abs(x);
+				T big = fast_less(T(1.0f), ax);
+				T a = fast_min(ax, T(1.0f) / fast_max(ax, T(1e-30f)));
+				T r = fast_atan_unit(a);
+				r = r + big * (T(1.57079632679489661923f) - T(2.0f) * r);
+				return r * (T(1.0f) - T(2.0f) * fast_less(x, T(0.0f)));
+			}
+
+			template<typename T>
+			CRAFT_ENGINE_MATH_FUNC_DECL T fast_atan2(T y, T x)
+			{
+				T ax = fast_abs(x), ay = fast_abs(y);
+				T hi = fast_max(ax, ay);
+				T a = fast_min(ax, ay) / fast_max(hi, T(1e-30f));
+				T r = fast_atan_unit(a);
+				T steep = fast_less(ax, ay);
+				r = r + steep * (T(1.57079632679489661923f) - T(2.0f) * r);
+				T left = fast_less(x, T(0.0f));
+				r = r + left * (T(3.14159265358979323846f) - T(2.0f) * r);
+				return r * (T(1.0f) - T(2.0f) * fast_less(y, T(0.0f)));
+			}
+
+			template<typename T>
+			CRAFT_ENGINE_MATH_FUNC_DECL T fast_exp(T x) { return fast_exp_kernel(x); }
+			template<typename T>
+			CRAFT_ENGINE_MATH_FUNC_DECL T fast_exp2(T x) { return fast_exp2_kernel(x); }
+			template<typename T>
+			CRAFT_ENGINE_MATH_FUNC_DECL T fast_sin(T x) { return fast_sin_kernel(x, 0.0f); }
+			template<typename T>
+			CRAFT_ENGINE_MATH_FUNC_DECL T fast_cos(T x) { return fast_sin_kernel(x, 1.0f); }
+
+			// 0 where x <= 0, 1 where y == 0
+			template<typename T>
+			CRAFT_ENGINE_MATH_FUNC_DECL T fast_pow(T x, T y)
+			{
+				T positive = fast_less(T(0.0f), x);
+				T zero = T(1.0f) - fast_less(y, T(0.0f)) - fast_less(T(0.0f), y);
+				T safe = fast_max(x, T(1.17549435e-38f));
+				return fast_exp2_kernel(y * fast_log2(safe)) * positive * (T(1.0f) - zero) + zero;
+			}
+
+#if defined(CRAFT_ENGINE_MATH_FAST_EXACT)
+			template<typename F>
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 fast_per_lane(F f, simd_float8 const& a)
+			{
+				float x[8];
+				a.store(x);
+				for (int i = 0; i < 8; i++) x[i] = f(x[i]);
+				return simd_float8::load(x);
+			}
+			template<typename F>
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 fast_per_lane(F f, simd_float8 const& a, simd_float8 const& b)
+			{
+				float x[8], y[8];
+				a.store(x);
+				b.store(y);
+				for (int i = 0; i < 8; i++) x[i] = f(x[i], y[i]);
+				return simd_float8::load(x);
+			}
+#endif
+
+		}
+
+
+
+		namespace fast
+		{
+
+#if defined(CRAFT_ENGINE_MATH_FAST_EXACT)
+			CRAFT_ENGINE_MATH_FUNC_DECL float exp(float x) { return std::exp(x); }
+			CRAFT_ENGINE_MATH_FUNC_DECL float exp2(float x) { return std::exp2(x); }
+			CRAFT_ENGINE_MATH_FUNC_DECL float log(float x) { return std::log(x); }
+			CRAFT_ENGINE_MATH_FUNC_DECL float log2(float x) { return std::log2(x); }
+			CRAFT_ENGINE_MATH_FUNC_DECL float pow(float x, float y) { return std::pow(x, y); }
+			CRAFT_ENGINE_MATH_FUNC_DECL float sin(float x) { return std::sin(x); }
+			CRAFT_ENGINE_MATH_FUNC_DECL float cos(float x) { return std::cos(x); }
+			CRAFT_ENGINE_MATH_FUNC_DECL float atan(float x) { return std::atan(x); }
+			CRAFT_ENGINE_MATH_FUNC_DECL float atan2(float y, float x) { return std::atan2(y, x); }
+
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 exp(simd_float8 x) { return _Math_Detail::fast_per_lane([](float a) { return std::exp(a); }, x); }
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 exp2(simd_float8 x) { return _Math_Detail::fast_per_lane([](float a) { return std::exp2(a); }, x); }
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 log(simd_float8 x) { return _Math_Detail::fast_per_lane([](float a) { return std::log(a); }, x); }
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 log2(simd_float8 x) { return _Math_Detail::fast_per_lane([](float a) { return std::log2(a); }, x); }
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 pow(simd_float8 x, simd_float8 y) { return _Math_Detail::fast_per_lane([](float a, float b) { return std::pow(a, b); }, x, y); }
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 sin(simd_float8 x) { return _Math_Detail::fast_per_lane([](float a) { return std::sin(a); }, x); }
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 cos(simd_float8 x) { return _Math_Detail::fast_per_lane([](float a) { return std::cos(a); }, x); }
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 atan(simd_float8 x) { return _Math_Detail::fast_per_lane([](float a) { return std::atan(a); }, x); }
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 atan2(simd_float8 y, simd_float8 x) { return _Math_Detail::fast_per_lane([](float a, float b) { return std::atan2(a, b); }, y, x); }
+#else
+			// a float is faster in libm, see the header comment
+			CRAFT_ENGINE_MATH_FUNC_DECL float exp(float x) { return std::exp(x); }
+			CRAFT_ENGINE_MATH_FUNC_DECL float exp2(float x) { return std::exp2(x); }
+			CRAFT_ENGINE_MATH_FUNC_DECL float log(float x) { return std::log(x); }
+			CRAFT_ENGINE_MATH_FUNC_DECL float log2(float x) { return std::log2(x); }
+			CRAFT_ENGINE_MATH_FUNC_DECL float pow(float x, float y) { return std::pow(x, y); }
+			CRAFT_ENGINE_MATH_FUNC_DECL float sin(float x) { return std::sin(x); }
+			CRAFT_ENGINE_MATH_FUNC_DECL float cos(float x) { return std::cos(x); }
+			CRAFT_ENGINE_MATH_FUNC_DECL float atan(float x) { return _Math_Detail::fast_atan(x); }
+			CRAFT_ENGINE_MATH_FUNC_DECL float atan2(float y, float x) { return _Math_Detail::fast_atan2(y, x); }
+
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 exp(simd_float8 x) { return _Math_Detail::fast_exp(x); }
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 exp2(simd_float8 x) { return _Math_Detail::fast_exp2(x); }
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 log(simd_float8 x) { return _Math_Detail::fast_log(x); }
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 log2(simd_float8 x) { return _Math_Detail::fast_log2(x); }
+			// lanes with x <= 0 return 0, lanes with y == 0 return 1
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 pow(simd_float8 x, simd_float8 y) { return _Math_Detail::fast_pow(x, y); }
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 sin(simd_float8 x) { return _Math_Detail::fast_sin(x); }
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 cos(simd_float8 x) { return _Math_Detail::fast_cos(x); }
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 atan(simd_float8 x) { return _Math_Detail::fast_atan(x); }
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 atan2(simd_float8 y, simd_float8 x) { return _Math_Detail::fast_atan2(y, x); }
+#endif
+
+			// component-wise versions for Vector<Len, float> and Vector<Len, simd_float8>
+#define CRAFT_ENGINE_MATH_FAST_UNARY(name) \
+			template<length_t Len, typename Type> CRAFT_ENGINE_MATH_FUNC_DECL Vector<Len, Type> name(Vector<Len, Type> const& v) { return _Math_Detail::functor1<Vector, Len, Type>::call(fast::name, v); }
+#define CRAFT_ENGINE_MATH_FAST_BINARY(name) \
+			template<length_t Len, typename Type> CRAFT_ENGINE_MATH_FUNC_DECL Vector<Len, Type> name(Vector<Len, Type> const& a, Vector<Len, Type> const& b) { return _Math_Detail::functor2<Vector, Len, Type>::call(fast::name, a, b); }
+			CRAFT_ENGINE_MATH_FAST_UNARY(exp)
+			CRAFT_ENGINE_MATH_FAST_UNARY(exp2)
+			CRAFT_ENGINE_MATH_FAST_UNARY(log)
+			CRAFT_ENGINE_MATH_FAST_UNARY(log2)
+			CRAFT_ENGINE_MATH_FAST_UNARY(sin)
+			CRAFT_ENGINE_MATH_FAST_UNARY(cos)
+			CRAFT_ENGINE_MATH_FAST_UNARY(atan)
+			CRAFT_ENGINE_MATH_FAST_BINARY(pow)
+			CRAFT_ENGINE_MATH_FAST_BINARY(atan2)
+#undef CRAFT_ENGINE_MATH_FAST_UNARY
+#undef CRAFT_ENGINE_MATH_FAST_BINARY
+		}
+
+	}
+}
+
+#endif // !CRAFT_ENGINE_MATH_FAST_H_
@@ -6,6 +6,7 @@
 #include <assert.h>
 #include <cmath>
 #include <limits>
+#include "./LinearMathSimd.h"
 
 
 
@@ -18,6 +19,7 @@
 
 
 //#define CRAFT_ENGINE_USING_WORLD_SPACE_RIGHT_HAND
+//#define CRAFT_ENGINE_MATH_USING_SIMD // vec4/quat/mat4 float kernels, see LinearMathSimd.h
 
 
 #define CRAFT_ENGINE_MATH_CLIP_WORLD_SPACE_LH (1 << 0) // vulkan/direct3d
@@ -519,37 +521,37 @@ namespace CraftEngine
 			Type& operator[](uint32_t index) { return value[index]; }
 			Type const& operator[](uint32_t index)const { return value[index]; }
 
-			Vector<4, Type>& operator+=(Vector<4, Type> const& v) CRAFT_ENGINE_NOEXCEPT { x += v.x; y += v.y; z += v.z; w += v.w; return *this; }
-			Vector<4, Type>& operator-=(Vector<4, Type> const& v) CRAFT_ENGINE_NOEXCEPT { x -= v.x; y -= v.y; z -= v.z; w -= v.w; return *this; }
-			Vector<4, Type>& operator*=(Vector<4, Type> const& v) CRAFT_ENGINE_NOEXCEPT { x *= v.x; y *= v.y; z *= v.z; w *= v.w; return *this; }
-			Vector<4, Type>& operator/=(Vector<4, Type> const& v) CRAFT_ENGINE_NOEXCEPT { x /= v.x; y /= v.y; z /= v.z; w /= v.w; return *this; }
+			Vector<4, Type>& operator+=(Vector<4, Type> const& v) CRAFT_ENGINE_NOEXCEPT { if constexpr (_Math_Detail::simd4<Type>::enabled) return *this = _Math_Detail::simd4<Type>::vec4_add(*this, v); else { x += v.x; y += v.y; z += v.z; w += v.w; return *this; } }
+			Vector<4, Type>& operator-=(Vector<4, Type> const& v) CRAFT_ENGINE_NOEXCEPT { if constexpr (_Math_Detail::simd4<Type>::enabled) return *this = _Math_Detail::simd4<Type>::vec4_sub(*this, v); else { x -= v.x; y -= v.y; z -= v.z; w -= v.w; return *this; } }
+			Vector<4, Type>& operator*=(Vector<4, Type> const& v) CRAFT_ENGINE_NOEXCEPT { if constexpr (_Math_Detail::simd4<Type>::enabled) return *this = _Math_Detail::simd4<Type>::vec4_mul(*this, v); else { x *= v.x; y *= v.y; z *= v.z; w *= v.w; return *this; } }
+			Vector<4, Type>& operator/=(Vector<4, Type> const& v) CRAFT_ENGINE_NOEXCEPT { if constexpr (_Math_Detail::simd4<Type>::enabled) return *this = _Math_Detail::simd4<Type>::vec4_div(*this, v); else { x /= v.x; y /= v.y; z /= v.z; w /= v.w; return *this; } }
 			Vector<4, Type>& operator%=(Vector<4, Type> const& v) CRAFT_ENGINE_NOEXCEPT { x %= v.x; y %= v.y; z %= v.z; w %= v.w; return *this; }
-			Vector<4, Type>& operator+=(Type const& scalar) CRAFT_ENGINE_NOEXCEPT { x += scalar; y += scalar; z += scalar; w += scalar; return *this; }
-			Vector<4, Type>& operator-=(Type const& scalar) CRAFT_ENGINE_NOEXCEPT { x -= scalar; y -= scalar; z -= scalar; w += scalar; return *this; }
-			Vector<4, Type>& operator*=(Type const& scalar) CRAFT_ENGINE_NOEXCEPT { x *= scalar; y *= scalar; z *= scalar; w *= scalar; return *this; }
+			Vector<4, Type>& operator+=(Type const& scalar) CRAFT_ENGINE_NOEXCEPT { if constexpr (_Math_Detail::simd4<Type>::enabled) return *this = _Math_Detail::simd4<Type>::vec4_add(*this, scalar); else { x += scalar; y += scalar; z += scalar; w += scalar; return *this; } }
+			Vector<4, Type>& operator-=(Type const& scalar) CRAFT_ENGINE_NOEXCEPT { if constexpr (_Math_Detail::simd4<Type>::enabled) return *this = _Math_Detail::simd4<Type>::vec4_sub(*this, scalar); else { x -= scalar; y -= scalar; z -= scalar; w -= scalar; return *this; } }
+			Vector<4, Type>& operator*=(Type const& scalar) CRAFT_ENGINE_NOEXCEPT { if constexpr (_Math_Detail::simd4<Type>::enabled) return *this = _Math_Detail::simd4<Type>::vec4_mul(*this, scalar); else { x *= scalar; y *= scalar; z *= scalar; w *= scalar; return *this; } }
 			Vector<4, Type>& operator/=(Type const& scalar) CRAFT_ENGINE_NOEXCEPT { auto it = inverse(scalar);  return (*this) *= it; }
-			Vector<4, Type>  operator-()const { return Vector<4, Type>(-x, -y, -z, -w); }
+			Vector<4, Type>  operator-()const { if constexpr (_Math_Detail::simd4<Type>::enabled) return _Math_Detail::simd4<Type>::vec4_neg(*this); else return Vector<4, Type>(-x, -y, -z, -w); }
 			bool             operator==(const Vector<4, Type>& v)const { return x == v.x && y == v.y && z == v.z && w == v.w; }
 			bool             operator==(Type val)const { return x == val && y == val && z == val && w == val; }
 
-			CRAFT_ENGINE_MATH_FUNC_DECL CRAFT_ENGINE_CONSTEXPR friend Vector<4, Type> operator+(Vector<4, Type> const& v1, Vector<4, Type> const& v2) CRAFT_ENGINE_NOEXCEPT { return Vector<4, Type>(v1.x + v2.x, v1.y + v2.y, v1.z + v2.z, v1.w + v2.w); }
-			CRAFT_ENGINE_MATH_FUNC_DECL CRAFT_ENGINE_CONSTEXPR friend Vector<4, Type> operator-(Vector<4, Type> const& v1, Vector<4, Type> const& v2) CRAFT_ENGINE_NOEXCEPT { return Vector<4, Type>(v1.x - v2.x, v1.y - v2.y, v1.z - v2.z, v1.w - v2.w); }
-			CRAFT_ENGINE_MATH_FUNC_DECL CRAFT_ENGINE_CONSTEXPR friend Vector<4, Type> operator*(Vector<4, Type> const& v1, Vector<4, Type> const& v2) CRAFT_ENGINE_NOEXCEPT { return Vector<4, Type>(v1.x * v2.x, v1.y * v2.y, v1.z * v2.z, v1.w * v2.w); }
-			CRAFT_ENGINE_MATH_FUNC_DECL CRAFT_ENGINE_CONSTEXPR friend Vector<4, Type> operator/(Vector<4, Type> const& v1, Vector<4, Type> const& v2) CRAFT_ENGINE_NOEXCEPT { return Vector<4, Type>(v1.x / v2.x, v1.y / v2.y, v1.z / v2.z, v1.w / v2.w); }
+			CRAFT_ENGINE_MATH_FUNC_DECL CRAFT_ENGINE_CONSTEXPR friend Vector<4, Type> operator+(Vector<4, Type> const& v1, Vector<4, Type> const& v2) CRAFT_ENGINE_NOEXCEPT { if constexpr (_Math_Detail::simd4<Type>::enabled) return _Math_Detail::simd4<Type>::vec4_add(v1, v2); else return Vector<4, Type>(v1.x + v2.x, v1.y + v2.y, v1.z + v2.z, v1.w + v2.w); }
+			CRAFT_ENGINE_MATH_FUNC_DECL CRAFT_ENGINE_CONSTEXPR friend Vector<4, Type> operator-(Vector<4, Type> const& v1, Vector<4, Type> const& v2) CRAFT_ENGINE_NOEXCEPT { if constexpr (_Math_Detail::simd4<Type>::enabled) return _Math_Detail::simd4<Type>::vec4_sub(v1, v2); else return Vector<4, Type>(v1.x - v2.x, v1.y - v2.y, v1.z - v2.z, v1.w - v2.w); }
+			CRAFT_ENGINE_MATH_FUNC_DECL CRAFT_ENGINE_CONSTEXPR friend Vector<4, Type> operator*(Vector<4, Type> const& v1, Vector<4, Type> const& v2) CRAFT_ENGINE_NOEXCEPT { if constexpr (_Math_Detail::simd4<Type>::enabled) return _Math_Detail::simd4<Type>::vec4_mul(v1, v2); else return Vector<4, Type>(v1.x * v2.x, v1.y * v2.y, v1.z * v2.z, v1.w * v2.w); }
+			CRAFT_ENGINE_MATH_FUNC_DECL CRAFT_ENGINE_CONSTEXPR friend Vector<4, Type> operator/(Vector<4, Type> const& v1, Vector<4, Type> const& v2) CRAFT_ENGINE_NOEXCEPT { if constexpr (_Math_Detail::simd4<Type>::enabled) return _Math_Detail::simd4<Type>::vec4_div(v1, v2); else return Vector<4, Type>(v1.x / v2.x, v1.y / v2.y, v1.z / v2.z, v1.w / v2.w); }
 			CRAFT_ENGINE_MATH_FUNC_DECL CRAFT_ENGINE_CONSTEXPR friend Vector<4, Type> operator%(Vector<4, Type> const& v1, Vector<4, Type> const& v2) CRAFT_ENGINE_NOEXCEPT { return Vector<4, Type>(v1.x % v2.x, v1.y % v2.y, v1.z % v2.z, v1.w % v2.w); }
 
-			CRAFT_ENGINE_MATH_FUNC_DECL CRAFT_ENGINE_CONSTEXPR friend Vector<4, Type> operator+(Type scalar, Vector<4, Type> const& v) CRAFT_ENGINE_NOEXCEPT { return Vector<4, Type>(v.x + scalar, v.y + scalar, v.z + scalar, v.w + scalar); }
-			CRAFT_ENGINE_MATH_FUNC_DECL CRAFT_ENGINE_CONSTEXPR friend Vector<4, Type> operator-(Type scalar, Vector<4, Type> const& v) CRAFT_ENGINE_NOEXCEPT { return Vector<4, Type>(scalar - v.x, scalar - v.y, scalar - v.z, scalar - v.w); }
-			CRAFT_ENGINE_MATH_FUNC_DECL CRAFT_ENGINE_CONSTEXPR friend Vector<4, Type> operator*(Type scalar, Vector<4, Type> const& v) CRAFT_ENGINE_NOEXCEPT { return Vector<4, Type>(v.x * scalar, v.y * scalar, v.z * scalar, v.w * scalar); }
-			CRAFT_ENGINE_MATH_FUNC_DECL CRAFT_ENGINE_CONSTEXPR friend Vector<4, Type> operator/(Type scalar, Vector<4, Type> const& v) CRAFT_ENGINE_NOEXCEPT { return Vector<4, Type>(scalar / v.x, scalar / v.y, scalar / v.z, scalar / v.w); }
+			CRAFT_ENGINE_MATH_FUNC_DECL CRAFT_ENGINE_CONSTEXPR friend Vector<4, Type> operator+(Type scalar, Vector<4, Type> const& v) CRAFT_ENGINE_NOEXCEPT { if constexpr (_Math_Detail::simd4<Type>::enabled) return _Math_Detail::simd4<Type>::vec4_add(v, scalar); else return Vector<4, Type>(v.x + scalar, v.y + scalar, v.z + scalar, v.w + scalar); }
+			CRAFT_ENGINE_MATH_FUNC_DECL CRAFT_ENGINE_CONSTEXPR friend Vector<4, Type> operator-(Type scalar, Vector<4, Type> const& v) CRAFT_ENGINE_NOEXCEPT { if constexpr (_Math_Detail::simd4<Type>::enabled) return _Math_Detail::simd4<Type>::vec4_sub(scalar, v); else return Vector<4, Type>(scalar - v.x, scalar - v.y, scalar - v.z, scalar - v.w); }
+			CRAFT_ENGINE_MATH_FUNC_DECL CRAFT_ENGINE_CONSTEXPR friend Vector<4, Type> operator*(Type scalar, Vector<4, Type> const& v) CRAFT_ENGINE_NOEXCEPT { if constexpr (_Math_Detail::simd4<Type>::enabled) return _Math_Detail::simd4<Type>::vec4_mul(v, scalar); else return Vector<4, Type>(v.x * scalar, v.y * scalar, v.z * scalar, v.w * scalar); }
+			CRAFT_ENGINE_MATH_FUNC_DECL CRAFT_ENGINE_CONSTEXPR friend Vector<4, Type> operator/(Type scalar, Vector<4, Type> const& v) CRAFT_ENGINE_NOEXCEPT { if constexpr (_Math_Detail::simd4<Type>::enabled) return _Math_Detail::simd4<Type>::vec4_div(scalar, v); else return Vector<4, Type>(scalar / v.x, scalar / v.y, scalar / v.z, scalar / v.w); }
 
-			CRAFT_ENGINE_MATH_FUNC_DECL CRAFT_ENGINE_CONSTEXPR friend Vector<4, Type> operator+(Vector<4, Type> const& v, Type scalar) CRAFT_ENGINE_NOEXCEPT { return Vector<4, Type>(v.x + scalar, v.y + scalar, v.z + scalar, v.w + scalar); }
-			CRAFT_ENGINE_MATH_FUNC_DECL CRAFT_ENGINE_CONSTEXPR friend Vector<4, Type> operator-(Vector<4, Type> const& v, Type scalar) CRAFT_ENGINE_NOEXCEPT { return Vector<4, Type>(v.x - scalar, v.y - scalar, v.z - scalar, v.w - scalar); }
-			CRAFT_ENGINE_MATH_FUNC_DECL CRAFT_ENGINE_CONSTEXPR friend Vector<4, Type> operator*(Vector<4, Type> const& v, Type scalar) CRAFT_ENGINE_NOEXCEPT { return Vector<4, Type>(v.x * scalar, v.y * scalar, v.z * scalar, v.w * scalar); }
-			CRAFT_ENGINE_MATH_FUNC_DECL CRAFT_ENGINE_CONSTEXPR friend Vector<4, Type> operator/(Vector<4, Type> const& v, Type scalar) CRAFT_ENGINE_NOEXCEPT { return Vector<4, Type>(v.x / scalar, v.y / scalar, v.z / scalar, v.w / scalar); }
+			CRAFT_ENGINE_MATH_FUNC_DECL CRAFT_ENGINE_CONSTEXPR friend Vector<4, Type> operator+(Vector<4, Type> const& v, Type scalar) CRAFT_ENGINE_NOEXCEPT { if constexpr (_Math_Detail::simd4<Type>::enabled) return _Math_Detail::simd4<Type>::vec4_add(v, scalar); else return Vector<4, Type>(v.x + scalar, v.y + scalar, v.z + scalar, v.w + scalar); }
+			CRAFT_ENGINE_MATH_FUNC_DECL CRAFT_ENGINE_CONSTEXPR friend Vector<4, Type> operator-(Vector<4, Type> const& v, Type scalar) CRAFT_ENGINE_NOEXCEPT { if constexpr (_Math_Detail::simd4<Type>::enabled) return _Math_Detail::simd4<Type>::vec4_sub(v, scalar); else return Vector<4, Type>(v.x - scalar, v.y - scalar, v.z - scalar, v.w - scalar); }
+			CRAFT_ENGINE_MATH_FUNC_DECL CRAFT_ENGINE_CONSTEXPR friend Vector<4, Type> operator*(Vector<4, Type> const& v, Type scalar) CRAFT_ENGINE_NOEXCEPT { if constexpr (_Math_Detail::simd4<Type>::enabled) return _Math_Detail::simd4<Type>::vec4_mul(v, scalar); else return Vector<4, Type>(v.x * scalar, v.y * scalar, v.z * scalar, v.w * scalar); }
+			CRAFT_ENGINE_MATH_FUNC_DECL CRAFT_ENGINE_CONSTEXPR friend Vector<4, Type> operator/(Vector<4, Type> const& v, Type scalar) CRAFT_ENGINE_NOEXCEPT { if constexpr (_Math_Detail::simd4<Type>::enabled) return _Math_Detail::simd4<Type>::vec4_div(v, scalar); else return Vector<4, Type>(v.x / scalar, v.y / scalar, v.z / scalar, v.w / scalar); }
 
 			Type length()const CRAFT_ENGINE_NOEXCEPT { return std::sqrt(length2()); }
-			Type length2()const CRAFT_ENGINE_NOEXCEPT { return x * x + y * y + z * z + w * w; }
+			Type length2()const CRAFT_ENGINE_NOEXCEPT { return dot(*this); }
 			Vector<4, Type> normalize()const CRAFT_ENGINE_NOEXCEPT { auto il = inverse(length()); return *this * il; }
 			Vector<4, Type> mul(Vector<4, Type> const& v)const CRAFT_ENGINE_NOEXCEPT { return *this * v; }
 
@@ -563,7 +565,10 @@ namespace CraftEngine
 
 			CRAFT_ENGINE_MATH_FUNC_DECL CRAFT_ENGINE_CONSTEXPR Type dot(Vector<4, Type> const& v)const CRAFT_ENGINE_NOEXCEPT
 			{
-				return x * v.x + y * v.y + z * v.z + w * v.w;
+				if constexpr (_Math_Detail::simd4<Type>::enabled)
+					return _Math_Detail::simd4<Type>::vec4_dot(*this, v);
+				else
+					return x * v.x + y * v.y + z * v.z + w * v.w;
 			}
 
 		};
@@ -661,12 +666,15 @@ namespace CraftEngine
 			CRAFT_ENGINE_MATH_FUNC_DECL friend Quaternion operator-(Quaternion const& q1, Quaternion const& q2) CRAFT_ENGINE_NOEXCEPT { return Quaternion(q1.i - q2.i, q1.j - q2.j, q1.k - q2.k, q1.r - q2.r); }
 			CRAFT_ENGINE_MATH_FUNC_DECL friend Quaternion operator*(Quaternion const& p, Quaternion const& q)CRAFT_ENGINE_NOEXCEPT
 			{
-				return Quaternion(
-					p.r * q.i + p.i * q.r + p.j * q.k - p.k * q.j,
-					p.r * q.j + p.j * q.r + p.k * q.i - p.i * q.k,
-					p.r * q.k + p.k * q.r + p.i * q.j - p.j * q.i,
-					p.r * q.r - p.i * q.i - p.j * q.j - p.k * q.k
-				);
+				if constexpr (_Math_Detail::simd4<Type>::enabled)
+					return _Math_Detail::simd4<Type>::quat_mul(p, q);
+				else
+					return Quaternion(
+						p.r * q.i + p.i * q.r + p.j * q.k - p.k * q.j,
+						p.r * q.j + p.j * q.r + p.k * q.i - p.i * q.k,
+						p.r * q.k + p.k * q.r + p.i * q.j - p.j * q.i,
+						p.r * q.r - p.i * q.i - p.j * q.j - p.k * q.k
+					);
 			}
 
 			CRAFT_ENGINE_MATH_FUNC_DECL friend Vector<3, Type> operator*(Vector<3, Type> const& v, Quaternion const& q) CRAFT_ENGINE_NOEXCEPT
@@ -1010,6 +1018,8 @@ namespace CraftEngine
 
 			Matrix<4, 4, Type> transpose()const
 			{
+				if constexpr (_Math_Detail::simd4<Type>::enabled)
+					return _Math_Detail::simd4<Type>::mat4_transpose(*this);
 				return Matrix<4, 4, Type>(
 					{ c0.x,c1.x,c2.x,c3.x },
 					{ c0.y,c1.y,c2.y,c3.y },
@@ -1020,6 +1030,8 @@ namespace CraftEngine
 
 			Matrix<4, 4, Type> inverse()const
 			{
+				if constexpr (_Math_Detail::simd4<Type>::enabled)
+					return _Math_Detail::simd4<Type>::mat4_inverse(*this);
 				const mat4_t& m = *this;
 
 				value_t coef00 = m[2][2] * m[3][3] - m[3][2] * m[2][3];
@@ -1078,11 +1090,14 @@ namespace CraftEngine
 			CRAFT_ENGINE_CONSTEXPR Matrix<4, 4, Type>& operator*=(Matrix<4, 4, Type> const& m) { return *this = *this * m; }
 			CRAFT_ENGINE_CONSTEXPR Matrix<4, 4, Type>& operator*=(Type scalar) { c0 *= scalar; c1 *= scalar; c2 *= scalar, c3 *= scalar; return *this; }
 
-			CRAFT_ENGINE_MATH_FUNC_DECL friend Matrix<4, 4, Type> operator*(Matrix<4, 4, Type> const& m, Type scalar) { return Matrix<4, 4, Type>(m.c0 * scalar, m.c1 * scalar, m.c2 * scalar, m.c3 * scalar); }
-			CRAFT_ENGINE_MATH_FUNC_DECL friend Matrix<4, 4, Type> operator*(Type scalar, Matrix<4, 4, Type> const& m) { return Matrix<4, 4, Type>(m.c0 * scalar, m.c1 * scalar, m.c2 * scalar, m.c3 * scalar); }
+			CRAFT_ENGINE_MATH_FUNC_DECL friend Matrix<4, 4, Type> operator*(Matrix<4, 4, Type> const& m, Type scalar) { if constexpr (_Math_Detail::simd4<Type>::enabled) return _Math_Detail::simd4<Type>::mat4_mul(m, scalar); else return Matrix<4, 4, Type>(m.c0 * scalar, m.c1 * scalar, m.c2 * scalar, m.c3 * scalar); }
+			CRAFT_ENGINE_MATH_FUNC_DECL friend Matrix<4, 4, Type> operator*(Type scalar, Matrix<4, 4, Type> const& m) { return m * scalar; }
 
 			CRAFT_ENGINE_MATH_FUNC_DECL friend Matrix<4, 4, Type> operator*(Matrix<4, 4, Type> const& m1, Matrix<4, 4, Type> const& m2)
 			{
+				if constexpr (_Math_Detail::simd4<Type>::enabled)
+					return _Math_Detail::simd4<Type>::mat4_mul(m1, m2);
+
 				auto const& SrcA0 = m1[0];
 				auto const& SrcA1 = m1[1];
 				auto const& SrcA2 = m1[2];
@@ -1102,10 +1117,16 @@ namespace CraftEngine
 			}
 
 			CRAFT_ENGINE_MATH_FUNC_DECL friend row_vector operator*(Matrix<4, 4, Type> const& m, col_vector const& col_vec) {
-				return (col_vec[0] * m[0] + col_vec[1] * m[1] + col_vec[2] * m[2] + col_vec[3] * m[3]);
+				if constexpr (_Math_Detail::simd4<Type>::enabled)
+					return _Math_Detail::simd4<Type>::mat4_mul_vec(m, col_vec);
+				else
+					return (col_vec[0] * m[0] + col_vec[1] * m[1] + col_vec[2] * m[2] + col_vec[3] * m[3]);
 			}
 			CRAFT_ENGINE_MATH_FUNC_DECL friend col_vector operator*(row_vector const& row_vec, Matrix<4, 4, Type> const& m) {
-				return Vector<4, Type>(dot(m[0], row_vec), dot(m[1], row_vec), dot(m[2], row_vec), dot(m[3], row_vec));
+				if constexpr (_Math_Detail::simd4<Type>::enabled)
+					return _Math_Detail::simd4<Type>::vec_mul_mat4(row_vec, m);
+				else
+					return Vector<4, Type>(dot(m[0], row_vec), dot(m[1], row_vec), dot(m[2], row_vec), dot(m[3], row_vec));
 			}
 
 		};
@@ -2665,10 +2686,9 @@ namespace CraftEngine
 		}
 
 
-		union AABB
+		struct AABB
 		{
-			struct { vec3 mMin, mMax; };
-			struct { float xMin, yMin, zMin, xMax, yMax, zMax; };
+			vec3 mMin, mMax;
 		};
 
 
@@ -2688,4 +2708,7 @@ namespace CraftEngine
 	}
 }
 
+#include "./LinearMathWide.h"
+#include "./FastMath.h"
+
 #endif // !CRAFT_ENGINE_INCLUDED
\ No newline at end of file
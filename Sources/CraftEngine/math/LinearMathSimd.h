@@ -0,0 +1,281 @@
+#pragma once
+#ifndef CRAFT_ENGINE_MATH_SIMD_H_
+#define CRAFT_ENGINE_MATH_SIMD_H_
+
+#include "../Common.h"
+
+
+/*
+ Opt-in SIMD backend for Vector<4, float>, Quaternion<float> and Matrix<4, 4, float>.
+ Define CRAFT_ENGINE_MATH_USING_SIMD before including the math headers to select it.
+ Storage layout is unchanged (unaligned loads/stores), so the vector types keep their
+ size and alignment and can still be memcpy-ed into vertex/uniform buffers.
+*/
+#if defined(CRAFT_ENGINE_MATH_USING_SIMD)
+#	if defined(CRAFT_ENGINE_SIMD_SSE2)
+#		define CRAFT_ENGINE_MATH_SIMD_SSE
+#	elif defined(CRAFT_ENGINE_SIMD_NEON)
+#		define CRAFT_ENGINE_MATH_SIMD_NEON
+#	endif
+#endif
+
+namespace CraftEngine
+{
+	namespace math
+	{
+
+		namespace _Math_Detail
+		{
+
+			/*
+			 simd4<Type>::enabled selects the kernels at compile time. The kernels work on
+			 raw float[4] (vector/quaternion) and float[16] (column-major matrix) storage and
+			 keep the evaluation order of the scalar code, so results match it bit for bit
+			 unless the compiler contracts the scalar code into fused multiply-adds.
+			*/
+			template<typename Type>
+			struct simd4
+			{
+				static constexpr bool enabled = false;
+			};
+
+#if defined(CRAFT_ENGINE_MATH_SIMD_SSE) || defined(CRAFT_ENGINE_MATH_SIMD_NEON)
+			template<>
+			struct simd4<float>
+			{
+				static constexpr bool enabled = true;
+
+#if defined(CRAFT_ENGINE_MATH_SIMD_SSE)
+				typedef __m128 reg_t;
+				static inline reg_t load(const float* p) { return _mm_loadu_ps(p); }
+				static inline void  store(float* p, reg_t v) { _mm_storeu_ps(p, v); }
+				static inline reg_t set1(float s) { return _mm_set1_ps(s); }
+				static inline reg_t set(float x, float y, float z, float w) { return _mm_setr_ps(x, y, z, w); }
+				static inline reg_t add(reg_t a, reg_t b) { return _mm_add_ps(a, b); }
+				static inline reg_t sub(reg_t a, reg_t b) { return _mm_sub_ps(a, b); }
+				static inline reg_t mul(reg_t a, reg_t b) { return _mm_mul_ps(a, b); }
+				static inline reg_t div(reg_t a, reg_t b) { return _mm_div_ps(a, b); }
+				static inline reg_t neg(reg_t a) { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+				// lanes (a[i0], a[i1], b[i2], b[i3]), same as _mm_shuffle_ps
+				template<int i0, int i1, int i2, int i3>
+				static inline reg_t shuffle(reg_t a, reg_t b) { return _mm_shuffle_ps(a, b, _MM_SHUFFLE(i3, i2, i1, i0)); }
+				template<int i>
+				static inline reg_t splat(reg_t a) { return _mm_shuffle_ps(a, a, _MM_SHUFFLE(i, i, i, i)); }
+				static inline float hsum(reg_t v)
+				{
+					// ((x + y) + z) + w, the order of the scalar dot product
+					reg_t s = _mm_add_ss(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)));
+					s = _mm_add_ss(s, _mm_movehl_ps(v, v));
+					s = _mm_add_ss(s, _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)));
+					return _mm_cvtss_f32(s);
+				}
+				static inline void transpose(reg_t& c0, reg_t& c1, reg_t& c2, reg_t& c3) { _MM_TRANSPOSE4_PS(c0, c1, c2, c3); }
+#else
+				typedef float32x4_t reg_t;
+				static inline reg_t load(const float* p) { return vld1q_f32(p); }
+				static inline void  store(float* p, reg_t v) { vst1q_f32(p, v); }
+				static inline reg_t set1(float s) { return vdupq_n_f32(s); }
+				static inline reg_t set(float x, float y, float z, float w) { const float v[4] = { x, y, z, w }; return vld1q_f32(v); }
+				static inline reg_t add(reg_t a, reg_t b) { return vaddq_f32(a, b); }
+				static inline reg_t sub(reg_t a, reg_t b) { return vsubq_f32(a, b); }
+				static inline reg_t mul(reg_t a, reg_t b) { return vmulq_f32(a, b); }
+				static inline reg_t div(reg_t a, reg_t b)
+				{
+#if defined(__aarch64__) || defined(_M_ARM64)
+					return vdivq_f32(a, b);
+#else
+					float x[4], y[4];
+					vst1q_f32(x, a); vst1q_f32(y, b);
+					return set(x[0] / y[0], x[1] / y[1], x[2] / y[2], x[3] / y[3]);
+#endif
+				}
+				static inline reg_t neg(reg_t a) { return vnegq_f32(a); }
+				template<int i0, int i1, int i2, int i3>
+				static inline reg_t shuffle(reg_t a, reg_t b)
+				{
+					reg_t r = vdupq_n_f32(vgetq_lane_f32(a, i0));
+					r = vsetq_lane_f32(vgetq_lane_f32(a, i1), r, 1);
+					r = vsetq_lane_f32(vgetq_lane_f32(b, i2), r, 2);
+					return vsetq_lane_f32(vgetq_lane_f32(b, i3), r, 3);
+				}
+				template<int i>
+				static inline reg_t splat(reg_t a) { return vdupq_n_f32(vgetq_lane_f32(a, i)); }
+				static inline float hsum(reg_t v)
+				{
+					return ((vgetq_lane_f32(v, 0) + vgetq_lane_f32(v, 1)) + vgetq_lane_f32(v, 2)) + vgetq_lane_f32(v, 3);
+				}
+				static inline void transpose(reg_t& c0, reg_t& c1, reg_t& c2, reg_t& c3)
+				{
+					float32x4x2_t t01 = vtrnq_f32(c0, c1);
+					float32x4x2_t t23 = vtrnq_f32(c2, c3);
+					c0 = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+					c1 = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+					c2 = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+					c3 = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+				}
+#endif
+
+				// Vector<4, float>
+
+				static inline void vec4_add(float* r, const float* a, const float* b) { store(r, add(load(a), load(b))); }
+				static inline void vec4_sub(float* r, const float* a, const float* b) { store(r, sub(load(a), load(b))); }
+				static inline void vec4_mul(float* r, const float* a, const float* b) { store(r, mul(load(a), load(b))); }
+				static inline void vec4_div(float* r, const float* a, const float* b) { store(r, div(load(a), load(b))); }
+				static inline void vec4_add(float* r, const float* a, float s) { store(r, add(load(a), set1(s))); }
+				static inline void vec4_sub(float* r, const float* a, float s) { store(r, sub(load(a), set1(s))); }
+				static inline void vec4_sub(float* r, float s, const float* a) { store(r, sub(set1(s), load(a))); }
+				static inline void vec4_mul(float* r, const float* a, float s) { store(r, mul(load(a), set1(s))); }
+				static inline void vec4_div(float* r, const float* a, float s) { store(r, div(load(a), set1(s))); }
+				static inline void vec4_div(float* r, float s, const float* a) { store(r, div(set1(s), load(a))); }
+				static inline void vec4_neg(float* r, const float* a) { store(r, neg(load(a))); }
+				static inline float vec4_dot(const float* a, const float* b) { return hsum(mul(load(a), load(b))); }
+
+				// Quaternion<float>, storage (i, j, k, r)
+
+				static inline void quat_mul(float* r, const float* p, const float* q)
+				{
+					reg_t vp = load(p);
+					reg_t vq = load(q);
+					const reg_t signW = set(1.0f, 1.0f, 1.0f, -1.0f);
+					// (pr*qi, pr*qj, pr*qk, pr*qr)
+					reg_t a = mul(splat<3>(vp), vq);
+					// (pi*qr, pj*qr, pk*qr, -pi*qi)
+					reg_t b = mul(mul(shuffle<0, 1, 2, 0>(vp, vp), shuffle<3, 3, 3, 0>(vq, vq)), signW);
+					// (pj*qk, pk*qi, pi*qj, -pj*qj)
+					reg_t c = mul(mul(shuffle<1, 2, 0, 1>(vp, vp), shuffle<2, 0, 1, 1>(vq, vq)), signW);
+					// (pk*qj, pi*qk, pj*qi, pk*qk)
+					reg_t d = mul(shuffle<2, 0, 1, 2>(vp, vp), shuffle<1, 2, 0, 2>(vq, vq));
+					store(r, sub(add(add(a, b), c), d));
+				}
+
+				// Matrix<4, 4, float>, column-major float[16]
+
+				static inline reg_t mat4_mul_vec(reg_t c0, reg_t c1, reg_t c2, reg_t c3, reg_t v)
+				{
+					reg_t r = mul(c0, splat<0>(v));
+					r = add(r, mul(c1, splat<1>(v)));
+					r = add(r, mul(c2, splat<2>(v)));
+					return add(r, mul(c3, splat<3>(v)));
+				}
+				static inline void mat4_mul_vec(float* r, const float* m, const float* v)
+				{
+					store(r, mat4_mul_vec(load(m), load(m + 4), load(m + 8), load(m + 12), load(v)));
+				}
+				static inline void vec_mul_mat4(float* r, const float* v, const float* m)
+				{
+					// dot(m[i], v) for every column i, evaluated as transpose(m) * v
+					reg_t c0 = load(m), c1 = load(m + 4), c2 = load(m + 8), c3 = load(m + 12);
+					transpose(c0, c1, c2, c3);
+					store(r, mat4_mul_vec(c0, c1, c2, c3, load(v)));
+				}
+				static inline void mat4_mul(float* r, const float* a, const float* b)
+				{
+					reg_t a0 = load(a), a1 = load(a + 4), a2 = load(a + 8), a3 = load(a + 12);
+					// load all of b first so r may alias a or b
+					reg_t b0 = load(b), b1 = load(b + 4), b2 = load(b + 8), b3 = load(b + 12);
+					store(r, mat4_mul_vec(a0, a1, a2, a3, b0));
+					store(r + 4, mat4_mul_vec(a0, a1, a2, a3, b1));
+					store(r + 8, mat4_mul_vec(a0, a1, a2, a3, b2));
+					store(r + 12, mat4_mul_vec(a0, a1, a2, a3, b3));
+				}
+				static inline void mat4_mul(float* r, const float* m, float s)
+				{
+					reg_t vs = set1(s);
+					reg_t c0 = mul(load(m), vs), c1 = mul(load(m + 4), vs), c2 = mul(load(m + 8), vs), c3 = mul(load(m + 12), vs);
+					store(r, c0); store(r + 4, c1); store(r + 8, c2); store(r + 12, c3);
+				}
+				static inline void mat4_transpose(float* r, const float* m)
+				{
+					reg_t c0 = load(m), c1 = load(m + 4), c2 = load(m + 8), c3 = load(m + 12);
+					transpose(c0, c1, c2, c3);
+					store(r, c0); store(r + 4, c1); store(r + 8, c2); store(r + 12, c3);
+				}
+
+				// 2x2 cofactor column of Matrix<4, 4>::inverse() for the component pair (p, q):
+				// (m2p*m3q - m3p*m2q, <same>, m1p*m3q - m3p*m1q, m1p*m2q - m2p*m1q)
+				template<int p, int q>
+				static inline reg_t mat4_cofactor(reg_t m1, reg_t m2, reg_t m3)
+				{
+					reg_t xp = shuffle<p, p, p, p>(m2, m1);
+					reg_t xq = shuffle<q, q, q, q>(m2, m1);
+					reg_t yp = shuffle<p, p, p, p>(m3, m2);
+					reg_t yq = shuffle<q, q, q, q>(m3, m2);
+					yp = shuffle<0, 0, 0, 2>(yp, yp);
+					yq = shuffle<0, 0, 0, 2>(yq, yq);
+					return sub(mul(xp, yq), mul(yp, xq));
+				}
+				template<int i>
+				static inline reg_t mat4_inverse_tec(reg_t m0, reg_t m1)
+				{
+					// (m1[i], m0[i], m0[i], m0[i])
+					reg_t t = shuffle<i, i, i, i>(m1, m0);
+					return shuffle<0, 2, 2, 2>(t, t);
+				}
+				static inline void mat4_inverse(float* r, const float* m)
+				{
+					reg_t m0 = load(m), m1 = load(m + 4), m2 = load(m + 8), m3 = load(m + 12);
+
+					reg_t fac0 = mat4_cofactor<2, 3>(m1, m2, m3);
+					reg_t fac1 = mat4_cofactor<1, 3>(m1, m2, m3);
+					reg_t fac2 = mat4_cofactor<1, 2>(m1, m2, m3);
+					reg_t fac3 = mat4_cofactor<0, 3>(m1, m2, m3);
+					reg_t fac4 = mat4_cofactor<0, 2>(m1, m2, m3);
+					reg_t fac5 = mat4_cofactor<0, 1>(m1, m2, m3);
+
+					reg_t tec0 = mat4_inverse_tec<0>(m0, m1);
+					reg_t tec1 = mat4_inverse_tec<1>(m0, m1);
+					reg_t tec2 = mat4_inverse_tec<2>(m0, m1);
+					reg_t tec3 = mat4_inverse_tec<3>(m0, m1);
+
+					const reg_t signA = set(+1.0f, -1.0f, +1.0f, -1.0f);
+					const reg_t signB = set(-1.0f, +1.0f, -1.0f, +1.0f);
+					reg_t inv0 = mul(add(sub(mul(tec1, fac0), mul(tec2, fac1)), mul(tec3, fac2)), signA);
+					reg_t inv1 = mul(add(sub(mul(tec0, fac0), mul(tec2, fac3)), mul(tec3, fac4)), signB);
+					reg_t inv2 = mul(add(sub(mul(tec0, fac1), mul(tec1, fac3)), mul(tec3, fac5)), signA);
+					reg_t inv3 = mul(add(sub(mul(tec0, fac2), mul(tec1, fac4)), mul(tec2, fac5)), signB);
+
+					// (inv0[0], inv1[0], inv2[0], inv3[0])
+					reg_t row0 = shuffle<0, 2, 0, 2>(shuffle<0, 0, 0, 0>(inv0, inv1), shuffle<0, 0, 0, 0>(inv2, inv3));
+					float dot0[4];
+					store(dot0, mul(m0, row0));
+					float dot1 = (dot0[0] + dot0[1]) + (dot0[2] + dot0[3]);
+					reg_t oneOverDeterminant = set1(1.0f / dot1);
+
+					store(r, mul(inv0, oneOverDeterminant));
+					store(r + 4, mul(inv1, oneOverDeterminant));
+					store(r + 8, mul(inv2, oneOverDeterminant));
+					store(r + 12, mul(inv3, oneOverDeterminant));
+				}
+
+				// Value-level wrappers used by LinearMath.h
+
+				template<typename Vec> static inline Vec vec4_add(Vec const& a, Vec const& b) { Vec r; vec4_add(r.value, a.value, b.value); return r; }
+				template<typename Vec> static inline Vec vec4_sub(Vec const& a, Vec const& b) { Vec r; vec4_sub(r.value, a.value, b.value); return r; }
+				template<typename Vec> static inline Vec vec4_mul(Vec const& a, Vec const& b) { Vec r; vec4_mul(r.value, a.value, b.value); return r; }
+				template<typename Vec> static inline Vec vec4_div(Vec const& a, Vec const& b) { Vec r; vec4_div(r.value, a.value, b.value); return r; }
+				template<typename Vec> static inline Vec vec4_add(Vec const& a, float s) { Vec r; vec4_add(r.value, a.value, s); return r; }
+				template<typename Vec> static inline Vec vec4_sub(Vec const& a, float s) { Vec r; vec4_sub(r.value, a.value, s); return r; }
+				template<typename Vec> static inline Vec vec4_sub(float s, Vec const& a) { Vec r; vec4_sub(r.value, s, a.value); return r; }
+				template<typename Vec> static inline Vec vec4_mul(Vec const& a, float s) { Vec r; vec4_mul(r.value, a.value, s); return r; }
+				template<typename Vec> static inline Vec vec4_div(Vec const& a, float s) { Vec r; vec4_div(r.value, a.value, s); return r; }
+				template<typename Vec> static inline Vec vec4_div(float s, Vec const& a) { Vec r; vec4_div(r.value, s, a.value); return r; }
+				template<typename Vec> static inline Vec vec4_neg(Vec const& a) { Vec r; vec4_neg(r.value, a.value); return r; }
+				template<typename Vec> static inline float vec4_dot(Vec const& a, Vec const& b) { return vec4_dot(a.value, b.value); }
+
+				template<typename Quat> static inline Quat quat_mul(Quat const& p, Quat const& q) { Quat r; quat_mul(r.value, p.value, q.value); return r; }
+
+				template<typename Mat> static inline Mat mat4_mul(Mat const& a, Mat const& b) { Mat r; mat4_mul(r.value[0].value, a.value[0].value, b.value[0].value); return r; }
+				template<typename Mat> static inline Mat mat4_mul(Mat const& m, float s) { Mat r; mat4_mul(r.value[0].value, m.value[0].value, s); return r; }
+				template<typename Mat> static inline Mat mat4_transpose(Mat const& m) { Mat r; mat4_transpose(r.value[0].value, m.value[0].value); return r; }
+				template<typename Mat> static inline Mat mat4_inverse(Mat const& m) { Mat r; mat4_inverse(r.value[0].value, m.value[0].value); return r; }
+				template<typename Mat, typename Vec> static inline Vec mat4_mul_vec(Mat const& m, Vec const& v) { Vec r; mat4_mul_vec(r.value, m.value[0].value, v.value); return r; }
+				template<typename Vec, typename Mat> static inline Vec vec_mul_mat4(Vec const& v, Mat const& m) { Vec r; vec_mul_mat4(r.value, v.value, m.value[0].value); return r; }
+			};
+#endif
+
+		}
+
+	}
+}
+
+#endif // CRAFT_ENGINE_MATH_SIMD_H_
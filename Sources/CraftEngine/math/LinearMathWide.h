@@ -0,0 +1,498 @@
+#pragma once
+#ifndef CRAFT_ENGINE_MATH_WIDE_H_
+#define CRAFT_ENGINE_MATH_WIDE_H_
+
+#include "./LinearMath.h"
+#include <stddef.h>
+
+
+namespace CraftEngine
+{
+	namespace math
+	{
+
+		/*
+		 simd_float8: eight float lanes in one AVX register, two SSE2/NEON registers or a plain array.
+		 It is the component type of the structure-of-arrays packets vec3x8/vec4x8, so
+		 Vector<3, simd_float8> has the usual Vector API and every operation handles eight items.
+		*/
+		struct simd_float8
+		{
+#if defined(CRAFT_ENGINE_SIMD_AVX2)
+			__m256 v;
+#elif defined(CRAFT_ENGINE_SIMD_SSE2)
+			__m128 lo, hi;
+#elif defined(CRAFT_ENGINE_SIMD_NEON)
+			float32x4_t lo, hi;
+#else
+			float v[8];
+#endif
+
+			simd_float8() {}
+			simd_float8(float s)
+			{
+#if defined(CRAFT_ENGINE_SIMD_AVX2)
+				v = _mm256_set1_ps(s);
+#elif defined(CRAFT_ENGINE_SIMD_SSE2)
+				lo = hi = _mm_set1_ps(s);
+#elif defined(CRAFT_ENGINE_SIMD_NEON)
+				lo = hi = vdupq_n_f32(s);
+#else
+				for (int i = 0; i < 8; i++) v[i] = s;
+#endif
+			}
+
+			// Loads eight consecutive floats, p need not be aligned
+			static simd_float8 load(const float* p)
+			{
+				simd_float8 r;
+#if defined(CRAFT_ENGINE_SIMD_AVX2)
+				r.v = _mm256_loadu_ps(p);
+#elif defined(CRAFT_ENGINE_SIMD_SSE2)
+				r.lo = _mm_loadu_ps(p); r.hi = _mm_loadu_ps(p + 4);
+#elif defined(CRAFT_ENGINE_SIMD_NEON)
+				r.lo = vld1q_f32(p); r.hi = vld1q_f32(p + 4);
+#else
+				for (int i = 0; i < 8; i++) r.v[i] = p[i];
+#endif
+				return r;
+			}
+
+			void store(float* p) const
+			{
+#if defined(CRAFT_ENGINE_SIMD_AVX2)
+				_mm256_storeu_ps(p, v);
+#elif defined(CRAFT_ENGINE_SIMD_SSE2)
+				_mm_storeu_ps(p, lo); _mm_storeu_ps(p + 4, hi);
+#elif defined(CRAFT_ENGINE_SIMD_NEON)
+				vst1q_f32(p, lo); vst1q_f32(p + 4, hi);
+#else
+				for (int i = 0; i < 8; i++) p[i] = v[i];
+#endif
+			}
+
+			float operator[](int index) const { float lanes[8]; store(lanes); return lanes[index]; }
+
+			simd_float8& operator+=(simd_float8 const& b);
+			simd_float8& operator-=(simd_float8 const& b);
+			simd_float8& operator*=(simd_float8 const& b);
+			simd_float8& operator/=(simd_float8 const& b);
+		};
+
+#if defined(CRAFT_ENGINE_SIMD_AVX2)
+#	define CRAFT_ENGINE_MATH_WIDE_BINARY(a, b, avx, sse, neon, op) simd_float8 r; r.v = avx(a.v, b.v); return r;
+#	define CRAFT_ENGINE_MATH_WIDE_UNARY(a, avx, sse, neon, op) simd_float8 r; r.v = avx(a.v); return r;
+#elif defined(CRAFT_ENGINE_SIMD_SSE2)
+#	define CRAFT_ENGINE_MATH_WIDE_BINARY(a, b, avx, sse, neon, op) simd_float8 r; r.lo = sse(a.lo, b.lo); r.hi = sse(a.hi, b.hi); return r;
+#	define CRAFT_ENGINE_MATH_WIDE_UNARY(a, avx, sse, neon, op) simd_float8 r; r.lo = sse(a.lo); r.hi = sse(a.hi); return r;
+#elif defined(CRAFT_ENGINE_SIMD_NEON)
+#	define CRAFT_ENGINE_MATH_WIDE_BINARY(a, b, avx, sse, neon, op) simd_float8 r; r.lo = neon(a.lo, b.lo); r.hi = neon(a.hi, b.hi); return r;
+#	define CRAFT_ENGINE_MATH_WIDE_UNARY(a, avx, sse, neon, op) simd_float8 r; r.lo = neon(a.lo); r.hi = neon(a.hi); return r;
+#else
+#	define CRAFT_ENGINE_MATH_WIDE_BINARY(a, b, avx, sse, neon, op) simd_float8 r; for (int i = 0; i < 8; i++) r.v[i] = op(a.v[i], b.v[i]); return r;
+#	define CRAFT_ENGINE_MATH_WIDE_UNARY(a, avx, sse, neon, op) simd_float8 r; for (int i = 0; i < 8; i++) r.v[i] = op(a.v[i]); return r;
+#endif
+
+		namespace _Math_Detail
+		{
+			CRAFT_ENGINE_MATH_FUNC_DECL float wide_add(float a, float b) { return a + b; }
+			CRAFT_ENGINE_MATH_FUNC_DECL float wide_sub(float a, float b) { return a - b; }
+			CRAFT_ENGINE_MATH_FUNC_DECL float wide_mul(float a, float b) { return a * b; }
+			CRAFT_ENGINE_MATH_FUNC_DECL float wide_div(float a, float b) { return a / b; }
+			CRAFT_ENGINE_MATH_FUNC_DECL float wide_min(float a, float b) { return a < b ? a : b; }
+			CRAFT_ENGINE_MATH_FUNC_DECL float wide_max(float a, float b) { return a > b ? a : b; }
+			CRAFT_ENGINE_MATH_FUNC_DECL float wide_sqrt(float a) { return std::sqrt(a); }
+			CRAFT_ENGINE_MATH_FUNC_DECL float wide_abs(float a) { return std::abs(a); }
+			CRAFT_ENGINE_MATH_FUNC_DECL float wide_neg(float a) { return -a; }
+#if defined(CRAFT_ENGINE_SIMD_AVX2)
+			CRAFT_ENGINE_MATH_FUNC_DECL __m256 wide_abs_avx(__m256 a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+			CRAFT_ENGINE_MATH_FUNC_DECL __m256 wide_neg_avx(__m256 a) { return _mm256_xor_ps(_mm256_set1_ps(-0.0f), a); }
+#elif defined(CRAFT_ENGINE_SIMD_SSE2)
+			CRAFT_ENGINE_MATH_FUNC_DECL __m128 wide_abs_sse(__m128 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+			CRAFT_ENGINE_MATH_FUNC_DECL __m128 wide_neg_sse(__m128 a) { return _mm_xor_ps(_mm_set1_ps(-0.0f), a); }
+#elif defined(CRAFT_ENGINE_SIMD_NEON)
+			CRAFT_ENGINE_MATH_FUNC_DECL float32x4_t wide_div_neon(float32x4_t a, float32x4_t b)
+			{
+#if defined(__aarch64__) || defined(_M_ARM64)
+				return vdivq_f32(a, b);
+#else
+				float x[4], y[4];
+				vst1q_f32(x, a); vst1q_f32(y, b);
+				for (int i = 0; i < 4; i++) x[i] /= y[i];
+				return vld1q_f32(x);
+#endif
+			}
+			CRAFT_ENGINE_MATH_FUNC_DECL float32x4_t wide_sqrt_neon(float32x4_t a)
+			{
+#if defined(__aarch64__) || defined(_M_ARM64)
+				return vsqrtq_f32(a);
+#else
+				float x[4];
+				vst1q_f32(x, a);
+				for (int i = 0; i < 4; i++) x[i] = std::sqrt(x[i]);
+				return vld1q_f32(x);
+#endif
+			}
+#endif
+		}
+
+		CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 operator+(simd_float8 const& a, simd_float8 const& b) { CRAFT_ENGINE_MATH_WIDE_BINARY(a, b, _mm256_add_ps, _mm_add_ps, vaddq_f32, _Math_Detail::wide_add) }
+		CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 operator-(simd_float8 const& a, simd_float8 const& b) { CRAFT_ENGINE_MATH_WIDE_BINARY(a, b, _mm256_sub_ps, _mm_sub_ps, vsubq_f32, _Math_Detail::wide_sub) }
+		CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 operator*(simd_float8 const& a, simd_float8 const& b) { CRAFT_ENGINE_MATH_WIDE_BINARY(a, b, _mm256_mul_ps, _mm_mul_ps, vmulq_f32, _Math_Detail::wide_mul) }
+		CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 operator/(simd_float8 const& a, simd_float8 const& b) { CRAFT_ENGINE_MATH_WIDE_BINARY(a, b, _mm256_div_ps, _mm_div_ps, _Math_Detail::wide_div_neon, _Math_Detail::wide_div) }
+		CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 operator-(simd_float8 const& a) { CRAFT_ENGINE_MATH_WIDE_UNARY(a, _Math_Detail::wide_neg_avx, _Math_Detail::wide_neg_sse, vnegq_f32, _Math_Detail::wide_neg) }
+		CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 min(simd_float8 const& a, simd_float8 const& b) { CRAFT_ENGINE_MATH_WIDE_BINARY(a, b, _mm256_min_ps, _mm_min_ps, vminq_f32, _Math_Detail::wide_min) }
+		CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 max(simd_float8 const& a, simd_float8 const& b) { CRAFT_ENGINE_MATH_WIDE_BINARY(a, b, _mm256_max_ps, _mm_max_ps, vmaxq_f32, _Math_Detail::wide_max) }
+		CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 sqrt(simd_float8 const& a) { CRAFT_ENGINE_MATH_WIDE_UNARY(a, _mm256_sqrt_ps, _mm_sqrt_ps, _Math_Detail::wide_sqrt_neon, _Math_Detail::wide_sqrt) }
+		CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 abs(simd_float8 const& a) { CRAFT_ENGINE_MATH_WIDE_UNARY(a, _Math_Detail::wide_abs_avx, _Math_Detail::wide_abs_sse, vabsq_f32, _Math_Detail::wide_abs) }
+
+#undef CRAFT_ENGINE_MATH_WIDE_BINARY
+#undef CRAFT_ENGINE_MATH_WIDE_UNARY
+
+		CRAFT_ENGINE_MATH_FUNC_DECL simd_float8& simd_float8::operator+=(simd_float8 const& b) { return *this = *this + b; }
+		CRAFT_ENGINE_MATH_FUNC_DECL simd_float8& simd_float8::operator-=(simd_float8 const& b) { return *this = *this - b; }
+		CRAFT_ENGINE_MATH_FUNC_DECL simd_float8& simd_float8::operator*=(simd_float8 const& b) { return *this = *this * b; }
+		CRAFT_ENGINE_MATH_FUNC_DECL simd_float8& simd_float8::operator/=(simd_float8 const& b) { return *this = *this / b; }
+
+		// Bit i is set when a[i] <= b[i]
+		CRAFT_ENGINE_MATH_FUNC_DECL uint32_t lessEqualMask(simd_float8 const& a, simd_float8 const& b)
+		{
+#if defined(CRAFT_ENGINE_SIMD_AVX2)
+			return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)));
+#elif defined(CRAFT_ENGINE_SIMD_SSE2)
+			return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(a.lo, b.lo)) | (_mm_movemask_ps(_mm_cmple_ps(a.hi, b.hi)) << 4));
+#elif defined(CRAFT_ENGINE_SIMD_NEON)
+			uint32x4_t l = vcleq_f32(a.lo, b.lo), h = vcleq_f32(a.hi, b.hi);
+			return (vgetq_lane_u32(l, 0) & 1) | (vgetq_lane_u32(l, 1) & 2) | (vgetq_lane_u32(l, 2) & 4) | (vgetq_lane_u32(l, 3) & 8) |
+				(vgetq_lane_u32(h, 0) & 16) | (vgetq_lane_u32(h, 1) & 32) | (vgetq_lane_u32(h, 2) & 64) | (vgetq_lane_u32(h, 3) & 128);
+#else
+			uint32_t mask = 0;
+			for (int i = 0; i < 8; i++) mask |= (a.v[i] <= b.v[i] ? 1u : 0u) << i;
+			return mask;
+#endif
+		}
+
+		// Lane i is b[i] when bit i of mask is set and a[i] otherwise
+		CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 select(uint32_t mask, simd_float8 const& a, simd_float8 const& b)
+		{
+			simd_float8 r;
+#if defined(CRAFT_ENGINE_SIMD_AVX2)
+			__m256i bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+			__m256i m = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(static_cast<int>(mask)), bits), bits);
+			r.v = _mm256_blendv_ps(a.v, b.v, _mm256_castsi256_ps(m));
+#elif defined(CRAFT_ENGINE_SIMD_SSE2)
+			__m128i bits = _mm_setr_epi32(1, 2, 4, 8);
+			__m128 l = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(static_cast<int>(mask)), bits), bits));
+			__m128 h = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(static_cast<int>(mask >> 4)), bits), bits));
+			r.lo = _mm_or_ps(_mm_and_ps(l, b.lo), _mm_andnot_ps(l, a.lo));
+			r.hi = _mm_or_ps(_mm_and_ps(h, b.hi), _mm_andnot_ps(h, a.hi));
+#elif defined(CRAFT_ENGINE_SIMD_NEON)
+			static const uint32_t lanes[4] = { 1, 2, 4, 8 };
+			uint32x4_t bits = vld1q_u32(lanes);
+			r.lo = vbslq_f32(vtstq_u32(vdupq_n_u32(mask), bits), b.lo, a.lo);
+			r.hi = vbslq_f32(vtstq_u32(vdupq_n_u32(mask >> 4), bits), b.hi, a.hi);
+#else
+			for (int i = 0; i < 8; i++) r.v[i] = (mask >> i) & 1 ? b.v[i] : a.v[i];
+#endif
+			return r;
+		}
+
+		CRAFT_ENGINE_MATH_FUNC_DECL float reduceMin(simd_float8 const& a)
+		{
+			float lanes[8];
+			a.store(lanes);
+			return math::min(math::min(math::min(lanes[0], lanes[1]), math::min(lanes[2], lanes[3])), math::min(math::min(lanes[4], lanes[5]), math::min(lanes[6], lanes[7])));
+		}
+		CRAFT_ENGINE_MATH_FUNC_DECL float reduceMax(simd_float8 const& a)
+		{
+			float lanes[8];
+			a.store(lanes);
+			return math::max(math::max(math::max(lanes[0], lanes[1]), math::max(lanes[2], lanes[3])), math::max(math::max(lanes[4], lanes[5]), math::max(lanes[6], lanes[7])));
+		}
+
+
+
+		typedef Vector<3, simd_float8> vec3x8;
+		typedef Vector<4, simd_float8> vec4x8;
+
+		// The member length()/normalize() go through std::sqrt, these overloads keep the packets in registers
+		CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 length(vec3x8 const& v) { return sqrt(v.length2()); }
+		CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 length(vec4x8 const& v) { return sqrt(v.x * v.x + v.y * v.y + v.z * v.z + v.w * v.w); }
+		CRAFT_ENGINE_MATH_FUNC_DECL vec3x8 normalize(vec3x8 const& v) { return v * (simd_float8(1.0f) / length(v)); }
+		CRAFT_ENGINE_MATH_FUNC_DECL vec4x8 normalize(vec4x8 const& v) { return v * (simd_float8(1.0f) / length(v)); }
+
+
+
+		namespace _Math_Detail
+		{
+#if defined(CRAFT_ENGINE_SIMD_SSE2) || defined(CRAFT_ENGINE_SIMD_NEON)
+#	if defined(CRAFT_ENGINE_SIMD_SSE2)
+			typedef __m128 wide_half_t;
+			// four packed vec3 (x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3) to x, y, z
+			CRAFT_ENGINE_MATH_FUNC_DECL void wide_deinterleave3(const float* p, __m128& x, __m128& y, __m128& z)
+			{
+				__m128 a = _mm_loadu_ps(p), b = _mm_loadu_ps(p + 4), c = _mm_loadu_ps(p + 8);
+				x = _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+				y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+				z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+			}
+			CRAFT_ENGINE_MATH_FUNC_DECL void wide_interleave3(float* p, __m128 x, __m128 y, __m128 z)
+			{
+				_mm_storeu_ps(p, _mm_shuffle_ps(_mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 0, 0, 0)), _mm_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0)));
+				_mm_storeu_ps(p + 4, _mm_shuffle_ps(_mm_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1)), _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0)));
+				_mm_storeu_ps(p + 8, _mm_shuffle_ps(_mm_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 2, 2)), _mm_shuffle_ps(y, z, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0)));
+			}
+			CRAFT_ENGINE_MATH_FUNC_DECL void wide_deinterleave4(const float* p, __m128& x, __m128& y, __m128& z, __m128& w)
+			{
+				x = _mm_loadu_ps(p); y = _mm_loadu_ps(p + 4); z = _mm_loadu_ps(p + 8); w = _mm_loadu_ps(p + 12);
+				_MM_TRANSPOSE4_PS(x, y, z, w);
+			}
+			CRAFT_ENGINE_MATH_FUNC_DECL void wide_interleave4(float* p, __m128 x, __m128 y, __m128 z, __m128 w)
+			{
+				_MM_TRANSPOSE4_PS(x, y, z, w);
+				_mm_storeu_ps(p, x); _mm_storeu_ps(p + 4, y); _mm_storeu_ps(p + 8, z); _mm_storeu_ps(p + 12, w);
+			}
+#	else
+			typedef float32x4_t wide_half_t;
+			CRAFT_ENGINE_MATH_FUNC_DECL void wide_deinterleave3(const float* p, float32x4_t& x, float32x4_t& y, float32x4_t& z)
+			{
+				float32x4x3_t v = vld3q_f32(p);
+				x = v.val[0]; y = v.val[1]; z = v.val[2];
+			}
+			CRAFT_ENGINE_MATH_FUNC_DECL void wide_interleave3(float* p, float32x4_t x, float32x4_t y, float32x4_t z)
+			{
+				float32x4x3_t v;
+				v.val[0] = x; v.val[1] = y; v.val[2] = z;
+				vst3q_f32(p, v);
+			}
+			CRAFT_ENGINE_MATH_FUNC_DECL void wide_deinterleave4(const float* p, float32x4_t& x, float32x4_t& y, float32x4_t& z, float32x4_t& w)
+			{
+				float32x4x4_t v = vld4q_f32(p);
+				x = v.val[0]; y = v.val[1]; z = v.val[2]; w = v.val[3];
+			}
+			CRAFT_ENGINE_MATH_FUNC_DECL void wide_interleave4(float* p, float32x4_t x, float32x4_t y, float32x4_t z, float32x4_t w)
+			{
+				float32x4x4_t v;
+				v.val[0] = x; v.val[1] = y; v.val[2] = z; v.val[3] = w;
+				vst4q_f32(p, v);
+			}
+#	endif
+			CRAFT_ENGINE_MATH_FUNC_DECL simd_float8 wide_combine(wide_half_t lo, wide_half_t hi)
+			{
+				simd_float8 r;
+#	if defined(CRAFT_ENGINE_SIMD_AVX2)
+				r.v = _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+#	else
+				r.lo = lo; r.hi = hi;
+#	endif
+				return r;
+			}
+			CRAFT_ENGINE_MATH_FUNC_DECL wide_half_t wide_low(simd_float8 const& a)
+			{
+#	if defined(CRAFT_ENGINE_SIMD_AVX2)
+				return _mm256_castps256_ps128(a.v);
+#	else
+				return a.lo;
+#	endif
+			}
+			CRAFT_ENGINE_MATH_FUNC_DECL wide_half_t wide_high(simd_float8 const& a)
+			{
+#	if defined(CRAFT_ENGINE_SIMD_AVX2)
+				return _mm256_extractf128_ps(a.v, 1);
+#	else
+				return a.hi;
+#	endif
+			}
+#	define CRAFT_ENGINE_MATH_WIDE_INTERLEAVE
+#endif
+		}
+
+		/*
+		 AoS <-> SoA conversion. count < 8 loads the remaining lanes with zero and stores only count items.
+		*/
+		CRAFT_ENGINE_MATH_FUNC_DECL vec3x8 packVec3x8(const vec3* src, size_t count = 8)
+		{
+#if defined(CRAFT_ENGINE_MATH_WIDE_INTERLEAVE)
+			if (count == 8)
+			{
+				const float* p = reinterpret_cast<const float*>(src);
+				_Math_Detail::wide_half_t x0, y0, z0, x1, y1, z1;
+				_Math_Detail::wide_deinterleave3(p, x0, y0, z0);
+				_Math_Detail::wide_deinterleave3(p + 12, x1, y1, z1);
+				return vec3x8(_Math_Detail::wide_combine(x0, x1), _Math_Detail::wide_combine(y0, y1), _Math_Detail::wide_combine(z0, z1));
+			}
+#endif
+			float lanes[3][8] = {};
+			for (size_t i = 0; i < count; i++)
+			{
+				lanes[0][i] = src[i].x;
+				lanes[1][i] = src[i].y;
+				lanes[2][i] = src[i].z;
+			}
+			return vec3x8(simd_float8::load(lanes[0]), simd_float8::load(lanes[1]), simd_float8::load(lanes[2]));
+		}
+		CRAFT_ENGINE_MATH_FUNC_DECL void unpackVec3x8(vec3x8 const& v, vec3* dst, size_t count = 8)
+		{
+#if defined(CRAFT_ENGINE_MATH_WIDE_INTERLEAVE)
+			if (count == 8)
+			{
+				float* p = reinterpret_cast<float*>(dst);
+				_Math_Detail::wide_interleave3(p, _Math_Detail::wide_low(v.x), _Math_Detail::wide_low(v.y), _Math_Detail::wide_low(v.z));
+				_Math_Detail::wide_interleave3(p + 12, _Math_Detail::wide_high(v.x), _Math_Detail::wide_high(v.y), _Math_Detail::wide_high(v.z));
+				return;
+			}
+#endif
+			float lanes[3][8];
+			v.x.store(lanes[0]);
+			v.y.store(lanes[1]);
+			v.z.store(lanes[2]);
+			for (size_t i = 0; i < count; i++)
+				dst[i] = vec3(lanes[0][i], lanes[1][i], lanes[2][i]);
+		}
+		CRAFT_ENGINE_MATH_FUNC_DECL vec4x8 packVec4x8(const vec4* src, size_t count = 8)
+		{
+#if defined(CRAFT_ENGINE_MATH_WIDE_INTERLEAVE)
+			if (count == 8)
+			{
+				const float* p = reinterpret_cast<const float*>(src);
+				_Math_Detail::wide_half_t x0, y0, z0, w0, x1, y1, z1, w1;
+				_Math_Detail::wide_deinterleave4(p, x0, y0, z0, w0);
+				_Math_Detail::wide_deinterleave4(p + 16, x1, y1, z1, w1);
+				return vec4x8(_Math_Detail::wide_combine(x0, x1), _Math_Detail::wide_combine(y0, y1), _Math_Detail::wide_combine(z0, z1), _Math_Detail::wide_combine(w0, w1));
+			}
+#endif
+			float lanes[4][8] = {};
+			for (size_t i = 0; i < count; i++)
+				for (int c = 0; c < 4; c++)
+					lanes[c][i] = src[i][c];
+			return vec4x8(simd_float8::load(lanes[0]), simd_float8::load(lanes[1]), simd_float8::load(lanes[2]), simd_float8::load(lanes[3]));
+		}
+		CRAFT_ENGINE_MATH_FUNC_DECL void unpackVec4x8(vec4x8 const& v, vec4* dst, size_t count = 8)
+		{
+#if defined(CRAFT_ENGINE_MATH_WIDE_INTERLEAVE)
+			if (count == 8)
+			{
+				float* p = reinterpret_cast<float*>(dst);
+				_Math_Detail::wide_interleave4(p, _Math_Detail::wide_low(v.x), _Math_Detail::wide_low(v.y), _Math_Detail::wide_low(v.z), _Math_Detail::wide_low(v.w));
+				_Math_Detail::wide_interleave4(p + 16, _Math_Detail::wide_high(v.x), _Math_Detail::wide_high(v.y), _Math_Detail::wide_high(v.z), _Math_Detail::wide_high(v.w));
+				return;
+			}
+#endif
+			float lanes[4][8];
+			for (int c = 0; c < 4; c++)
+				v[c].store(lanes[c]);
+			for (size_t i = 0; i < count; i++)
+				dst[i] = vec4(lanes[0][i], lanes[1][i], lanes[2][i], lanes[3][i]);
+		}
+
+
+
+		// vec3(m * vec4(p, 1)) for eight points
+		CRAFT_ENGINE_MATH_FUNC_DECL vec3x8 transformPoint(mat4 const& m, vec3x8 const& p)
+		{
+			return vec3x8(
+				simd_float8(m[0][0]) * p.x + simd_float8(m[1][0]) * p.y + simd_float8(m[2][0]) * p.z + simd_float8(m[3][0]),
+				simd_float8(m[0][1]) * p.x + simd_float8(m[1][1]) * p.y + simd_float8(m[2][1]) * p.z + simd_float8(m[3][1]),
+				simd_float8(m[0][2]) * p.x + simd_float8(m[1][2]) * p.y + simd_float8(m[2][2]) * p.z + simd_float8(m[3][2])
+			);
+		}
+		// vec3(m * vec4(d, 0)) for eight directions
+		CRAFT_ENGINE_MATH_FUNC_DECL vec3x8 transformDirection(mat4 const& m, vec3x8 const& d)
+		{
+			return vec3x8(
+				simd_float8(m[0][0]) * d.x + simd_float8(m[1][0]) * d.y + simd_float8(m[2][0]) * d.z,
+				simd_float8(m[0][1]) * d.x + simd_float8(m[1][1]) * d.y + simd_float8(m[2][1]) * d.z,
+				simd_float8(m[0][2]) * d.x + simd_float8(m[1][2]) * d.y + simd_float8(m[2][2]) * d.z
+			);
+		}
+		// m * v for eight vectors
+		CRAFT_ENGINE_MATH_FUNC_DECL vec4x8 transform(mat4 const& m, vec4x8 const& v)
+		{
+			vec4x8 r;
+			for (int c = 0; c < 4; c++)
+				r[c] = simd_float8(m[0][c]) * v.x + simd_float8(m[1][c]) * v.y + simd_float8(m[2][c]) * v.z + simd_float8(m[3][c]) * v.w;
+			return r;
+		}
+
+		// Bounds of the eight transformed corners of the box (boxMin, boxMax)
+		CRAFT_ENGINE_MATH_FUNC_DECL void transformBounds(mat4 const& m, vec3 const& boxMin, vec3 const& boxMax, vec3& outMin, vec3& outMax)
+		{
+			// corner i takes the max x, y or z when bit 0, 1 or 2 of i is set, the components are exact even for infinite boxes
+			vec3x8 corners(
+				select(0xAA, simd_float8(boxMin.x), simd_float8(boxMax.x)),
+				select(0xCC, simd_float8(boxMin.y), simd_float8(boxMax.y)),
+				select(0xF0, simd_float8(boxMin.z), simd_float8(boxMax.z))
+			);
+			vec3x8 p = transformPoint(m, corners);
+			outMin = vec3(reduceMin(p.x), reduceMin(p.y), reduceMin(p.z));
+			outMax = vec3(reduceMax(p.x), reduceMax(p.y), reduceMax(p.z));
+		}
+
+		/*
+		 Slab test of one ray against eight boxes. invDirection is 1 / direction.
+		 Bit i of the result is set when the ray hits box i within [tMin, tMax].
+		*/
+		CRAFT_ENGINE_MATH_FUNC_DECL uint32_t intersectRayAABB8(vec3 const& origin, vec3 const& invDirection, vec3x8 const& boxMin, vec3x8 const& boxMax, float tMin, float tMax)
+		{
+			vec3x8 o(origin.x, origin.y, origin.z);
+			vec3x8 id(invDirection.x, invDirection.y, invDirection.z);
+			vec3x8 t0 = (boxMin - o) * id;
+			vec3x8 t1 = (boxMax - o) * id;
+			simd_float8 tNear = max(max(min(t0.x, t1.x), min(t0.y, t1.y)), max(min(t0.z, t1.z), simd_float8(tMin)));
+			simd_float8 tFar = min(min(max(t0.x, t1.x), max(t0.y, t1.y)), min(max(t0.z, t1.z), simd_float8(tMax)));
+			return lessEqualMask(tNear, tFar);
+		}
+
+
+
+		/*
+		 Batch kernels over AoS arrays, eight items per iteration. src and dst may be the same array.
+		*/
+		CRAFT_ENGINE_MATH_FUNC_DECL void batchTransformPoints(mat4 const& m, const vec3* src, vec3* dst, size_t count)
+		{
+			for (size_t i = 0; i < count; i += 8)
+			{
+				size_t n = math::min<size_t>(count - i, 8);
+				unpackVec3x8(transformPoint(m, packVec3x8(src + i, n)), dst + i, n);
+			}
+		}
+		CRAFT_ENGINE_MATH_FUNC_DECL void batchTransformDirections(mat4 const& m, const vec3* src, vec3* dst, size_t count)
+		{
+			for (size_t i = 0; i < count; i += 8)
+			{
+				size_t n = math::min<size_t>(count - i, 8);
+				unpackVec3x8(transformDirection(m, packVec3x8(src + i, n)), dst + i, n);
+			}
+		}
+		CRAFT_ENGINE_MATH_FUNC_DECL void batchTransform(mat4 const& m, const vec4* src, vec4* dst, size_t count)
+		{
+			for (size_t i = 0; i < count; i += 8)
+			{
+				size_t n = math::min<size_t>(count - i, 8);
+				unpackVec4x8(transform(m, packVec4x8(src + i, n)), dst + i, n);
+			}
+		}
+		CRAFT_ENGINE_MATH_FUNC_DECL void batchNormalize(const vec3* src, vec3* dst, size_t count)
+		{
+			for (size_t i = 0; i < count; i += 8)
+			{
+				size_t n = math::min<size_t>(count - i, 8);
+				unpackVec3x8(normalize(packVec3x8(src + i, n)), dst + i, n);
+			}
+		}
+		CRAFT_ENGINE_MATH_FUNC_DECL void batchDot(const vec3* a, const vec3* b, float* dst, size_t count)
+		{
+			for (size_t i = 0; i < count; i += 8)
+			{
+				size_t n = math::min<size_t>(count - i, 8);
+				float lanes[8];
+				dot(packVec3x8(a + i, n), packVec3x8(b + i, n)).store(lanes);
+				for (size_t j = 0; j < n; j++)
+					dst[i + j] = lanes[j];
+			}
+		}
+
+	}
+}
+
+#endif // !CRAFT_ENGINE_MATH_WIDE_H_
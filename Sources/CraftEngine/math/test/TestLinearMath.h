@@ -0,0 +1,363 @@
+#pragma once
+#include "../LinearMath.h"
+#include "../../core/test/TestCheck.h"
+#include <iostream>
+#include <random>
+#include <vector>
+
+
+
+/*
+ Checks the float vec4/quat/mat4 operations (SIMD kernels when CRAFT_ENGINE_MATH_USING_SIMD
+ is defined) against the double precision scalar implementation.
+*/
+void testLinearMath()
+{
+	using namespace CraftEngine;
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> dist(-4.0f, 4.0f);
+	auto rand_vec4 = [&]() { return math::vec4(dist(rng), dist(rng), dist(rng), dist(rng)); };
+	auto rand_mat4 = [&]() { return math::mat4(rand_vec4(), rand_vec4(), rand_vec4(), rand_vec4()); };
+	auto rand_quat = [&]() { return math::quat(dist(rng), dist(rng), dist(rng), dist(rng)); };
+
+	test::TestCheck report("testLinearMath", "mismatches");
+	auto check = [&](const char* what, double a, double b, double tolerance)
+	{
+		if (std::abs(a - b) > tolerance * (1.0 + std::abs(b)))
+		{
+			if (report.fail())
+				report.log() << what << " mismatch " << a << " vs " << b << "\n";
+		}
+	};
+	auto check_vec4 = [&](const char* what, math::vec4 const& a, math::dvec4 const& b, double tolerance = 1e-5)
+	{
+		for (int i = 0; i < 4; i++)
+			check(what, a[i], b[i], tolerance);
+	};
+	auto check_mat4 = [&](const char* what, math::mat4 const& a, math::dmat4 const& b, double tolerance = 1e-5)
+	{
+		for (int i = 0; i < 4; i++)
+			check_vec4(what, a[i], b[i], tolerance);
+	};
+
+	for (int n = 0; n < 10000; n++)
+	{
+		auto a = rand_vec4(), b = rand_vec4();
+		auto s = dist(rng);
+		math::dvec4 da(a), db(b);
+		double ds = s;
+
+		check_vec4("vec4 + vec4", a + b, da + db);
+		check_vec4("vec4 - vec4", a - b, da - db);
+		check_vec4("vec4 * vec4", a * b, da * db);
+		check_vec4("vec4 * scalar", a * s, da * ds);
+		check_vec4("scalar - vec4", s - a, ds - da);
+		check_vec4("-vec4", -a, -da);
+		check("dot(vec4)", math::dot(a, b), math::dot(da, db), 1e-5);
+		auto c = a;
+		c -= s;
+		check_vec4("vec4 -= scalar", c, da - ds);
+		if (std::abs(b.x) > 0.1f && std::abs(b.y) > 0.1f && std::abs(b.z) > 0.1f && std::abs(b.w) > 0.1f)
+			check_vec4("vec4 / vec4", a / b, da / db);
+
+		auto p = rand_quat(), q = rand_quat();
+		auto pq = p * q;
+		auto dpq = math::dquat(p.i, p.j, p.k, p.r) * math::dquat(q.i, q.j, q.k, q.r);
+		for (int i = 0; i < 4; i++)
+			check("quat * quat", pq.value[i], dpq.value[i], 1e-5);
+
+		auto m1 = rand_mat4(), m2 = rand_mat4();
+		math::dmat4 dm1(m1), dm2(m2);
+		check_mat4("mat4 * mat4", m1 * m2, dm1 * dm2);
+		check_mat4("mat4 * scalar", m1 * s, dm1 * ds);
+		check_mat4("transpose(mat4)", math::transpose(m1), math::transpose(dm1), 0.0);
+		check_vec4("mat4 * vec4", m1 * a, dm1 * da);
+		check_vec4("vec4 * mat4", a * m1, da * dm1);
+
+		// keep the determinant away from zero so the inverse is well conditioned
+		auto m3 = m1;
+		for (int i = 0; i < 4; i++)
+			m3[i][i] += 16.0f;
+		math::dmat4 dm3(m3);
+		check_mat4("inverse(mat4)", math::inverse(m3), math::inverse(dm3), 1e-4);
+	}
+
+	report.finish();
+}
+
+
+
+/*
+ Checks the eight-wide SoA packets and batch kernels against the scalar vec3/vec4/mat4 code.
+*/
+void testLinearMathWide()
+{
+	using namespace CraftEngine;
+
+	std::mt19937 rng(4321);
+	std::uniform_real_distribution<float> dist(-4.0f, 4.0f);
+	auto rand_vec3 = [&]() { return math::vec3(dist(rng), dist(rng), dist(rng)); };
+	auto rand_vec4 = [&]() { return math::vec4(dist(rng), dist(rng), dist(rng), dist(rng)); };
+
+	test::TestCheck report("testLinearMathWide", "mismatches");
+	auto check = [&](const char* what, float a, float b)
+	{
+		if (std::abs(a - b) > 1e-5f * (1.0f + std::abs(b)))
+		{
+			if (report.fail())
+				report.log() << what << " mismatch " << a << " vs " << b << "\n";
+		}
+	};
+
+	const size_t count = 1003; // not a multiple of eight, exercises the tail
+	std::vector<math::vec3> points(count), directions(count), result(count);
+	std::vector<math::vec4> vectors(count), result4(count);
+	std::vector<float> dots(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		points[i] = rand_vec3();
+		directions[i] = rand_vec3();
+		vectors[i] = rand_vec4();
+	}
+	math::mat4 m(rand_vec4(), rand_vec4(), rand_vec4(), rand_vec4());
+
+	math::batchTransformPoints(m, points.data(), result.data(), count);
+	for (size_t i = 0; i < count; i++)
+	{
+		auto ref = math::vec3(m * math::vec4(points[i], 1.0f));
+		for (int c = 0; c < 3; c++)
+			check("batchTransformPoints", result[i][c], ref[c]);
+	}
+	math::batchTransformDirections(m, directions.data(), result.data(), count);
+	for (size_t i = 0; i < count; i++)
+	{
+		auto ref = math::vec3(m * math::vec4(directions[i], 0.0f));
+		for (int c = 0; c < 3; c++)
+			check("batchTransformDirections", result[i][c], ref[c]);
+	}
+	math::batchTransform(m, vectors.data(), result4.data(), count);
+	for (size_t i = 0; i < count; i++)
+	{
+		auto ref = m * vectors[i];
+		for (int c = 0; c < 4; c++)
+			check("batchTransform", result4[i][c], ref[c]);
+	}
+	math::batchNormalize(directions.data(), result.data(), count);
+	for (size_t i = 0; i < count; i++)
+	{
+		auto ref = math::normalize(directions[i]);
+		for (int c = 0; c < 3; c++)
+			check("batchNormalize", result[i][c], ref[c]);
+	}
+	math::batchDot(points.data(), directions.data(), dots.data(), count);
+	for (size_t i = 0; i < count; i++)
+		check("batchDot", dots[i], math::dot(points[i], directions[i]));
+
+	// transformed bounds match the min/max of the eight transformed corners
+	for (int n = 0; n < 1000; n++)
+	{
+		auto a = rand_vec3(), b = rand_vec3();
+		auto boxMin = math::min(a, b), boxMax = math::max(a, b);
+		math::vec3 outMin, outMax;
+		math::transformBounds(m, boxMin, boxMax, outMin, outMax);
+		math::vec3 refMin(std::numeric_limits<float>::max()), refMax(-std::numeric_limits<float>::max());
+		for (int k = 0; k < 8; k++)
+		{
+			math::vec3 corner(k & 1 ? boxMax.x : boxMin.x, k & 2 ? boxMax.y : boxMin.y, k & 4 ? boxMax.z : boxMin.z);
+			auto p = math::vec3(m * math::vec4(corner, 1.0f));
+			refMin = math::min(refMin, p);
+			refMax = math::max(refMax, p);
+		}
+		for (int c = 0; c < 3; c++)
+		{
+			check("transformBounds min", outMin[c], refMin[c]);
+			check("transformBounds max", outMax[c], refMax[c]);
+		}
+	}
+	// the identity returns the box itself, bit for bit, and an infinite extent stays infinite
+	{
+		math::mat4 identity(1.0f);
+		bool exact = true;
+		std::uniform_real_distribution<float> exponent(-20.0f, 20.0f);
+		for (int n = 0; n < 1000; n++)
+		{
+			auto a = rand_vec3() * std::exp2(exponent(rng)), b = rand_vec3();
+			auto boxMin = math::min(a, b), boxMax = math::max(a, b);
+			math::vec3 outMin, outMax;
+			math::transformBounds(identity, boxMin, boxMax, outMin, outMax);
+			for (int c = 0; c < 3; c++)
+				exact &= outMin[c] == boxMin[c] && outMax[c] == boxMax[c];
+		}
+		if (!exact && report.fail())
+			report.log() << "transformBounds identity is not exact\n";
+
+		const float inf = std::numeric_limits<float>::infinity();
+		math::mat4 positive(math::vec4(1.0f, 2.0f, 3.0f, 0.0f), math::vec4(0.5f, 1.0f, 0.25f, 0.0f), math::vec4(2.0f, 0.5f, 1.0f, 0.0f), math::vec4(1.0f, 1.0f, 1.0f, 1.0f));
+		math::vec3 outMin, outMax;
+		math::transformBounds(positive, math::vec3(-inf, -1.0f, 0.0f), math::vec3(inf, 1.0f, 2.0f), outMin, outMax);
+		bool infinite = true;
+		for (int c = 0; c < 3; c++)
+			infinite &= outMin[c] == -inf && outMax[c] == inf;
+		if (!infinite && report.fail())
+			report.log() << "transformBounds of an infinite box " << outMin.x << " " << outMax.x << "\n";
+	}
+
+	// packet ray/box test against a scalar slab test
+	for (int n = 0; n < 1000; n++)
+	{
+		math::vec3 boxMin[8], boxMax[8];
+		for (int k = 0; k < 8; k++)
+		{
+			auto a = rand_vec3(), b = rand_vec3();
+			boxMin[k] = math::min(a, b);
+			boxMax[k] = math::max(a, b);
+		}
+		auto origin = rand_vec3() * 2.0f;
+		auto invDirection = 1.0f / math::normalize(rand_vec3());
+		uint32_t mask = math::intersectRayAABB8(origin, invDirection, math::packVec3x8(boxMin), math::packVec3x8(boxMax), 0.0f, 100.0f);
+		for (int k = 0; k < 8; k++)
+		{
+			float tNear = 0.0f, tFar = 100.0f;
+			for (int c = 0; c < 3; c++)
+			{
+				float t0 = (boxMin[k][c] - origin[c]) * invDirection[c];
+				float t1 = (boxMax[k][c] - origin[c]) * invDirection[c];
+				tNear = math::max(tNear, math::min(t0, t1));
+				tFar = math::min(tFar, math::max(t0, t1));
+			}
+			if (((mask >> k) & 1) != (tNear <= tFar ? 1u : 0u))
+				check("intersectRayAABB8", float((mask >> k) & 1), tNear <= tFar ? 1.0f : 0.0f);
+		}
+	}
+
+	report.finish();
+}
+
+
+
+/*
+ Checks math::fast against <cmath> within the documented error bounds, and that the
+ eight-wide and vector versions return the scalar result in every lane.
+*/
+void testFastMath()
+{
+	using namespace CraftEngine;
+	// the polynomials themselves, a scalar fast::exp/log/pow/sin/cos is the <cmath> function
+	namespace kernel = math::_Math_Detail;
+
+	std::mt19937 rng(2468);
+	test::TestCheck report("testFastMath", "mismatches");
+	auto check = [&](const char* what, double x, double a, double b, double tolerance)
+	{
+		if (!(std::abs(a - b) <= tolerance))
+		{
+			if (report.fail())
+				report.log() << what << "(" << x << ") " << a << " vs " << b << "\n";
+		}
+	};
+	auto check_lanes = [&](const char* what, math::simd_float8 const& wide, const float* scalar, float tolerance = 1e-6f)
+	{
+		for (int i = 0; i < 8; i++)
+		{
+			// identical unless the compiler contracted one of the two into fused multiply-adds
+			if (wide[i] != scalar[i] && !(std::abs(wide[i] - scalar[i]) <= tolerance * (1.0f + std::abs(scalar[i]))))
+			{
+				if (report.fail())
+					report.log() << what << " lane " << i << " " << wide[i] << " vs " << scalar[i] << "\n";
+			}
+		}
+	};
+
+	// tolerances are the documented bounds with a little headroom
+	std::uniform_real_distribution<float> exp_dist(-87.0f, 87.0f), log_dist(-30.0f, 30.0f), trig_dist(-100.0f, 100.0f), atan_dist(-50.0f, 50.0f);
+	for (int n = 0; n < 100000; n++)
+	{
+		float x = exp_dist(rng);
+		double ref = std::exp(double(x));
+		check("exp", x, kernel::fast_exp(x), ref, 3e-7 * ref);
+		ref = std::exp2(double(x));
+		if (x > -126.0f)
+			check("exp2", x, kernel::fast_exp2(x), ref, 3e-7 * ref);
+
+		x = std::exp2(log_dist(rng));
+		ref = std::log(double(x));
+		check("log", x, kernel::fast_log(x), ref, 2e-7 + 3e-7 * std::abs(ref));
+		ref = std::log2(double(x));
+		check("log2", x, kernel::fast_log2(x), ref, 3e-7 + 3e-7 * std::abs(ref));
+		float y = trig_dist(rng) * 0.04f;
+		ref = std::pow(double(x), double(y));
+		if (std::abs(y * ref) < 1e30)
+			check("pow", x, kernel::fast_pow(x, y), ref, 3e-7 * (1.0 + std::abs(y * std::log2(double(x)))) * ref);
+
+		x = trig_dist(rng);
+		check("sin", x, kernel::fast_sin(x), std::sin(double(x)), 3e-7);
+		check("cos", x, kernel::fast_cos(x), std::cos(double(x)), 3e-7);
+		x = atan_dist(rng);
+		check("atan", x, math::fast::atan(x), std::atan(double(x)), 3e-7);
+		y = atan_dist(rng);
+		check("atan2", x, math::fast::atan2(y, x), std::atan2(double(y), double(x)), 6e-7);
+	}
+	check("atan2", 0.0, math::fast::atan2(0.0f, 0.0f), 0.0, 0.0);
+	const float pow_bases[] = { 0.0f, -0.0f, -2.0f, 3.0f, 1e-30f };
+	for (auto x : pow_bases)
+		check("pow(x, 0)", x, kernel::fast_pow(x, 0.0f), 1.0, 0.0);
+	check("pow(0, y)", 0.0, kernel::fast_pow(0.0f, 2.0f), 0.0, 0.0);
+	{
+		const float x[8] = { 0.0f, 0.0f, -2.0f, -2.0f, 3.0f, 3.0f, 0.5f, -0.0f };
+		const float y[8] = { 0.0f, 1.5f, 0.0f, 2.0f, 0.0f, -1.0f, 0.0f, -0.0f };
+		float r[8];
+		for (int i = 0; i < 8; i++) r[i] = kernel::fast_pow(x[i], y[i]);
+		check_lanes("pow(x, 0)", math::fast::pow(math::simd_float8::load(x), math::simd_float8::load(y)), r);
+	}
+
+	// packets and vectors go through the same polynomials lane by lane
+	for (int n = 0; n < 1000; n++)
+	{
+		float a[8], b[8], r[8];
+		for (int i = 0; i < 8; i++)
+		{
+			a[i] = trig_dist(rng);
+			b[i] = std::exp2(log_dist(rng));
+		}
+		auto wa = math::simd_float8::load(a), wb = math::simd_float8::load(b);
+		for (int i = 0; i < 8; i++) r[i] = kernel::fast_exp(a[i]);
+		check_lanes("exp", math::fast::exp(wa), r);
+		for (int i = 0; i < 8; i++) r[i] = kernel::fast_exp2(a[i]);
+		check_lanes("exp2", math::fast::exp2(wa), r);
+		for (int i = 0; i < 8; i++) r[i] = kernel::fast_log(b[i]);
+		check_lanes("log", math::fast::log(wb), r);
+		for (int i = 0; i < 8; i++) r[i] = kernel::fast_log2(b[i]);
+		check_lanes("log2", math::fast::log2(wb), r);
+		for (int i = 0; i < 8; i++) r[i] = kernel::fast_pow(b[i], a[i] * 0.1f);
+		// a contracted y * log2(x) is scaled by up to |y * log2(x)| = 300 here
+		check_lanes("pow", math::fast::pow(wb, wa * math::simd_float8(0.1f)), r, 3e-5f);
+		for (int i = 0; i < 8; i++) r[i] = kernel::fast_sin(a[i]);
+		check_lanes("sin", math::fast::sin(wa), r);
+		for (int i = 0; i < 8; i++) r[i] = kernel::fast_cos(a[i]);
+		check_lanes("cos", math::fast::cos(wa), r);
+		for (int i = 0; i < 8; i++) r[i] = math::fast::atan(a[i]);
+		check_lanes("atan", math::fast::atan(wa), r);
+		for (int i = 0; i < 8; i++) r[i] = math::fast::atan2(a[i], b[i] - 1.0f);
+		check_lanes("atan2", math::fast::atan2(wa, wb - math::simd_float8(1.0f)), r);
+
+		math::vec4 v(a[0], a[1], a[2], a[3]);
+		auto sv = math::fast::sin(v);
+		for (int i = 0; i < 4; i++)
+			check("sin(vec4)", v[i], sv[i], math::fast::sin(v[i]), 1e-6);
+		auto pv = math::fast::pow(math::vec4(b[0], b[1], b[2], b[3]), math::vec4(0.5f));
+		for (int i = 0; i < 4; i++)
+			check("pow(vec4)", b[i], pv[i], math::fast::pow(b[i], 0.5f), 1e-6 * (1.0 + std::abs(pv[i])));
+	}
+
+	// a float goes to <cmath>, atan and atan2 keep the polynomial
+	{
+		float x = 1.37f;
+		check("scalar exp", x, math::fast::exp(x), std::exp(x), 0.0);
+		check("scalar pow", x, math::fast::pow(-2.0f, 3.0f), -8.0, 0.0);
+		check("scalar sin", x, math::fast::sin(x), std::sin(x), 0.0);
+		check("scalar atan", x, math::fast::atan(x), kernel::fast_atan(x), 0.0);
+	}
+
+	report.finish();
+}
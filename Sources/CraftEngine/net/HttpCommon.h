@@ -83,6 +83,7 @@ using socket_t = int;
 #include <cassert>
 #include <climits>
 #include <condition_variable>
+#include <deque>
 #include <errno.h>
 #include <fcntl.h>
 #include <fstream>
@@ -125,6 +126,8 @@ inline const unsigned char* ASN1_STRING_get0_data(const ASN1_STRING* asn1) {
 
 #include <iostream>
 
+#include "../core/core/Callable.h"
+
 
 namespace CraftEngine
 {
@@ -171,6 +174,14 @@ namespace CraftEngine
                     virtual ~TaskQueue() = default;
 
                     virtual void enqueue(std::function<void()> fn) = 0;
+
+                    // Move-only tasks. Queues that only implement enqueue() get the task
+                    // wrapped in a copyable function; override this to store it as it is.
+                    virtual void enqueue_task(core::UniqueTask fn) {
+                        auto task = std::make_shared<core::UniqueTask>(std::move(fn));
+                        enqueue([task]() { (*task)(); });
+                    }
+
                     virtual void shutdown() = 0;
                     virtual void on_idle() {};
                 };
@@ -188,8 +199,12 @@ namespace CraftEngine
                     ~ThreadPool() override = default;
 
                     void enqueue(std::function<void()> fn) override {
+                        enqueue_task(core::UniqueTask(std::move(fn)));
+                    }
+
+                    void enqueue_task(core::UniqueTask fn) override {
                         std::unique_lock<std::mutex> lock(mutex_);
-                        jobs_.push_back(fn);
+                        jobs_.push_back(std::move(fn));
                         cond_.notify_one();
                     }
 
@@ -214,7 +229,7 @@ namespace CraftEngine
 
                         void operator()() {
                             for (;;) {
-                                std::function<void()> fn;
+                                core::UniqueTask fn;
                                 {
                                     std::unique_lock<std::mutex> lock(pool_.mutex_);
 
@@ -223,7 +238,7 @@ namespace CraftEngine
 
                                     if (pool_.shutdown_ && pool_.jobs_.empty()) { break; }
 
-                                    fn = pool_.jobs_.front();
+                                    fn = std::move(pool_.jobs_.front());
                                     pool_.jobs_.pop_front();
                                 }
 
@@ -237,7 +252,7 @@ namespace CraftEngine
                     friend struct worker;
 
                     std::vector<std::thread> threads_;
-                    std::list<std::function<void()>> jobs_;
+                    std::deque<core::UniqueTask> jobs_;
 
                     bool shutdown_;
 
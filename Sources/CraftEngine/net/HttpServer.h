@@ -750,9 +750,9 @@ namespace CraftEngine
                         }
 
 #if __cplusplus > 201703L
-                        task_queue->enqueue([=, this]() { process_and_close_socket(sock); });
+                        task_queue->enqueue_task([=, this]() { process_and_close_socket(sock); });
 #else
-                        task_queue->enqueue([=]() { process_and_close_socket(sock); });
+                        task_queue->enqueue_task([=]() { process_and_close_socket(sock); });
 #endif
                     }
 
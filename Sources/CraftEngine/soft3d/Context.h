@@ -81,6 +81,8 @@ namespace CraftEngine
 			}
 			void bindTexture(const Image& texture, uint32_t index)
 			{
+				if (texture.valid())
+					detail::resolveFastClear((detail::ImageData*)texture.handle());
 				m_contextData->mTempRenderResources.mImages[index] = texture;
 			}
 			void bindBuffer(const Buffer& buffer, uint32_t index)
@@ -152,7 +154,8 @@ namespace CraftEngine
 			void sendVertex(ShaderVertexPhaseOutput& shader_vertex_output);
 
 			// Ƭμ
-			void acceptFragment(const Pipeline& pipeline, const ShaderFragmentPhaseOutput& output, const ivec2& fragPos, float depth, const Scissor& scissor);
+			// returns false only when the fragment fails the depth test
+			bool acceptFragment(const Pipeline& pipeline, const ShaderFragmentPhaseOutput& output, const ivec2& fragPos, float depth, const Scissor& scissor);
 
 			// ƬԪһԹһ
 			void homogenizeVertexShaderVaryingOutput(ShaderVertexPhaseOutput& vertex);
@@ -187,6 +190,8 @@ namespace CraftEngine
 			// դ
 			void rasterizeTriganle(const ShaderVertexPhaseOutput& p1, const ShaderVertexPhaseOutput& p2, const ShaderVertexPhaseOutput& p3);
 
+			detail::ProfilerData* profiler() const { return &((detail::DeviceData*)m_contextData->mDevice.handle())->mProfiler; }
+
 		};
 
 
@@ -204,7 +209,7 @@ namespace CraftEngine
 		void destroyGraphicsContext(GraphicsContext& context, const MemAllocator& allocator = MemAllocator())
 		{
 			auto ctx_data = (detail::GraphicsContextData*)context.handle();
-			delete ctx_data;
+			allocator.free(ctx_data);
 		}
 
 
@@ -241,6 +246,8 @@ namespace CraftEngine
 			ShaderVertexPhaseInput shader_vertex_input;
 			ShaderVertexPhaseOutput shader_vertex_output;
 			int v = 0;
+			soft3d_profile_scope(profiler(), "drawVertex", 0);
+			soft3d_profile_count(eProfileVerticesShaded, uint64_t(vertexCount) * instanceCount);
 			for (int i = firstInstance; i < firstInstance + instanceCount; i++)
 			{
 				shader_vertex_input.mInstance = i;
@@ -282,6 +289,8 @@ namespace CraftEngine
 			ShaderVertexPhaseInput shader_vertex_input;
 			ShaderVertexPhaseOutput shader_vertex_output;
 			uint32_t index = 0;
+			soft3d_profile_scope(profiler(), "drawIndex", 0);
+			soft3d_profile_count(eProfileVerticesShaded, uint64_t(indexCount) * instanceCount);
 
 			switch (m_contextData->mCurIndexType)
 			{
@@ -372,6 +381,8 @@ namespace CraftEngine
 							drawLine(m_contextData->mTempVertexList[2], m_contextData->mTempVertexList[0]);
 						}
 					}
+					else
+						soft3d_profile_add(profiler(), eProfilePrimitivesCulled, 1);
 					m_contextData->mTempVertexCount = 0;
 				}
 				break;
@@ -432,6 +443,8 @@ namespace CraftEngine
 							drawLine(m_contextData->mTempVertexList[2], m_contextData->mTempVertexList[0]);
 						}
 					}
+					else
+						soft3d_profile_add(profiler(), eProfilePrimitivesCulled, 1);
 					m_contextData->mTempVertexList[0] = m_contextData->mTempVertexList[1];
 					m_contextData->mTempVertexList[1] = m_contextData->mTempVertexList[2];
 					break;
@@ -471,6 +484,8 @@ namespace CraftEngine
 							drawLine(m_contextData->mTempVertexList[2], m_contextData->mTempVertexList[0]);
 						}
 					}
+					else
+						soft3d_profile_add(profiler(), eProfilePrimitivesCulled, 1);
 					m_contextData->mTempVertexList[1] = m_contextData->mTempVertexList[2];
 					break;
 				case 0:
@@ -487,19 +502,19 @@ namespace CraftEngine
 			}
 		}
 
-		inline void GraphicsContext::acceptFragment(const Pipeline& pipeline, const ShaderFragmentPhaseOutput& output, const ivec2& fragPos, float depth, const Scissor& scissor)
+		inline bool GraphicsContext::acceptFragment(const Pipeline& pipeline, const ShaderFragmentPhaseOutput& output, const ivec2& fragPos, float depth, const Scissor& scissor)
 		{
 			// depth cull
 			if (depth > 1.0f || depth < 0.0f)
-				return;
+				return true;
 
 			int width = m_contextData->mCurTargetSize.x;
 			int height = m_contextData->mCurTargetSize.y;
 
 			if (fragPos.x < 0 || fragPos.x >= width)
-				return;
+				return true;
 			if (fragPos.y < 0 || fragPos.y >= height)
-				return;
+				return true;
 
 			auto pixel_index = width * fragPos.y + fragPos.x;
 			auto pipeline_data = (detail::PipelineData*)pipeline.handle();
@@ -511,7 +526,7 @@ namespace CraftEngine
 					fragPos.y < scissor.mOffset.y ||
 					fragPos.x >= scissor.mOffset.x + scissor.mSize.x ||
 					fragPos.y >= scissor.mOffset.y + scissor.mSize.y
-					)return;
+					)return true;
 			}
 
 			// depth test
@@ -519,45 +534,52 @@ namespace CraftEngine
 			if (pipeline_data->mEnableDepthTest &&
 				depth_stencil_buffer.valid())
 			{
+				auto depth_clear = detail::findFastClear((detail::ImageData*)depth_stencil_buffer.handle(), 0, 0);
+				bool depth_cleared = depth_clear != nullptr && detail::isFastClearTexel(depth_clear, fragPos.x, fragPos.y);
 				auto ptr = (byte*)((detail::ImageData*)depth_stencil_buffer.handle())->mMappedPtr;
 				auto& pixel_size = ((detail::ImageData*)depth_stencil_buffer.handle())->mPixelBytes;
 				ptr = ptr + pixel_index * pixel_size;
 				auto pixel = (detail::ImagePixelData*)ptr;
+				// a texel untouched since a fast clear is only in the clear value
+				auto dst_pixel = depth_cleared ? &depth_clear->mClearValue : pixel;
 				float dst_depth;
 				switch (depth_stencil_buffer.format())
 				{
 				case ImageFormat::eD24_UNORM_S8_UINT:
-					dst_depth = pixel->mD24_UNORM_S8_UINT.D24 * (1.0f / ((1 << 24) - 1));
+					dst_depth = dst_pixel->mD24_UNORM_S8_UINT.D24 * (1.0f / ((1 << 24) - 1));
 					break;
 				case ImageFormat::eD32_SFLOAT:
-					dst_depth = pixel->mD32_SFLOAT;
+					dst_depth = dst_pixel->mD32_SFLOAT;
 					break;
 				}
 				switch (pipeline_data->mDepthCompareMode)
 				{
 				case PipelineDepthCompareMode::eLessEqualMode:
 					if (depth > dst_depth)
-						return;
+						return false;
 					break;
 				case PipelineDepthCompareMode::eLessMode:
 					if (depth >= dst_depth)
-						return;
+						return false;
 					break;
 				case PipelineDepthCompareMode::eGreaterEqualMode:
 					if (depth < dst_depth)
-						return;
+						return false;
 					break;
 				case PipelineDepthCompareMode::eGreaterMode:
 					if (depth <= dst_depth)
-						return;
+						return false;
 					break;
 				case PipelineDepthCompareMode::eEqualMode:
 					if (depth != dst_depth)
-						return;
+						return false;
 					break;
 				}
 				if (pipeline_data->mEnableDepthWrite)
 				{
+					// the stencil bits of a cleared texel come from the clear value
+					if (depth_cleared)
+						memcpy(pixel, dst_pixel, pixel_size);
 					switch (depth_stencil_buffer.format())
 					{
 					case ImageFormat::eD24_UNORM_S8_UINT:
@@ -567,6 +589,8 @@ namespace CraftEngine
 						pixel->mD32_SFLOAT = depth;
 						break;
 					}
+					if (depth_cleared)
+						detail::markFastClearTexel(depth_clear, fragPos.x, fragPos.y);
 				}
 			}
 
@@ -576,27 +600,35 @@ namespace CraftEngine
 			{
 				for (int i = 0; i < pipeline_data->mAttachmentCount; i++)
 				{
+					auto color_clear = detail::findFastClear((detail::ImageData*)color_target_list[i].handle(), 0, 0);
+					bool color_cleared = color_clear != nullptr && detail::isFastClearTexel(color_clear, fragPos.x, fragPos.y);
 					auto ptr = (byte*)((detail::ImageData*)color_target_list[i].handle())->mMappedPtr;
 					auto& pixel_size = ((detail::ImageData*)color_target_list[i].handle())->mPixelBytes;
 					ptr = ptr + pixel_index * pixel_size;
-					memcpy(&pixel_data, ptr, pixel_size);
+					memcpy(&pixel_data, color_cleared ? color_clear->mClearValue.mData : ptr, pixel_size);
 					vec4 dst_color = detail::castPixelToVector(pixel_data, color_target_list[i].format());
 					vec4 src_color = output.mColors[i].a * output.mColors[i] + (1.0f - output.mColors[i].a) * dst_color;
 					pixel_data = detail::castVectorToPixel(src_color, color_target_list[i].format());
 					memcpy(ptr, &pixel_data, pixel_size);
+					if (color_cleared)
+						detail::markFastClearTexel(color_clear, fragPos.x, fragPos.y);
 				}
 			}
 			else
 			{
 				for (int i = 0; i < pipeline_data->mAttachmentCount; i++)
 				{
+					auto color_clear = detail::findFastClear((detail::ImageData*)color_target_list[i].handle(), 0, 0);
 					auto ptr = (byte*)((detail::ImageData*)color_target_list[i].handle())->mMappedPtr;
 					auto& pixel_size = ((detail::ImageData*)color_target_list[i].handle())->mPixelBytes;
 					ptr = ptr + pixel_index * pixel_size;
 					pixel_data = detail::castVectorToPixel(output.mColors[i], color_target_list[i].format());
 					memcpy(ptr, &pixel_data, pixel_size);
+					if (color_clear != nullptr)
+						detail::markFastClearTexel(color_clear, fragPos.x, fragPos.y);
 				}
 			}
+			return true;
 		}
 
 		inline void GraphicsContext::homogenizeVertexShaderVaryingOutput(ShaderVertexPhaseOutput& vertex)
@@ -813,6 +845,8 @@ namespace CraftEngine
 		{
 			if (clipPoint(p1) == 1)
 				rasterizePoint(p1);
+			else
+				soft3d_profile_add(profiler(), eProfilePrimitivesClipped, 1);
 		}
 
 		inline void GraphicsContext::drawLine(const ShaderVertexPhaseOutput& p1, const ShaderVertexPhaseOutput& p2)
@@ -823,14 +857,20 @@ namespace CraftEngine
 				rasterizeLine(p1, p2);
 				break;
 			case 1:
+				soft3d_profile_add(profiler(), eProfilePrimitivesClipped, 1);
 				rasterizeLine(m_contextData->mTempClipVertexList[0], m_contextData->mTempClipVertexList[1]);
 				break;
+			default:
+				soft3d_profile_add(profiler(), eProfilePrimitivesClipped, 1);
+				break;
 			}
 		}
 
 		inline void GraphicsContext::drawTriganle(const ShaderVertexPhaseOutput p[3])
 		{
 			int vertex_count = clipTriangle(p);
+			if (vertex_count != -1)
+				soft3d_profile_add(profiler(), eProfilePrimitivesClipped, 1);
 			if (vertex_count == 0)
 				return;
 			if (vertex_count == -1)
@@ -857,11 +897,12 @@ namespace CraftEngine
 			auto thread_count = device_data->mThreadPool.threadCount();
 			auto cur_thread = device_data->mCurThread + 1;
 			cur_thread %= thread_count;
-			device_data->mThreadPool.push([this, input,
+			device_data->mThreadPool.push([this, input, cur_thread,
 				pipeline = m_contextData->mCurPipeline,
 				scissor = m_contextData->mCurScissor,
 				fragment_shader = ((detail::ShaderData*)pipeline_data->mShader.handle())->mFragmentShader,
 				resource_data = m_contextData->mTempRenderResources]() {
+				soft3d_profile_scope(profiler(), "rasterizePoint", cur_thread + 1);
 				ShaderFragmentPhaseInput frag_input;
 				ShaderFragmentPhaseOutput frag_output;
 				frag_input.mFragPos = ivec2(input.mPosition.xy + 0.5f);
@@ -872,8 +913,14 @@ namespace CraftEngine
 
 				frag_output.mDiscard = false;
 				fragment_shader(resource_data, frag_input, frag_output);
+				soft3d_profile_count(eProfileFragmentsShaded, 1);
 				if (frag_output.mDiscard == false)
-					acceptFragment(pipeline, frag_output, frag_input.mFragPos, frag_input.mDepth, scissor);
+				{
+					if (!acceptFragment(pipeline, frag_output, frag_input.mFragPos, frag_input.mDepth, scissor))
+						soft3d_profile_count(eProfileFragmentsDepthRejected, 1);
+				}
+				else
+					soft3d_profile_count(eProfileFragmentsDiscarded, 1);
 			}, cur_thread);
 			device_data->mCurThread = cur_thread;
 		}
@@ -889,12 +936,12 @@ namespace CraftEngine
 			auto cur_thread = device_data->mCurThread + 1;
 			cur_thread %= thread_count;
 
-			device_data->mThreadPool.push([this, p1, p2,
+			device_data->mThreadPool.push([this, p1, p2, cur_thread,
 				pipeline = m_contextData->mCurPipeline,
 				scissor = m_contextData->mCurScissor,
 				fragment_shader = ((detail::ShaderData*)pipeline_data->mShader.handle())->mFragmentShader,
 				resource_data = m_contextData->mTempRenderResources]() {//
-
+				soft3d_profile_scope(profiler(), "rasterizeLine", cur_thread + 1);
 				ShaderFragmentPhaseInput frag_input;
 				ShaderFragmentPhaseOutput frag_output;
 				int dx, dy, s1, s2, temp, interchange = 0, p, i;
@@ -930,8 +977,14 @@ namespace CraftEngine
 
 					frag_output.mDiscard = false;
 					fragment_shader(resource_data, frag_input, frag_output);
+					soft3d_profile_count(eProfileFragmentsShaded, 1);
 					if (frag_output.mDiscard == false)
-						acceptFragment(pipeline, frag_output, frag_input.mFragPos, frag_input.mDepth, scissor);
+					{
+						if (!acceptFragment(pipeline, frag_output, frag_input.mFragPos, frag_input.mDepth, scissor))
+							soft3d_profile_count(eProfileFragmentsDepthRejected, 1);
+					}
+					else
+						soft3d_profile_count(eProfileFragmentsDiscarded, 1);
 
 					if (p > 0) {
 						if (interchange)
@@ -985,10 +1038,11 @@ namespace CraftEngine
 			if (device_data->mNoBlock)
 			{
 
-				device_data->mThreadPool.push([this, p1, p2, p3, pos, ixymin, ixymax, thread_count,
+				device_data->mThreadPool.push([this, p1, p2, p3, pos, ixymin, ixymax, thread_count, cur_thread,
 					pipeline = m_contextData->mCurPipeline, scissor = m_contextData->mCurScissor,
 					fragment_shader = ((detail::ShaderData*)pipeline_data->mShader.handle())->mFragmentShader,
 					resource_data = m_contextData->mTempRenderResources]() {
+					soft3d_profile_scope(profiler(), "rasterizeTriangle", cur_thread + 1);
 					ShaderFragmentPhaseInput frag_input;
 					ShaderFragmentPhaseOutput frag_output;
 					vec2 cur_pos;
@@ -1030,8 +1084,14 @@ namespace CraftEngine
 
 								frag_output.mDiscard = false;
 								fragment_shader(resource_data, frag_input, frag_output);
+								soft3d_profile_count(eProfileFragmentsShaded, 1);
 								if (frag_output.mDiscard == false)
-									acceptFragment(pipeline, frag_output, frag_input.mFragPos, frag_input.mDepth, scissor);
+								{
+									if (!acceptFragment(pipeline, frag_output, frag_input.mFragPos, frag_input.mDepth, scissor))
+										soft3d_profile_count(eProfileFragmentsDepthRejected, 1);
+								}
+								else
+									soft3d_profile_count(eProfileFragmentsDiscarded, 1);
 							}
 						}
 
@@ -1048,6 +1108,7 @@ namespace CraftEngine
 						pipeline = m_contextData->mCurPipeline, scissor = m_contextData->mCurScissor,
 						fragment_shader = ((detail::ShaderData*)pipeline_data->mShader.handle())->mFragmentShader,
 						resource_data = m_contextData->mTempRenderResources]() {
+						soft3d_profile_scope(profiler(), "rasterizeTriangle", tid + 1);
 						ShaderFragmentPhaseInput frag_input;
 						ShaderFragmentPhaseOutput frag_output;
 						vec2 cur_pos;
@@ -1089,8 +1150,14 @@ namespace CraftEngine
 
 									frag_output.mDiscard = false;
 									fragment_shader(resource_data, frag_input, frag_output);
+									soft3d_profile_count(eProfileFragmentsShaded, 1);
 									if (frag_output.mDiscard == false)
-										acceptFragment(pipeline, frag_output, frag_input.mFragPos, frag_input.mDepth, scissor);
+									{
+										if (!acceptFragment(pipeline, frag_output, frag_input.mFragPos, frag_input.mDepth, scissor))
+											soft3d_profile_count(eProfileFragmentsDepthRejected, 1);
+									}
+									else
+										soft3d_profile_count(eProfileFragmentsDiscarded, 1);
 								}
 							}
 
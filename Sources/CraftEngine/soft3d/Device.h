@@ -2,6 +2,7 @@
 #include "./Common.h"
 
 #include "./Memory.h"
+#include "./Profiler.h"
 
 
 namespace CraftEngine
@@ -19,6 +20,7 @@ namespace CraftEngine
 				uint32_t         mCurThread;
 				bool             mNoBlock;
 				std::atomic_int  mThreadWorking;
+				ProfilerData     mProfiler;
 			};
 		}
 
@@ -49,6 +51,28 @@ namespace CraftEngine
 				waitDevice();
 				m_deviceData->mThreadPool.init(count);
 			}
+
+			// counters are only gathered when CRAFT_ENGINE_SOFT3D_PROFILING is defined
+			PipelineStatistics getStatistics() const
+			{
+				return detail::collectStatistics(m_deviceData->mProfiler, m_deviceData->mThreadPool.threadCount());
+			}
+			void resetStatistics()
+			{
+				detail::resetProfiler(m_deviceData->mProfiler);
+			}
+			// records a span for every draw, raster task, ray trace tile and mipmap chain until endTrace
+			void beginTrace()
+			{
+				std::lock_guard<std::mutex> lock(m_deviceData->mProfiler.mTraceMutex);
+				m_deviceData->mProfiler.mTraceEvents.clear();
+				m_deviceData->mProfiler.mTracing = true;
+			}
+			bool endTrace(const char* filename)
+			{
+				m_deviceData->mProfiler.mTracing = false;
+				return detail::writeChromeTrace(m_deviceData->mProfiler, filename);
+			}
 			void* handle() const { return m_deviceData; }
 			bool  valid() const { return handle() != nullptr; }
 		};
@@ -63,6 +87,7 @@ namespace CraftEngine
 			device_data->mThreadPool.init(math::max(int(std::thread::hardware_concurrency()), 1));
 			device_data->mCurThread = 0;
 			device_data->mNoBlock = false;
+			detail::initProfiler(device_data->mProfiler);
 			return device;
 		}
 
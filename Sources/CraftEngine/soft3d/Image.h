@@ -45,6 +45,11 @@ namespace CraftEngine
 			// Mixed
 			// Compressed
 			eR5G5B5A1_UNORM,
+			eBC1_RGBA_UNORM,
+			eBC3_RGBA_UNORM,
+			eBC4_R_UNORM,
+			eBC5_RG_UNORM,
+			eBC7_RGBA_UNORM,
 			// Depth-stencil
 			eD24_UNORM_S8_UINT,
 			eD32_SFLOAT,
@@ -76,12 +81,36 @@ namespace CraftEngine
 				// Mixed
 				// Compressed
 				4,
+				0,
+				0,
+				0,
+				0,
+				0,
 				// Depth-stencil
 				4,
 				4,
 			};
 
-			constexpr int getPixelByteSize(const ImageFormat& format)
+			// 4x4 block compressed formats, texels are addressed by block instead of by pixel
+			constexpr bool isBlockCompressedFormat(const ImageFormat& format)
+			{
+				return format >= ImageFormat::eBC1_RGBA_UNORM && format <= ImageFormat::eBC7_RGBA_UNORM;
+			}
+
+			constexpr int getBlockByteSize(const ImageFormat& format)
+			{
+				return (format == ImageFormat::eBC1_RGBA_UNORM || format == ImageFormat::eBC4_R_UNORM) ? 8 :
+					isBlockCompressedFormat(format) ? 16 : 0;
+			}
+
+			// bumped whenever compressed image memory may have changed, stale decoded blocks are dropped
+			inline std::atomic<uint32_t>& compressedBlockCacheGeneration()
+			{
+				static std::atomic<uint32_t> generation(0);
+				return generation;
+			}
+
+			inline int getPixelByteSize(const ImageFormat& format)
 			{
 				if (format >= ImageFormat::eImageFormatMin && format <= ImageFormat::eImageFormatMax)
 					return PixelByteSize[(size_t)format];
@@ -131,14 +160,14 @@ namespace CraftEngine
 					float mR32_SFLOAT;
 					// Mixed
 					// Compressed
-					union R5G5B5A1_UNORM {
+					union {
 						uint8_t R5 : 5;
 						uint8_t G5 : 5;
 						uint8_t B5 : 5;
 						uint8_t A1 : 1;
 					}mR5G5B5A1_UNORM;
 					// Depth-stencil
-					union D24_UNORM_S8_UINT {
+					union {
 						uint32_t D24 : 24;
 						uint8_t  S8 : 8;
 					}mD24_UNORM_S8_UINT;
@@ -342,7 +371,27 @@ namespace CraftEngine
 		namespace detail
 		{
 			constexpr uint32_t MaxImageMipLevel = 32;
-			constexpr uint32_t MaxImageExtent = (1 << (MaxImageMipLevel - 1)) - 1;
+			constexpr uint32_t MaxImageExtent = (1u << (MaxImageMipLevel - 1)) - 1;
+
+			constexpr uint32_t FastClearSpanTexels = 32;
+
+			// clear state of one mip level / layer, a bit per texel is set once the texel holds rendered data.
+			// untouched texels are never written until the level is resolved and read back from the clear value.
+			struct ImageFastClearLevel
+			{
+				ImagePixelData                           mClearValue;
+				uint32_t                                 mSpansPerRow;
+				uint32_t                                 mRows;
+				std::atomic<bool>                        mPending;
+				std::unique_ptr<std::atomic<uint32_t>[]> mWritten;
+			};
+
+			// one entry per mip level and layer, allocated the first time that subresource is fast cleared
+			struct ImageFastClearData
+			{
+				std::atomic<uint32_t>                             mPendingLevels;
+				std::vector<std::unique_ptr<ImageFastClearLevel>> mLevels;
+			};
 
 			struct ImageData
 			{
@@ -353,6 +402,7 @@ namespace CraftEngine
 				ImageFormat mFormat;
 				ImageType   mType;
 				uint32_t    mPixelBytes;
+				uint32_t    mBlockBytes;
 				ImageExtent mLevelExtents[detail::MaxImageMipLevel];
 				size_t      mLevelOffsets[detail::MaxImageMipLevel];
 				vec3        mBaseDelta;
@@ -361,7 +411,149 @@ namespace CraftEngine
 				uint32_t    mMipLevels;
 				uint32_t    mMaxMipLevels;
 				uint32_t    mSampleCount;
+				ImageFastClearData* mFastClear;
 			};
+
+
+			inline bool hasPendingFastClear(const ImageData* imageData)
+			{
+				return imageData->mFastClear != nullptr && imageData->mFastClear->mPendingLevels.load(std::memory_order_acquire) > 0;
+			}
+
+			// the clear state of a subresource while it still has untouched texels, otherwise nullptr
+			inline ImageFastClearLevel* findFastClear(const ImageData* imageData, uint32_t mipLevel, uint32_t layer)
+			{
+				if (!hasPendingFastClear(imageData))
+					return nullptr;
+				auto& level = imageData->mFastClear->mLevels[mipLevel * imageData->mLayers + layer];
+				if (level == nullptr || !level->mPending.load(std::memory_order_acquire))
+					return nullptr;
+				return level.get();
+			}
+
+			// true while the texel at row y (z * height + y for 3d levels) still holds only the clear value
+			inline bool isFastClearTexel(const ImageFastClearLevel* level, uint32_t x, uint32_t y)
+			{
+				auto word = level->mWritten[size_t(y) * level->mSpansPerRow + x / FastClearSpanTexels].load(std::memory_order_acquire);
+				return (word & (1u << (x % FastClearSpanTexels))) == 0;
+			}
+
+			// call after the texel has been written, a partial write must copy the clear value in first
+			inline void markFastClearTexel(ImageFastClearLevel* level, uint32_t x, uint32_t y)
+			{
+				auto& word = level->mWritten[size_t(y) * level->mSpansPerRow + x / FastClearSpanTexels];
+				uint32_t bit = 1u << (x % FastClearSpanTexels);
+				if ((word.load(std::memory_order_relaxed) & bit) == 0)
+					word.fetch_or(bit, std::memory_order_release);
+			}
+
+			// calls func(x, y, count) for each run of untouched texels in the rows [rowBegin, rowEnd)
+			template<typename Func>
+			inline void forEachFastClearRun(const ImageFastClearLevel* level, uint32_t width, uint32_t rowBegin, uint32_t rowEnd, Func&& func)
+			{
+				for (uint32_t y = rowBegin; y < rowEnd; y++)
+				{
+					auto words = &level->mWritten[size_t(y) * level->mSpansPerRow];
+					uint32_t run_begin = 0, run_count = 0;
+					for (uint32_t span = 0; span < level->mSpansPerRow; span++)
+					{
+						uint32_t x_begin = span * FastClearSpanTexels;
+						uint32_t span_texels = math::min(width - x_begin, FastClearSpanTexels);
+						uint32_t span_mask = span_texels == 32 ? ~0u : (1u << span_texels) - 1u;
+						uint32_t word = words[span].load(std::memory_order_acquire) & span_mask;
+						if (word == 0)
+						{
+							if (run_count == 0)
+								run_begin = x_begin;
+							run_count += span_texels;
+							continue;
+						}
+						for (uint32_t i = 0; i < span_texels; i++)
+						{
+							if ((word & (1u << i)) == 0)
+							{
+								if (run_count == 0)
+									run_begin = x_begin + i;
+								run_count++;
+							}
+							else if (run_count > 0)
+							{
+								func(run_begin, y, run_count);
+								run_count = 0;
+							}
+						}
+					}
+					if (run_count > 0)
+						func(run_begin, y, run_count);
+				}
+			}
+
+			inline void finishFastClear(ImageData* imageData, ImageFastClearLevel* level)
+			{
+				if (level->mPending.exchange(false, std::memory_order_acq_rel))
+					imageData->mFastClear->mPendingLevels.fetch_sub(1, std::memory_order_acq_rel);
+			}
+
+			// writes the clear value into the texels of a subresource that nothing has touched yet
+			inline void resolveFastClear(ImageData* imageData, uint32_t mipLevel, uint32_t layer)
+			{
+				auto level = findFastClear(imageData, mipLevel, layer);
+				if (level == nullptr)
+					return;
+				auto pixel_bytes = imageData->mPixelBytes;
+				auto width = imageData->mLevelExtents[mipLevel].mWidth;
+				auto level_begin = ((byte*)imageData->mMappedPtr) + imageData->mLayerSize * layer + imageData->mLevelOffsets[mipLevel];
+				forEachFastClearRun(level, width, 0, level->mRows, [&](uint32_t x, uint32_t y, uint32_t count) {
+					auto texel = level_begin + (size_t(y) * width + x) * pixel_bytes;
+					for (uint32_t i = 0; i < count; i++, texel += pixel_bytes)
+						memcpy(texel, level->mClearValue.mData, pixel_bytes);
+				});
+				finishFastClear(imageData, level);
+			}
+
+			inline void resolveFastClear(ImageData* imageData)
+			{
+				if (!hasPendingFastClear(imageData))
+					return;
+				for (uint32_t mip_level = 0; mip_level < imageData->mMipLevels; mip_level++)
+					for (uint32_t layer = 0; layer < imageData->mLayers; layer++)
+						resolveFastClear(imageData, mip_level, layer);
+			}
+
+			// drops the pending clear of a subresource that is about to be overwritten entirely
+			inline void discardFastClear(ImageData* imageData, uint32_t mipLevel, uint32_t layer)
+			{
+				auto level = findFastClear(imageData, mipLevel, layer);
+				if (level != nullptr)
+					finishFastClear(imageData, level);
+			}
+
+			// must not race with rendering into the image
+			inline void markFastClear(ImageData* imageData, uint32_t mipLevel, uint32_t layer, const ImagePixelData& clearValue)
+			{
+				if (imageData->mFastClear == nullptr)
+				{
+					imageData->mFastClear = new ImageFastClearData;
+					imageData->mFastClear->mPendingLevels.store(0, std::memory_order_relaxed);
+					imageData->mFastClear->mLevels.resize(size_t(imageData->mMipLevels) * imageData->mLayers);
+				}
+				auto& level = imageData->mFastClear->mLevels[mipLevel * imageData->mLayers + layer];
+				if (level == nullptr)
+				{
+					auto& level_extent = imageData->mLevelExtents[mipLevel];
+					level.reset(new ImageFastClearLevel);
+					level->mSpansPerRow = (level_extent.mWidth + FastClearSpanTexels - 1) / FastClearSpanTexels;
+					level->mRows = level_extent.mHeight * level_extent.mDepth;
+					level->mPending.store(false, std::memory_order_relaxed);
+					level->mWritten.reset(new std::atomic<uint32_t>[size_t(level->mSpansPerRow) * level->mRows]);
+				}
+				size_t word_count = size_t(level->mSpansPerRow) * level->mRows;
+				for (size_t i = 0; i < word_count; i++)
+					level->mWritten[i].store(0, std::memory_order_relaxed);
+				level->mClearValue = clearValue;
+				if (!level->mPending.exchange(true, std::memory_order_acq_rel))
+					imageData->mFastClear->mPendingLevels.fetch_add(1, std::memory_order_release);
+			}
 		}
 
 
@@ -395,13 +587,15 @@ namespace CraftEngine
 				unbind();
 				if (mem.valid())
 				{
-					if (this->size() > mem.size())
+					if (offset + this->size() > mem.size())
 						soft3d_throw_error(ErrorType::eImageMemoryNotEnough);
-					if (this->size() > mem.size())
+					if (offset + this->size() > mem.size())
 						return;
 					m_imageData->mMemoryOffset = offset;
 					m_imageData->mMemory = mem;
 					m_imageData->mMappedPtr = ((byte*)m_imageData->mMemory.data()) + m_imageData->mMemoryOffset;
+					if (detail::isBlockCompressedFormat(m_imageData->mFormat))
+						detail::compressedBlockCacheGeneration()++;
 				}
 			}	
 
@@ -411,6 +605,7 @@ namespace CraftEngine
 
 			void writeToFile(const char* filename, uint32_t mipmapLevel, uint32_t layer)
 			{
+				detail::resolveFastClear(m_imageData, mipmapLevel, layer);
 				byte const* data = (byte*)m_imageData->mMappedPtr;
 
 				stbi_write_png(filename, m_imageData->mLevelExtents[mipmapLevel].mWidth, m_imageData->mLevelExtents[mipmapLevel].mHeight, 4,
@@ -456,15 +651,23 @@ namespace CraftEngine
 				soft3d_assert_error(layers == 6, ErrorType::eInvalidParam);
 				break;
 			}
+			if (detail::isBlockCompressedFormat(format))
+			{
+				if (type == ImageType::eImage1D || type == ImageType::eImage1DArray)
+					soft3d_throw_error(ErrorType::eWrongImageType);
+				soft3d_assert_error(sampleCount <= 1, ErrorType::eInvalidParam);
+			}
 
 			auto img_data = (detail::ImageData*)allocator.alloc(sizeof(detail::ImageData));
 			img_data->mMemory = Memory(nullptr);
 			img_data->mMemoryOffset = 0;
 			img_data->mMappedPtr = nullptr;
+			img_data->mFastClear = nullptr;
 
 			img_data->mType = type;
 			img_data->mFormat = format;
 			img_data->mPixelBytes = detail::getPixelByteSize(format);
+			img_data->mBlockBytes = detail::getBlockByteSize(format);
 
 			img_data->mLevelExtents[0].mWidth = width;
 			img_data->mLevelExtents[0].mHeight = height;
@@ -487,8 +690,12 @@ namespace CraftEngine
 			for (int i = 0; i < img_data->mMipLevels; i++)
 			{
 				img_data->mLevelOffsets[i] = offset;
-				offset += (size_t)img_data->mPixelBytes * img_data->mLevelExtents[i].mWidth *
-					img_data->mLevelExtents[i].mHeight * img_data->mLevelExtents[i].mDepth;
+				if (img_data->mBlockBytes > 0)
+					offset += (size_t)img_data->mBlockBytes * ((img_data->mLevelExtents[i].mWidth + 3) / 4) *
+						((img_data->mLevelExtents[i].mHeight + 3) / 4) * img_data->mLevelExtents[i].mDepth;
+				else
+					offset += (size_t)img_data->mPixelBytes * img_data->mLevelExtents[i].mWidth *
+						img_data->mLevelExtents[i].mHeight * img_data->mLevelExtents[i].mDepth;
 			}
 
 			img_data->mLayerSize = offset;
@@ -502,6 +709,7 @@ namespace CraftEngine
 
 		void destroyImage(const Image& image, const MemAllocator& allocator = MemAllocator())
 		{
+			delete ((detail::ImageData*)image.handle())->mFastClear;
 			allocator.free(image.handle());
 		}
 
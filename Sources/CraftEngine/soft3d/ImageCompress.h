@@ -0,0 +1,755 @@
+#pragma once
+#include "./Image.h"
+
+#ifndef CRAFT_ENGINE_SOFT3D_BLOCK_CACHE_SIZE
+// decoded 4x4 blocks kept per thread, 0 disables the cache
+#define CRAFT_ENGINE_SOFT3D_BLOCK_CACHE_SIZE 64
+#endif
+
+namespace CraftEngine
+{
+	namespace soft3d
+	{
+
+
+		namespace detail
+		{
+			static_assert(sizeof(u8vec4) == 4, "u8vec4 must be tightly packed.");
+
+			constexpr int CompressedBlockExtent = 4;
+			constexpr int CompressedBlockTexelCount = CompressedBlockExtent * CompressedBlockExtent;
+
+			const uint16_t BC7PartitionTable2[64] =
+			{
+				0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80, 0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+				0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE, 0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+				0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A, 0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+				0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C, 0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22,
+			};
+
+			const uint32_t BC7PartitionTable3[64] =
+			{
+				0xAA685050, 0x6A5A5040, 0x5A5A4200, 0x5450A0A8, 0xA5A50000, 0xA0A05050, 0x5555A0A0, 0x5A5A5050,
+				0xAA550000, 0xAA555500, 0xAAAA5500, 0x90909090, 0x94949494, 0xA4A4A4A4, 0xA9A59450, 0x2A0A4250,
+				0xA5945040, 0x0A425054, 0xA5A5A500, 0x55A0A0A0, 0xA8A85454, 0x6A6A4040, 0xA4A45000, 0x1A1A0500,
+				0x0050A4A4, 0xAAA59090, 0x14696914, 0x69691400, 0xA08585A0, 0xAA821414, 0x50A4A450, 0x6A5A0200,
+				0xA9A58000, 0x5090A0A8, 0xA8A09050, 0x24242424, 0x00AA5500, 0x24924924, 0x24499224, 0x50A50A50,
+				0x500AA550, 0xAAAA4444, 0x66660000, 0xA5A0A5A0, 0x50A050A0, 0x69286928, 0x44AAAA44, 0x66666600,
+				0xAA444444, 0x54A854A8, 0x95809580, 0x96969600, 0xA85454A8, 0x80959580, 0xAA141414, 0x96960000,
+				0xAAAA1414, 0xA05050A0, 0xA0A5A5A0, 0x96000000, 0x40804080, 0xA9A8A9A8, 0xAAAAAA44, 0x2A4A5254,
+			};
+
+			const uint8_t BC7AnchorTable2[64] =
+			{
+				15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+				15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+				15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+				 6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15,
+			};
+
+			const uint8_t BC7AnchorTable3a[64] =
+			{
+				 3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+				 3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+				 8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+				 3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3,
+			};
+
+			const uint8_t BC7AnchorTable3b[64] =
+			{
+				15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+				15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+				15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+				15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8,
+			};
+
+			const uint8_t BC7Weights2[4] = { 0, 21, 43, 64 };
+			const uint8_t BC7Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+			const uint8_t BC7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+			struct BC7ModeInfo
+			{
+				uint8_t mSubsetCount;
+				uint8_t mPartitionBits;
+				uint8_t mRotationBits;
+				uint8_t mIndexSelectionBits;
+				uint8_t mColorBits;
+				uint8_t mAlphaBits;
+				uint8_t mEndpointPBits;
+				uint8_t mSharedPBits;
+				uint8_t mIndexBits;
+				uint8_t mIndexBits2;
+			};
+
+			const BC7ModeInfo BC7Modes[8] =
+			{
+				{ 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+				{ 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+				{ 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+				{ 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+				{ 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+				{ 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+				{ 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+				{ 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 },
+			};
+
+
+			// little-endian bit stream over a 128-bit block
+			class CompressedBlockBits
+			{
+			private:
+				uint64_t m_bits[2];
+				uint32_t m_pos;
+			public:
+				CompressedBlockBits() : m_bits{ 0, 0 }, m_pos(0) {}
+				explicit CompressedBlockBits(const byte* block) : m_pos(0)
+				{
+					memcpy(m_bits, block, 16);
+				}
+				uint32_t read(uint32_t count)
+				{
+					if (count == 0)
+						return 0;
+					uint32_t value;
+					uint32_t word = m_pos >> 6, bit = m_pos & 63;
+					if (bit + count <= 64)
+						value = uint32_t(m_bits[word] >> bit);
+					else
+						value = uint32_t((m_bits[0] >> bit) | (m_bits[1] << (64 - bit)));
+					m_pos += count;
+					return value & ((1u << count) - 1);
+				}
+				void write(uint32_t value, uint32_t count)
+				{
+					for (uint32_t i = 0; i < count; i++, m_pos++)
+						m_bits[m_pos >> 6] |= uint64_t((value >> i) & 1) << (m_pos & 63);
+				}
+				void store(byte* block) const
+				{
+					memcpy(block, m_bits, 16);
+				}
+			};
+
+
+			inline u8vec4 expandColor565(uint16_t color)
+			{
+				uint8_t r = (color >> 11) & 0x1F;
+				uint8_t g = (color >> 5) & 0x3F;
+				uint8_t b = color & 0x1F;
+				return u8vec4((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2), 0xFF);
+			}
+
+			inline uint16_t packColor565(const u8vec4& color)
+			{
+				return uint16_t(((color[0] * 31 + 127) / 255) << 11 | ((color[1] * 63 + 127) / 255) << 5 | ((color[2] * 31 + 127) / 255));
+			}
+
+
+			// palette[4] from the two 565 endpoints of a bc1 color block
+			inline void decodeColorPaletteBC1(const byte* block, u8vec4* palette, bool allowPunchThrough)
+			{
+				uint16_t c0 = uint16_t(block[0] | (block[1] << 8));
+				uint16_t c1 = uint16_t(block[2] | (block[3] << 8));
+				palette[0] = expandColor565(c0);
+				palette[1] = expandColor565(c1);
+				bool four_color = !allowPunchThrough || c0 > c1;
+#ifdef CRAFT_ENGINE_SIMD_SSE2
+				__m128i zero = _mm_setzero_si128();
+				__m128i ends = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)palette), zero); // c0.rgba c1.rgba
+				__m128i swap = _mm_shuffle_epi32(ends, _MM_SHUFFLE(1, 0, 3, 2));                    // c1.rgba c0.rgba
+				__m128i mixed;
+				if (four_color)
+				{
+					// (2 * c0 + c1 + 1) / 3 and (c0 + 2 * c1 + 1) / 3, x / 3 == (x * 0xAAAB) >> 17
+					mixed = _mm_add_epi16(_mm_add_epi16(_mm_add_epi16(ends, ends), swap), _mm_set1_epi16(1));
+					mixed = _mm_srli_epi16(_mm_mulhi_epu16(mixed, _mm_set1_epi16((short)0xAAAB)), 1);
+				}
+				else
+				{
+					mixed = _mm_srli_epi16(_mm_add_epi16(ends, swap), 1);
+				}
+				_mm_storel_epi64((__m128i*)(palette + 2), _mm_packus_epi16(mixed, zero));
+				if (!four_color)
+					palette[3] = u8vec4(0, 0, 0, 0);
+#else
+				if (four_color)
+				{
+					for (int c = 0; c < 3; c++)
+					{
+						palette[2][c] = uint8_t((2 * palette[0][c] + palette[1][c] + 1) / 3);
+						palette[3][c] = uint8_t((palette[0][c] + 2 * palette[1][c] + 1) / 3);
+					}
+					palette[2][3] = palette[3][3] = 0xFF;
+				}
+				else
+				{
+					for (int c = 0; c < 3; c++)
+						palette[2][c] = uint8_t((palette[0][c] + palette[1][c]) / 2);
+					palette[2][3] = 0xFF;
+					palette[3] = u8vec4(0, 0, 0, 0);
+				}
+#endif
+			}
+
+			// 16 single channel values from an 8 bytes bc4 block, written with the given stride
+			inline void decodeChannelBC4(const byte* block, uint8_t* values, int stride)
+			{
+				uint8_t palette[8];
+				palette[0] = block[0];
+				palette[1] = block[1];
+				if (palette[0] > palette[1])
+				{
+					for (int i = 1; i < 7; i++)
+						palette[i + 1] = uint8_t(((7 - i) * palette[0] + i * palette[1] + 3) / 7);
+				}
+				else
+				{
+					for (int i = 1; i < 5; i++)
+						palette[i + 1] = uint8_t(((5 - i) * palette[0] + i * palette[1] + 2) / 5);
+					palette[6] = 0x00;
+					palette[7] = 0xFF;
+				}
+				uint64_t indices = 0;
+				for (int i = 0; i < 6; i++)
+					indices |= uint64_t(block[2 + i]) << (8 * i);
+				for (int i = 0; i < CompressedBlockTexelCount; i++, indices >>= 3)
+					values[i * stride] = palette[indices & 0x7];
+			}
+
+			inline void decodeBlockBC1(const byte* block, u8vec4* texels)
+			{
+				u8vec4 palette[4];
+				decodeColorPaletteBC1(block, palette, true);
+				uint32_t indices = uint32_t(block[4] | (block[5] << 8) | (block[6] << 16) | (block[7] << 24));
+				for (int i = 0; i < CompressedBlockTexelCount; i++, indices >>= 2)
+					texels[i] = palette[indices & 0x3];
+			}
+
+			inline void decodeBlockBC3(const byte* block, u8vec4* texels)
+			{
+				u8vec4 palette[4];
+				decodeColorPaletteBC1(block + 8, palette, false);
+				uint32_t indices = uint32_t(block[12] | (block[13] << 8) | (block[14] << 16) | (block[15] << 24));
+				for (int i = 0; i < CompressedBlockTexelCount; i++, indices >>= 2)
+					texels[i] = palette[indices & 0x3];
+				decodeChannelBC4(block, (uint8_t*)texels + 3, 4);
+			}
+
+			inline void decodeBlockBC4(const byte* block, u8vec4* texels)
+			{
+				// broadcast like eR8_UNORM
+				uint8_t values[CompressedBlockTexelCount];
+				decodeChannelBC4(block, values, 1);
+				for (int i = 0; i < CompressedBlockTexelCount; i++)
+					texels[i] = u8vec4(values[i]);
+			}
+
+			inline void decodeBlockBC5(const byte* block, u8vec4* texels)
+			{
+				for (int i = 0; i < CompressedBlockTexelCount; i++)
+					texels[i] = u8vec4(0, 0, 0, 0xFF);
+				decodeChannelBC4(block, (uint8_t*)texels + 0, 4);
+				decodeChannelBC4(block + 8, (uint8_t*)texels + 1, 4);
+			}
+
+			inline void decodeBlockBC7(const byte* block, u8vec4* texels)
+			{
+				int mode = 0;
+				while (mode < 8 && (block[0] & (1 << mode)) == 0)
+					mode++;
+				if (mode == 8)
+				{
+					// reserved mode, decodes to transparent black
+					memset(texels, 0, sizeof(u8vec4) * CompressedBlockTexelCount);
+					return;
+				}
+				const BC7ModeInfo& info = BC7Modes[mode];
+				CompressedBlockBits bits(block);
+				bits.read(mode + 1);
+				uint32_t partition = bits.read(info.mPartitionBits);
+				uint32_t rotation = bits.read(info.mRotationBits);
+				uint32_t index_selection = bits.read(info.mIndexSelectionBits);
+
+				int endpoint_count = info.mSubsetCount * 2;
+				uint8_t endpoints[6][4];
+				for (int c = 0; c < 3; c++)
+					for (int e = 0; e < endpoint_count; e++)
+						endpoints[e][c] = bits.read(info.mColorBits);
+				for (int e = 0; e < endpoint_count; e++)
+					endpoints[e][3] = bits.read(info.mAlphaBits);
+
+				int color_bits = info.mColorBits, alpha_bits = info.mAlphaBits;
+				if (info.mEndpointPBits || info.mSharedPBits)
+				{
+					uint32_t pbits[6];
+					if (info.mEndpointPBits)
+						for (int e = 0; e < endpoint_count; e++)
+							pbits[e] = bits.read(1);
+					else
+						for (int s = 0; s < info.mSubsetCount; s++)
+							pbits[s * 2] = pbits[s * 2 + 1] = bits.read(1);
+					for (int e = 0; e < endpoint_count; e++)
+						for (int c = 0; c < 4; c++)
+							endpoints[e][c] = (endpoints[e][c] << 1) | pbits[e];
+					color_bits++;
+					if (alpha_bits)
+						alpha_bits++;
+				}
+				for (int e = 0; e < endpoint_count; e++)
+				{
+					for (int c = 0; c < 3; c++)
+						endpoints[e][c] = (endpoints[e][c] << (8 - color_bits)) | (endpoints[e][c] >> (2 * color_bits - 8));
+					if (alpha_bits)
+						endpoints[e][3] = (endpoints[e][3] << (8 - alpha_bits)) | (endpoints[e][3] >> (2 * alpha_bits - 8));
+					else
+						endpoints[e][3] = 0xFF;
+				}
+
+				uint8_t subsets[CompressedBlockTexelCount];
+				uint32_t anchor1 = 0, anchor2 = 0;
+				for (int i = 0; i < CompressedBlockTexelCount; i++)
+				{
+					switch (info.mSubsetCount)
+					{
+					case 1: subsets[i] = 0; break;
+					case 2: subsets[i] = (BC7PartitionTable2[partition] >> i) & 0x1; break;
+					case 3: subsets[i] = (BC7PartitionTable3[partition] >> (2 * i)) & 0x3; break;
+					}
+				}
+				if (info.mSubsetCount == 2)
+					anchor1 = BC7AnchorTable2[partition];
+				else if (info.mSubsetCount == 3)
+					anchor1 = BC7AnchorTable3a[partition], anchor2 = BC7AnchorTable3b[partition];
+
+				uint8_t indices[CompressedBlockTexelCount], indices2[CompressedBlockTexelCount];
+				for (uint32_t i = 0; i < CompressedBlockTexelCount; i++)
+				{
+					bool anchor = i == 0 || (info.mSubsetCount > 1 && i == anchor1) || (info.mSubsetCount > 2 && i == anchor2);
+					indices[i] = bits.read(info.mIndexBits - (anchor ? 1 : 0));
+				}
+				for (uint32_t i = 0; i < CompressedBlockTexelCount && info.mIndexBits2; i++)
+					indices2[i] = bits.read(info.mIndexBits2 - (i == 0 ? 1 : 0));
+
+				auto weight_table = [](uint32_t indexBits) {
+					return indexBits == 2 ? BC7Weights2 : indexBits == 3 ? BC7Weights3 : BC7Weights4;
+				};
+				const uint8_t* color_weights = weight_table(info.mIndexBits);
+				const uint8_t* alpha_weights = color_weights;
+				const uint8_t* color_indices = indices;
+				const uint8_t* alpha_indices = indices;
+				if (info.mIndexBits2)
+				{
+					alpha_weights = weight_table(info.mIndexBits2);
+					alpha_indices = indices2;
+					if (index_selection)
+					{
+						std::swap(color_weights, alpha_weights);
+						std::swap(color_indices, alpha_indices);
+					}
+				}
+
+#ifdef CRAFT_ENGINE_SIMD_SSE2
+				// two texels per register, 16-bit lanes: e0 * (64 - w) + e1 * w + 32 >> 6
+				const __m128i zero = _mm_setzero_si128();
+				for (int i = 0; i < CompressedBlockTexelCount; i += 2)
+				{
+					uint32_t e0[2], e1[2];
+					int16_t w[8];
+					for (int k = 0; k < 2; k++)
+					{
+						memcpy(&e0[k], endpoints[subsets[i + k] * 2 + 0], 4);
+						memcpy(&e1[k], endpoints[subsets[i + k] * 2 + 1], 4);
+						w[k * 4 + 0] = w[k * 4 + 1] = w[k * 4 + 2] = color_weights[color_indices[i + k]];
+						w[k * 4 + 3] = alpha_weights[alpha_indices[i + k]];
+					}
+					__m128i v0 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)e0), zero);
+					__m128i v1 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)e1), zero);
+					__m128i w1 = _mm_loadu_si128((const __m128i*)w);
+					__m128i w0 = _mm_sub_epi16(_mm_set1_epi16(64), w1);
+					__m128i r = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(v0, w0), _mm_mullo_epi16(v1, w1)), _mm_set1_epi16(32));
+					_mm_storel_epi64((__m128i*)(texels + i), _mm_packus_epi16(_mm_srli_epi16(r, 6), zero));
+				}
+#else
+				for (int i = 0; i < CompressedBlockTexelCount; i++)
+				{
+					const uint8_t* e0 = endpoints[subsets[i] * 2 + 0];
+					const uint8_t* e1 = endpoints[subsets[i] * 2 + 1];
+					uint32_t cw = color_weights[color_indices[i]], aw = alpha_weights[alpha_indices[i]];
+					for (int c = 0; c < 3; c++)
+						texels[i][c] = uint8_t((e0[c] * (64 - cw) + e1[c] * cw + 32) >> 6);
+					texels[i][3] = uint8_t((e0[3] * (64 - aw) + e1[3] * aw + 32) >> 6);
+				}
+#endif
+				if (rotation)
+				{
+					for (int i = 0; i < CompressedBlockTexelCount; i++)
+						std::swap(texels[i][3], texels[i][rotation - 1]);
+				}
+			}
+
+			inline void decodeCompressedBlock(ImageFormat format, const byte* block, u8vec4* texels)
+			{
+				switch (format)
+				{
+				case ImageFormat::eBC1_RGBA_UNORM:
+					decodeBlockBC1(block, texels);
+					break;
+				case ImageFormat::eBC3_RGBA_UNORM:
+					decodeBlockBC3(block, texels);
+					break;
+				case ImageFormat::eBC4_R_UNORM:
+					decodeBlockBC4(block, texels);
+					break;
+				case ImageFormat::eBC5_RG_UNORM:
+					decodeBlockBC5(block, texels);
+					break;
+				case ImageFormat::eBC7_RGBA_UNORM:
+					decodeBlockBC7(block, texels);
+					break;
+				default:
+					soft3d_throw_error(ErrorType::eInvalidEnum);
+				}
+			}
+
+
+
+
+			// principal axis of the block colors, endpoints are the extreme projections
+			inline void findColorEndpoints(const u8vec4* texels, int channels, vec4& minColor, vec4& maxColor)
+			{
+				vec4 mean = vec4(0.0f);
+				for (int i = 0; i < CompressedBlockTexelCount; i++)
+					mean += vec4(texels[i]);
+				mean *= 1.0f / CompressedBlockTexelCount;
+				float cov[4][4] = {};
+				for (int i = 0; i < CompressedBlockTexelCount; i++)
+				{
+					vec4 d = vec4(texels[i]) - mean;
+					for (int a = 0; a < channels; a++)
+						for (int b = a; b < channels; b++)
+							cov[a][b] += d[a] * d[b];
+				}
+				for (int a = 0; a < channels; a++)
+					for (int b = 0; b < a; b++)
+						cov[a][b] = cov[b][a];
+				vec4 axis = vec4(1.0f, 1.0f, 1.0f, channels > 3 ? 1.0f : 0.0f);
+				for (int iter = 0; iter < 8; iter++)
+				{
+					vec4 next = vec4(0.0f);
+					for (int a = 0; a < channels; a++)
+						for (int b = 0; b < channels; b++)
+							next[a] += cov[a][b] * axis[b];
+					float len = math::max(math::abs(next[0]), math::abs(next[1]), math::abs(next[2]), math::abs(next[3]));
+					if (len < 1e-6f)
+						break;
+					axis = next * (1.0f / len);
+				}
+				float tmin = 0.0f, tmax = 0.0f, norm = 0.0f;
+				for (int a = 0; a < channels; a++)
+					norm += axis[a] * axis[a];
+				if (norm < 1e-12f)
+				{
+					minColor = maxColor = mean;
+					return;
+				}
+				for (int i = 0; i < CompressedBlockTexelCount; i++)
+				{
+					vec4 d = vec4(texels[i]) - mean;
+					float t = 0.0f;
+					for (int a = 0; a < channels; a++)
+						t += d[a] * axis[a];
+					t /= norm;
+					tmin = math::min(tmin, t);
+					tmax = math::max(tmax, t);
+				}
+				minColor = math::clamp(mean + axis * tmin, vec4(0.0f), vec4(255.0f));
+				maxColor = math::clamp(mean + axis * tmax, vec4(0.0f), vec4(255.0f));
+			}
+
+			inline uint32_t colorDistance(const u8vec4& a, const u8vec4& b, int channels)
+			{
+				uint32_t dist = 0;
+				for (int c = 0; c < channels; c++)
+				{
+					int d = int(a[c]) - int(b[c]);
+					dist += d * d;
+				}
+				return dist;
+			}
+
+			inline void encodeColorBC1(const u8vec4* texels, byte* block, bool allowPunchThrough)
+			{
+				bool punch_through = false;
+				if (allowPunchThrough)
+					for (int i = 0; i < CompressedBlockTexelCount; i++)
+						punch_through |= texels[i][3] < 128;
+				vec4 min_color, max_color;
+				findColorEndpoints(texels, 3, min_color, max_color);
+				uint16_t c0 = packColor565(u8vec4(max_color + 0.5f)), c1 = packColor565(u8vec4(min_color + 0.5f));
+				// c0 > c1 selects four colors, c0 <= c1 selects three colors plus transparent black
+				if ((c0 < c1) != punch_through)
+					std::swap(c0, c1);
+				if (c0 == c1 && !punch_through)
+				{
+					if (c1 > 0) c1--;
+					else c0++;
+				}
+				block[0] = byte(c0 & 0xFF);
+				block[1] = byte(c0 >> 8);
+				block[2] = byte(c1 & 0xFF);
+				block[3] = byte(c1 >> 8);
+				u8vec4 palette[4];
+				decodeColorPaletteBC1(block, palette, allowPunchThrough);
+				uint32_t indices = 0;
+				for (int i = 0; i < CompressedBlockTexelCount; i++)
+				{
+					uint32_t best = 0;
+					if (punch_through && texels[i][3] < 128)
+					{
+						best = 3;
+					}
+					else
+					{
+						uint32_t best_dist = ~0u;
+						for (uint32_t k = 0; k < (punch_through ? 3u : 4u); k++)
+						{
+							uint32_t dist = colorDistance(texels[i], palette[k], 3);
+							if (dist < best_dist)
+								best_dist = dist, best = k;
+						}
+					}
+					indices |= best << (2 * i);
+				}
+				block[4] = byte(indices & 0xFF);
+				block[5] = byte((indices >> 8) & 0xFF);
+				block[6] = byte((indices >> 16) & 0xFF);
+				block[7] = byte(indices >> 24);
+			}
+
+			inline void encodeChannelBC4(const uint8_t* values, int stride, byte* block)
+			{
+				uint8_t vmin = 0xFF, vmax = 0x00;
+				for (int i = 0; i < CompressedBlockTexelCount; i++)
+				{
+					vmin = math::min(vmin, values[i * stride]);
+					vmax = math::max(vmax, values[i * stride]);
+				}
+				memset(block, 0, 8);
+				block[0] = vmax;
+				block[1] = vmin;
+				if (vmax == vmin)
+					return;
+				uint8_t palette[8];
+				palette[0] = vmax;
+				palette[1] = vmin;
+				for (int i = 1; i < 7; i++)
+					palette[i + 1] = uint8_t(((7 - i) * palette[0] + i * palette[1] + 3) / 7);
+				uint64_t indices = 0;
+				for (int i = 0; i < CompressedBlockTexelCount; i++)
+				{
+					uint32_t best = 0, best_dist = ~0u;
+					for (uint32_t k = 0; k < 8; k++)
+					{
+						uint32_t dist = math::abs(int(values[i * stride]) - int(palette[k]));
+						if (dist < best_dist)
+							best_dist = dist, best = k;
+					}
+					indices |= uint64_t(best) << (3 * i);
+				}
+				for (int i = 0; i < 6; i++)
+					block[2 + i] = byte((indices >> (8 * i)) & 0xFF);
+			}
+
+			inline void encodeBlockBC1(const u8vec4* texels, byte* block)
+			{
+				encodeColorBC1(texels, block, true);
+			}
+
+			inline void encodeBlockBC3(const u8vec4* texels, byte* block)
+			{
+				encodeChannelBC4((const uint8_t*)texels + 3, 4, block);
+				encodeColorBC1(texels, block + 8, false);
+			}
+
+			inline void encodeBlockBC4(const u8vec4* texels, byte* block)
+			{
+				encodeChannelBC4((const uint8_t*)texels, 4, block);
+			}
+
+			inline void encodeBlockBC5(const u8vec4* texels, byte* block)
+			{
+				encodeChannelBC4((const uint8_t*)texels + 0, 4, block);
+				encodeChannelBC4((const uint8_t*)texels + 1, 4, block + 8);
+			}
+
+			// mode 6 only: one subset, rgba 7.7.7.7 endpoints with a p-bit each, 4-bit indices
+			inline void encodeBlockBC7(const u8vec4* texels, byte* block)
+			{
+				vec4 min_color, max_color;
+				findColorEndpoints(texels, 4, min_color, max_color);
+				uint8_t endpoints[2][4];
+				uint32_t pbits[2];
+				const vec4 ends[2] = { min_color, max_color };
+				for (int e = 0; e < 2; e++)
+				{
+					// pick the p-bit that loses the least precision over all four channels
+					float err[2] = { 0.0f, 0.0f };
+					uint8_t quant[2][4];
+					for (int p = 0; p < 2; p++)
+					{
+						for (int c = 0; c < 4; c++)
+						{
+							int q = math::clamp(int(math::round((ends[e][c] - p) * 0.5f)), 0, 127);
+							quant[p][c] = uint8_t(q);
+							float d = float((q << 1) | p) - ends[e][c];
+							err[p] += d * d;
+						}
+					}
+					pbits[e] = err[1] < err[0] ? 1 : 0;
+					memcpy(endpoints[e], quant[pbits[e]], 4);
+				}
+				u8vec4 palette[16];
+				for (int k = 0; k < 16; k++)
+				{
+					uint32_t w = BC7Weights4[k];
+					for (int c = 0; c < 4; c++)
+					{
+						uint32_t e0 = (endpoints[0][c] << 1) | pbits[0];
+						uint32_t e1 = (endpoints[1][c] << 1) | pbits[1];
+						palette[k][c] = uint8_t((e0 * (64 - w) + e1 * w + 32) >> 6);
+					}
+				}
+				uint8_t indices[CompressedBlockTexelCount];
+				for (int i = 0; i < CompressedBlockTexelCount; i++)
+				{
+					uint32_t best = 0, best_dist = ~0u;
+					for (uint32_t k = 0; k < 16; k++)
+					{
+						uint32_t dist = colorDistance(texels[i], palette[k], 4);
+						if (dist < best_dist)
+							best_dist = dist, best = k;
+					}
+					indices[i] = best;
+				}
+				// the anchor index drops its top bit, flip the endpoints to keep it clear
+				if (indices[0] & 0x8)
+				{
+					for (int c = 0; c < 4; c++)
+						std::swap(endpoints[0][c], endpoints[1][c]);
+					std::swap(pbits[0], pbits[1]);
+					for (int i = 0; i < CompressedBlockTexelCount; i++)
+						indices[i] = 15 - indices[i];
+				}
+				CompressedBlockBits bits;
+				bits.write(1 << 6, 7);
+				for (int c = 0; c < 4; c++)
+					for (int e = 0; e < 2; e++)
+						bits.write(endpoints[e][c], 7);
+				bits.write(pbits[0], 1);
+				bits.write(pbits[1], 1);
+				for (int i = 0; i < CompressedBlockTexelCount; i++)
+					bits.write(indices[i], i == 0 ? 3 : 4);
+				bits.store(block);
+			}
+
+			inline void encodeCompressedBlock(ImageFormat format, const u8vec4* texels, byte* block)
+			{
+				switch (format)
+				{
+				case ImageFormat::eBC1_RGBA_UNORM:
+					encodeBlockBC1(texels, block);
+					break;
+				case ImageFormat::eBC3_RGBA_UNORM:
+					encodeBlockBC3(texels, block);
+					break;
+				case ImageFormat::eBC4_R_UNORM:
+					encodeBlockBC4(texels, block);
+					break;
+				case ImageFormat::eBC5_RG_UNORM:
+					encodeBlockBC5(texels, block);
+					break;
+				case ImageFormat::eBC7_RGBA_UNORM:
+					encodeBlockBC7(texels, block);
+					break;
+				default:
+					soft3d_throw_error(ErrorType::eInvalidEnum);
+				}
+			}
+
+
+
+
+			struct CompressedBlockCacheEntry
+			{
+				const byte* mBlock;
+				ImageFormat mFormat;
+				uint32_t    mGeneration;
+				u8vec4      mTexels[CompressedBlockTexelCount];
+			};
+
+			// decodes the block on a miss, the result stays valid until the next fetch on this thread
+			inline const u8vec4* fetchCompressedBlock(ImageFormat format, const byte* block)
+			{
+#if CRAFT_ENGINE_SOFT3D_BLOCK_CACHE_SIZE > 0
+				static_assert((CRAFT_ENGINE_SOFT3D_BLOCK_CACHE_SIZE & (CRAFT_ENGINE_SOFT3D_BLOCK_CACHE_SIZE - 1)) == 0,
+					"CRAFT_ENGINE_SOFT3D_BLOCK_CACHE_SIZE must be a power of 2.");
+				thread_local CompressedBlockCacheEntry cache[CRAFT_ENGINE_SOFT3D_BLOCK_CACHE_SIZE] = {};
+				uint32_t generation = compressedBlockCacheGeneration().load(std::memory_order_relaxed);
+				// slot by block index so neighbouring blocks never share one
+				size_t block_index = getBlockByteSize(format) == 8 ? size_t(block) >> 3 : size_t(block) >> 4;
+				auto& entry = cache[block_index & (CRAFT_ENGINE_SOFT3D_BLOCK_CACHE_SIZE - 1)];
+				// the same bytes may be viewed through another format, e.g. after memory was rebound
+				if (entry.mBlock != block || entry.mFormat != format || entry.mGeneration != generation)
+				{
+					decodeCompressedBlock(format, block, entry.mTexels);
+					entry.mBlock = block;
+					entry.mFormat = format;
+					entry.mGeneration = generation;
+				}
+				return entry.mTexels;
+#else
+				thread_local u8vec4 texels[CompressedBlockTexelCount];
+				decodeCompressedBlock(format, block, texels);
+				return texels;
+#endif
+			}
+
+			inline const byte* getCompressedBlockAddress(const ImageData* imageData, uint32_t mipLevel, uint32_t layer, const ivec3& texCoord)
+			{
+				auto& level_extent = imageData->mLevelExtents[mipLevel];
+				uint32_t blocks_x = (level_extent.mWidth + CompressedBlockExtent - 1) / CompressedBlockExtent;
+				uint32_t blocks_y = (level_extent.mHeight + CompressedBlockExtent - 1) / CompressedBlockExtent;
+				size_t block_index = (size_t(texCoord.z) * blocks_y + texCoord.y / CompressedBlockExtent) * blocks_x + texCoord.x / CompressedBlockExtent;
+				return ((const byte*)imageData->mMappedPtr) + imageData->mLayerSize * layer + imageData->mLevelOffsets[mipLevel] +
+					block_index * imageData->mBlockBytes;
+			}
+
+			// texCoord must already be resolved by the address mode
+			inline const u8vec4& fetchCompressedTexel(const ImageData* imageData, uint32_t mipLevel, uint32_t layer, const ivec3& texCoord)
+			{
+				auto texels = fetchCompressedBlock(imageData->mFormat, getCompressedBlockAddress(imageData, mipLevel, layer, texCoord));
+				return texels[(texCoord.y % CompressedBlockExtent) * CompressedBlockExtent + texCoord.x % CompressedBlockExtent];
+			}
+
+			inline vec4 castCompressedTexelToVector(const u8vec4& texel)
+			{
+				return vec4(texel) * (1.0f / ((1 << 8) - 1));
+			}
+
+			inline ivec4 castCompressedTexelToVectorInt(const u8vec4& texel)
+			{
+				return ivec4(texel);
+			}
+
+		}
+
+
+		// call after writing compressed texels through Memory::data() on an image that has already been sampled
+		inline void invalidateCompressedBlockCache()
+		{
+			detail::compressedBlockCacheGeneration()++;
+		}
+
+
+	}
+}
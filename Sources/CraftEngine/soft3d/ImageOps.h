@@ -1,6 +1,9 @@
 #pragma once
 #include "./Common.h"
 #include "./ImageView.h"
+#include "./ImageCompress.h"
+#include "./ImageResample.h"
+#include "./Device.h"
 #include "./Sampler.h"
 #include "./SamplerExt.h"
 
@@ -62,6 +65,19 @@ namespace CraftEngine
 			Sampler sampler
 		);
 
+		// separable filtered scaling of 2d levels, rows are split across the device threads
+		void imgBlit(
+			const Device& device,
+			const Image& dstImage,
+			const Image& srcImage,
+			ImageFilter filter,
+			bool     srgb = false,
+			uint32_t dstMipLevel = 0,
+			uint32_t srcMipLevel = 0,
+			uint32_t dstLayer = 0,
+			uint32_t srcLayer = 0
+		);
+
 		void imgGenMipmapFast(
 			const Image& image,
 			uint32_t level, 
@@ -74,6 +90,16 @@ namespace CraftEngine
 			uint32_t count = detail::MaxImageMipLevel
 		);
 
+		// srgb averages color channels in linear space, alpha is always linear
+		void imgGenMipmap(
+			const Device& device,
+			const Image& image,
+			ImageFilter filter = ImageFilter::eBox,
+			bool     srgb = false,
+			uint32_t level = 1,
+			uint32_t count = detail::MaxImageMipLevel
+		);
+
 		void imgClear(
 			const Image& image,
 			vec4     clearColor = vec4(0.0f),
@@ -87,12 +113,50 @@ namespace CraftEngine
 			uint32_t layer = 0
 		);
 
+		// only records the clear value, texels are read as cleared until something writes them and
+		// the rest are filled when the level is resolved, presented with imgTrans or read back
+		void imgFastClear(
+			const Image& image,
+			vec4     clearValue = vec4(0.0f),
+			uint32_t mipLevel = 0,
+			uint32_t layer = 0
+		);
+
+		// writes the clear value into every texel still untouched since imgFastClear, call before reading memory directly
+		void imgResolveFastClear(
+			const Image& image
+		);
+
 		void imgSetOne(
 			const Image& image,
 			uint32_t mipLevel = 0,
 			uint32_t layer = 0
 		);
 
+		// encodes an eR8G8B8A8_UNORM level into a block compressed image of the same extent
+		void imgCompress(
+			const Image& dstImage,
+			const Image& srcImage,
+			uint32_t mipLevel = 0,
+			uint32_t layer = 0
+		);
+
+		// same as above, block rows are split across the device threads
+		void imgCompress(
+			const Device& device,
+			const Image& dstImage,
+			const Image& srcImage,
+			uint32_t mipLevel = 0,
+			uint32_t layer = 0
+		);
+
+		void imgDecompress(
+			const Image& dstImage,
+			const Image& srcImage,
+			uint32_t mipLevel = 0,
+			uint32_t layer = 0
+		);
+
 		void imgTrans(
 			const Image& image,
 			uint32_t mipLevel = 0,
@@ -106,6 +170,31 @@ namespace CraftEngine
 				image_data->mLevelExtents[mipLevel].mHeight,
 				image_data->mLevelExtents[mipLevel].mDepth);
 			constexpr auto pixel_bytes = 4;
+			auto fast_clear = detail::findFastClear(image_data, mipLevel, layer);
+			if (fast_clear != nullptr)
+			{
+				// untouched texels get the swapped clear value directly, only rendered texels are swapped in place
+				byte swapped[pixel_bytes];
+				memcpy(swapped, fast_clear->mClearValue.mData, pixel_bytes);
+				std::swap(swapped[0], swapped[2]);
+				for (int y = 0; y < level_extent.y; y++)
+				{
+					cur_data = img_data_begin + size_t(y) * level_extent.x * pixel_bytes;
+					for (int x = 0; x < level_extent.x; x++, cur_data += pixel_bytes)
+					{
+						if (detail::isFastClearTexel(fast_clear, x, y))
+							memcpy(cur_data, swapped, pixel_bytes);
+						else
+						{
+							temp = cur_data[0];
+							cur_data[0] = cur_data[2];
+							cur_data[2] = temp;
+						}
+					}
+				}
+				detail::finishFastClear(image_data, fast_clear);
+				return;
+			}
 			auto total_pixel = level_extent.x * level_extent.y;
 			for (int i = 0; i < total_pixel; i++, cur_data += pixel_bytes)
 			{
@@ -141,6 +230,8 @@ namespace CraftEngine
 		{
 			if (dstImage.format() != ImageFormat::eR8G8B8A8_UNORM && srcImage.format() != ImageFormat::eR8G8B8A8_UNORM)
 				return;
+			detail::resolveFastClear((detail::ImageData*)srcImage.handle());
+			detail::resolveFastClear((detail::ImageData*)dstImage.handle());
 			struct ImageBlit
 			{
 				uint32_t dstMipLevel;
@@ -204,6 +295,8 @@ namespace CraftEngine
 			Sampler  sampler
 		)
 		{
+			if (detail::isBlockCompressedFormat(dstImage.format()))
+				soft3d_throw_error(ErrorType::eWrongImageType);
 			struct ImageBlit
 			{
 				uint32_t dstMipLevel;
@@ -215,6 +308,8 @@ namespace CraftEngine
 			info.dstLayer = math::clamp(dstLayer, 0U, dstImage.layers() - 1);
 			info.srcMipLevel = math::clamp(srcMipLevel, 0.0f, float(srcImage.mipLevels() - 1));
 			info.srcLayer = math::clamp(srcLayer, 0U, srcImage.layers() - 1);
+			detail::resolveFastClear((detail::ImageData*)srcImage.handle());
+			detail::discardFastClear((detail::ImageData*)dstImage.handle(), info.dstMipLevel, info.dstLayer);
 
 			auto image_data = (detail::ImageData*)dstImage.handle();
 			auto img_data_begin = ((byte*)image_data->mMappedPtr) + image_data->mLayerSize * info.dstLayer + image_data->mLevelOffsets[info.dstMipLevel];
@@ -348,6 +443,40 @@ namespace CraftEngine
 			imgBlit(dst_view_data->mImage, src_view_data->mImage, dstImageView.baseMipLevel(), srcImageView.baseMipLevel(), dstImageView.baseLayer(), srcImageView.baseLayer(), sampler);
 		}
 
+		void imgBlit(
+			const Device& device,
+			const Image& dstImage,
+			const Image& srcImage,
+			ImageFilter filter,
+			bool     srgb,
+			uint32_t dstMipLevel,
+			uint32_t srcMipLevel,
+			uint32_t dstLayer,
+			uint32_t srcLayer
+		)
+		{
+			if (detail::isBlockCompressedFormat(dstImage.format()))
+				soft3d_throw_error(ErrorType::eWrongImageType);
+			dstMipLevel = math::clamp(dstMipLevel, 0U, dstImage.mipLevels() - 1);
+			dstLayer = math::clamp(dstLayer, 0U, dstImage.layers() - 1);
+			srcMipLevel = math::clamp(srcMipLevel, 0U, srcImage.mipLevels() - 1);
+			srcLayer = math::clamp(srcLayer, 0U, srcImage.layers() - 1);
+			detail::resolveFastClear((detail::ImageData*)srcImage.handle());
+			detail::discardFastClear((detail::ImageData*)dstImage.handle(), dstMipLevel, dstLayer);
+			switch (dstImage.type())
+			{
+			case ImageType::eImage2D:
+			case ImageType::eImage2DArray:
+			case ImageType::eImageCube:
+				detail::resampleImage2D(device, (detail::ImageData*)dstImage.handle(), dstMipLevel, dstLayer,
+					(const detail::ImageData*)srcImage.handle(), srcMipLevel, srcLayer, filter, srgb);
+				break;
+			default:
+				imgBlit(dstImage, srcImage, dstMipLevel, float(srcMipLevel), dstLayer, srcLayer);
+				break;
+			}
+		}
+
 
 
 
@@ -360,45 +489,15 @@ namespace CraftEngine
 			if (image.format() != ImageFormat::eR8G8B8A8_UNORM)
 				soft3d_throw_error(ErrorType::eWrongImageType);
 
-			auto sampler = createSampler(
-				SamplerFilterType::eLinear, SamplerAddressMode::eClampToEdge,
-				SamplerBorderColor::eWhiteFloat, SamplerMipmapMode::eNearestMipmap,
-				0.0f, 32.0f
-			);
-			auto sampler_fast = SamplerFast(sampler);
-
 			auto image_data = (detail::ImageData*)image.handle();
 			if (level >= image.mipLevels())
 				return;
-			int begin_level = level;
-			int level_count = (level + count) >= image.mipLevels() ? image.mipLevels() - begin_level : count;
+			detail::resolveFastClear(image_data);
+			int begin_level = level == 0 ? 1 : level;
+			int level_count = (begin_level + count) >= image.mipLevels() ? image.mipLevels() - begin_level : count;
 			for (int L = 0; L < image_data->mLayers; L++)
-			{
 				for (int cur_level = begin_level; cur_level < begin_level + level_count; cur_level++)
-				{
-					auto img_data_begin = ((byte*)image_data->mMappedPtr) + image_data->mLayerSize * L + image_data->mLevelOffsets[cur_level];
-					auto level_extent = ivec2(image_data->mLevelExtents[cur_level].mWidth, image_data->mLevelExtents[cur_level].mHeight);
-					auto inverse_extent = math::inverse(vec2(level_extent));
-					u8vec4 texel_val;
-					int  last_level = cur_level - 1;
-					vec2 tex_coord;
-					byte* cur_data = img_data_begin;
-					for (int h = 0; h < level_extent.y; h++)
-					{
-						tex_coord.y = (0.5f + float(h)) * inverse_extent.y;
-						for (int w = 0; w < level_extent.x; w++, cur_data += 4)
-						{
-							tex_coord.x = (0.5f + float(w)) * inverse_extent.x;
-							texel_val = sampler_fast.texture2D(image, tex_coord, last_level, L);
-							cur_data[0] = texel_val[0];
-							cur_data[1] = texel_val[1];
-							cur_data[2] = texel_val[2];
-							cur_data[3] = texel_val[3];
-						}
-					}
-				}
-			}
-			destroySampler(sampler);
+					detail::downsampleBoxRowsRGBA8(image_data, cur_level, L, 0, image_data->mLevelExtents[cur_level].mHeight, false);
 		}
 
 
@@ -410,6 +509,8 @@ namespace CraftEngine
 		{
 			if (level >= image.mipLevels())
 				return;
+			if (detail::isBlockCompressedFormat(image.format()))
+				soft3d_throw_error(ErrorType::eWrongImageType);
 			int begin_level = level == 0 ? 1 : level;
 			int level_count = (begin_level + count) > image.mipLevels() ? image.mipLevels() - begin_level : count;
 
@@ -430,6 +531,46 @@ namespace CraftEngine
 		}
 
 
+		void imgGenMipmap(
+			const Device& device,
+			const Image& image,
+			ImageFilter filter,
+			bool     srgb,
+			uint32_t level,
+			uint32_t count
+		)
+		{
+			if (level >= image.mipLevels())
+				return;
+			if (detail::isBlockCompressedFormat(image.format()))
+				soft3d_throw_error(ErrorType::eWrongImageType);
+			if (image.type() != ImageType::eImage2D && image.type() != ImageType::eImage2DArray && image.type() != ImageType::eImageCube)
+			{
+				imgGenMipmap(image, level, count);
+				return;
+			}
+			auto image_data = (detail::ImageData*)image.handle();
+			soft3d_profile_scope(device.valid() ? &((detail::DeviceData*)device.handle())->mProfiler : nullptr, "imgGenMipmap", 0);
+			detail::resolveFastClear(image_data);
+			int begin_level = level == 0 ? 1 : level;
+			int level_count = (begin_level + count) > image.mipLevels() ? image.mipLevels() - begin_level : count;
+			bool box_fast = filter == ImageFilter::eBox && image.format() == ImageFormat::eR8G8B8A8_UNORM;
+			// each level reads the previous one, so only the rows inside a level run in parallel
+			for (uint32_t L = 0; L < image_data->mLayers; L++)
+			{
+				for (int cur_level = begin_level; cur_level < begin_level + level_count; cur_level++)
+				{
+					if (box_fast)
+						detail::parallelRange(device, image_data->mLevelExtents[cur_level].mHeight, [=](uint32_t begin, uint32_t end) {
+							detail::downsampleBoxRowsRGBA8(image_data, cur_level, L, begin, end, srgb);
+						});
+					else
+						detail::resampleImage2D(device, image_data, cur_level, L, image_data, cur_level - 1, L, filter, srgb);
+				}
+			}
+		}
+
+
 
 		void imgClear(
 			const Image& image,
@@ -442,7 +583,10 @@ namespace CraftEngine
 				return;
 			if (layer >= image.layers())
 				return;
+			if (detail::isBlockCompressedFormat(image.format()))
+				soft3d_throw_error(ErrorType::eWrongImageType);
 			auto image_data = (detail::ImageData*)image.handle();
+			detail::discardFastClear(image_data, mipLevel, layer);
 
 			auto img_data_begin = ((byte*)image_data->mMappedPtr) + image_data->mLayerSize * layer + image_data->mLevelOffsets[mipLevel];
 			auto level_extent = ivec3(image_data->mLevelExtents[mipLevel].mWidth, image_data->mLevelExtents[mipLevel].mHeight, image_data->mLevelExtents[mipLevel].mDepth);
@@ -468,6 +612,7 @@ namespace CraftEngine
 			if (layer >= image.layers())
 				return;
 			auto image_data = (detail::ImageData*)image.handle();
+			detail::discardFastClear(image_data, mipLevel, layer);
 
 			auto img_data_begin = ((byte*)image_data->mMappedPtr) + image_data->mLayerSize * layer + image_data->mLevelOffsets[mipLevel];
 			auto level_extent = ivec3(image_data->mLevelExtents[mipLevel].mWidth, image_data->mLevelExtents[mipLevel].mHeight, image_data->mLevelExtents[mipLevel].mDepth);
@@ -487,6 +632,7 @@ namespace CraftEngine
 			if (layer >= image.layers())
 				return;
 			auto image_data = (detail::ImageData*)image.handle();
+			detail::discardFastClear(image_data, mipLevel, layer);
 
 			auto img_data_begin = ((byte*)image_data->mMappedPtr) + image_data->mLayerSize * layer + image_data->mLevelOffsets[mipLevel];
 			auto level_extent = ivec3(image_data->mLevelExtents[mipLevel].mWidth, image_data->mLevelExtents[mipLevel].mHeight, image_data->mLevelExtents[mipLevel].mDepth);
@@ -497,7 +643,156 @@ namespace CraftEngine
 
 
 
-	}
-}
+		void imgFastClear(
+			const Image& image,
+			vec4     clearValue,
+			uint32_t mipLevel,
+			uint32_t layer
+		)
+		{
+			if (mipLevel >= image.mipLevels())
+				return;
+			if (layer >= image.layers())
+				return;
+			if (detail::isBlockCompressedFormat(image.format()))
+				soft3d_throw_error(ErrorType::eWrongImageType);
+			detail::markFastClear((detail::ImageData*)image.handle(), mipLevel, layer, detail::castVectorToPixel(clearValue, image.format()));
+		}
+
+		void imgResolveFastClear(
+			const Image& image
+		)
+		{
+			detail::resolveFastClear((detail::ImageData*)image.handle());
+		}
+
+
+
+		namespace detail
+		{
+			inline void checkCompressParams(const Image& compressedImage, const Image& image, uint32_t mipLevel, uint32_t layer)
+			{
+				if (!isBlockCompressedFormat(compressedImage.format()) || image.format() != ImageFormat::eR8G8B8A8_UNORM)
+					soft3d_throw_error(ErrorType::eWrongImageType);
+				if (mipLevel >= compressedImage.mipLevels() || mipLevel >= image.mipLevels() ||
+					layer >= compressedImage.layers() || layer >= image.layers())
+					soft3d_throw_error(ErrorType::eInvalidParam);
+				auto compressed_data = (ImageData*)compressedImage.handle();
+				auto image_data = (ImageData*)image.handle();
+				auto& a = compressed_data->mLevelExtents[mipLevel];
+				auto& b = image_data->mLevelExtents[mipLevel];
+				if (a.mWidth != b.mWidth || a.mHeight != b.mHeight || a.mDepth != b.mDepth)
+					soft3d_throw_error(ErrorType::eInvalidParam);
+			}
+
+			// encodes block rows [rowBegin, rowEnd), a row spans all slices of a 3d level
+			inline void compressBlockRows(ImageData* dstData, ImageData* srcData, uint32_t mipLevel, uint32_t layer, uint32_t rowBegin, uint32_t rowEnd)
+			{
+				auto& level_extent = srcData->mLevelExtents[mipLevel];
+				auto src_begin = ((const byte*)srcData->mMappedPtr) + srcData->mLayerSize * layer + srcData->mLevelOffsets[mipLevel];
+				uint32_t blocks_x = (level_extent.mWidth + CompressedBlockExtent - 1) / CompressedBlockExtent;
+				uint32_t blocks_y = (level_extent.mHeight + CompressedBlockExtent - 1) / CompressedBlockExtent;
+				u8vec4 texels[CompressedBlockTexelCount];
+				for (uint32_t row = rowBegin; row < rowEnd; row++)
+				{
+					uint32_t slice = row / blocks_y, block_y = row % blocks_y;
+					auto slice_begin = (const u8vec4*)(src_begin + size_t(slice) * level_extent.mWidth * level_extent.mHeight * 4);
+					for (uint32_t block_x = 0; block_x < blocks_x; block_x++)
+					{
+						// partial edge blocks repeat the last row and column
+						for (int j = 0; j < CompressedBlockExtent; j++)
+						{
+							uint32_t y = math::min(block_y * CompressedBlockExtent + j, level_extent.mHeight - 1);
+							for (int i = 0; i < CompressedBlockExtent; i++)
+							{
+								uint32_t x = math::min(block_x * CompressedBlockExtent + i, level_extent.mWidth - 1);
+								texels[j * CompressedBlockExtent + i] = slice_begin[size_t(y) * level_extent.mWidth + x];
+							}
+						}
+						auto block = (byte*)getCompressedBlockAddress(dstData, mipLevel, layer, ivec3(block_x * CompressedBlockExtent, block_y * CompressedBlockExtent, slice));
+						encodeCompressedBlock(dstData->mFormat, texels, block);
+					}
+				}
+			}
+		}
+
 
 
+		void imgCompress(
+			const Image& dstImage,
+			const Image& srcImage,
+			uint32_t mipLevel,
+			uint32_t layer
+		)
+		{
+			detail::checkCompressParams(dstImage, srcImage, mipLevel, layer);
+			detail::resolveFastClear((detail::ImageData*)srcImage.handle());
+			auto dst_data = (detail::ImageData*)dstImage.handle();
+			auto src_data = (detail::ImageData*)srcImage.handle();
+			auto& level_extent = src_data->mLevelExtents[mipLevel];
+			uint32_t rows = (level_extent.mHeight + detail::CompressedBlockExtent - 1) / detail::CompressedBlockExtent * level_extent.mDepth;
+			detail::compressBlockRows(dst_data, src_data, mipLevel, layer, 0, rows);
+			invalidateCompressedBlockCache();
+		}
+
+		void imgCompress(
+			const Device& device,
+			const Image& dstImage,
+			const Image& srcImage,
+			uint32_t mipLevel,
+			uint32_t layer
+		)
+		{
+			detail::checkCompressParams(dstImage, srcImage, mipLevel, layer);
+			detail::resolveFastClear((detail::ImageData*)srcImage.handle());
+			auto device_data = (detail::DeviceData*)device.handle();
+			auto dst_data = (detail::ImageData*)dstImage.handle();
+			auto src_data = (detail::ImageData*)srcImage.handle();
+			auto& level_extent = src_data->mLevelExtents[mipLevel];
+			uint32_t rows = (level_extent.mHeight + detail::CompressedBlockExtent - 1) / detail::CompressedBlockExtent * level_extent.mDepth;
+			uint32_t thread_count = math::max(math::min(device_data->mThreadPool.threadCount(), rows), 1U);
+			for (uint32_t tid = 0; tid < thread_count; tid++)
+			{
+				uint32_t row_begin = rows * tid / thread_count, row_end = rows * (tid + 1) / thread_count;
+				device_data->mThreadPool.push([=]() {
+					detail::compressBlockRows(dst_data, src_data, mipLevel, layer, row_begin, row_end);
+				}, tid);
+			}
+			device_data->mThreadPool.wait();
+			invalidateCompressedBlockCache();
+		}
+
+		void imgDecompress(
+			const Image& dstImage,
+			const Image& srcImage,
+			uint32_t mipLevel,
+			uint32_t layer
+		)
+		{
+			detail::checkCompressParams(srcImage, dstImage, mipLevel, layer);
+			detail::discardFastClear((detail::ImageData*)dstImage.handle(), mipLevel, layer);
+			auto dst_data = (detail::ImageData*)dstImage.handle();
+			auto src_data = (detail::ImageData*)srcImage.handle();
+			auto& level_extent = dst_data->mLevelExtents[mipLevel];
+			auto dst_begin = (u8vec4*)(((byte*)dst_data->mMappedPtr) + dst_data->mLayerSize * layer + dst_data->mLevelOffsets[mipLevel]);
+			u8vec4 texels[detail::CompressedBlockTexelCount];
+			for (uint32_t d = 0; d < level_extent.mDepth; d++)
+			{
+				for (uint32_t y = 0; y < level_extent.mHeight; y += detail::CompressedBlockExtent)
+				{
+					for (uint32_t x = 0; x < level_extent.mWidth; x += detail::CompressedBlockExtent)
+					{
+						detail::decodeCompressedBlock(src_data->mFormat, detail::getCompressedBlockAddress(src_data, mipLevel, layer, ivec3(x, y, d)), texels);
+						uint32_t w = math::min(level_extent.mWidth - x, uint32_t(detail::CompressedBlockExtent));
+						uint32_t h = math::min(level_extent.mHeight - y, uint32_t(detail::CompressedBlockExtent));
+						for (uint32_t j = 0; j < h; j++)
+							memcpy(dst_begin + (size_t(d) * level_extent.mHeight + y + j) * level_extent.mWidth + x, texels + j * detail::CompressedBlockExtent, w * sizeof(u8vec4));
+					}
+				}
+			}
+		}
+
+
+
+	}
+}
@@ -0,0 +1,415 @@
+#pragma once
+#include "./Image.h"
+#include "./ImageCompress.h"
+#include "./Device.h"
+
+namespace CraftEngine
+{
+	namespace soft3d
+	{
+
+
+		enum class ImageFilter
+		{
+			eBox,
+			eKaiser,
+			eLanczos,
+		};
+
+
+		namespace detail
+		{
+
+			// runs func(begin, end) over [0, count) split across the device threads, inline when the device is invalid
+			template<typename Func>
+			void parallelRange(const Device& device, uint32_t count, Func func)
+			{
+				auto device_data = (DeviceData*)device.handle();
+				uint32_t thread_count = device_data == nullptr ? 1 : math::min(device_data->mThreadPool.threadCount(), count);
+				if (thread_count <= 1)
+				{
+					func(0U, count);
+					return;
+				}
+				for (uint32_t tid = 0; tid < thread_count; tid++)
+				{
+					uint32_t begin = uint32_t(uint64_t(count) * tid / thread_count);
+					uint32_t end = uint32_t(uint64_t(count) * (tid + 1) / thread_count);
+					device_data->mThreadPool.push([=]() {
+						soft3d_profile_scope(&device_data->mProfiler, "parallelRange", tid + 1);
+						func(begin, end);
+					}, tid);
+				}
+				device_data->mThreadPool.wait();
+			}
+
+
+
+			struct ColorConvertTables
+			{
+				float   mUnormToFloat[256];
+				float   mSrgbToLinear[256];
+				uint8_t mLinearToSrgb[1 << 16];   // indexed by linear * 65535
+			};
+
+			inline const ColorConvertTables& colorConvertTables()
+			{
+				static const ColorConvertTables* tables = []() {
+					auto t = new ColorConvertTables;
+					for (int i = 0; i < 256; i++)
+					{
+						float c = i * (1.0f / 255.0f);
+						t->mUnormToFloat[i] = c;
+						t->mSrgbToLinear[i] = c <= 0.04045f ? c * (1.0f / 12.92f) : powf((c + 0.055f) * (1.0f / 1.055f), 2.4f);
+					}
+					for (int i = 0; i < (1 << 16); i++)
+					{
+						float c = i * (1.0f / 65535.0f);
+						float s = c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+						t->mLinearToSrgb[i] = uint8_t(math::clamp(s, 0.0f, 1.0f) * 255.0f + 0.5f);
+					}
+					return t;
+				}();
+				return *tables;
+			}
+
+			inline void loadTexelRGBA8(const u8vec4& texel, float* dst, bool srgb)
+			{
+				auto& tables = colorConvertTables();
+				const float* table = srgb ? tables.mSrgbToLinear : tables.mUnormToFloat;
+				dst[0] = table[texel[0]];
+				dst[1] = table[texel[1]];
+				dst[2] = table[texel[2]];
+				dst[3] = tables.mUnormToFloat[texel[3]];
+			}
+
+			inline void storeTexelRGBA8(const float* src, byte* dst, bool srgb)
+			{
+				if (srgb)
+				{
+					auto& tables = colorConvertTables();
+					for (int c = 0; c < 3; c++)
+						dst[c] = tables.mLinearToSrgb[int(math::clamp(src[c], 0.0f, 1.0f) * 65535.0f + 0.5f)];
+					dst[3] = uint8_t(math::clamp(src[3], 0.0f, 1.0f) * 255.0f + 0.5f);
+					return;
+				}
+#ifdef CRAFT_ENGINE_SIMD_SSE2
+				__m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src), _mm_setzero_ps()), _mm_set1_ps(1.0f));
+				__m128i i = _mm_cvtps_epi32(_mm_mul_ps(v, _mm_set1_ps(255.0f)));
+				i = _mm_packs_epi32(i, i);
+				i = _mm_packus_epi16(i, i);
+				int packed = _mm_cvtsi128_si32(i);
+				memcpy(dst, &packed, 4);
+#else
+				for (int c = 0; c < 4; c++)
+					dst[c] = uint8_t(math::clamp(src[c], 0.0f, 1.0f) * 255.0f + 0.5f);
+#endif
+			}
+
+			// one row of a level as rgba floats, sRGB decoding only applies to 8-bit unorm data
+			inline void loadRowFloat(const ImageData* imageData, uint32_t mipLevel, uint32_t layer, uint32_t y, float* row, bool srgb)
+			{
+				auto& level_extent = imageData->mLevelExtents[mipLevel];
+				if (imageData->mBlockBytes > 0)
+				{
+					for (uint32_t x = 0; x < level_extent.mWidth; x++)
+						loadTexelRGBA8(fetchCompressedTexel(imageData, mipLevel, layer, ivec3(x, y, 0)), row + x * 4, srgb);
+					return;
+				}
+				auto row_begin = ((const byte*)imageData->mMappedPtr) + imageData->mLayerSize * layer + imageData->mLevelOffsets[mipLevel] +
+					size_t(y) * level_extent.mWidth * imageData->mPixelBytes;
+				if (imageData->mFormat == ImageFormat::eR8G8B8A8_UNORM)
+				{
+					for (uint32_t x = 0; x < level_extent.mWidth; x++)
+						loadTexelRGBA8(((const u8vec4*)row_begin)[x], row + x * 4, srgb);
+					return;
+				}
+				ImagePixelData pixel;
+				for (uint32_t x = 0; x < level_extent.mWidth; x++)
+				{
+					memcpy(pixel.mData, row_begin + x * imageData->mPixelBytes, imageData->mPixelBytes);
+					vec4 value = castPixelToVector(pixel, imageData->mFormat);
+					memcpy(row + x * 4, &value, sizeof(float) * 4);
+				}
+			}
+
+			inline void storeRowFloat(ImageData* imageData, uint32_t mipLevel, uint32_t layer, uint32_t y, const float* row, bool srgb)
+			{
+				auto& level_extent = imageData->mLevelExtents[mipLevel];
+				auto row_begin = ((byte*)imageData->mMappedPtr) + imageData->mLayerSize * layer + imageData->mLevelOffsets[mipLevel] +
+					size_t(y) * level_extent.mWidth * imageData->mPixelBytes;
+				if (imageData->mFormat == ImageFormat::eR8G8B8A8_UNORM)
+				{
+					for (uint32_t x = 0; x < level_extent.mWidth; x++)
+						storeTexelRGBA8(row + x * 4, row_begin + x * 4, srgb);
+					return;
+				}
+				for (uint32_t x = 0; x < level_extent.mWidth; x++)
+				{
+					vec4 value;
+					memcpy(&value, row + x * 4, sizeof(float) * 4);
+					auto pixel = castVectorToPixel(value, imageData->mFormat);
+					memcpy(row_begin + x * imageData->mPixelBytes, pixel.mData, imageData->mPixelBytes);
+				}
+			}
+
+			// acc[0..4) += w * value[0..4)
+			inline void multiplyAddTexel(float* acc, const float* value, float w)
+			{
+#ifdef CRAFT_ENGINE_SIMD_SSE2
+				_mm_storeu_ps(acc, _mm_add_ps(_mm_loadu_ps(acc), _mm_mul_ps(_mm_loadu_ps(value), _mm_set1_ps(w))));
+#else
+				acc[0] += value[0] * w;
+				acc[1] += value[1] * w;
+				acc[2] += value[2] * w;
+				acc[3] += value[3] * w;
+#endif
+			}
+
+			inline void multiplyAddRow(float* acc, const float* row, float w, uint32_t texelCount)
+			{
+				uint32_t count = texelCount * 4, i = 0;
+#if defined(CRAFT_ENGINE_SIMD_AVX2)
+				__m256 wv8 = _mm256_set1_ps(w);
+				for (; i + 8 <= count; i += 8)
+					_mm256_storeu_ps(acc + i, _mm256_add_ps(_mm256_loadu_ps(acc + i), _mm256_mul_ps(_mm256_loadu_ps(row + i), wv8)));
+#endif
+#ifdef CRAFT_ENGINE_SIMD_SSE2
+				__m128 wv = _mm_set1_ps(w);
+				for (; i + 4 <= count; i += 4)
+					_mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), _mm_mul_ps(_mm_loadu_ps(row + i), wv)));
+#endif
+				for (; i < count; i++)
+					acc[i] += row[i] * w;
+			}
+
+
+
+
+			inline float filterSupport(ImageFilter filter)
+			{
+				switch (filter)
+				{
+				case ImageFilter::eBox:
+					return 0.5f;
+				case ImageFilter::eKaiser:
+				case ImageFilter::eLanczos:
+					return 3.0f;
+				default:
+					soft3d_throw_error(ErrorType::eInvalidEnum);
+				}
+			}
+
+			inline float besselI0(float x)
+			{
+				float sum = 1.0f, term = 1.0f, half_x = x * 0.5f;
+				for (int k = 1; k < 16; k++)
+				{
+					term *= (half_x / k) * (half_x / k);
+					sum += term;
+				}
+				return sum;
+			}
+
+			inline float sinc(float x)
+			{
+				if (math::abs(x) < 1e-6f)
+					return 1.0f;
+				x *= 3.14159265358979f;
+				return sinf(x) / x;
+			}
+
+			inline float filterKernel(ImageFilter filter, float x)
+			{
+				x = math::abs(x);
+				switch (filter)
+				{
+				case ImageFilter::eBox:
+					return x < 0.5f ? 1.0f : 0.0f;
+				case ImageFilter::eKaiser:
+				{
+					constexpr float alpha = 4.0f;
+					if (x >= 3.0f)
+						return 0.0f;
+					float r = x * (1.0f / 3.0f);
+					return sinc(x) * besselI0(alpha * sqrtf(1.0f - r * r)) / besselI0(alpha);
+				}
+				case ImageFilter::eLanczos:
+					return x < 3.0f ? sinc(x) * sinc(x * (1.0f / 3.0f)) : 0.0f;
+				default:
+					soft3d_throw_error(ErrorType::eInvalidEnum);
+				}
+			}
+
+			// normalized taps for each destination coordinate, source indices are clamped to the edge
+			struct ResampleWeights
+			{
+				std::vector<uint32_t> mOffsets;   // dst + 1 entries into mIndices/mWeights
+				std::vector<uint32_t> mIndices;
+				std::vector<float>    mWeights;
+			};
+
+			inline ResampleWeights calcResampleWeights(uint32_t srcExtent, uint32_t dstExtent, ImageFilter filter)
+			{
+				ResampleWeights weights;
+				float scale = float(srcExtent) / float(dstExtent);
+				float filter_scale = math::max(scale, 1.0f);
+				float support = filterSupport(filter) * filter_scale;
+				weights.mOffsets.reserve(dstExtent + 1);
+				weights.mOffsets.push_back(0);
+				for (uint32_t d = 0; d < dstExtent; d++)
+				{
+					float center = (d + 0.5f) * scale;
+					int left = int(math::floor(center - support));
+					int right = int(math::ceil(center + support));
+					size_t first = weights.mWeights.size();
+					float total = 0.0f;
+					for (int s = left; s < right; s++)
+					{
+						float w = filterKernel(filter, (s + 0.5f - center) / filter_scale);
+						if (w == 0.0f)
+							continue;
+						weights.mIndices.push_back(uint32_t(math::clamp(s, 0, int(srcExtent) - 1)));
+						weights.mWeights.push_back(w);
+						total += w;
+					}
+					if (total == 0.0f)
+					{
+						weights.mIndices.resize(first);
+						weights.mWeights.resize(first);
+						weights.mIndices.push_back(math::min(uint32_t(center), srcExtent - 1));
+						weights.mWeights.push_back(1.0f);
+						total = 1.0f;
+					}
+					for (size_t i = first; i < weights.mWeights.size(); i++)
+						weights.mWeights[i] /= total;
+					weights.mOffsets.push_back(uint32_t(weights.mWeights.size()));
+				}
+				return weights;
+			}
+
+			// separable resample of one 2d level, dst rows are processed in chunks so the
+			// horizontally filtered source rows of a chunk stay small
+			inline void resampleImage2D(
+				const Device& device,
+				ImageData* dstData, uint32_t dstMipLevel, uint32_t dstLayer,
+				const ImageData* srcData, uint32_t srcMipLevel, uint32_t srcLayer,
+				ImageFilter filter, bool srgb)
+			{
+				auto& dst_extent = dstData->mLevelExtents[dstMipLevel];
+				auto& src_extent = srcData->mLevelExtents[srcMipLevel];
+				auto weights_x = calcResampleWeights(src_extent.mWidth, dst_extent.mWidth, filter);
+				auto weights_y = calcResampleWeights(src_extent.mHeight, dst_extent.mHeight, filter);
+				constexpr uint32_t chunk_rows = 32;
+				uint32_t chunk_count = (dst_extent.mHeight + chunk_rows - 1) / chunk_rows;
+				parallelRange(device, chunk_count, [&](uint32_t begin, uint32_t end) {
+					std::vector<float> src_row(size_t(src_extent.mWidth) * 4);
+					std::vector<float> dst_row(size_t(dst_extent.mWidth) * 4);
+					std::vector<float> filtered_rows;
+					size_t filtered_stride = size_t(dst_extent.mWidth) * 4;
+					for (uint32_t chunk = begin; chunk < end; chunk++)
+					{
+						uint32_t y_begin = chunk * chunk_rows, y_end = math::min(y_begin + chunk_rows, dst_extent.mHeight);
+						uint32_t src_min = src_extent.mHeight, src_max = 0;
+						for (uint32_t i = weights_y.mOffsets[y_begin]; i < weights_y.mOffsets[y_end]; i++)
+						{
+							src_min = math::min(src_min, weights_y.mIndices[i]);
+							src_max = math::max(src_max, weights_y.mIndices[i]);
+						}
+						filtered_rows.assign((src_max - src_min + 1) * filtered_stride, 0.0f);
+						for (uint32_t sy = src_min; sy <= src_max; sy++)
+						{
+							loadRowFloat(srcData, srcMipLevel, srcLayer, sy, src_row.data(), srgb);
+							float* out = filtered_rows.data() + (sy - src_min) * filtered_stride;
+							for (uint32_t x = 0; x < dst_extent.mWidth; x++)
+								for (uint32_t i = weights_x.mOffsets[x]; i < weights_x.mOffsets[x + 1]; i++)
+									multiplyAddTexel(out + x * 4, src_row.data() + weights_x.mIndices[i] * 4, weights_x.mWeights[i]);
+						}
+						for (uint32_t y = y_begin; y < y_end; y++)
+						{
+							std::fill(dst_row.begin(), dst_row.end(), 0.0f);
+							for (uint32_t i = weights_y.mOffsets[y]; i < weights_y.mOffsets[y + 1]; i++)
+								multiplyAddRow(dst_row.data(), filtered_rows.data() + (weights_y.mIndices[i] - src_min) * filtered_stride,
+									weights_y.mWeights[i], dst_extent.mWidth);
+							storeRowFloat(dstData, dstMipLevel, dstLayer, y, dst_row.data(), srgb);
+						}
+					}
+				});
+			}
+
+
+
+			// 2x2 average of an eR8G8B8A8_UNORM level into the next one, odd edges reuse the last row/column
+			inline void downsampleBoxRowsRGBA8(ImageData* imageData, uint32_t mipLevel, uint32_t layer, uint32_t rowBegin, uint32_t rowEnd, bool srgb)
+			{
+				auto& src_extent = imageData->mLevelExtents[mipLevel - 1];
+				auto& dst_extent = imageData->mLevelExtents[mipLevel];
+				auto layer_begin = ((byte*)imageData->mMappedPtr) + imageData->mLayerSize * layer;
+				auto src_begin = (const u8vec4*)(layer_begin + imageData->mLevelOffsets[mipLevel - 1]);
+				auto dst_begin = (u8vec4*)(layer_begin + imageData->mLevelOffsets[mipLevel]);
+				uint32_t src_w = src_extent.mWidth, src_h = src_extent.mHeight, dst_w = dst_extent.mWidth;
+				auto& tables = colorConvertTables();
+				for (uint32_t y = rowBegin; y < rowEnd; y++)
+				{
+					const u8vec4* row0 = src_begin + size_t(math::min(y * 2, src_h - 1)) * src_w;
+					const u8vec4* row1 = src_begin + size_t(math::min(y * 2 + 1, src_h - 1)) * src_w;
+					u8vec4* dst_row = dst_begin + size_t(y) * dst_w;
+					uint32_t x = 0;
+#ifdef CRAFT_ENGINE_SIMD_SSE2
+					if (!srgb)
+					{
+						const __m128i zero = _mm_setzero_si128();
+						const __m128i round = _mm_set1_epi16(2);
+						// four destination texels from eight source texels per row
+						for (; x * 2 + 8 <= src_w && x + 4 <= dst_w; x += 4)
+						{
+							__m128i a0 = _mm_loadu_si128((const __m128i*)(row0 + x * 2));
+							__m128i b0 = _mm_loadu_si128((const __m128i*)(row0 + x * 2 + 4));
+							__m128i a1 = _mm_loadu_si128((const __m128i*)(row1 + x * 2));
+							__m128i b1 = _mm_loadu_si128((const __m128i*)(row1 + x * 2 + 4));
+							__m128i s0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(a1, zero));
+							__m128i s1 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(a1, zero));
+							__m128i s2 = _mm_add_epi16(_mm_unpacklo_epi8(b0, zero), _mm_unpacklo_epi8(b1, zero));
+							__m128i s3 = _mm_add_epi16(_mm_unpackhi_epi8(b0, zero), _mm_unpackhi_epi8(b1, zero));
+							s0 = _mm_add_epi16(s0, _mm_srli_si128(s0, 8));
+							s1 = _mm_add_epi16(s1, _mm_srli_si128(s1, 8));
+							s2 = _mm_add_epi16(s2, _mm_srli_si128(s2, 8));
+							s3 = _mm_add_epi16(s3, _mm_srli_si128(s3, 8));
+							__m128i lo = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(s0, s1), round), 2);
+							__m128i hi = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(s2, s3), round), 2);
+							_mm_storeu_si128((__m128i*)(dst_row + x), _mm_packus_epi16(lo, hi));
+						}
+					}
+#endif
+					for (; x < dst_w; x++)
+					{
+						uint32_t x0 = math::min(x * 2, src_w - 1), x1 = math::min(x * 2 + 1, src_w - 1);
+						const u8vec4* texels[4] = { row0 + x0, row0 + x1, row1 + x0, row1 + x1 };
+						if (srgb)
+						{
+							float sum[3] = { 0.0f, 0.0f, 0.0f };
+							uint32_t alpha = 2;
+							for (int k = 0; k < 4; k++)
+							{
+								for (int c = 0; c < 3; c++)
+									sum[c] += tables.mSrgbToLinear[(*texels[k])[c]];
+								alpha += (*texels[k])[3];
+							}
+							for (int c = 0; c < 3; c++)
+								dst_row[x][c] = tables.mLinearToSrgb[int(sum[c] * (65535.0f / 4.0f) + 0.5f)];
+							dst_row[x][3] = uint8_t(alpha >> 2);
+						}
+						else
+						{
+							for (int c = 0; c < 4; c++)
+								dst_row[x][c] = uint8_t(((*texels[0])[c] + (*texels[1])[c] + (*texels[2])[c] + (*texels[3])[c] + 2) >> 2);
+						}
+					}
+				}
+			}
+
+		}
+
+
+	}
+}
@@ -0,0 +1,350 @@
+#pragma once
+#include "./Common.h"
+#include "./Memory.h"
+#include "./Buffer.h"
+#include "./Image.h"
+
+namespace CraftEngine
+{
+	namespace soft3d
+	{
+
+
+		// a sub-range of a Memory block, bind it with bindMemory(range.mMemory, range.mOffset)
+		struct MemoryRange
+		{
+			Memory mMemory;
+			size_t mOffset;
+			size_t mSize;
+			bool valid() const { return mMemory.valid(); }
+		};
+
+
+		namespace detail
+		{
+			inline size_t alignMemoryOffset(const Memory& memory, size_t offset, size_t alignment)
+			{
+				auto address = size_t((const byte*)memory.data() + offset);
+				return offset + ((alignment - address % alignment) % alignment);
+			}
+
+			struct LinearArenaData
+			{
+				MemAllocator        mAllocator;
+				size_t              mBlockSize;
+				size_t              mAlignment;
+				std::vector<Memory> mBlocks;
+				size_t              mOffset;
+				size_t              mUsedBytes;
+				size_t              mPeakBytes;
+			};
+		}
+
+
+		/*
+		 * LinearArena: bump allocator for transient memory.
+		 * Ranges are never freed one by one, reset() recycles all of them at once (e.g. once per frame).
+		 * When a frame overflows into extra blocks, reset() merges them into one block sized for that peak.
+		 * Not thread safe.
+		*/
+		class LinearArena
+		{
+		private:
+			detail::LinearArenaData* m_arenaData;
+		public:
+			explicit LinearArena(void* handle) : m_arenaData((detail::LinearArenaData*)handle) {}
+			LinearArena() : m_arenaData(nullptr) {}
+
+			MemoryRange allocate(size_t size, size_t alignment = 0)
+			{
+				alignment = alignment == 0 ? m_arenaData->mAlignment : alignment;
+				if (m_arenaData->mBlocks.size() > 0)
+				{
+					auto& block = m_arenaData->mBlocks.back();
+					size_t offset = detail::alignMemoryOffset(block, m_arenaData->mOffset, alignment);
+					if (offset + size <= block.size())
+					{
+						m_arenaData->mOffset = offset + size;
+						return commit(block, offset, size);
+					}
+				}
+				auto block = createMemory(math::max(m_arenaData->mBlockSize, size + alignment), m_arenaData->mAllocator);
+				m_arenaData->mBlocks.push_back(block);
+				size_t offset = detail::alignMemoryOffset(block, 0, alignment);
+				m_arenaData->mOffset = offset + size;
+				return commit(block, offset, size);
+			}
+
+			MemoryRange bind(Buffer buffer, size_t alignment = 0)
+			{
+				auto range = allocate(buffer.size(), alignment);
+				buffer.bindMemory(range.mMemory, range.mOffset);
+				return range;
+			}
+
+			MemoryRange bind(Image image, size_t alignment = 0)
+			{
+				auto range = allocate(image.size(), alignment);
+				image.bindMemory(range.mMemory, range.mOffset);
+				return range;
+			}
+
+			// invalidates every range handed out since the last reset
+			void reset()
+			{
+				if (m_arenaData->mBlocks.size() > 1)
+				{
+					size_t total = 0;
+					for (auto& block : m_arenaData->mBlocks)
+					{
+						total += block.size();
+						destroyMemory(block, m_arenaData->mAllocator);
+					}
+					m_arenaData->mBlocks.clear();
+					m_arenaData->mBlocks.push_back(createMemory(total, m_arenaData->mAllocator));
+				}
+				m_arenaData->mOffset = 0;
+				m_arenaData->mUsedBytes = 0;
+			}
+
+			size_t usedBytes() const { return m_arenaData->mUsedBytes; }
+			size_t peakBytes() const { return m_arenaData->mPeakBytes; }
+			size_t capacity() const
+			{
+				size_t total = 0;
+				for (auto& block : m_arenaData->mBlocks)
+					total += block.size();
+				return total;
+			}
+			void* handle() const { return m_arenaData; }
+			bool  valid() const { return handle() != nullptr; }
+		private:
+			MemoryRange commit(const Memory& block, size_t offset, size_t size)
+			{
+				m_arenaData->mUsedBytes += size;
+				m_arenaData->mPeakBytes = math::max(m_arenaData->mPeakBytes, m_arenaData->mUsedBytes);
+				return MemoryRange{ block, offset, size };
+			}
+		};
+
+
+		LinearArena createLinearArena(size_t blockSize, size_t alignment = 16, const MemAllocator& allocator = MemAllocator())
+		{
+			soft3d_assert_error(blockSize > 0 && alignment > 0 && (alignment & (alignment - 1)) == 0, ErrorType::eInvalidParam);
+			auto arena_data = new detail::LinearArenaData;
+			arena_data->mAllocator = allocator;
+			arena_data->mBlockSize = blockSize;
+			arena_data->mAlignment = alignment;
+			arena_data->mOffset = 0;
+			arena_data->mUsedBytes = 0;
+			arena_data->mPeakBytes = 0;
+			arena_data->mBlocks.push_back(createMemory(blockSize, allocator));
+			return LinearArena(arena_data);
+		}
+
+		void destroyLinearArena(const LinearArena& arena)
+		{
+			auto arena_data = (detail::LinearArenaData*)arena.handle();
+			for (auto& block : arena_data->mBlocks)
+				destroyMemory(block, arena_data->mAllocator);
+			delete arena_data;
+		}
+
+
+
+
+		namespace detail
+		{
+			struct MemoryPoolBlock
+			{
+				struct FreeRange
+				{
+					size_t mOffset;
+					size_t mSize;
+				};
+				Memory                 mMemory;
+				std::vector<FreeRange> mFreeRanges;   // sorted by offset, neighbours are always merged
+				size_t                 mUsedBytes;
+			};
+
+			struct MemoryPoolData
+			{
+				MemAllocator                 mAllocator;
+				size_t                       mBlockSize;
+				size_t                       mAlignment;
+				std::vector<MemoryPoolBlock> mBlocks;
+				std::mutex                   mMutex;
+			};
+		}
+
+
+		/*
+		 * MemoryPool: first-fit sub-allocator over large blocks for objects with independent lifetimes.
+		 * Freed ranges are coalesced with their neighbours, empty blocks are kept until trim().
+		 * Thread safe.
+		*/
+		class MemoryPool
+		{
+		private:
+			detail::MemoryPoolData* m_poolData;
+		public:
+			explicit MemoryPool(void* handle) : m_poolData((detail::MemoryPoolData*)handle) {}
+			MemoryPool() : m_poolData(nullptr) {}
+
+			MemoryRange allocate(size_t size, size_t alignment = 0)
+			{
+				alignment = alignment == 0 ? m_poolData->mAlignment : alignment;
+				size = math::max(size, size_t(1));
+				std::lock_guard<std::mutex> lock(m_poolData->mMutex);
+				for (auto& block : m_poolData->mBlocks)
+				{
+					auto range = allocateFromBlock(block, size, alignment);
+					if (range.valid())
+						return range;
+				}
+				detail::MemoryPoolBlock block;
+				block.mMemory = createMemory(math::max(m_poolData->mBlockSize, size + alignment), m_poolData->mAllocator);
+				block.mFreeRanges.push_back({ 0, block.mMemory.size() });
+				block.mUsedBytes = 0;
+				m_poolData->mBlocks.push_back(block);
+				return allocateFromBlock(m_poolData->mBlocks.back(), size, alignment);
+			}
+
+			void free(const MemoryRange& range)
+			{
+				if (!range.valid())
+					return;
+				std::lock_guard<std::mutex> lock(m_poolData->mMutex);
+				for (auto& block : m_poolData->mBlocks)
+				{
+					if (block.mMemory.handle() != range.mMemory.handle())
+						continue;
+					auto& ranges = block.mFreeRanges;
+					size_t size = math::max(range.mSize, size_t(1));
+					auto it = ranges.begin();
+					while (it != ranges.end() && it->mOffset < range.mOffset)
+						++it;
+					it = ranges.insert(it, { range.mOffset, size });
+					if (it + 1 != ranges.end() && it->mOffset + it->mSize == (it + 1)->mOffset)
+					{
+						it->mSize += (it + 1)->mSize;
+						ranges.erase(it + 1);
+					}
+					if (it != ranges.begin() && (it - 1)->mOffset + (it - 1)->mSize == it->mOffset)
+					{
+						(it - 1)->mSize += it->mSize;
+						ranges.erase(it);
+					}
+					block.mUsedBytes -= size;
+					return;
+				}
+				soft3d_throw_error(ErrorType::eInvalidParam);
+			}
+
+			MemoryRange bind(Buffer buffer, size_t alignment = 0)
+			{
+				auto range = allocate(buffer.size(), alignment);
+				buffer.bindMemory(range.mMemory, range.mOffset);
+				return range;
+			}
+
+			MemoryRange bind(Image image, size_t alignment = 0)
+			{
+				auto range = allocate(image.size(), alignment);
+				image.bindMemory(range.mMemory, range.mOffset);
+				return range;
+			}
+
+			// frees every range at once, blocks are kept
+			void reset()
+			{
+				std::lock_guard<std::mutex> lock(m_poolData->mMutex);
+				for (auto& block : m_poolData->mBlocks)
+				{
+					block.mFreeRanges.clear();
+					block.mFreeRanges.push_back({ 0, block.mMemory.size() });
+					block.mUsedBytes = 0;
+				}
+			}
+
+			// releases empty blocks back to the allocator
+			void trim()
+			{
+				std::lock_guard<std::mutex> lock(m_poolData->mMutex);
+				auto& blocks = m_poolData->mBlocks;
+				for (size_t i = 0; i < blocks.size();)
+				{
+					if (blocks[i].mUsedBytes == 0)
+					{
+						destroyMemory(blocks[i].mMemory, m_poolData->mAllocator);
+						blocks.erase(blocks.begin() + i);
+					}
+					else
+						i++;
+				}
+			}
+
+			size_t usedBytes() const
+			{
+				std::lock_guard<std::mutex> lock(m_poolData->mMutex);
+				size_t total = 0;
+				for (auto& block : m_poolData->mBlocks)
+					total += block.mUsedBytes;
+				return total;
+			}
+			size_t capacity() const
+			{
+				std::lock_guard<std::mutex> lock(m_poolData->mMutex);
+				size_t total = 0;
+				for (auto& block : m_poolData->mBlocks)
+					total += block.mMemory.size();
+				return total;
+			}
+			void* handle() const { return m_poolData; }
+			bool  valid() const { return handle() != nullptr; }
+		private:
+			MemoryRange allocateFromBlock(detail::MemoryPoolBlock& block, size_t size, size_t alignment)
+			{
+				auto& ranges = block.mFreeRanges;
+				for (size_t i = 0; i < ranges.size(); i++)
+				{
+					auto free_range = ranges[i];
+					size_t offset = detail::alignMemoryOffset(block.mMemory, free_range.mOffset, alignment);
+					if (offset + size > free_range.mOffset + free_range.mSize)
+						continue;
+					// keep the alignment padding in front and the remainder behind as free ranges
+					ranges.erase(ranges.begin() + i);
+					size_t tail = free_range.mOffset + free_range.mSize - (offset + size);
+					if (tail > 0)
+						ranges.insert(ranges.begin() + i, { offset + size, tail });
+					if (offset > free_range.mOffset)
+						ranges.insert(ranges.begin() + i, { free_range.mOffset, offset - free_range.mOffset });
+					block.mUsedBytes += size;
+					return MemoryRange{ block.mMemory, offset, size };
+				}
+				return MemoryRange{ Memory(nullptr), 0, 0 };
+			}
+		};
+
+
+		MemoryPool createMemoryPool(size_t blockSize, size_t alignment = 16, const MemAllocator& allocator = MemAllocator())
+		{
+			soft3d_assert_error(blockSize > 0 && alignment > 0 && (alignment & (alignment - 1)) == 0, ErrorType::eInvalidParam);
+			auto pool_data = new detail::MemoryPoolData;
+			pool_data->mAllocator = allocator;
+			pool_data->mBlockSize = blockSize;
+			pool_data->mAlignment = alignment;
+			return MemoryPool(pool_data);
+		}
+
+		void destroyMemoryPool(const MemoryPool& pool)
+		{
+			auto pool_data = (detail::MemoryPoolData*)pool.handle();
+			for (auto& block : pool_data->mBlocks)
+				destroyMemory(block.mMemory, pool_data->mAllocator);
+			delete pool_data;
+		}
+
+
+	}
+}
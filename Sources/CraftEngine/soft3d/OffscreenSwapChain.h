@@ -0,0 +1,393 @@
+#pragma once
+#include "./Common.h"
+#include "./Device.h"
+#include "./Image.h"
+
+#include <deque>
+#include <fstream>
+#include <condition_variable>
+
+namespace CraftEngine
+{
+	namespace soft3d
+	{
+
+
+		// a presented frame handed to the sink, mData points into the swap chain image and is only valid during the call
+		struct OffscreenFrame
+		{
+			const void* mData;
+			uint32_t    mWidth;
+			uint32_t    mHeight;
+			size_t      mRowPitch;
+			ImageFormat mFormat;
+			uint64_t    mFrameIndex;
+			int         mImageIndex;
+		};
+
+		using OffscreenFrameSink = std::function<void(const OffscreenFrame&)>;
+
+		enum class OffscreenPresentMode
+		{
+			eFifo,      // every presented frame reaches the sink, acquire blocks while all images are queued
+			eMailbox,   // acquire recycles the oldest queued frame instead of waiting, that frame is dropped
+		};
+
+
+		namespace detail
+		{
+			constexpr int MaxOffscreenSwapChainImageCount = 16;
+
+			enum class OffscreenImageState
+			{
+				eFree,
+				eAcquired,
+				eQueued,
+				eReading,
+			};
+
+			struct OffscreenSwapChainData
+			{
+				Device               mDevice;
+				OffscreenPresentMode mPresentMode;
+				OffscreenFrameSink   mSink;
+				int                  mWidth;
+				int                  mHeight;
+				int                  mImageCount;
+				int                  mNextIndex;
+				Image                mImageBuffers[MaxOffscreenSwapChainImageCount];
+				Memory               mImageMemorys[MaxOffscreenSwapChainImageCount];
+				OffscreenImageState  mImageStates[MaxOffscreenSwapChainImageCount];
+				uint64_t             mImageFrameIndices[MaxOffscreenSwapChainImageCount];
+				Image                mDepthStencilBuffer;
+				Memory               mDepthStencilMemory;
+
+				std::deque<int>         mPresentQueue;
+				uint64_t                mPresentedFrames;
+				uint64_t                mDroppedFrames;
+				bool                    mStop;
+				std::mutex              mMutex;
+				std::condition_variable mCondition;
+				std::thread             mReadbackThread;
+			};
+
+			// hands queued frames to the sink one at a time while the render threads work on the next frame
+			inline void offscreenReadbackLoop(OffscreenSwapChainData* data)
+			{
+				std::unique_lock<std::mutex> lock(data->mMutex);
+				while (true)
+				{
+					data->mCondition.wait(lock, [data]() { return data->mStop || !data->mPresentQueue.empty(); });
+					if (data->mPresentQueue.empty())
+						return;
+					int index = data->mPresentQueue.front();
+					data->mPresentQueue.pop_front();
+					data->mImageStates[index] = OffscreenImageState::eReading;
+					lock.unlock();
+
+					auto image_data = (ImageData*)data->mImageBuffers[index].handle();
+					resolveFastClear(image_data);
+					if (data->mSink)
+					{
+						OffscreenFrame frame;
+						frame.mData = image_data->mMappedPtr;
+						frame.mWidth = image_data->mLevelExtents[0].mWidth;
+						frame.mHeight = image_data->mLevelExtents[0].mHeight;
+						frame.mRowPitch = size_t(frame.mWidth) * image_data->mPixelBytes;
+						frame.mFormat = image_data->mFormat;
+						frame.mFrameIndex = data->mImageFrameIndices[index];
+						frame.mImageIndex = index;
+						data->mSink(frame);
+					}
+
+					lock.lock();
+					data->mImageStates[index] = OffscreenImageState::eFree;
+					data->mCondition.notify_all();
+				}
+			}
+		}
+
+
+		/*
+		 * OffscreenSwapChain: N-buffered render targets without a window.
+		 * presentImage() queues the frame for an internal readback thread which feeds the sink,
+		 * so encoding or sending frame N overlaps with rendering frame N+1.
+		*/
+		class OffscreenSwapChain
+		{
+		private:
+			detail::OffscreenSwapChainData* m_swapChainData;
+		public:
+			OffscreenSwapChain(void* handle) : m_swapChainData((detail::OffscreenSwapChainData*)handle) {}
+			OffscreenSwapChain() : m_swapChainData(nullptr) {}
+
+			int imageCount() const { return m_swapChainData->mImageCount; }
+			int width() const { return m_swapChainData->mWidth; }
+			int height() const { return m_swapChainData->mHeight; }
+
+			Image getImage(int index) const
+			{
+				return m_swapChainData->mImageBuffers[index];
+			}
+			Image getDepthStencilImage() const
+			{
+				return m_swapChainData->mDepthStencilBuffer;
+			}
+
+			// returns an image that is neither being rendered nor read back
+			int acquireNextImage()
+			{
+				std::unique_lock<std::mutex> lock(m_swapChainData->mMutex);
+				while (true)
+				{
+					for (int i = 0; i < imageCount(); i++)
+					{
+						int index = (m_swapChainData->mNextIndex + i) % imageCount();
+						if (m_swapChainData->mImageStates[index] == detail::OffscreenImageState::eFree)
+						{
+							m_swapChainData->mImageStates[index] = detail::OffscreenImageState::eAcquired;
+							m_swapChainData->mNextIndex = (index + 1) % imageCount();
+							return index;
+						}
+					}
+					if (m_swapChainData->mPresentMode == OffscreenPresentMode::eMailbox && !m_swapChainData->mPresentQueue.empty())
+					{
+						int index = m_swapChainData->mPresentQueue.front();
+						m_swapChainData->mPresentQueue.pop_front();
+						m_swapChainData->mImageStates[index] = detail::OffscreenImageState::eAcquired;
+						m_swapChainData->mDroppedFrames++;
+						return index;
+					}
+					m_swapChainData->mCondition.wait(lock);
+				}
+			}
+
+			// waits for the device to finish the frame, then queues the image for readback
+			bool presentImage(int index)
+			{
+				if (index < 0 || index >= imageCount())
+					return false;
+				if (m_swapChainData->mImageStates[index] != detail::OffscreenImageState::eAcquired)
+					return false;
+				m_swapChainData->mDevice.waitDevice();
+				std::lock_guard<std::mutex> lock(m_swapChainData->mMutex);
+				m_swapChainData->mImageStates[index] = detail::OffscreenImageState::eQueued;
+				m_swapChainData->mImageFrameIndices[index] = m_swapChainData->mPresentedFrames++;
+				m_swapChainData->mPresentQueue.push_back(index);
+				m_swapChainData->mCondition.notify_all();
+				return true;
+			}
+
+			// blocks until every presented frame went through the sink
+			void waitIdle()
+			{
+				std::unique_lock<std::mutex> lock(m_swapChainData->mMutex);
+				m_swapChainData->mCondition.wait(lock, [this]() {
+					if (!m_swapChainData->mPresentQueue.empty())
+						return false;
+					for (int i = 0; i < imageCount(); i++)
+						if (m_swapChainData->mImageStates[i] == detail::OffscreenImageState::eReading)
+							return false;
+					return true;
+				});
+			}
+
+			void setSink(const OffscreenFrameSink& sink)
+			{
+				waitIdle();
+				std::lock_guard<std::mutex> lock(m_swapChainData->mMutex);
+				m_swapChainData->mSink = sink;
+			}
+
+			uint64_t presentedFrames() const
+			{
+				std::lock_guard<std::mutex> lock(m_swapChainData->mMutex);
+				return m_swapChainData->mPresentedFrames;
+			}
+			uint64_t droppedFrames() const
+			{
+				std::lock_guard<std::mutex> lock(m_swapChainData->mMutex);
+				return m_swapChainData->mDroppedFrames;
+			}
+
+			void* handle() const { return m_swapChainData; }
+			bool  valid() const { return handle() != nullptr; }
+		};
+
+
+		OffscreenSwapChain createOffscreenSwapChain(
+			const Device&        device,
+			int                  width,
+			int                  height,
+			int                  imageCount,
+			OffscreenFrameSink   sink,
+			bool                 depth = false,
+			OffscreenPresentMode presentMode = OffscreenPresentMode::eFifo,
+			ImageFormat          format = ImageFormat::eR8G8B8A8_UNORM
+		)
+		{
+			soft3d_assert_error(width > 0 && height > 0, ErrorType::eInvalidParam);
+			soft3d_assert_error(imageCount > 0 && imageCount <= detail::MaxOffscreenSwapChainImageCount, ErrorType::eInvalidParam);
+			auto swap_chain_data = new detail::OffscreenSwapChainData;
+			swap_chain_data->mDevice = device;
+			swap_chain_data->mPresentMode = presentMode;
+			swap_chain_data->mSink = sink;
+			swap_chain_data->mWidth = width;
+			swap_chain_data->mHeight = height;
+			swap_chain_data->mImageCount = imageCount;
+			swap_chain_data->mNextIndex = 0;
+			swap_chain_data->mPresentedFrames = 0;
+			swap_chain_data->mDroppedFrames = 0;
+			swap_chain_data->mStop = false;
+			for (int i = 0; i < imageCount; i++)
+			{
+				auto img = createImage(width, height, 1, 1, ImageType::eImage2D, format, 1, 1);
+				auto mem = createMemory(img.size());
+				img.bindMemory(mem, 0);
+				swap_chain_data->mImageBuffers[i] = img;
+				swap_chain_data->mImageMemorys[i] = mem;
+				swap_chain_data->mImageStates[i] = detail::OffscreenImageState::eFree;
+				swap_chain_data->mImageFrameIndices[i] = 0;
+			}
+			if (depth)
+			{
+				auto img = createImage(width, height, 1, 1, ImageType::eImage2D, ImageFormat::eD32_SFLOAT, 1, 1);
+				auto mem = createMemory(img.size());
+				img.bindMemory(mem, 0);
+				swap_chain_data->mDepthStencilBuffer = img;
+				swap_chain_data->mDepthStencilMemory = mem;
+			}
+			swap_chain_data->mReadbackThread = std::thread(detail::offscreenReadbackLoop, swap_chain_data);
+			return OffscreenSwapChain(swap_chain_data);
+		}
+
+		// drains the frames still queued before releasing the images
+		void destroyOffscreenSwapChain(OffscreenSwapChain& swapChain)
+		{
+			auto swap_chain_data = (detail::OffscreenSwapChainData*)swapChain.handle();
+			{
+				std::lock_guard<std::mutex> lock(swap_chain_data->mMutex);
+				swap_chain_data->mStop = true;
+				swap_chain_data->mCondition.notify_all();
+			}
+			swap_chain_data->mReadbackThread.join();
+			for (int i = 0; i < swap_chain_data->mImageCount; i++)
+			{
+				destroyImage(swap_chain_data->mImageBuffers[i]);
+				destroyMemory(swap_chain_data->mImageMemorys[i]);
+			}
+			if (swap_chain_data->mDepthStencilBuffer.valid())
+			{
+				destroyImage(swap_chain_data->mDepthStencilBuffer);
+				destroyMemory(swap_chain_data->mDepthStencilMemory);
+			}
+			delete swap_chain_data;
+		}
+
+
+
+
+		/*
+		 * OffscreenFrameRing: fixed size ring of frame copies between the readback thread and a consumer,
+		 * e.g. a network sender. When the consumer falls behind the oldest frame is overwritten.
+		*/
+		class OffscreenFrameRing
+		{
+		private:
+			struct Slot
+			{
+				std::vector<uint8_t> mPixels;
+				OffscreenFrame       mFrame;
+			};
+			std::vector<Slot>       m_slots;
+			size_t                  m_head;
+			size_t                  m_count;
+			uint64_t                m_overwritten;
+			std::mutex              m_mutex;
+			std::condition_variable m_condition;
+		public:
+			explicit OffscreenFrameRing(size_t capacity) : m_slots(math::max(capacity, size_t(1))), m_head(0), m_count(0), m_overwritten(0) {}
+			OffscreenFrameRing(const OffscreenFrameRing&) = delete;
+			OffscreenFrameRing& operator=(const OffscreenFrameRing&) = delete;
+
+			void push(const OffscreenFrame& frame)
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (m_count == m_slots.size())
+				{
+					m_head = (m_head + 1) % m_slots.size();
+					m_count--;
+					m_overwritten++;
+				}
+				auto& slot = m_slots[(m_head + m_count) % m_slots.size()];
+				slot.mPixels.resize(frame.mRowPitch * frame.mHeight);
+				memcpy(slot.mPixels.data(), frame.mData, slot.mPixels.size());
+				slot.mFrame = frame;
+				m_count++;
+				m_condition.notify_one();
+			}
+
+			// moves the oldest frame into pixels, frame.mData then points at pixels
+			bool pop(std::vector<uint8_t>& pixels, OffscreenFrame& frame, bool wait = true)
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				if (wait)
+					m_condition.wait(lock, [this]() { return m_count > 0; });
+				if (m_count == 0)
+					return false;
+				auto& slot = m_slots[m_head];
+				pixels.swap(slot.mPixels);
+				frame = slot.mFrame;
+				frame.mData = pixels.data();
+				m_head = (m_head + 1) % m_slots.size();
+				m_count--;
+				return true;
+			}
+
+			size_t size()
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				return m_count;
+			}
+			uint64_t overwrittenFrames()
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				return m_overwritten;
+			}
+
+			OffscreenFrameSink sink()
+			{
+				return [this](const OffscreenFrame& frame) { push(frame); };
+			}
+		};
+
+
+		// appends every frame as tightly packed raw pixels to one file
+		OffscreenFrameSink createRawFileSink(const char* filename)
+		{
+			auto file = std::make_shared<std::ofstream>(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+			if (!file->is_open())
+				soft3d_throw_error(ErrorType::eInvalidParam);
+			return [file](const OffscreenFrame& frame) {
+				file->write((const char*)frame.mData, frame.mRowPitch * frame.mHeight);
+				file->flush();
+			};
+		}
+
+		// writes one png per frame, pattern is a printf format receiving the frame index, e.g. "frame_%06llu.png"
+		// only 4 byte per pixel formats are written, other frames are skipped
+		OffscreenFrameSink createPngFileSink(const char* pattern)
+		{
+			std::string file_pattern = pattern;
+			return [file_pattern](const OffscreenFrame& frame) {
+				if (frame.mRowPitch != size_t(frame.mWidth) * 4)
+					return;
+				char filename[1024];
+				snprintf(filename, sizeof(filename), file_pattern.c_str(), (unsigned long long)frame.mFrameIndex);
+				stbi_write_png(filename, frame.mWidth, frame.mHeight, 4, frame.mData, int(frame.mRowPitch));
+			};
+		}
+
+
+	}
+}
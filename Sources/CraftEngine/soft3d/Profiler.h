@@ -0,0 +1,204 @@
+#pragma once
+#include "./Common.h"
+#include <chrono>
+#include <fstream>
+
+/*
+ * Pipeline statistics and Chrome-trace profiling.
+ * Define CRAFT_ENGINE_SOFT3D_PROFILING before including soft3d to enable it,
+ * otherwise every soft3d_profile_* macro expands to nothing and the counters stay zero.
+*/
+
+#ifdef CRAFT_ENGINE_SOFT3D_PROFILING
+#define soft3d_profile_scope(profiler, name, slot) \
+	::CraftEngine::soft3d::detail::ProfileScope soft3d_profile_scope_((profiler), (name), (slot))
+#define soft3d_profile_count(counter, n) \
+	soft3d_profile_scope_.count(::CraftEngine::soft3d::detail::counter, (n))
+#define soft3d_profile_add(profiler, counter, n) \
+	(profiler)->mSlots[0].mCounters[::CraftEngine::soft3d::detail::counter].fetch_add((n), std::memory_order_relaxed)
+#else
+#define soft3d_profile_scope(profiler, name, slot)
+#define soft3d_profile_count(counter, n) ((void)0)
+#define soft3d_profile_add(profiler, counter, n) ((void)0)
+#endif
+
+namespace CraftEngine
+{
+	namespace soft3d
+	{
+
+
+		struct PipelineStatistics
+		{
+			uint64_t mVerticesShaded;
+			uint64_t mPrimitivesCulled;
+			uint64_t mPrimitivesClipped;
+			uint64_t mFragmentsShaded;
+			uint64_t mFragmentsDepthRejected;
+			uint64_t mFragmentsDiscarded;
+			uint64_t mElapsedTime;                  // nanoseconds since the last reset
+			std::vector<uint64_t> mWorkerBusyTime;  // nanoseconds, one entry per device thread
+			std::vector<uint64_t> mWorkerIdleTime;
+		};
+
+
+		namespace detail
+		{
+			enum ProfileCounter
+			{
+				eProfileVerticesShaded,
+				eProfilePrimitivesCulled,
+				eProfilePrimitivesClipped,
+				eProfileFragmentsShaded,
+				eProfileFragmentsDepthRejected,
+				eProfileFragmentsDiscarded,
+				eProfileCounterCount,
+			};
+
+			// slot 0 is the submitting thread, slot tid + 1 is device thread tid
+			constexpr uint32_t MaxProfileSlots = 49;
+			constexpr size_t   MaxTraceEvents = 1 << 20;
+
+			struct alignas(64) ProfileSlot
+			{
+				std::atomic<uint64_t> mCounters[eProfileCounterCount];
+				std::atomic<uint64_t> mBusyTime;
+			};
+
+			struct TraceEvent
+			{
+				const char* mName;
+				uint32_t    mSlot;
+				uint64_t    mBegin;
+				uint64_t    mDuration;
+			};
+
+			struct ProfilerData
+			{
+				ProfileSlot                           mSlots[MaxProfileSlots];
+				std::chrono::steady_clock::time_point mEpoch;
+				uint64_t                              mResetTime;
+				std::atomic_bool                      mTracing;
+				std::mutex                            mTraceMutex;
+				std::vector<TraceEvent>               mTraceEvents;
+			};
+
+			inline uint64_t profilerTime(const ProfilerData& profiler)
+			{
+				return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - profiler.mEpoch).count());
+			}
+
+			inline void resetProfiler(ProfilerData& profiler)
+			{
+				for (auto& slot : profiler.mSlots)
+				{
+					for (auto& counter : slot.mCounters)
+						counter.store(0, std::memory_order_relaxed);
+					slot.mBusyTime.store(0, std::memory_order_relaxed);
+				}
+				profiler.mResetTime = profilerTime(profiler);
+			}
+
+			inline void initProfiler(ProfilerData& profiler)
+			{
+				profiler.mEpoch = std::chrono::steady_clock::now();
+				profiler.mTracing = false;
+				resetProfiler(profiler);
+			}
+
+			/*
+			 * Times one task and gathers its counters locally,
+			 * they are flushed into the slot once when the scope ends so workers never contend per fragment.
+			 * A null profiler turns the scope into a no-op.
+			*/
+			class ProfileScope
+			{
+			private:
+				ProfilerData* m_profiler;
+				const char*   m_name;
+				uint32_t      m_slot;
+				uint64_t      m_begin;
+				uint64_t      m_counters[eProfileCounterCount];
+			public:
+				ProfileScope(ProfilerData* profiler, const char* name, uint32_t slot)
+					: m_profiler(profiler), m_name(name), m_slot(math::min(slot, MaxProfileSlots - 1)), m_begin(profiler != nullptr ? profilerTime(*profiler) : 0)
+				{
+					for (auto& counter : m_counters)
+						counter = 0;
+				}
+				ProfileScope(const ProfileScope&) = delete;
+				ProfileScope& operator=(const ProfileScope&) = delete;
+
+				void count(ProfileCounter counter, uint64_t n) { m_counters[counter] += n; }
+
+				~ProfileScope()
+				{
+					if (m_profiler == nullptr)
+						return;
+					auto duration = profilerTime(*m_profiler) - m_begin;
+					auto& slot = m_profiler->mSlots[m_slot];
+					for (int i = 0; i < eProfileCounterCount; i++)
+						if (m_counters[i] > 0)
+							slot.mCounters[i].fetch_add(m_counters[i], std::memory_order_relaxed);
+					if (m_slot > 0)
+						slot.mBusyTime.fetch_add(duration, std::memory_order_relaxed);
+					if (m_profiler->mTracing.load(std::memory_order_relaxed))
+					{
+						std::lock_guard<std::mutex> lock(m_profiler->mTraceMutex);
+						if (m_profiler->mTraceEvents.size() < MaxTraceEvents)
+							m_profiler->mTraceEvents.push_back({ m_name, m_slot, m_begin, duration });
+					}
+				}
+			};
+
+			inline PipelineStatistics collectStatistics(const ProfilerData& profiler, uint32_t threadCount)
+			{
+				uint64_t totals[eProfileCounterCount] = {};
+				for (auto& slot : profiler.mSlots)
+					for (int i = 0; i < eProfileCounterCount; i++)
+						totals[i] += slot.mCounters[i].load(std::memory_order_relaxed);
+
+				PipelineStatistics statistics;
+				statistics.mVerticesShaded = totals[eProfileVerticesShaded];
+				statistics.mPrimitivesCulled = totals[eProfilePrimitivesCulled];
+				statistics.mPrimitivesClipped = totals[eProfilePrimitivesClipped];
+				statistics.mFragmentsShaded = totals[eProfileFragmentsShaded];
+				statistics.mFragmentsDepthRejected = totals[eProfileFragmentsDepthRejected];
+				statistics.mFragmentsDiscarded = totals[eProfileFragmentsDiscarded];
+				statistics.mElapsedTime = profilerTime(profiler) - profiler.mResetTime;
+				threadCount = math::min(threadCount, MaxProfileSlots - 1);
+				statistics.mWorkerBusyTime.resize(threadCount);
+				statistics.mWorkerIdleTime.resize(threadCount);
+				for (uint32_t i = 0; i < threadCount; i++)
+				{
+					auto busy = profiler.mSlots[i + 1].mBusyTime.load(std::memory_order_relaxed);
+					statistics.mWorkerBusyTime[i] = busy;
+					statistics.mWorkerIdleTime[i] = statistics.mElapsedTime > busy ? statistics.mElapsedTime - busy : 0;
+				}
+				return statistics;
+			}
+
+			// Chrome trace event format, open it with chrome://tracing or Perfetto
+			inline bool writeChromeTrace(ProfilerData& profiler, const char* filename)
+			{
+				std::ofstream file(filename, std::ios::out | std::ios::trunc);
+				if (!file.is_open())
+					return false;
+				std::lock_guard<std::mutex> lock(profiler.mTraceMutex);
+				file << "{\"traceEvents\":[\n";
+				for (size_t i = 0; i < profiler.mTraceEvents.size(); i++)
+				{
+					auto& event = profiler.mTraceEvents[i];
+					file << "{\"name\":\"" << event.mName << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.mSlot
+						<< ",\"ts\":" << event.mBegin / 1000 << "." << (event.mBegin % 1000) / 100
+						<< ",\"dur\":" << event.mDuration / 1000 << "." << (event.mDuration % 1000) / 100
+						<< (i + 1 < profiler.mTraceEvents.size() ? "},\n" : "}\n");
+				}
+				file << "],\"displayTimeUnit\":\"ns\"}\n";
+				return file.good();
+			}
+		}
+
+
+	}
+}
@@ -276,8 +276,8 @@ namespace CraftEngine
 				RayTraceAABB* primitive_aabb = new RayTraceAABB[primitive_count];
 
 				// calcular every triangle's aabb
-				const uint8_t const* vertex_buffer = (const uint8_t*)acStructureData->mVertexBuffer.data();
-				const uint8_t const* index_buffer = (const uint8_t*)acStructureData->mIndexBuffer.data();
+				const uint8_t* vertex_buffer = (const uint8_t*)acStructureData->mVertexBuffer.data();
+				const uint8_t* index_buffer = (const uint8_t*)acStructureData->mIndexBuffer.data();
 				uint8_t const* cur_index_ptr = index_buffer;
 				const uint32_t vertex_stride = acStructureData->mVertexStride;
 				const uint32_t vertex_offset = acStructureData->mVertexOffset;
@@ -409,8 +409,8 @@ namespace CraftEngine
 				if (node->mIsLeaf)
 				{
 					const uint32_t primitive_index = node->mPrimitiveIndex;
-					const uint8_t const* vertex_buffer = (const uint8_t*)resources->acStructureData->mVertexBuffer.data();
-					const uint8_t const* index_buffer = (const uint8_t*)resources->acStructureData->mIndexBuffer.data();
+					const uint8_t* vertex_buffer = (const uint8_t*)resources->acStructureData->mVertexBuffer.data();
+					const uint8_t* index_buffer = (const uint8_t*)resources->acStructureData->mIndexBuffer.data();
 					uint8_t const* cur_index_ptr = index_buffer;
 					const uint32_t vertex_stride = resources->acStructureData->mVertexStride;
 					const uint32_t vertex_offset = resources->acStructureData->mVertexOffset;
@@ -553,8 +553,8 @@ namespace CraftEngine
 						if (node->mIsLeaf)
 						{
 							const uint32_t primitive_index = node->mPrimitiveIndex;
-							const uint8_t const* vertex_buffer = (const uint8_t*)resources->acStructureData->mVertexBuffer.data();
-							const uint8_t const* index_buffer = (const uint8_t*)resources->acStructureData->mIndexBuffer.data();
+							const uint8_t* vertex_buffer = (const uint8_t*)resources->acStructureData->mVertexBuffer.data();
+							const uint8_t* index_buffer = (const uint8_t*)resources->acStructureData->mIndexBuffer.data();
 							uint8_t const* cur_index_ptr = index_buffer;
 							const uint32_t vertex_stride = resources->acStructureData->mVertexStride;
 							const uint32_t vertex_offset = resources->acStructureData->mVertexOffset;
@@ -833,7 +833,6 @@ namespace CraftEngine
 		{
 			auto acs_data = (detail::RayTraceTopLevelAccelerationStructureData*)allocator.alloc(sizeof(detail::RayTraceTopLevelAccelerationStructureData));
 
-			vec3 vertices[8];
 			acs_data->mInstanceCount = instanceCount;
 			acs_data->mInstanceList = (detail::RayTraceBottomLevelAccelerationStructureInstanceData*)allocator.alloc(
 				instanceCount * sizeof(detail::RayTraceBottomLevelAccelerationStructureInstanceData));
@@ -850,24 +849,8 @@ namespace CraftEngine
 				auto btm_lv_as = (detail::RayTraceBottomLevelAccelerationStructureData*)instances[i].mBLAS.handle();
 
 				auto aabb = ((detail::RayTraceBVHNodeData*)btm_lv_as->mBVHData)->mAABB;
-				vertices[0] = aabb.mMin;
-				vertices[1] = vec3(aabb.mMin.x, aabb.mMin.y, aabb.mMax.z);
-				vertices[2] = vec3(aabb.mMin.x, aabb.mMax.y, aabb.mMin.z);
-				vertices[3] = vec3(aabb.mMax.x, aabb.mMin.y, aabb.mMin.z);
-				vertices[4] = aabb.mMax;
-				vertices[5] = vec3(aabb.mMax.x, aabb.mMax.y, aabb.mMin.z);
-				vertices[6] = vec3(aabb.mMax.x, aabb.mMin.y, aabb.mMax.z);
-				vertices[7] = vec3(aabb.mMin.x, aabb.mMax.y, aabb.mMax.z);
-				for (int j = 0; j < 8; j++)
-					vertices[j] = vec3(transform * vec4(vertices[j], 1.0f));
-
-				acs_data->mInstanceList[i].mAABB.mMin = vertices[0];
-				acs_data->mInstanceList[i].mAABB.mMax = vertices[0];
-				for (int j = 1; j < 8; j++)
-				{
-					acs_data->mInstanceList[i].mAABB.mMin = math::min(acs_data->mInstanceList[i].mAABB.mMin, vertices[j]);
-					acs_data->mInstanceList[i].mAABB.mMax = math::max(acs_data->mInstanceList[i].mAABB.mMax, vertices[j]);
-				}
+				// all eight corners are transformed as one packet
+				math::transformBounds(transform, aabb.mMin, aabb.mMax, acs_data->mInstanceList[i].mAABB.mMin, acs_data->mInstanceList[i].mAABB.mMax);
 			}
 			detail::rayTraceConstructTopLevelBVH(acs_data, allocator);
 
@@ -1131,8 +1114,8 @@ namespace CraftEngine
 					auto btm_lv_as_data = (detail::RayTraceBottomLevelAccelerationStructureData*)instance.mBLAS.handle();
 
 					const uint32_t primitive_index = resources.primitiveIndex;
-					const uint8_t const* vertex_buffer = (const uint8_t*)btm_lv_as_data->mVertexBuffer.data();
-					const uint8_t const* index_buffer = (const uint8_t*)btm_lv_as_data->mIndexBuffer.data();
+					const uint8_t* vertex_buffer = (const uint8_t*)btm_lv_as_data->mVertexBuffer.data();
+					const uint8_t* index_buffer = (const uint8_t*)btm_lv_as_data->mIndexBuffer.data();
 					uint8_t const* cur_index_ptr = index_buffer;
 					const uint32_t vertex_stride = btm_lv_as_data->mVertexStride;
 					const uint32_t vertex_offset = btm_lv_as_data->mVertexOffset;
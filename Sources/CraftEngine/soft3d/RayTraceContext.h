@@ -127,6 +127,7 @@ namespace CraftEngine
 							m_contextData->mCurTileID.x++;
 							m_contextData->mMutex.unlock();
 
+							soft3d_profile_scope(&((detail::DeviceData*)m_contextData->mDevice.handle())->mProfiler, "traceRayTile", tid + 1);
 							ivec2 tile_beg = tile_id * m_contextData->mTileSize;
 							ivec2 tile_end = tile_beg + m_contextData->mTileSize;
 							tile_end = math::clamp(tile_end, ivec2(0, 0), ivec2(width, height));
@@ -167,6 +168,7 @@ namespace CraftEngine
 						input.mLaunchSize = ivec2(width, height);
 
 						{
+							soft3d_profile_scope(&((detail::DeviceData*)m_contextData->mDevice.handle())->mProfiler, "traceRay", tid + 1);
 							ivec2 tile_beg = ivec2(0, 0);
 							ivec2 tile_end = ivec2(width, height);
 							for (int y = tile_beg.y; y < tile_end.y; y++)
@@ -205,8 +207,8 @@ namespace CraftEngine
 
 		void destroyRayTrackContext(RayTraceContext& context, const MemAllocator& allocator = MemAllocator())
 		{
-			auto ctx_data = (detail::RayTraceContextData*)allocator.alloc(sizeof(detail::RayTraceContextData));
-			delete(&ctx_data->mMutex);
+			auto ctx_data = (detail::RayTraceContextData*)context.handle();
+			ctx_data->mMutex.~mutex();
 			allocator.free(context.handle());
 		}
 
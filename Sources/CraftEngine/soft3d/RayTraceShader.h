@@ -142,6 +142,8 @@ namespace CraftEngine
 				auto dst_pixel_data_begin = ((byte*)img_data->mMappedPtr) + (coord.y * image.width() + coord.x) * pixel_size;
 				detail::ImagePixelData pixel_data = detail::castVectorToPixel(color, image.format());
 				memcpy(dst_pixel_data_begin, &pixel_data, pixel_size);
+				if (auto fast_clear = detail::findFastClear(img_data, 0, 0))
+					detail::markFastClearTexel(fast_clear, coord.x, coord.y);
 			}
 
 			vec4 imageRead(const Image& image, ivec2 coord) const
@@ -149,6 +151,9 @@ namespace CraftEngine
 				auto img_data = (detail::ImageData*)image.handle();
 				auto pixel_size = img_data->mPixelBytes;
 				auto dst_pixel_data_begin = ((byte*)img_data->mMappedPtr) + (coord.y * image.width() + coord.x) * pixel_size;
+				auto fast_clear = detail::findFastClear(img_data, 0, 0);
+				if (fast_clear != nullptr && detail::isFastClearTexel(fast_clear, coord.x, coord.y))
+					dst_pixel_data_begin = fast_clear->mClearValue.mData;
 				vec4 color = detail::castPixelToVector(*((detail::ImagePixelData*)dst_pixel_data_begin), image.format());
 				return color;
 			}
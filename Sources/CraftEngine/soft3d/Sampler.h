@@ -1,6 +1,7 @@
 #pragma once
 #include "./Common.h"
 #include "./Image.h"
+#include "./ImageCompress.h"
 
 namespace CraftEngine
 {
@@ -394,12 +395,13 @@ namespace CraftEngine
 					switch (borderColor())
 					{
 					case SamplerBorderColor::eWhiteFloat:
+					case SamplerBorderColor::eWhiteInt:
 						return vec4(1.0f, 1.0f, 1.0f, 0.0f);
 						break;
 					case SamplerBorderColor::eBlackFloat:
-						return vec4(0.0f);
-						break;
+					case SamplerBorderColor::eBlackInt:
 					default:
+						return vec4(0.0f);
 						break;
 					}
 				}
@@ -513,12 +515,13 @@ namespace CraftEngine
 					switch (borderColor())
 					{
 					case SamplerBorderColor::eWhiteFloat:
+					case SamplerBorderColor::eWhiteInt:
 						return vec4(1.0f, 1.0f, 1.0f, 0.0f);
 						break;
 					case SamplerBorderColor::eBlackFloat:
-						return vec4(0.0f);
-						break;
+					case SamplerBorderColor::eBlackInt:
 					default:
+						return vec4(0.0f);
 						break;
 					}
 				}
@@ -529,6 +532,8 @@ namespace CraftEngine
 				break;
 			}
 			}
+			if (image_data->mBlockBytes > 0)
+				return detail::castCompressedTexelToVector(detail::fetchCompressedTexel(image_data, mipLevel, layer, ivec3(address, 0)));
 			return detail::castPixelToVector(*(const detail::ImagePixelData*)texel_data, image_data->mFormat);
 		}
 
@@ -671,12 +676,13 @@ namespace CraftEngine
 					switch (borderColor())
 					{
 					case SamplerBorderColor::eWhiteFloat:
+					case SamplerBorderColor::eWhiteInt:
 						return vec4(1.0f, 1.0f, 1.0f, 0.0f);
 						break;
 					case SamplerBorderColor::eBlackFloat:
-						return vec4(0.0f);
-						break;
+					case SamplerBorderColor::eBlackInt:
 					default:
+						return vec4(0.0f);
 						break;
 					}
 				}
@@ -687,6 +693,8 @@ namespace CraftEngine
 				break;
 			}
 			}
+			if (image_data->mBlockBytes > 0)
+				return detail::castCompressedTexelToVector(detail::fetchCompressedTexel(image_data, mipLevel, layer, address));
 			return detail::castPixelToVector(*(const detail::ImagePixelData*)texel_data, image_data->mFormat);
 		}
 
@@ -902,12 +910,13 @@ namespace CraftEngine
 					switch (borderColor())
 					{
 					case SamplerBorderColor::eWhiteFloat:
+					case SamplerBorderColor::eWhiteInt:
 						return vec4(1.0f, 1.0f, 1.0f, 0.0f);
 						break;
 					case SamplerBorderColor::eBlackFloat:
-						return vec4(0.0f);
-						break;
+					case SamplerBorderColor::eBlackInt:
 					default:
+						return vec4(0.0f);
 						break;
 					}
 				}
@@ -918,6 +927,8 @@ namespace CraftEngine
 				break;
 			}
 			}
+			if (image_data->mBlockBytes > 0)
+				return detail::castCompressedTexelToVector(detail::fetchCompressedTexel(image_data, mipLevel, layer, ivec3(address, 0)));
 			return detail::castPixelToVector(*(const detail::ImagePixelData*)texel_data, image_data->mFormat);
 		}
 		inline vec4 Sampler::sampleNeaestImageCube(const Image& image, const vec2& texCoord, uint32_t mipLevel, uint32_t layer) const
@@ -354,12 +354,13 @@ namespace CraftEngine
 					switch (borderColor())
 					{
 					case SamplerBorderColor::eWhiteFloat:
+					case SamplerBorderColor::eWhiteInt:
 						return ivec4(0xFFFF, 0xFFFF, 0xFFFF, 0);
 						break;
 					case SamplerBorderColor::eBlackFloat:
-						return ivec4(0);
-						break;
+					case SamplerBorderColor::eBlackInt:
 					default:
+						return ivec4(0);
 						break;
 					}
 				}
@@ -473,12 +474,13 @@ namespace CraftEngine
 					switch (borderColor())
 					{
 					case SamplerBorderColor::eWhiteFloat:
+					case SamplerBorderColor::eWhiteInt:
 						return ivec4(0xFFFF, 0xFFFF, 0xFFFF, 0);
 						break;
 					case SamplerBorderColor::eBlackFloat:
-						return ivec4(0);
-						break;
+					case SamplerBorderColor::eBlackInt:
 					default:
+						return ivec4(0);
 						break;
 					}
 				}
@@ -489,6 +491,8 @@ namespace CraftEngine
 				break;
 			}
 			}
+			if (image_data->mBlockBytes > 0)
+				return detail::castCompressedTexelToVectorInt(detail::fetchCompressedTexel(image_data, mipLevel, layer, ivec3(address, 0)));
 			return detail::castPixelToVectorInt(*(const detail::ImagePixelData*)texel_data, image_data->mFormat);
 		}
 
@@ -631,12 +635,13 @@ namespace CraftEngine
 					switch (borderColor())
 					{
 					case SamplerBorderColor::eWhiteFloat:
+					case SamplerBorderColor::eWhiteInt:
 						return ivec4(0xFFFF, 0xFFFF, 0xFFFF, 0);
 						break;
 					case SamplerBorderColor::eBlackFloat:
-						return ivec4(0);
-						break;
+					case SamplerBorderColor::eBlackInt:
 					default:
+						return ivec4(0);
 						break;
 					}
 				}
@@ -647,6 +652,8 @@ namespace CraftEngine
 				break;
 			}
 			}
+			if (image_data->mBlockBytes > 0)
+				return detail::castCompressedTexelToVectorInt(detail::fetchCompressedTexel(image_data, mipLevel, layer, address));
 			return detail::castPixelToVectorInt(*(const detail::ImagePixelData*)texel_data, image_data->mFormat);
 		}
 
@@ -863,12 +870,13 @@ namespace CraftEngine
 					switch (borderColor())
 					{
 					case SamplerBorderColor::eWhiteFloat:
+					case SamplerBorderColor::eWhiteInt:
 						return ivec4(0xFFFF, 0xFFFF, 0xFFFF, 0);
 						break;
 					case SamplerBorderColor::eBlackFloat:
-						return ivec4(0);
-						break;
+					case SamplerBorderColor::eBlackInt:
 					default:
+						return ivec4(0);
 						break;
 					}
 				}
@@ -879,6 +887,8 @@ namespace CraftEngine
 				break;
 			}
 			}
+			if (image_data->mBlockBytes > 0)
+				return detail::castCompressedTexelToVectorInt(detail::fetchCompressedTexel(image_data, mipLevel, layer, ivec3(address, 0)));
 			return detail::castPixelToVectorInt(*(const detail::ImagePixelData*)texel_data, image_data->mFormat);
 		}
 
@@ -1109,12 +1119,13 @@ namespace CraftEngine
 					switch (borderColor())
 					{
 					case SamplerBorderColor::eWhiteFloat:
+					case SamplerBorderColor::eWhiteInt:
 						return white_color;
 						break;
 					case SamplerBorderColor::eBlackFloat:
-						return black_color;
-						break;
+					case SamplerBorderColor::eBlackInt:
 					default:
+						return black_color;
 						break;
 					}
 				}
@@ -1126,6 +1137,8 @@ namespace CraftEngine
 				break; 
 			}
 			}
+			if (image_data->mBlockBytes > 0)
+				return detail::fetchCompressedTexel(image_data, mipLevel, layer, ivec3(address, 0));
 			return (*(const detail::ImagePixelData*)texel_data).mR8G8B8A8_UNORM;
 		}
 
@@ -2,12 +2,14 @@
 #include "./Common.h"
 
 #include "./Memory.h"
+#include "./MemoryPool.h"
 #include "./Buffer.h"
 #include "./Image.h"
 #include "./ImageView.h"
 #include "./Sampler.h"
 
 #include "./Context.h"
+#include "./OffscreenSwapChain.h"
 
 namespace CraftEngine
 {
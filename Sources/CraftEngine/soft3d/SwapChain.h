@@ -1,6 +1,8 @@
 #pragma once
 
+#ifdef _WIN32
 #include <Windows.h>
+#endif
 
 
 #include "./Image.h"
@@ -26,6 +28,7 @@ namespace CraftEngine
 				int mWidth;
 				int mHeight;
 
+#ifdef _WIN32
 				//ڵHDChandle
 				HWND mScreenHwnd;
 				HDC mScreenHdc;
@@ -33,6 +36,7 @@ namespace CraftEngine
 				HBITMAP mHCompatibleBitmap; //BITMAP
 				HBITMAP mHOldBitmap; //ɵBITMAP				  
 				BITMAPINFO mBitmapInfo; //BITMAPINFOṹ
+#endif
 			};
 
 		}
@@ -87,6 +91,8 @@ namespace CraftEngine
 			int width() const { return m_swapChainData->mWidth; }
 			int height() const { return m_swapChainData->mHeight; }
 
+#ifdef _WIN32
+			// window backend, see OffscreenSwapChain.h for headless rendering
 			void create(HWND hwnd, int width, int height, int imageCount, bool depth = false)
 			{	
 				clear();
@@ -132,6 +138,7 @@ namespace CraftEngine
 				}
 			}
 
+#endif
 			void clear()
 			{
 				for (int i = 0; i < imageCount(); i++)
@@ -152,6 +159,7 @@ namespace CraftEngine
 				}
 			}
 
+#ifdef _WIN32
 			bool presentImage(int index)
 			{
 				if (imageCount() < 0)
@@ -165,6 +173,8 @@ namespace CraftEngine
 				return true;
 			}
 
+#endif
+
 			void* handle() const { return m_swapChainData; }
 			bool  valid() const { return handle() != nullptr; }
 		};
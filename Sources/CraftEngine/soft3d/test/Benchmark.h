@@ -0,0 +1,890 @@
+#pragma once
+#include "../Soft3D.h"
+#include "../ImageOps.h"
+#include "../RayTraceContext.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <stdexcept>
+
+
+/*
+ * Headless soft3d benchmark suite.
+ * Renders the standard workloads into offscreen targets for every requested thread count and
+ * reports ns/pixel, Mtri/s or Mrays/s. Results are written as CSV/JSON and can be compared
+ * against a stored baseline CSV. No window or GPU is needed, a two line main is enough:
+ *
+ *   #include "soft3d/test/Benchmark.h"
+ *   int main(int argc, char** argv) { return CraftEngine::soft3d::bench::benchmarkMain(argc, argv); }
+ *
+ *   ./soft3d_bench --threads 1,2,4,8 --csv current.csv --baseline baseline.csv --tolerance 0.1
+*/
+
+namespace CraftEngine
+{
+	namespace soft3d
+	{
+		namespace bench
+		{
+
+
+			struct BenchmarkOptions
+			{
+				std::vector<uint32_t> mThreadCounts;        // empty: 1, 2, 4 ... up to hardware_concurrency
+				uint32_t              mWidth = 1024;
+				uint32_t              mHeight = 1024;
+				uint32_t              mRepeat = 3;          // best of N runs is reported
+				uint32_t              mMaxTriangles = 5000000;
+				std::string           mFilter;              // only run workloads whose name contains this
+				std::ostream*         mLog = &std::cout;    // progress output, may be null
+			};
+
+			struct BenchmarkResult
+			{
+				std::string mName;
+				std::string mUnit;
+				uint32_t    mThreads;
+				double      mValue;
+				double      mSeconds;                     // best wall time of one run
+			};
+
+			struct BenchmarkRegression
+			{
+				BenchmarkResult mCurrent;
+				double          mBaseline;
+				double          mChange;                  // relative slowdown, 0.1 = 10% worse
+			};
+
+
+			namespace detail
+			{
+				inline bool higherIsBetter(const std::string& unit)
+				{
+					return unit == "Mtri/s" || unit == "Mrays/s";
+				}
+
+				// the whole string must be the number, std::stoul alone accepts "4x" and wraps "-1"
+				inline uint32_t parseUnsigned(const std::string& text)
+				{
+					size_t end = 0;
+					auto value = text.empty() || text[0] == '-' ? 0 : std::stoul(text, &end);
+					if (end == 0 || end != text.size() || value > 0xFFFFFFFFUL)
+						throw std::invalid_argument(text);
+					return uint32_t(value);
+				}
+
+				inline double parseDouble(const std::string& text)
+				{
+					size_t end = 0;
+					auto value = std::stod(text, &end);
+					if (end != text.size())
+						throw std::invalid_argument(text);
+					return value;
+				}
+
+				// prepare() runs before every timed call of func() and is not measured
+				template<typename Prepare, typename Func>
+				double measureBest(uint32_t repeat, Prepare prepare, Func func)
+				{
+					double best = std::numeric_limits<double>::max();
+					for (uint32_t i = 0; i < math::max(repeat, 1U); i++)
+					{
+						prepare();
+						auto begin = std::chrono::steady_clock::now();
+						func();
+						auto end = std::chrono::steady_clock::now();
+						best = math::min(best, std::chrono::duration<double>(end - begin).count());
+					}
+					return best;
+				}
+
+				template<typename Func>
+				double measureBest(uint32_t repeat, Func func)
+				{
+					return measureBest(repeat, []() {}, func);
+				}
+
+				struct BenchVertex
+				{
+					vec4 mPosition;
+					vec4 mTexCoord;
+				};
+
+				struct BenchPushConstants
+				{
+					vec4  mColor;
+					float mLod;
+				};
+
+				inline void benchVertexShader(const ShaderResources& resources, const ShaderVertexPhaseInput& input, ShaderVertexPhaseOutput& output)
+				{
+					auto vertex = (const BenchVertex*)input.mAttributes;
+					output.mPosition = vertex->mPosition;
+					output.mAttributes[0] = vertex->mTexCoord;
+				}
+
+				inline void benchPositionShader(const ShaderResources& resources, const ShaderVertexPhaseInput& input, ShaderVertexPhaseOutput& output)
+				{
+					output.mPosition = *(const vec4*)input.mAttributes;
+					output.mAttributes[0] = vec4(0.0f);
+				}
+
+				inline void benchFlatShader(const ShaderResources& resources, const ShaderFragmentPhaseInput& input, ShaderFragmentPhaseOutput& output)
+				{
+					output.mColors[0] = ((const BenchPushConstants*)resources.mPushContants)->mColor;
+				}
+
+				inline void benchTextureShader(const ShaderResources& resources, const ShaderFragmentPhaseInput& input, ShaderFragmentPhaseOutput& output)
+				{
+					auto constants = (const BenchPushConstants*)resources.mPushContants;
+					output.mColors[0] = resources.mSamplers[0].texture2D(resources.mImages[0], input.mAttributes[0].xy, constants->mLod, 0);
+				}
+
+				// offscreen color + depth target with the pipelines every raster workload needs
+				struct RasterScene
+				{
+					Device          mDevice;
+					GraphicsContext mContext;
+					Image           mColor;
+					Image           mDepth;
+					Memory          mColorMemory;
+					Memory          mDepthMemory;
+					FrameBuffer     mFrameBuffer;
+					Shader          mFlatShader;
+					Shader          mTextureShader;
+					Shader          mPositionShader;
+					Pipeline        mFlatPipeline;
+					Pipeline        mTexturePipeline;
+					Pipeline        mPositionPipeline;
+					Buffer          mQuadBuffer;
+					Memory          mQuadMemory;
+					uint32_t        mQuadCount;
+				};
+
+				inline void initRasterScene(RasterScene& scene, const Device& device, uint32_t width, uint32_t height, uint32_t maxQuads)
+				{
+					scene.mDevice = device;
+					scene.mContext = createGraphicsContext(device);
+					scene.mColor = createImage(width, height, 1, 1, ImageType::eImage2D, ImageFormat::eR8G8B8A8_UNORM, 1, 1);
+					scene.mColorMemory = createMemory(scene.mColor.size());
+					scene.mColor.bindMemory(scene.mColorMemory, 0);
+					scene.mDepth = createImage(width, height, 1, 1, ImageType::eImage2D, ImageFormat::eD32_SFLOAT, 1, 1);
+					scene.mDepthMemory = createMemory(scene.mDepth.size());
+					scene.mDepth.bindMemory(scene.mDepthMemory, 0);
+					scene.mFrameBuffer = createFrameBuffer();
+					scene.mFrameBuffer.bindColorTarget(scene.mColor);
+					scene.mFrameBuffer.bindDepthTarget(scene.mDepth);
+
+					scene.mFlatShader = createShader(benchVertexShader, benchFlatShader);
+					scene.mTextureShader = createShader(benchVertexShader, benchTextureShader);
+					scene.mPositionShader = createShader(benchPositionShader, benchFlatShader);
+					scene.mFlatPipeline = createPipeline(scene.mFlatShader, sizeof(BenchVertex));
+					scene.mTexturePipeline = createPipeline(scene.mTextureShader, sizeof(BenchVertex));
+					scene.mPositionPipeline = createPipeline(scene.mPositionShader, sizeof(vec4));
+
+					// full screen quads, quad i sits at depth i / maxQuads
+					scene.mQuadCount = maxQuads;
+					scene.mQuadBuffer = createBuffer(sizeof(BenchVertex) * 6 * maxQuads);
+					scene.mQuadMemory = createMemory(scene.mQuadBuffer.size());
+					scene.mQuadBuffer.bindMemory(scene.mQuadMemory, 0);
+					auto vertices = (BenchVertex*)scene.mQuadMemory.data();
+					const vec2 corners[6] = { vec2(-1, -1), vec2(1, -1), vec2(1, 1), vec2(-1, -1), vec2(1, 1), vec2(-1, 1) };
+					for (uint32_t q = 0; q < maxQuads; q++)
+					{
+						float depth = (q + 0.5f) / maxQuads;
+						for (int i = 0; i < 6; i++)
+						{
+							vertices[q * 6 + i].mPosition = vec4(corners[i].x, corners[i].y, depth, 1.0f);
+							vertices[q * 6 + i].mTexCoord = vec4(corners[i].x * 0.5f + 0.5f, corners[i].y * 0.5f + 0.5f, 0.0f, 0.0f);
+						}
+					}
+				}
+
+				inline void clearRasterScene(RasterScene& scene)
+				{
+					scene.mDevice.waitDevice();
+					destroyPipeline(scene.mFlatPipeline);
+					destroyPipeline(scene.mTexturePipeline);
+					destroyPipeline(scene.mPositionPipeline);
+					destroyShader(scene.mFlatShader);
+					destroyShader(scene.mTextureShader);
+					destroyShader(scene.mPositionShader);
+					destroyFrameBuffer(scene.mFrameBuffer);
+					destroyImage(scene.mColor);
+					destroyImage(scene.mDepth);
+					destroyMemory(scene.mColorMemory);
+					destroyMemory(scene.mDepthMemory);
+					destroyBuffer(scene.mQuadBuffer);
+					destroyMemory(scene.mQuadMemory);
+					destroyGraphicsContext(scene.mContext);
+				}
+
+				// draws quads [first, first + count), in reverse order when backToFront is false
+				inline void drawQuads(RasterScene& scene, const Pipeline& pipeline, uint32_t first, uint32_t count, bool backToFront = true)
+				{
+					auto& context = scene.mContext;
+					BenchPushConstants constants = { vec4(0.8f, 0.4f, 0.2f, 0.5f), 0.0f };
+					context.pushConstants(&constants, sizeof(constants));
+					context.bindFrameBuffer(scene.mFrameBuffer);
+					context.bindPipeline(pipeline);
+					context.bindVertexBuffer(scene.mQuadBuffer);
+					for (uint32_t i = 0; i < count; i++)
+					{
+						uint32_t quad = backToFront ? first + count - 1 - i : first + i;
+						context.drawVertex(6, 1, quad * 6, 0);
+					}
+					scene.mDevice.waitDevice();
+				}
+
+				inline void resetTargets(RasterScene& scene)
+				{
+					imgClear(scene.mColor, vec4(0.0f));
+					imgClear(scene.mDepth, vec4(1.0f));
+				}
+
+
+				// procedural UV sphere, vec3 positions with a vec4 stride so it can also feed the raster pipelines
+				struct Mesh
+				{
+					Buffer   mVertexBuffer;
+					Memory   mVertexMemory;
+					Buffer   mIndexBuffer;
+					Memory   mIndexMemory;
+					uint32_t mVertexCount;
+					uint32_t mTriangleCount;
+				};
+
+				inline Mesh createSphereMesh(uint32_t rings, uint32_t segments)
+				{
+					Mesh mesh;
+					mesh.mVertexCount = (rings + 1) * (segments + 1);
+					mesh.mTriangleCount = rings * segments * 2;
+					mesh.mVertexBuffer = createBuffer(sizeof(vec4) * mesh.mVertexCount);
+					mesh.mVertexMemory = createMemory(mesh.mVertexBuffer.size());
+					mesh.mVertexBuffer.bindMemory(mesh.mVertexMemory, 0);
+					mesh.mIndexBuffer = createBuffer(sizeof(uint32_t) * 3 * mesh.mTriangleCount);
+					mesh.mIndexMemory = createMemory(mesh.mIndexBuffer.size());
+					mesh.mIndexBuffer.bindMemory(mesh.mIndexMemory, 0);
+
+					auto vertices = (vec4*)mesh.mVertexMemory.data();
+					for (uint32_t r = 0; r <= rings; r++)
+					{
+						float theta = math::pi<float>() * r / rings;
+						for (uint32_t s = 0; s <= segments; s++)
+						{
+							float phi = 2.0f * math::pi<float>() * s / segments;
+							vertices[r * (segments + 1) + s] = vec4(math::sin(theta) * math::cos(phi), math::cos(theta), math::sin(theta) * math::sin(phi), 1.0f);
+						}
+					}
+					auto indices = (uint32_t*)mesh.mIndexMemory.data();
+					for (uint32_t r = 0; r < rings; r++)
+					{
+						for (uint32_t s = 0; s < segments; s++)
+						{
+							uint32_t i0 = r * (segments + 1) + s, i1 = i0 + 1, i2 = i0 + segments + 1, i3 = i2 + 1;
+							*indices++ = i0; *indices++ = i2; *indices++ = i1;
+							*indices++ = i1; *indices++ = i2; *indices++ = i3;
+						}
+					}
+					return mesh;
+				}
+
+				inline void destroyMesh(Mesh& mesh)
+				{
+					destroyBuffer(mesh.mVertexBuffer);
+					destroyBuffer(mesh.mIndexBuffer);
+					destroyMemory(mesh.mVertexMemory);
+					destroyMemory(mesh.mIndexMemory);
+				}
+
+				// screen covering grid of small triangles, drawn through the index buffer
+				inline Mesh createGridMesh(uint32_t triangleCount)
+				{
+					uint32_t side = math::max(uint32_t(math::sqrt(triangleCount * 0.5f)), 1U);
+					uint32_t cells = math::max(triangleCount / 2, 1U);
+					Mesh mesh;
+					mesh.mVertexCount = (side + 1) * (cells / side + 2);
+					mesh.mTriangleCount = cells * 2;
+					mesh.mVertexBuffer = createBuffer(sizeof(vec4) * mesh.mVertexCount);
+					mesh.mVertexMemory = createMemory(mesh.mVertexBuffer.size());
+					mesh.mVertexBuffer.bindMemory(mesh.mVertexMemory, 0);
+					mesh.mIndexBuffer = createBuffer(sizeof(uint32_t) * 3 * mesh.mTriangleCount);
+					mesh.mIndexMemory = createMemory(mesh.mIndexBuffer.size());
+					mesh.mIndexBuffer.bindMemory(mesh.mIndexMemory, 0);
+
+					uint32_t rows = mesh.mVertexCount / (side + 1);
+					auto vertices = (vec4*)mesh.mVertexMemory.data();
+					for (uint32_t y = 0; y < rows; y++)
+						for (uint32_t x = 0; x <= side; x++)
+							vertices[y * (side + 1) + x] = vec4(2.0f * x / side - 1.0f, 2.0f * y / (rows - 1) - 1.0f, 0.5f, 1.0f);
+					auto indices = (uint32_t*)mesh.mIndexMemory.data();
+					for (uint32_t c = 0; c < cells; c++)
+					{
+						uint32_t x = c % side, y = c / side;
+						uint32_t i0 = y * (side + 1) + x, i1 = i0 + 1, i2 = i0 + side + 1, i3 = i2 + 1;
+						*indices++ = i0; *indices++ = i1; *indices++ = i2;
+						*indices++ = i1; *indices++ = i3; *indices++ = i2;
+					}
+					return mesh;
+				}
+
+
+				struct RayTraceBenchData
+				{
+					RayTraceTopLevelAccelerationStructure mScene;
+					Image                                 mTarget;
+					vec3                                  mEye;
+					vec3                                  mLightDirection;
+					bool                                  mShadows;
+					std::atomic<uint64_t>                 mRayCount;
+				};
+
+				inline void benchRayGenShader(const RayTraceShaderResources& resources, RayTraceShaderPayload& payload, const RayTraceCaller& caller, const RayTraceShaderRayGenPhaseInput& input)
+				{
+					auto data = (RayTraceBenchData*)resources.mUserDatas[0];
+					vec2 uv = (vec2(input.mLaunchID) + 0.5f) / vec2(input.mLaunchSize) * 2.0f - 1.0f;
+					vec3 direction = math::normalize(vec3(uv.x, -uv.y, 1.5f));
+					float t = caller.traceRay(data->mScene, data->mEye, direction, 0.001f, 1e30f);
+					uint64_t rays = 1;
+					float shade = t >= 0.0f ? 1.0f : 0.0f;
+					if (t >= 0.0f && data->mShadows)
+					{
+						vec3 hit = data->mEye + direction * (t * 0.999f);
+						if (caller.anyHit(data->mScene, hit, data->mLightDirection, 0.001f, 1e30f))
+							shade = 0.3f;
+						rays++;
+					}
+					caller.imageStore(data->mTarget, input.mLaunchID, vec4(shade, shade, shade, 1.0f));
+					data->mRayCount.fetch_add(rays, std::memory_order_relaxed);
+				}
+
+				inline void benchClosestHitShader(const RayTraceShaderResources& resources, RayTraceShaderPayload& payload, const RayTraceCaller& caller, const RayTraceResult& result)
+				{
+				}
+
+
+				class BenchmarkRunner
+				{
+				private:
+					const BenchmarkOptions&       m_options;
+					std::vector<BenchmarkResult>& m_results;
+				public:
+					BenchmarkRunner(const BenchmarkOptions& options, std::vector<BenchmarkResult>& results)
+						: m_options(options), m_results(results) { }
+
+					bool enabled(const std::string& name) const
+					{
+						return m_options.mFilter.empty() || name.find(m_options.mFilter) != std::string::npos;
+					}
+
+					void report(const std::string& name, const std::string& unit, uint32_t threads, double value, double seconds)
+					{
+						m_results.push_back({ name, unit, threads, value, seconds });
+						if (m_options.mLog != nullptr)
+							*m_options.mLog << name << " [" << threads << " threads] " << value << " " << unit << "\n";
+					}
+
+					uint64_t pixels() const { return uint64_t(m_options.mWidth) * m_options.mHeight; }
+
+					void runRaster(Device& device, uint32_t threads)
+					{
+						RasterScene scene;
+						initRasterScene(scene, device, m_options.mWidth, m_options.mHeight, 16);
+
+						// fill rate: opaque full screen quads
+						if (enabled("fill/quad"))
+						{
+							const uint32_t quads = 8;
+							double seconds = measureBest(m_options.mRepeat, [&]() { drawQuads(scene, scene.mFlatPipeline, 0, quads); });
+							report("fill/quad", "ns/pixel", threads, seconds * 1e9 / (pixels() * quads), seconds);
+						}
+
+						// overdraw: depth tested stacks, back to front always writes, front to back rejects
+						for (uint32_t layers : { 4U, 16U })
+						{
+							for (bool back_to_front : { true, false })
+							{
+								auto name = std::string("overdraw/") + (back_to_front ? "back_to_front/" : "front_to_back/") + std::to_string(layers);
+								if (!enabled(name))
+									continue;
+								scene.mFlatPipeline.enableDepthTest(true);
+								double seconds = measureBest(m_options.mRepeat, [&]() { resetTargets(scene); }, [&]() {
+									drawQuads(scene, scene.mFlatPipeline, 0, layers, back_to_front);
+								});
+								scene.mFlatPipeline.enableDepthTest(false);
+								report(name, "ns/pixel", threads, seconds * 1e9 / (pixels() * layers), seconds);
+							}
+						}
+
+						// alpha blending
+						if (enabled("blend/quad"))
+						{
+							const uint32_t quads = 8;
+							scene.mFlatPipeline.enableColorBlend(true);
+							double seconds = measureBest(m_options.mRepeat, [&]() { drawQuads(scene, scene.mFlatPipeline, 0, quads); });
+							scene.mFlatPipeline.enableColorBlend(false);
+							report("blend/quad", "ns/pixel", threads, seconds * 1e9 / (pixels() * quads), seconds);
+						}
+
+						runTextured(scene, threads);
+						runTriangles(scene, threads);
+						clearRasterScene(scene);
+					}
+
+					void runTextured(RasterScene& scene, uint32_t threads)
+					{
+						const uint32_t size = 1024;
+						const uint32_t levels = 11;
+						auto texture = createImage(size, size, 1, 1, ImageType::eImage2D, ImageFormat::eR8G8B8A8_UNORM, levels, 1);
+						auto memory = createMemory(texture.size());
+						texture.bindMemory(memory, 0);
+						auto texels = (uint32_t*)memory.data();
+						for (uint32_t y = 0; y < size; y++)
+							for (uint32_t x = 0; x < size; x++)
+								texels[y * size + x] = ((x ^ y) & 8) ? 0xFFFFFFFF : 0xFF404040;
+						imgGenMipmap(scene.mDevice, texture, ImageFilter::eBox);
+
+						const SamplerFilterType filters[] = { SamplerFilterType::eNearest, SamplerFilterType::eLinear };
+						const SamplerMipmapMode mip_modes[] = { SamplerMipmapMode::eNearestMipmap, SamplerMipmapMode::eLinearMipmap };
+						for (auto filter : filters)
+						{
+							for (auto mip_mode : mip_modes)
+							{
+								auto name = std::string("texture/") + (filter == SamplerFilterType::eNearest ? "nearest" : "linear")
+									+ (mip_mode == SamplerMipmapMode::eNearestMipmap ? "_mip_nearest" : "_mip_linear");
+								if (!enabled(name))
+									continue;
+								auto sampler = createSampler(filter, SamplerAddressMode::eRepeat, SamplerBorderColor::eBlackFloat, mip_mode, 0.0f, float(levels - 1));
+								scene.mContext.bindSampler(sampler, 0);
+								scene.mContext.bindTexture(texture, 0);
+								const uint32_t quads = 4;
+								double seconds = measureBest(m_options.mRepeat, [&]() {
+									scene.mContext.bindPipeline(scene.mTexturePipeline);
+									BenchPushConstants constants = { vec4(1.0f), 1.5f };
+									scene.mContext.pushConstants(&constants, sizeof(constants));
+									scene.mContext.bindFrameBuffer(scene.mFrameBuffer);
+									scene.mContext.bindVertexBuffer(scene.mQuadBuffer);
+									for (uint32_t q = 0; q < quads; q++)
+										scene.mContext.drawVertex(6, 1, q * 6, 0);
+									scene.mDevice.waitDevice();
+								});
+								destroySampler(sampler);
+								report(name, "ns/pixel", threads, seconds * 1e9 / (pixels() * quads), seconds);
+							}
+						}
+						destroyImage(texture);
+						destroyMemory(memory);
+					}
+
+					// many small triangles, submitted without blocking the way the gui renderer batches them
+					void runTriangles(RasterScene& scene, uint32_t threads)
+					{
+						for (uint32_t count : { 1000U, 10000U, 100000U, 1000000U, 5000000U })
+						{
+							auto name = "triangles/" + std::to_string(count);
+							if (count > m_options.mMaxTriangles || !enabled(name))
+								continue;
+							auto mesh = createGridMesh(count);
+							double seconds = measureBest(m_options.mRepeat, [&]() {
+								scene.mContext.enableNoBlock(true);
+								scene.mContext.bindFrameBuffer(scene.mFrameBuffer);
+								scene.mContext.bindPipeline(scene.mPositionPipeline);
+								scene.mContext.bindVertexBuffer(mesh.mVertexBuffer);
+								scene.mContext.bindIndexBuffer(mesh.mIndexBuffer, IndexType::eUInt32);
+								scene.mContext.drawIndex(mesh.mTriangleCount * 3, 1, 0, 0, 0);
+								scene.mDevice.waitDevice();
+								scene.mContext.enableNoBlock(false);
+							});
+							report(name, "Mtri/s", threads, mesh.mTriangleCount / seconds * 1e-6, seconds);
+							destroyMesh(mesh);
+						}
+					}
+
+					void runRayTrace(Device& device, uint32_t threads)
+					{
+						bool primary = enabled("raytrace/primary");
+						bool shadow = enabled("raytrace/shadow");
+						if (!primary && !shadow)
+							return;
+
+						// a 4x4 grid of sphere instances sharing one bottom level structure
+						auto mesh = createSphereMesh(64, 128);
+						auto blas = createRayTraceBottomLevelAccelerationStructure(mesh.mVertexBuffer, mesh.mVertexCount, sizeof(vec4), 0,
+							mesh.mIndexBuffer, mesh.mTriangleCount * 3, IndexType::eUInt32);
+						std::vector<RayTraceAccelerationStructureInstanceCreateInfo> instances(16);
+						for (uint32_t i = 0; i < 16; i++)
+						{
+							instances[i].mTransform = math::translate(vec3((i % 4) * 2.5f - 3.75f, (i / 4) * 2.5f - 3.75f, 8.0f));
+							instances[i].mBLAS = blas;
+							instances[i].mShaderIndex = 0;
+							instances[i].mMask = 0xFF;
+						}
+						auto tlas = createRayTraceTopLevelAccelerationStructure(instances.data(), uint32_t(instances.size()));
+
+						RayTraceShaderRayClosestHitPhaseFunc closest_hit = benchClosestHitShader;
+						auto shader = createRayTraceShader(benchRayGenShader, &closest_hit, 1, nullptr);
+						auto pipeline = createRayTracePipeline(shader);
+						auto context = createRayTrackContext(device);
+						auto target = createImage(m_options.mWidth, m_options.mHeight, 1, 1, ImageType::eImage2D, ImageFormat::eR8G8B8A8_UNORM, 1, 1);
+						auto target_memory = createMemory(target.size());
+						target.bindMemory(target_memory, 0);
+
+						RayTraceBenchData data;
+						data.mScene = tlas;
+						data.mTarget = target;
+						data.mEye = vec3(0.0f);
+						data.mLightDirection = math::normalize(vec3(0.4f, 1.0f, -0.6f));
+						context.bindPipeline(pipeline);
+						context.bindUserData(&data, 0);
+
+						for (bool shadows : { false, true })
+						{
+							if (!(shadows ? shadow : primary))
+								continue;
+							data.mShadows = shadows;
+							uint64_t rays = 0;
+							double seconds = measureBest(m_options.mRepeat, [&]() {
+								data.mRayCount = 0;
+								context.traceRayTiled(m_options.mWidth, m_options.mHeight);
+								context.waitDevice();
+								rays = data.mRayCount.load();
+							});
+							report(shadows ? "raytrace/shadow" : "raytrace/primary", "Mrays/s", threads, rays / seconds * 1e-6, seconds);
+						}
+
+						destroyImage(target);
+						destroyMemory(target_memory);
+						destroyRayTrackContext(context);
+						destroyRayTracePipeline(pipeline);
+						destroyRayTraceShader(shader);
+						destroyRayTraceTopLevelAccelerationStructure(tlas);
+						destroyRayTraceBottomLevelAccelerationStructure(blas);
+						destroyMesh(mesh);
+					}
+
+					// the BVH builder is single threaded, it runs once outside the thread sweep
+					void runBVHBuild()
+					{
+						for (uint32_t rings : { 64U, 256U, 512U })
+						{
+							auto mesh = createSphereMesh(rings, rings * 2);
+							auto name = "bvh/" + std::to_string(mesh.mTriangleCount);
+							if (enabled(name) && mesh.mTriangleCount <= m_options.mMaxTriangles)
+							{
+								double seconds = measureBest(m_options.mRepeat, [&]() {
+									auto blas = createRayTraceBottomLevelAccelerationStructure(mesh.mVertexBuffer, mesh.mVertexCount, sizeof(vec4), 0,
+										mesh.mIndexBuffer, mesh.mTriangleCount * 3, IndexType::eUInt32);
+									destroyRayTraceBottomLevelAccelerationStructure(blas);
+								});
+								report(name, "Mtri/s", 1, mesh.mTriangleCount / seconds * 1e-6, seconds);
+							}
+							destroyMesh(mesh);
+						}
+					}
+
+					void runMipmap(Device& device, uint32_t threads)
+					{
+						const uint32_t size = 2048;
+						const ImageFilter filters[] = { ImageFilter::eBox, ImageFilter::eKaiser, ImageFilter::eLanczos };
+						const char* filter_names[] = { "box", "kaiser", "lanczos" };
+						for (int f = 0; f < 3; f++)
+						{
+							auto name = std::string("mipmap/") + filter_names[f];
+							if (!enabled(name))
+								continue;
+							auto image = createImage(size, size, 1, 1, ImageType::eImage2D, ImageFormat::eR8G8B8A8_UNORM, 12, 1);
+							auto memory = createMemory(image.size());
+							image.bindMemory(memory, 0);
+							auto texels = (uint8_t*)memory.data();
+							for (size_t i = 0; i < size_t(size) * size * 4; i++)
+								texels[i] = uint8_t(i * 2654435761u >> 24);
+							double seconds = measureBest(m_options.mRepeat, [&]() { imgGenMipmap(device, image, filters[f]); });
+							report(name, "ns/pixel", threads, seconds * 1e9 / (double(size) * size), seconds);
+							destroyImage(image);
+							destroyMemory(memory);
+						}
+					}
+				};
+			}
+
+
+			inline std::vector<BenchmarkResult> runBenchmarks(const BenchmarkOptions& options)
+			{
+				std::vector<BenchmarkResult> results;
+				detail::BenchmarkRunner runner(options, results);
+				auto thread_counts = options.mThreadCounts;
+				if (thread_counts.empty())
+				{
+					uint32_t hardware = math::max(std::thread::hardware_concurrency(), 1U);
+					for (uint32_t count = 1; count < hardware; count *= 2)
+						thread_counts.push_back(count);
+					thread_counts.push_back(hardware);
+				}
+
+				auto device = createDevice();
+				for (auto threads : thread_counts)
+				{
+					// benchmarkMain() rejects counts outside 1..48, the clamp only guards direct callers
+					device.resetDevice(math::clamp(threads, 1U, 48U));
+					runner.runRaster(device, threads);
+					runner.runRayTrace(device, threads);
+					runner.runMipmap(device, threads);
+				}
+				runner.runBVHBuild();
+				destroyDevice(device);
+				return results;
+			}
+
+
+			inline bool writeBenchmarkCsv(const std::vector<BenchmarkResult>& results, const char* filename)
+			{
+				std::ofstream file(filename, std::ios::out | std::ios::trunc);
+				if (!file.is_open())
+					return false;
+				file << "name,unit,threads,value,seconds\n";
+				file.precision(9);
+				for (auto& result : results)
+					file << result.mName << "," << result.mUnit << "," << result.mThreads << "," << result.mValue << "," << result.mSeconds << "\n";
+				file.close();
+				return !file.fail();
+			}
+
+			// false when the file cannot be opened or a line is not a result written by writeBenchmarkCsv()
+			inline bool readBenchmarkCsv(const char* filename, std::vector<BenchmarkResult>& results)
+			{
+				results.clear();
+				std::ifstream file(filename);
+				std::string line;
+				if (!std::getline(file, line))   // header
+					return false;
+				while (std::getline(file, line))
+				{
+					if (line.empty() || line == "\r")
+						continue;
+					std::stringstream stream(line);
+					BenchmarkResult result;
+					std::string threads, value, seconds;
+					if (!std::getline(stream, result.mName, ',') || !std::getline(stream, result.mUnit, ',') ||
+						!std::getline(stream, threads, ',') || !std::getline(stream, value, ',') || !std::getline(stream, seconds))
+						return false;
+					if (!seconds.empty() && seconds.back() == '\r')
+						seconds.pop_back();
+					try
+					{
+						result.mThreads = detail::parseUnsigned(threads);
+						result.mValue = detail::parseDouble(value);
+						result.mSeconds = detail::parseDouble(seconds);
+					}
+					catch (const std::exception&)
+					{
+						return false;
+					}
+					results.push_back(result);
+				}
+				return !file.bad();
+			}
+
+			// one record per run plus a per-workload thread scaling curve (speedup over the lowest thread count)
+			inline bool writeBenchmarkJson(const std::vector<BenchmarkResult>& results, const char* filename)
+			{
+				std::ofstream file(filename, std::ios::out | std::ios::trunc);
+				if (!file.is_open())
+					return false;
+				file.precision(9);
+				file << "{\n\t\"results\": [\n";
+				for (size_t i = 0; i < results.size(); i++)
+				{
+					auto& result = results[i];
+					file << "\t\t{\"name\": \"" << result.mName << "\", \"unit\": \"" << result.mUnit << "\", \"threads\": " << result.mThreads
+						<< ", \"value\": " << result.mValue << ", \"seconds\": " << result.mSeconds << (i + 1 < results.size() ? "},\n" : "}\n");
+				}
+				file << "\t],\n\t\"scaling\": {";
+				std::vector<std::string> names;
+				for (auto& result : results)
+					if (std::find(names.begin(), names.end(), result.mName) == names.end())
+						names.push_back(result.mName);
+				for (size_t n = 0; n < names.size(); n++)
+				{
+					const BenchmarkResult* reference = nullptr;
+					for (auto& result : results)
+						if (result.mName == names[n] && (reference == nullptr || result.mThreads < reference->mThreads))
+							reference = &result;
+					file << (n > 0 ? ",\n" : "\n") << "\t\t\"" << names[n] << "\": [";
+					bool first = true;
+					for (auto& result : results)
+					{
+						if (result.mName != names[n])
+							continue;
+						file << (first ? "" : ", ") << "[" << result.mThreads << ", " << reference->mSeconds / result.mSeconds << "]";
+						first = false;
+					}
+					file << "]";
+				}
+				file << "\n\t}\n}\n";
+				file.close();
+				return !file.fail();
+			}
+
+			// workloads (matched by name and thread count) that got worse than the baseline by more than tolerance
+			inline std::vector<BenchmarkRegression> compareBenchmarkBaseline(
+				const std::vector<BenchmarkResult>& results,
+				const std::vector<BenchmarkResult>& baseline,
+				double tolerance = 0.1
+			)
+			{
+				std::vector<BenchmarkRegression> regressions;
+				for (auto& result : results)
+				{
+					for (auto& base : baseline)
+					{
+						if (base.mName != result.mName || base.mThreads != result.mThreads || base.mUnit != result.mUnit || base.mValue <= 0.0)
+							continue;
+						double change = detail::higherIsBetter(result.mUnit) ? base.mValue / result.mValue - 1.0 : result.mValue / base.mValue - 1.0;
+						if (change > tolerance)
+							regressions.push_back({ result, base.mValue, change });
+						break;
+					}
+				}
+				return regressions;
+			}
+
+
+			inline void printBenchmarkUsage(std::ostream& out, const char* program)
+			{
+				out << "usage: " << program << " [options]\n"
+					<< "  --threads 1,2,4       thread counts from 1 to 48, default 1, 2, 4 ... hardware threads\n"
+					<< "  --size WxH            render target size, default 1024x1024\n"
+					<< "  --repeat N            best of N runs is reported, default 3\n"
+					<< "  --max-triangles N     triangle budget of the mesh workloads\n"
+					<< "  --filter name         only run workloads whose name contains this\n"
+					<< "  --csv file            write the results as CSV\n"
+					<< "  --json file           write the results as JSON\n"
+					<< "  --baseline file       compare with a CSV written by --csv\n"
+					<< "  --tolerance 0.1       relative slowdown reported as a regression\n"
+					<< "  --help                print this text\n";
+			}
+
+			/*
+			 * Command line driver, returns 1 when a baseline was given and a workload regressed,
+			 * 2 after printing the usage for an unknown option, a missing or a malformed value,
+			 * 3 when a CSV/JSON file could not be written or the baseline could not be read.
+			 * --help prints the usage and returns 0 without running anything.
+			 * --threads 1,2,4  --size 1024x1024  --repeat 3  --max-triangles N  --filter name
+			 * --csv file  --json file  --baseline file  --tolerance 0.1
+			*/
+			inline int benchmarkMain(int argc, char** argv)
+			{
+				BenchmarkOptions options;
+				std::string csv_file, json_file, baseline_file;
+				double tolerance = 0.1;
+				const char* program = argc > 0 ? argv[0] : "soft3d_bench";
+				auto usage_error = [&](const std::string& message) {
+					std::cerr << message << "\n";
+					printBenchmarkUsage(std::cerr, program);
+					return 2;
+				};
+				for (int i = 1; i < argc; i++)
+				{
+					std::string key = argv[i];
+					if (key == "--help" || key == "-h")
+					{
+						printBenchmarkUsage(std::cout, program);
+						return 0;
+					}
+					if (key != "--threads" && key != "--size" && key != "--repeat" && key != "--max-triangles" && key != "--filter" &&
+						key != "--csv" && key != "--json" && key != "--baseline" && key != "--tolerance")
+						return usage_error("unknown option " + key);
+					if (i + 1 >= argc)
+						return usage_error("missing value for " + key);
+					std::string value = argv[++i];
+					try
+					{
+						if (key == "--threads")
+						{
+							std::stringstream stream(value);
+							std::string item;
+							while (std::getline(stream, item, ','))
+							{
+								// the device runs 1 to 48 threads, anything else would be reported under a count that never ran
+								auto count = detail::parseUnsigned(item);
+								if (count == 0 || count > 48)
+									throw std::out_of_range(item);
+								options.mThreadCounts.push_back(count);
+							}
+							if (options.mThreadCounts.empty() || value.back() == ',')
+								throw std::invalid_argument(value);
+						}
+						else if (key == "--size")
+						{
+							auto split = value.find('x');
+							options.mWidth = detail::parseUnsigned(value.substr(0, split));
+							options.mHeight = split == std::string::npos ? options.mWidth : detail::parseUnsigned(value.substr(split + 1));
+							if (options.mWidth == 0 || options.mHeight == 0)
+								throw std::out_of_range(value);
+						}
+						else if (key == "--repeat")
+						{
+							options.mRepeat = detail::parseUnsigned(value);
+							if (options.mRepeat == 0)
+								throw std::out_of_range(value);
+						}
+						else if (key == "--max-triangles")
+							options.mMaxTriangles = detail::parseUnsigned(value);
+						else if (key == "--filter")
+							options.mFilter = value;
+						else if (key == "--csv")
+							csv_file = value;
+						else if (key == "--json")
+							json_file = value;
+						else if (key == "--baseline")
+							baseline_file = value;
+						else if (key == "--tolerance")
+						{
+							tolerance = detail::parseDouble(value);
+							if (!(tolerance >= 0.0))
+								throw std::out_of_range(value);
+						}
+					}
+					catch (const std::exception&)
+					{
+						return usage_error("invalid value " + value + " for " + key);
+					}
+				}
+
+				// read the baseline first, a bad path should not cost a whole run
+				std::vector<BenchmarkResult> baseline;
+				if (!baseline_file.empty() && !readBenchmarkCsv(baseline_file.c_str(), baseline))
+				{
+					std::cerr << "cannot read baseline " << baseline_file << "\n";
+					return 3;
+				}
+
+				auto results = runBenchmarks(options);
+				int status = 0;
+				if (!csv_file.empty() && !writeBenchmarkCsv(results, csv_file.c_str()))
+				{
+					std::cerr << "cannot write " << csv_file << "\n";
+					status = 3;
+				}
+				if (!json_file.empty() && !writeBenchmarkJson(results, json_file.c_str()))
+				{
+					std::cerr << "cannot write " << json_file << "\n";
+					status = 3;
+				}
+				if (baseline_file.empty())
+					return status;
+
+				auto regressions = compareBenchmarkBaseline(results, baseline, tolerance);
+				for (auto& regression : regressions)
+					std::cout << "REGRESSION " << regression.mCurrent.mName << " [" << regression.mCurrent.mThreads << " threads] "
+						<< regression.mCurrent.mValue << " " << regression.mCurrent.mUnit << " vs baseline " << regression.mBaseline
+						<< " (" << int(regression.mChange * 100.0) << "% worse)\n";
+				return status != 0 ? status : regressions.empty() ? 0 : 1;
+			}
+
+
+		}
+	}
+}
@@ -0,0 +1,236 @@
+#pragma once
+#include "../Soft3D.h"
+#include "../ImageOps.h"
+#include "../../core/test/TestCheck.h"
+#include <vector>
+
+
+
+/*
+ Fast clears a colour and a depth target, draws over part of them and checks that untouched texels
+ are neither written by the draw nor read from memory by the depth test and blending, then that
+ resolving, imgTrans and an offscreen readback produce the clear value there. Also clears a non-zero
+ mip level and layer and checks the other subresources stay as they were.
+*/
+void testFastClear()
+{
+	using namespace CraftEngine;
+	using namespace CraftEngine::soft3d;
+
+	test::TestCheck check("testFastClear");
+
+	const uint32_t width = 64, height = 48;
+	const vec4 clear_color = vec4(0.0f, 0.0f, 1.0f, 1.0f);
+	const byte sentinel = 0xCD;
+	auto device = createDevice();
+	auto context = createGraphicsContext(device);
+
+	// two quads: the left half at depth 0.5 in red, the upper rows at depth 0.75 in half transparent green
+	auto shader = createShader(
+		[](const ShaderResources& resources, const ShaderVertexPhaseInput& input, ShaderVertexPhaseOutput& output) {
+			output.mPosition = *(const vec4*)input.mAttributes;
+		},
+		[](const ShaderResources& resources, const ShaderFragmentPhaseInput& input, ShaderFragmentPhaseOutput& output) {
+			output.mColors[0] = *(const vec4*)resources.mPushContants;
+		});
+	auto pipeline = createPipeline(shader, sizeof(vec4));
+	pipeline.enableDepthTest(true);
+	Buffer quads[2] = { createBuffer(sizeof(vec4) * 6), createBuffer(sizeof(vec4) * 6) };
+	auto quads_memory = createMemory(sizeof(vec4) * 12);
+	quads[0].bindMemory(quads_memory, 0);
+	quads[1].bindMemory(quads_memory, sizeof(vec4) * 6);
+	{
+		auto vertices = (vec4*)quads_memory.data();
+		auto quad = [&](vec4* out, vec2 lo, vec2 hi, float depth) {
+			const vec2 corners[6] = { vec2(lo.x, lo.y), vec2(hi.x, lo.y), vec2(hi.x, hi.y), vec2(lo.x, lo.y), vec2(hi.x, hi.y), vec2(lo.x, hi.y) };
+			for (int i = 0; i < 6; i++)
+				out[i] = vec4(corners[i].x, corners[i].y, depth, 1.0f);
+		};
+		quad(vertices, vec2(-1.0f, -1.0f), vec2(0.0f, 1.0f), 0.5f);
+		quad(vertices + 6, vec2(-1.0f, -1.0f), vec2(1.0f, 0.0f), 0.75f);
+	}
+	auto draw = [&](const FrameBuffer& frameBuffer) {
+		context.bindFrameBuffer(frameBuffer);
+		vec4 red = vec4(1.0f, 0.0f, 0.0f, 1.0f), green = vec4(0.0f, 1.0f, 0.0f, 0.5f);
+		pipeline.enableColorBlend(false);
+		context.bindPipeline(pipeline);
+		context.bindVertexBuffer(quads[0]);
+		context.pushConstants(&red, sizeof(red));
+		context.drawVertex(6, 1, 0, 0);
+		device.waitDevice();
+		pipeline.enableColorBlend(true);
+		context.bindPipeline(pipeline);
+		context.bindVertexBuffer(quads[1]);
+		context.pushConstants(&green, sizeof(green));
+		context.drawVertex(6, 1, 0, 0);
+		device.waitDevice();
+	};
+
+	// regions away from the quad edges: left is red, upper right is green over the clear colour,
+	// lower right is never touched
+	enum Region { eLeft, eUpperRight, eLowerRight, eEdge };
+	auto region = [&](uint32_t x, uint32_t y) {
+		if (x + 1 < width / 2)
+			return eLeft;
+		if (x <= width / 2 + 1 || (y + 1 >= height / 2 && y <= height / 2 + 1))
+			return eEdge;
+		return y < height / 2 ? eUpperRight : eLowerRight;
+	};
+	const u8vec4 expected[3] = { u8vec4(255, 0, 0, 255), u8vec4(0, 128, 128, 191), u8vec4(0, 0, 255, 255) };
+	auto near = [](u8vec4 a, u8vec4 b) {
+		for (int c = 0; c < 4; c++)
+			if (std::abs(int(a[c]) - int(b[c])) > 1)
+				return false;
+		return true;
+	};
+	auto check_frame = [&](const char* what, const u8vec4* texels, bool swapped) {
+		bool ok = true;
+		for (uint32_t y = 0; y < height; y++)
+			for (uint32_t x = 0; x < width; x++)
+			{
+				auto r = region(x, y);
+				if (r == eEdge)
+					continue;
+				auto want = expected[r];
+				if (swapped)
+					std::swap(want[0], want[2]);
+				ok &= near(texels[y * width + x], want);
+			}
+		check(what, ok);
+	};
+
+	// clear, partial draw, resolve
+	{
+		auto color = createImage(width, height, 1, 1, ImageType::eImage2D, ImageFormat::eR8G8B8A8_UNORM, 1, 1);
+		auto color_memory = createMemory(color.size());
+		color.bindMemory(color_memory, 0);
+		auto depth = createImage(width, height, 1, 1, ImageType::eImage2D, ImageFormat::eD32_SFLOAT, 1, 1);
+		auto depth_memory = createMemory(depth.size());
+		depth.bindMemory(depth_memory, 0);
+		auto frame_buffer = createFrameBuffer();
+		frame_buffer.bindColorTarget(color);
+		frame_buffer.bindDepthTarget(depth);
+
+		memset(color_memory.data(), sentinel, color.size());
+		memset(depth_memory.data(), sentinel, depth.size());
+		imgFastClear(color, clear_color);
+		imgFastClear(depth, vec4(1.0f));
+		draw(frame_buffer);
+
+		auto texels = (const u8vec4*)color_memory.data();
+		auto depths = (const float*)depth_memory.data();
+		bool untouched = true;
+		for (uint32_t y = 0; y < height; y++)
+			for (uint32_t x = 0; x < width; x++)
+				if (region(x, y) == eLowerRight)
+					untouched &= texels[y * width + x] == u8vec4(sentinel) && ((const byte*)&depths[y * width + x])[0] == sentinel;
+		check("draw writes only covered texels", untouched);
+
+		imgResolveFastClear(color);
+		imgResolveFastClear(depth);
+		check_frame("clear then partial draw", texels, false);
+		bool depth_ok = true;
+		for (uint32_t y = 0; y < height; y++)
+			for (uint32_t x = 0; x < width; x++)
+			{
+				auto r = region(x, y);
+				if (r != eEdge)
+					depth_ok &= depths[y * width + x] == (r == eLeft ? 0.5f : r == eUpperRight ? 0.75f : 1.0f);
+			}
+		check("depth resolve", depth_ok);
+
+		// present path: imgTrans swaps the drawn texels and writes the swapped clear value into the rest
+		memset(color_memory.data(), sentinel, color.size());
+		imgFastClear(color, clear_color);
+		imgFastClear(depth, vec4(1.0f));
+		draw(frame_buffer);
+		imgTrans(color);
+		check_frame("clear then imgTrans", texels, true);
+		imgResolveFastClear(color);
+		check_frame("imgTrans finishes the clear", texels, true);
+
+		destroyFrameBuffer(frame_buffer);
+		destroyImage(color);
+		destroyImage(depth);
+		destroyMemory(color_memory);
+		destroyMemory(depth_memory);
+	}
+
+	// clear, partial draw, offscreen readback
+	{
+		std::vector<u8vec4> frames[2];
+		int frame_count = 0;
+		auto swap_chain = createOffscreenSwapChain(device, width, height, 2, [&](const OffscreenFrame& frame) {
+			auto texels = (const u8vec4*)frame.mData;
+			frames[frame_count++ % 2].assign(texels, texels + width * height);
+		}, true);
+		auto frame_buffer = createFrameBuffer();
+		for (int i = 0; i < 2; i++)
+		{
+			int index = swap_chain.acquireNextImage();
+			auto image = swap_chain.getImage(index);
+			// memory() is const, a copy of the handle gives write access to the bound buffer
+			Memory image_memory = image.memory();
+			memset(image_memory.data(), sentinel, image.size());
+			imgFastClear(image, clear_color);
+			if (i == 0)
+			{
+				imgFastClear(swap_chain.getDepthStencilImage(), vec4(1.0f));
+				frame_buffer.bindColorTarget(image);
+				frame_buffer.bindDepthTarget(swap_chain.getDepthStencilImage());
+				draw(frame_buffer);
+			}
+			swap_chain.presentImage(index);
+			swap_chain.waitIdle();
+		}
+		check("readback frames", frame_count == 2);
+		check_frame("clear then readback", frames[0].data(), false);
+		bool cleared = true;
+		for (auto texel : frames[1])
+			cleared &= texel == expected[eLowerRight];
+		check("readback of an undrawn frame", cleared);
+		destroyFrameBuffer(frame_buffer);
+		destroyOffscreenSwapChain(swap_chain);
+	}
+
+	// a non-zero mip level and layer
+	{
+		auto image = createImage(16, 16, 1, 2, ImageType::eImage2DArray, ImageFormat::eR8G8B8A8_UNORM, 3, 1);
+		auto memory = createMemory(image.size());
+		image.bindMemory(memory, 0);
+		memset(memory.data(), sentinel, image.size());
+		auto image_data = (detail::ImageData*)image.handle();
+		auto level = [&](uint32_t mipLevel, uint32_t layer) {
+			auto begin = (const u8vec4*)((const byte*)memory.data() + image_data->mLayerSize * layer + image_data->mLevelOffsets[mipLevel]);
+			return std::vector<u8vec4>(begin, begin + image_data->mLevelExtents[mipLevel].mWidth * image_data->mLevelExtents[mipLevel].mHeight);
+		};
+		auto all = [](const std::vector<u8vec4>& texels, u8vec4 value) {
+			for (auto texel : texels)
+				if (!(texel == value))
+					return false;
+			return true;
+		};
+
+		imgFastClear(image, vec4(1.0f, 0.0f, 0.0f, 1.0f), 1, 1);
+		imgFastClear(image, vec4(0.0f, 1.0f, 0.0f, 1.0f), 2, 0);
+		imgClear(image, vec4(0.0f, 0.0f, 1.0f, 1.0f), 2, 0);
+		check("mip clear is deferred", all(level(1, 1), u8vec4(sentinel)));
+		imgResolveFastClear(image);
+		check("mip 1 layer 1 resolved", all(level(1, 1), u8vec4(255, 0, 0, 255)));
+		check("imgClear discards the fast clear", all(level(2, 0), u8vec4(0, 0, 255, 255)));
+		check("other levels untouched", all(level(0, 0), u8vec4(sentinel)) && all(level(0, 1), u8vec4(sentinel)) &&
+			all(level(1, 0), u8vec4(sentinel)) && all(level(2, 1), u8vec4(sentinel)));
+		destroyImage(image);
+		destroyMemory(memory);
+	}
+
+	destroyBuffer(quads[0]);
+	destroyBuffer(quads[1]);
+	destroyMemory(quads_memory);
+	destroyPipeline(pipeline);
+	destroyShader(shader);
+	destroyGraphicsContext(context);
+	destroyDevice(device);
+
+	check.finish();
+}
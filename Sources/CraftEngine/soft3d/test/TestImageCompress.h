@@ -0,0 +1,132 @@
+#pragma once
+#include "../Sampler.h"
+#include "../../core/test/TestCheck.h"
+#include <random>
+
+
+
+/*
+ Encodes gradient and solid blocks as BC1/BC3/BC4/BC5 and decodes them back within each format's
+ error bound, checks that the block cache tells formats apart, and that clamp-to-border fetches
+ outside a compressed image return the border colour.
+*/
+void testImageCompress()
+{
+	using namespace CraftEngine;
+	using namespace CraftEngine::soft3d;
+
+	test::TestCheck check("testImageCompress");
+	std::mt19937 rng(26);
+
+	// a gradient of `levels` steps between two random colours with a little noise
+	auto gradient_block = [&](u8vec4* texels, int levels)
+	{
+		int from[4], to[4];
+		for (int c = 0; c < 4; c++)
+		{
+			from[c] = rng() % 256;
+			to[c] = rng() % 256;
+		}
+		for (int i = 0; i < detail::CompressedBlockTexelCount; i++)
+		{
+			float t = (i % levels) / float(levels - 1);
+			for (int c = 0; c < 4; c++)
+			{
+				int value = int(from[c] + (to[c] - from[c]) * t + 0.5f) + int(rng() % 5) - 2;
+				texels[i][c] = uint8_t(value < 0 ? 0 : value > 255 ? 255 : value);
+			}
+		}
+	};
+
+	// the steps match the palette sizes: 4 colours for BC1/BC3, 8 values for BC4/BC5 channels.
+	// BC3 alpha is a BC4 channel sampled at thirds, up to 1/14 of its range off the 8 value grid.
+	struct Case { ImageFormat format; int channels[4]; int levels; int tolerance; };
+	const Case cases[] = {
+		{ ImageFormat::eBC1_RGBA_UNORM, { 0, 1, 2, -1 }, 4, 10 },
+		{ ImageFormat::eBC3_RGBA_UNORM, { 0, 1, 2, 3 }, 4, 20 },
+		{ ImageFormat::eBC4_R_UNORM, { 0, -1, -1, -1 }, 8, 6 },
+		{ ImageFormat::eBC5_RG_UNORM, { 0, 1, -1, -1 }, 8, 6 },
+	};
+	for (auto& test_case : cases)
+	{
+		int worst = 0;
+		bool solid = true;
+		for (int n = 0; n < 2000; n++)
+		{
+			u8vec4 texels[detail::CompressedBlockTexelCount], decoded[detail::CompressedBlockTexelCount];
+			byte block[16];
+			gradient_block(texels, test_case.levels);
+			// BC1 keeps alpha only as a 1-bit cut-out
+			if (test_case.format == ImageFormat::eBC1_RGBA_UNORM)
+				for (auto& texel : texels)
+					texel[3] = 255;
+			bool is_solid = n % 10 == 0;
+			if (is_solid)
+				for (auto& texel : texels)
+					texel = texels[0];
+			detail::encodeCompressedBlock(test_case.format, texels, block);
+			detail::decodeCompressedBlock(test_case.format, block, decoded);
+			for (int i = 0; i < detail::CompressedBlockTexelCount; i++)
+				for (int c = 0; c < 4 && test_case.channels[c] >= 0; c++)
+				{
+					int error = std::abs(int(decoded[i][c]) - int(texels[i][c]));
+					worst = std::max(worst, error);
+					// a solid block only loses the endpoint quantization, 5 or 6 bits for BC1 colour
+					if (is_solid && error > 4)
+						solid = false;
+				}
+		}
+		check("round trip error", worst <= test_case.tolerance);
+		check("solid block", solid);
+	}
+
+	// the same block bytes fetched through two formats must not share a cache entry
+	{
+		u8vec4 texels[detail::CompressedBlockTexelCount], as_bc1[detail::CompressedBlockTexelCount], as_bc4[detail::CompressedBlockTexelCount];
+		alignas(16) byte block[16];
+		gradient_block(texels, 4);
+		detail::encodeCompressedBlock(ImageFormat::eBC1_RGBA_UNORM, texels, block);
+		detail::decodeCompressedBlock(ImageFormat::eBC1_RGBA_UNORM, block, as_bc1);
+		detail::decodeCompressedBlock(ImageFormat::eBC4_R_UNORM, block, as_bc4);
+		auto first = detail::fetchCompressedBlock(ImageFormat::eBC1_RGBA_UNORM, block);
+		check("cache bc1", memcmp(first, as_bc1, sizeof(as_bc1)) == 0);
+		auto second = detail::fetchCompressedBlock(ImageFormat::eBC4_R_UNORM, block);
+		check("cache format", memcmp(second, as_bc4, sizeof(as_bc4)) == 0);
+	}
+
+	// clamp to border on a compressed 8x8 image
+	{
+		const uint32_t size = 8;
+		auto image = createImage(size, size, 1, 1, ImageType::eImage2D, ImageFormat::eBC1_RGBA_UNORM, 1, 1);
+		auto memory = createMemory(image.size());
+		image.bindMemory(memory, 0);
+		u8vec4 texels[4][detail::CompressedBlockTexelCount];
+		for (int b = 0; b < 4; b++)
+		{
+			gradient_block(texels[b], 4);
+			detail::encodeCompressedBlock(ImageFormat::eBC1_RGBA_UNORM, texels[b], (byte*)memory.data() + b * 8);
+		}
+		invalidateCompressedBlockCache();
+
+		const SamplerBorderColor borders[] = { SamplerBorderColor::eWhiteFloat, SamplerBorderColor::eBlackFloat, SamplerBorderColor::eWhiteInt, SamplerBorderColor::eBlackInt };
+		const vec2 outside[] = { vec2(-0.05f, 0.5f), vec2(0.5f, -0.05f), vec2(1.05f, 0.4f), vec2(0.4f, 1.05f), vec2(100.0f, -100.0f) };
+		for (auto border : borders)
+		{
+			auto sampler = createSampler(SamplerFilterType::eNearest, SamplerAddressMode::eClampToBorder, border, SamplerMipmapMode::eNearestMipmap, 0.0f, 0.0f);
+			bool white = border == SamplerBorderColor::eWhiteFloat || border == SamplerBorderColor::eWhiteInt;
+			for (auto coord : outside)
+			{
+				auto color = sampler.texture2D(image, coord, 0.0f, 0);
+				check("border colour", color == (white ? vec4(1.0f, 1.0f, 1.0f, 0.0f) : vec4(0.0f)));
+			}
+			auto inside = sampler.texture2D(image, vec2(5.5f, 6.5f) / float(size), 0.0f, 0);
+			auto expected = detail::castCompressedTexelToVector(detail::fetchCompressedTexel((detail::ImageData*)image.handle(), 0, 0, ivec3(5, 6, 0)));
+			check("inside", inside == expected);
+			destroySampler(sampler);
+		}
+		destroyImage(image);
+		destroyMemory(memory);
+	}
+
+	check.finish();
+}